@@ -2,7 +2,7 @@
 
 #ifdef VERTEX_SHADER
 
-layout(location= 0) in vec3 position;
+layout(location= 0) in vec3 position;     // USE_COMPACT : position dans [0 1], decodee par mvpMatrix et mvMatrix
 uniform mat4 mvpMatrix;
 
 uniform mat4 mvMatrix;
@@ -14,7 +14,20 @@ out vec3 vertex_position;
 #endif
 
 #ifdef USE_NORMAL
-    layout(location= 2) in vec3 normal;
+    #ifdef USE_COMPACT
+        // normale en projection octaedrique, cf vertex_codec.h
+        layout(location= 2) in vec2 normal;
+        
+        vec3 oct_decode( const vec2 e )
+        {
+            vec3 n= vec3(e.x, e.y, 1 - abs(e.x) - abs(e.y));
+            if(n.z < 0)
+                n.xy= (1 - abs(n.yx)) * vec2(n.x >= 0 ? 1 : -1, n.y >= 0 ? 1 : -1);
+            return normalize(n);
+        }
+    #else
+        layout(location= 2) in vec3 normal;
+    #endif
     uniform mat4 normalMatrix;
     out vec3 vertex_normal;
 #endif
@@ -36,7 +49,11 @@ void main( )
 #endif
 
 #ifdef USE_NORMAL
-    vertex_normal= mat3(normalMatrix) * normal;
+    #ifdef USE_COMPACT
+        vertex_normal= mat3(normalMatrix) * oct_decode(normal);
+    #else
+        vertex_normal= mat3(normalMatrix) * normal;
+    #endif
 #endif
 
 #ifdef USE_COLOR
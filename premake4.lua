@@ -35,7 +35,9 @@ solution "gKit2light"
 		buildoptions { "-mtune=native -march=native" }
 		buildoptions { "-std=c++11" }
 		buildoptions { "-W -Wall -Wextra -Wsign-compare -Wno-unused-parameter -Wno-unused-function -Wno-unused-variable", "-pipe" }
-		links { "GLEW", "SDL2", "SDL2_image", "GL" }
+		links { "GLEW", "SDL2", "SDL2_image", "GL", "EGL" }
+		buildoptions { "-pthread" }
+		linkoptions { "-pthread" }
     
 	configuration { "linux", "debug" }
 		buildoptions { "-g"}
@@ -195,8 +197,9 @@ tutosM2 = {
 	"tuto_mdi",
 	"tuto_mdi_count",
 	"tuto_stream",
+	"tuto_mipmap",
+	"tuto_bc",
 
-	"tuto_is",
 	"tuto_raytrace_fragment"
 }
 
@@ -209,6 +212,24 @@ for i, name in ipairs(tutosM2) do
 		files { gkit_dir .. "/tutos/M2/" .. name..'.cpp' }
 end
 
+project("tuto_is")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/M2/tuto_is.cpp"}
+	files { gkit_dir .. "/tutos/M2/progressive.cpp"}
+	files { gkit_dir .. "/tutos/M2/progressive.h"}
+
+project("tuto_texture_cache")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/M2/tuto_texture_cache.cpp"}
+	files { gkit_dir .. "/tutos/mesh_data.cpp"}
+	files { gkit_dir .. "/tutos/mesh_data.h"}
+
 project("projet")
     language "C++"
 	kind "ConsoleApp"
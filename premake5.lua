@@ -25,7 +25,9 @@ workspace "gkit2"
 		buildoptions { "-W -Wall -Wextra -Wsign-compare -Wno-unused-parameter -Wno-unused-function -Wno-unused-variable", "-pipe" }
 		buildoptions { "-flto"}
 		linkoptions { "-flto"}
-		links { "GLEW", "SDL2", "SDL2_image", "GL" }
+		links { "GLEW", "SDL2", "SDL2_image", "GL", "EGL" }
+		buildoptions { "-pthread" }
+		linkoptions { "-pthread" }
 
 	configuration { "linux", "debug" }
 		linkoptions { "-g"}	-- bug : premake ne genere pas l'option "-g" pour le linker
@@ -189,7 +191,11 @@ project("mesh_viewer")
 tutosM2 = {
 	"tuto_time",
 	"tuto_mdi",
-	"tuto_is",
+	"tuto_mdi_count",
+	"tuto_stream",
+	"tuto_mipmap",
+	"tuto_bc",
+
 	"tuto_raytrace_fragment"
 }
 
@@ -201,3 +207,21 @@ for i, name in ipairs(tutosM2) do
 		files ( gkit_files )
 		files { gkit_dir .. "/tutos/M2/" .. name..'.cpp' }
 end
+
+project("tuto_is")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/M2/tuto_is.cpp"}
+	files { gkit_dir .. "/tutos/M2/progressive.cpp"}
+	files { gkit_dir .. "/tutos/M2/progressive.h"}
+
+project("tuto_texture_cache")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/M2/tuto_texture_cache.cpp"}
+	files { gkit_dir .. "/tutos/mesh_data.cpp"}
+	files { gkit_dir .. "/tutos/mesh_data.h"}
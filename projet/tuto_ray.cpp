@@ -8,6 +8,9 @@
 #include "mesh.h"
 #include "wavefront.h"
 #include "orbiter.h"
+#include "bvh.h"
+#include "shading_table.h"
+#include "profiler.h"
 
 #include "image.h"
 #include "image_io.h"
@@ -40,18 +43,6 @@ struct Hit
     operator bool( ) const { return (triangle_id != -1); }      // renvoie vrai si l'intersection est initialisee...
 };
 
-// renvoie la normale interpolee d'un triangle.
-Vector normal( const Hit& hit, const TriangleData& triangle )
-{
-    return normalize((1 - hit.u - hit.v) * Vector(triangle.na) + hit.u * Vector(triangle.nb) + hit.v * Vector(triangle.nc));
-}
-
-// renvoie le point d'intersection sur le triangle.
-Point point( const Hit& hit, const TriangleData& triangle )
-{
-    return (1 - hit.u - hit.v) * Point(triangle.a) + hit.u * Point(triangle.b) + hit.v * Point(triangle.c);
-}
-
 // renvoie le point d'intersection sur le rayon
 Point point( const Hit& hit, const Ray& ray )
 {
@@ -99,23 +90,34 @@ struct Triangle
 };
 
 
-// ensemble de triangles. 
-// a remplacer par une vraie structure acceleratrice, un bvh, par exemple
-struct BVH
+// ensemble de triangles, dans l'ordre des feuilles du bvh.
+// les informations de shading sont precalculees dans le meme ordre, cf ShadingTable, hit.triangle_id est l'indice dans l'ordre des feuilles.
+struct Scene
 {
+    BVH bvh;
     std::vector<Triangle> triangles;
+    ShadingTable shading;
     
-    BVH( ) = default;
-    BVH( const Mesh& mesh ) { build(mesh); }
+    Scene( ) = default;
+    Scene( const Mesh& mesh ) { build(mesh); }
     
     void build( const Mesh& mesh )
     {
+        {
+            PROFILE_SCOPE("bvh build");
+            bvh.build(mesh);
+        }
+        {
+            PROFILE_SCOPE("shading build");
+            shading.build(mesh, bvh.primitives());
+        }
+        
         triangles.clear();
-        triangles.reserve(mesh.triangle_count());
-        for(int id= 0; id < mesh.triangle_count(); id++)
+        triangles.reserve(shading.size());
+        for(int i= 0; i < shading.size(); i++)
         {
-            TriangleData data= mesh.triangle(id);
-            triangles.push_back( Triangle(data.a, data.b, data.c, id) );
+            TriangleData data= mesh.triangle(shading.triangle_id(i));
+            triangles.push_back( Triangle(data.a, data.b, data.c, i) );
         }
         
         printf("%d triangles\n", int(triangles.size()));
@@ -126,24 +128,26 @@ struct BVH
     {
         Hit hit;
         float tmax= ray.tmax;
-        for(int id= 0; id < int(triangles.size()); id++)
-            // ne renvoie vrai que si l'intersection existe dans l'intervalle [0 tmax]
-            if(Hit h= triangles[id].intersect(ray, tmax))
+        bvh.intersect(ray.o, ray.d, tmax,
+            [&]( const int id, float& htmax )
             {
-                hit= h;
-                tmax= h.t;
-            }
+                // ne renvoie vrai que si l'intersection existe dans l'intervalle [0 htmax]
+                if(Hit h= triangles[id].intersect(ray, htmax))
+                {
+                    hit= h;
+                    htmax= h.t;
+                    return true;
+                }
+                return false;
+            });
         
-        return hit;        
+        return hit;
     }
     
     bool visible( const Ray& ray ) const
     {
-        for(int id= 0; id < int(triangles.size()); id++)
-            if(triangles[id].intersect(ray, ray.tmax))
-                return false;
-        
-        return true;
+        return !bvh.occluded(ray.o, ray.d, ray.tmax,
+            [&]( const int id, const float tmax ) { return bool(triangles[id].intersect(ray, tmax)); });
     }
 };
 
@@ -252,7 +256,7 @@ struct World
     Vector n;
 };
 
-Color occlusion(const Color &mat, const BVH & bvh, const float &r1, const float &r2, const Vector &pn, const Point &p) {
+Color occlusion(const Color &mat, const Scene & scene, const float &r1, const float &r2, const Vector &pn, const Point &p) {
     World wp(pn);
 
     float phi = 2 * M_PI * r1;
@@ -268,7 +272,7 @@ Color occlusion(const Color &mat, const BVH & bvh, const float &r1, const float
     float cos_theta = std::max(0.f, dot(pn, normalize(dworld)));
     Ray rayS(p + 0.001f * pn, dworld);
 
-    return mat * bvh.visible(rayS);
+    return mat * scene.visible(rayS);
 }
 
 
@@ -280,6 +284,8 @@ int main( const int argc, const char **argv )
     
     if(argc > 1) mesh_filename= argv[1];
     if(argc > 2) orbiter_filename= argv[2];
+    // tuto_ray mesh orbiter trace.json : mesure la construction du bvh et le rendu de chaque ligne
+    if(argc > 3) profiler_enable(true);
     
     printf("%s: '%s' '%s'\n", argv[0], mesh_filename, orbiter_filename);
     
@@ -287,13 +293,13 @@ int main( const int argc, const char **argv )
     Image image(1024, 640);
     
     // charger un objet
-    Mesh mesh= read_mesh(mesh_filename);
+    Mesh mesh= read_indexed_mesh(mesh_filename);
     if(mesh.triangle_count() == 0)
         // erreur de chargement, pas de triangles
         return 1;
     
     // creer l'ensemble de triangles / structure acceleratrice
-    BVH bvh(mesh);
+    Scene scene(mesh);
     Sources sources(mesh);
     
     // charger la camera
@@ -310,12 +316,15 @@ int main( const int argc, const char **argv )
     Transform invImg = Inverse(viewport * projection * view);
 
     auto cpu_start= std::chrono::high_resolution_clock::now();
+    int64_t render_begin= profiler_time();
     
     // parcourir tous les pixels de l'image
     // en parallele avec openMP, un thread par bloc de 16 lignes
 #pragma omp parallel for schedule(dynamic, 1)
     for(int py= 0; py < image.height(); py++)
     {
+        PROFILE_SCOPE("row");
+        
         // nombres aleatoires, version c++11
         std::random_device seed;
         // un generateur par thread... pas de synchronisation
@@ -336,20 +345,19 @@ int main( const int argc, const char **argv )
 
                 Ray ray(o, e);
                 // calculer les intersections
-                if(Hit hit= bvh.intersect(ray))
+                if(Hit hit= scene.intersect(ray))
                 {
-                    const TriangleData& triangle= mesh.triangle(hit.triangle_id);           // recuperer le triangle
-                    const Material& material= mesh.triangle_material(hit.triangle_id);      // et sa matiere
+                    const Material& material= scene.shading.material(hit.triangle_id);     // recuperer la matiere du triangle
 
                     Point p= point(hit, ray);               // point d'intersection
-                    Vector pn= normal(hit, triangle);       // normale interpolee du triangle au point d'intersection
+                    Vector pn= scene.shading.normal(hit.triangle_id, hit.u, hit.v);        // normale interpolee du triangle au point d'intersection
 
                     
                     // retourne la normale pour faire face a la camera / origine du rayon...
                     if(dot(pn, ray.d) > 0)
                         pn= -pn;
 
-                    true_color = true_color + (1.f/N_RAY) * occlusion(material.diffuse, bvh, u01(rng), u01(rng), pn, p);
+                    true_color = true_color + (1.f/N_RAY) * occlusion(material.diffuse, scene, u01(rng), u01(rng), pn, p);
 
                     Color color= Black();
                     for (int i = 0; i < sources.sources.size() ; i++) {
@@ -358,7 +366,7 @@ int main( const int argc, const char **argv )
                         Point esa = sources.sources[i].sample(r1,r2);
                         Vector sn = normalize(cross(sources.sources[i].b - sources.sources[i].a, sources.sources[i].c - sources.sources[i].a));
                         Ray rayS(p + 0.00001 * pn, esa + 0.00001 * sn);
-                        if (bvh.visible(rayS)){
+                        if (scene.visible(rayS)){
                             // accumuler la couleur de l'echantillon
                             if(dot(sn, rayS.d) > 0)
                                 sn= -sn;
@@ -381,11 +389,16 @@ int main( const int argc, const char **argv )
     }
     
     auto cpu_stop= std::chrono::high_resolution_clock::now();
+    if(profiler_enabled())
+        profiler_event("render", render_begin, profiler_time());
     int cpu_time= std::chrono::duration_cast<std::chrono::milliseconds>(cpu_stop - cpu_start).count();
     printf("cpu  %ds %03dms\n", int(cpu_time / 1000), int(cpu_time % 1000));
     
     // enregistrer l'image resultat
     write_image(image, "render.png");
     write_image_hdr(image, "render.hdr");
+    
+    if(argc > 3)
+        profiler_write(argv[3]);
     return 0;
 }
@@ -0,0 +1,70 @@
+
+#ifndef _ALIGNED_H
+#define _ALIGNED_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+
+//! \addtogroup objet3D
+///@{
+
+//! \file
+//! allocateur aligne pour les std::vector, les tableaux commencent sur une ligne de cache.
+
+//! taille d'une ligne de cache.
+#define CACHE_LINE_SIZE 64
+
+//! allocateur aligne sur Alignment octets.
+template < typename T, std::size_t Alignment= CACHE_LINE_SIZE >
+struct AlignedAllocator
+{
+    typedef T value_type;
+
+    template < typename U > struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+    AlignedAllocator( ) {}
+    template < typename U > AlignedAllocator( const AlignedAllocator<U, Alignment>& ) {}
+
+    T *allocate( const std::size_t n )
+    {
+        if(n == 0)
+            return nullptr;
+
+        void *data= nullptr;
+    #ifdef _WIN32
+        data= _aligned_malloc(n * sizeof(T), Alignment);
+    #else
+        if(posix_memalign(&data, Alignment, n * sizeof(T)) != 0)
+            data= nullptr;
+    #endif
+        if(data == nullptr)
+            throw std::bad_alloc();
+        return static_cast<T *>(data);
+    }
+
+    void deallocate( T *data, const std::size_t )
+    {
+    #ifdef _WIN32
+        _aligned_free(data);
+    #else
+        free(data);
+    #endif
+    }
+
+    template < typename U > bool operator== ( const AlignedAllocator<U, Alignment>& ) const { return true; }
+    template < typename U > bool operator!= ( const AlignedAllocator<U, Alignment>& ) const { return false; }
+};
+
+//! tableau aligne sur une ligne de cache.
+template < typename T >
+using aligned_vector= std::vector<T, AlignedAllocator<T> >;
+
+///@}
+#endif
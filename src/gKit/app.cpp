@@ -3,9 +3,13 @@
 
 #include <cstdio>
 #include <cstring>
+#include <chrono>
 
 #include "app.h"
 #include "glcore.h"
+#include "profiler.h"
+#include "texture.h"
+#include "time_stats.h"
 
 
 App::App( const int width, const int height, const int major, const int minor )
@@ -31,12 +35,36 @@ int App::run( )
     // configure openGL
     glViewport(0, 0, window_width(), window_height());
 
+    // mesure les temps cpu et gpu de chaque image, si necessaire, cf GKIT_STATS
+    const char *stats= stats_filename();
+    TimeStats cpu_stats;
+    TimeStats gpu_stats;
+    GLuint time_query= 0;
+    if(stats)
+        glGenQueries(1, &time_query);
+
     // gestion des evenements
     while(events(m_window))
     {
         if(update(global_time(), delta_time()) < 0)
             break;
-        if(render() < 1)
+        
+        if(stats)
+            glBeginQuery(GL_TIME_ELAPSED, time_query);
+        std::chrono::high_resolution_clock::time_point cpu_start= std::chrono::high_resolution_clock::now();
+        
+        int code= 1;
+        {
+            PROFILE_SCOPE("render");
+            PROFILE_GPU_SCOPE("render");
+            code= render();
+        }
+        
+        std::chrono::high_resolution_clock::time_point cpu_stop= std::chrono::high_resolution_clock::now();
+        if(stats)
+            glEndQuery(GL_TIME_ELAPSED);
+        
+        if(code < 1)
             break;
 
         // presenter le resultat
@@ -45,7 +73,28 @@ int App::run( )
         // devrait limiter la consommation sur portable
         glFinish();
         
-        SDL_GL_SwapWindow(m_window);
+        if(stats)
+        {
+            // le resultat de la requete est disponible apres glFinish()
+            GLint64 gpu_time= 0;
+            glGetQueryObjecti64v(time_query, GL_QUERY_RESULT, &gpu_time);
+            gpu_stats.push(float(gpu_time) / 1000000);
+            cpu_stats.push(float(std::chrono::duration_cast<std::chrono::microseconds>(cpu_stop - cpu_start).count()) / 1000);
+        }
+        
+        swap_window(m_window);
+        // marque la fin de l'image pour les mesures, cf profiler.h
+        profiler_frame();
+    }
+    
+    // enregistre la derniere image, cf GKIT_CAPTURE
+    if(headless() && capture_filename())
+        screenshot(capture_filename());
+    
+    if(stats)
+    {
+        glDeleteQueries(1, &time_query);
+        write_time_stats(stats, cpu_stats, gpu_stats);
     }
 
     if(quit() < 0)
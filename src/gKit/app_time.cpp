@@ -1,13 +1,18 @@
 
+#include <cstdio>
 #include <chrono>
 
 #include "app_time.h"
 #include "texture.h"
+#include "profiler.h"
 
 
 AppTime::AppTime( const int width, const int height, const int major, const int minor ) 
-    : App(width, height, major, minor)
+    : App(width, height, major, minor), m_console(), m_query_first(0), m_query_count(0), m_cpu_stats(256), m_gpu_stats(256), m_stats_filename()
 {
+    // GKIT_STATS, cf window.h
+    stats_file(stats_filename());
+    
     // desactive vsync pour les mesures de temps
     SDL_GL_SetSwapInterval(0);
     printf("[Apptime] vsync OFF...\n");
@@ -16,13 +21,46 @@ AppTime::AppTime( const int width, const int height, const int major, const int
 AppTime::~AppTime( ) {}
 
 
+bool AppTime::read_time_query( const bool wait )
+{
+    if(m_query_count == 0)
+        return false;
+
+    GLuint query= m_time_queries[m_query_first];
+    if(!wait)
+    {
+        // le resultat est-il disponible ?
+        GLint available= 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available)
+            return false;
+    }
+
+    GLint64 gpu_time= 0;
+    glGetQueryObjecti64v(query, GL_QUERY_RESULT, &gpu_time);
+    m_gpu_stats.push(float(gpu_time) / 1000000);
+
+    m_query_first= (m_query_first + 1) % TIME_QUERIES;
+    m_query_count--;
+    return true;
+}
+
+
+int AppTime::write_stats( const char *filename ) const
+{
+    return write_time_stats(filename, m_cpu_stats, m_gpu_stats);
+}
+
+
 int AppTime::run( )
 {
     if(m_window == nullptr || m_context == nullptr || init() < 0)
         return -1;
     
-    // requete pour mesurer le temps gpu
-    glGenQueries(1, &m_time_query);
+    // requetes pour mesurer le temps gpu, utilisees a tour de role
+    glGenQueries(TIME_QUERIES, m_time_queries);
+    m_query_first= 0;
+    m_query_count= 0;
     
     // affichage du temps  dans la fenetre
     m_console= create_text();
@@ -36,38 +74,56 @@ int AppTime::run( )
         if(update(global_time(), delta_time()) < 0)
             break;
         
+        // toutes les requetes sont en attente, attendre la plus ancienne...
+        if(m_query_count == TIME_QUERIES)
+            read_time_query(true);
+        
         // mesure le temps d'execution du draw pour le gpu
-        glBeginQuery(GL_TIME_ELAPSED, m_time_query);
+        glBeginQuery(GL_TIME_ELAPSED, m_time_queries[(m_query_first + m_query_count) % TIME_QUERIES]);
         
         // mesure le temps d'execution du draw pour le cpu
         // utilise std::chrono pour mesurer le temps cpu 
         std::chrono::high_resolution_clock::time_point cpu_start= std::chrono::high_resolution_clock::now();
         
-        int code= render();
+        int code= 1;
+        {
+            PROFILE_SCOPE("render");
+            PROFILE_GPU_SCOPE("render");
+            code= render();
+        }
        
         std::chrono::high_resolution_clock::time_point cpu_stop= std::chrono::high_resolution_clock::now();
         // conversion des mesures en duree...
         int cpu_time= std::chrono::duration_cast<std::chrono::microseconds>(cpu_stop - cpu_start).count(); 
+        m_cpu_stats.push(float(cpu_time) / 1000);
 
         glEndQuery(GL_TIME_ELAPSED);
+        m_query_count++;
         
         if(code< 1)
             break;
         
-        // attendre le resultat de la requete
-        GLint64 gpu_time= 0;
-        glGetQueryObjecti64v(m_time_query, GL_QUERY_RESULT, &gpu_time);
+        // recupere les resultats disponibles des images precedentes, sans attendre
+        while(read_time_query(false))
+            {}
         
         // afficher le texte
+        float gpu_time= m_gpu_stats.last();
         clear(m_console);        
         printf(m_console, 0, 1, "cpu  %02dms %03dus", cpu_time / 1000, cpu_time % 1000);
-        printf(m_console, 0, 2, "gpu  %02dms %03dus", int(gpu_time / 1000000), int((gpu_time / 1000) % 1000));
+        printf(m_console, 0, 2, "gpu  %02dms %03dus", int(gpu_time), int(gpu_time * 1000) % 1000);
+        
+        printf(m_console, 0, 4, "       min    avg    p95    p99");
+        printf(m_console, 0, 5, "cpu %6.2f %6.2f %6.2f %6.2f ms", m_cpu_stats.min(), m_cpu_stats.avg(), m_cpu_stats.percentile(95), m_cpu_stats.percentile(99));
+        printf(m_console, 0, 6, "gpu %6.2f %6.2f %6.2f %6.2f ms", m_gpu_stats.min(), m_gpu_stats.avg(), m_gpu_stats.percentile(95), m_gpu_stats.percentile(99));
         
         // affiche le temps dans le terminal 
         //~ printf("cpu  %02dms %03dus    ", cpu_time / 1000, cpu_time % 1000);
-        //~ printf("gpu  %02dms %03dus\n", int(gpu_time / 1000000), int((gpu_time / 1000) % 1000));
+        //~ printf("gpu  %02dms %03dus\n", int(gpu_time), int(gpu_time * 1000) % 1000);
         
-        draw(m_console, window_width(), window_height());
+        // pas de texte en mode headless, l'image ne depend que de l'application
+        if(!headless())
+            draw(m_console, window_width(), window_height());
 
         if(key_state('s'))
         {
@@ -78,13 +134,28 @@ int AppTime::run( )
         }
         
         // presenter le resultat
-        SDL_GL_SwapWindow(m_window);
+        swap_window(m_window);
+        profiler_frame();
     }
     
+    // recupere les dernieres mesures
+    while(read_time_query(true))
+        {}
+    
+    // enregistre la derniere image, cf GKIT_CAPTURE
+    if(headless() && capture_filename())
+        screenshot(capture_filename());
+    
+    if(m_cpu_stats.count())
+        printf("[Apptime] %d frames, cpu avg %.2fms p99 %.2fms, gpu avg %.2fms p99 %.2fms\n", int(m_cpu_stats.samples().size()), 
+            m_cpu_stats.avg(), m_cpu_stats.percentile(99), m_gpu_stats.avg(), m_gpu_stats.percentile(99));
+    if(!m_stats_filename.empty())
+        write_stats(m_stats_filename.c_str());
+    
     if(quit() < 0)
         return -1;
     
-    glDeleteQueries(1, &m_time_query);
+    glDeleteQueries(TIME_QUERIES, m_time_queries);
     release_text(m_console);    
     
     return 0;    
@@ -2,15 +2,23 @@
 #ifndef _APP_TIME_H
 #define _APP_TIME_H
 
+#include <string>
+
 #include "glcore.h"
 #include "app.h"
 #include "text.h"
+#include "time_stats.h"
 
 
 //! \addtogroup application utilitaires pour creer une application
 
 //! \file
-//! classe application, avec mesure integree du temps d'execution cpu et gpu.
+/*! classe application, avec mesure integree du temps d'execution cpu et gpu.
+
+    le temps gpu est mesure par plusieurs requetes, utilisees a tour de role : le resultat d'une requete est lu quelques images plus tard, quand il est disponible, sans attendre le gpu.
+    les statistiques des dernieres images (min, moyenne, percentiles 95 et 99) sont affichees dans la fenetre,
+    et toutes les mesures peuvent etre exportees a la fin de l'execution, cf stats_file( ).
+ */
 class AppTime : public App
 {
 public:
@@ -32,9 +40,29 @@ public:
     //! execution de l'application.
     int run( );
 
+    //! exporte les mesures dans un fichier a la fin de l'execution, format json si le nom se termine par .json, csv sinon.
+    void stats_file( const char *filename ) { m_stats_filename= filename ? filename : ""; }
+    //! renvoie les mesures du temps cpu, en millisecondes.
+    const TimeStats& cpu_stats( ) const { return m_cpu_stats; }
+    //! renvoie les mesures du temps gpu, en millisecondes.
+    const TimeStats& gpu_stats( ) const { return m_gpu_stats; }
+
 protected:
+    //! recupere le resultat de la plus ancienne requete, renvoie faux s'il n'est pas encore disponible et que wait est faux.
+    bool read_time_query( const bool wait );
+    //! exporte les mesures.
+    int write_stats( const char *filename ) const;
+
+    enum { TIME_QUERIES= 4 };
+
     Text m_console;
-    GLuint m_time_query;
+    GLuint m_time_queries[TIME_QUERIES];
+    int m_query_first;
+    int m_query_count;
+
+    TimeStats m_cpu_stats;
+    TimeStats m_gpu_stats;
+    std::string m_stats_filename;
 };
 
 
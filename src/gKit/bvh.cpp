@@ -0,0 +1,175 @@
+
+#include <cstdio>
+#include <cfloat>
+#include <cassert>
+
+#include "bvh.h"
+
+
+int BVH::build( const Mesh& mesh, const int max_leaf )
+{
+    int n= mesh.triangle_count();
+    std::vector<Point> pmin(n);
+    std::vector<Point> pmax(n);
+    for(int i= 0; i < n; i++)
+    {
+        TriangleData t= mesh.triangle(i);
+        pmin[i]= min(Point(t.a), min(Point(t.b), Point(t.c)));
+        pmax[i]= max(Point(t.a), max(Point(t.b), Point(t.c)));
+    }
+
+    return build(pmin, pmax, max_leaf);
+}
+
+int BVH::build( const std::vector<Point>& pmin, const std::vector<Point>& pmax, const int max_leaf )
+{
+    assert(pmin.size() == pmax.size());
+
+    m_nodes.clear();
+    m_primitives.clear();
+    if(pmin.empty())
+        return 0;
+
+    m_pmin= pmin;
+    m_pmax= pmax;
+    m_max_leaf= std::max(1, max_leaf);
+
+    int n= int(pmin.size());
+    m_centers.resize(n);
+    m_primitives.resize(n);
+    for(int i= 0; i < n; i++)
+    {
+        m_centers[i]= center(pmin[i], pmax[i]);
+        m_primitives[i]= i;
+    }
+
+    m_nodes.reserve(2 * n / m_max_leaf + 1);
+    build_node(0, n, 0);
+
+    // nettoyage
+    m_pmin= std::vector<Point>();
+    m_pmax= std::vector<Point>();
+    m_centers= std::vector<Point>();
+
+    printf("bvh: %d nodes, %d primitives\n", int(m_nodes.size()), n);
+    return int(m_nodes.size());
+}
+
+
+static
+float area( const Point& pmin, const Point& pmax )
+{
+    Vector d= pmax - pmin;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+int BVH::build_node( const int begin, const int end, const int depth )
+{
+    // englobant des primitives et de leurs centres
+    Point pmin= Point(FLT_MAX, FLT_MAX, FLT_MAX);
+    Point pmax= Point(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    Point cmin= pmin;
+    Point cmax= pmax;
+    for(int i= begin; i < end; i++)
+    {
+        int id= m_primitives[i];
+        pmin= min(pmin, m_pmin[id]);
+        pmax= max(pmax, m_pmax[id]);
+        cmin= min(cmin, m_centers[id]);
+        cmax= max(cmax, m_centers[id]);
+    }
+
+    int index= int(m_nodes.size());
+    m_nodes.push_back( { pmin, begin, pmax, -(end - begin) } );     // feuille par defaut
+
+    int count= end - begin;
+    if(count <= m_max_leaf || depth >= BVH_MAX_DEPTH -1)
+        return index;
+
+    // axe le plus etire
+    Vector extent= cmax - cmin;
+    int axis= 0;
+    if(extent.y > extent.x) axis= 1;
+    if(extent.z > extent(axis)) axis= 2;
+    if(extent(axis) <= 0)
+        return index;       // tous les centres sont confondus...
+
+    // decoupage SAH, repartit les centres dans des cellules
+    const int bins= 16;
+    int bin_count[bins]= { };
+    Point bin_pmin[bins];
+    Point bin_pmax[bins];
+    for(int i= 0; i < bins; i++)
+    {
+        bin_pmin[i]= Point(FLT_MAX, FLT_MAX, FLT_MAX);
+        bin_pmax[i]= Point(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    }
+
+    float scale= bins / extent(axis);
+    for(int i= begin; i < end; i++)
+    {
+        int id= m_primitives[i];
+        int b= std::min(bins -1, int((m_centers[id](axis) - cmin(axis)) * scale));
+        bin_count[b]++;
+        bin_pmin[b]= min(bin_pmin[b], m_pmin[id]);
+        bin_pmax[b]= max(bin_pmax[b], m_pmax[id]);
+    }
+
+    // evalue le cout de chaque plan entre 2 cellules
+    float right_area[bins];
+    int right_count[bins];
+    {
+        Point rmin= Point(FLT_MAX, FLT_MAX, FLT_MAX);
+        Point rmax= Point(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        int n= 0;
+        for(int i= bins -1; i > 0; i--)
+        {
+            rmin= min(rmin, bin_pmin[i]);
+            rmax= max(rmax, bin_pmax[i]);
+            n+= bin_count[i];
+            right_area[i]= (n > 0) ? area(rmin, rmax) : 0;
+            right_count[i]= n;
+        }
+    }
+
+    int split= -1;
+    float split_cost= FLT_MAX;
+    {
+        Point lmin= Point(FLT_MAX, FLT_MAX, FLT_MAX);
+        Point lmax= Point(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        int n= 0;
+        for(int i= 0; i < bins -1; i++)
+        {
+            lmin= min(lmin, bin_pmin[i]);
+            lmax= max(lmax, bin_pmax[i]);
+            n+= bin_count[i];
+            if(n == 0 || right_count[i +1] == 0)
+                continue;
+
+            float cost= area(lmin, lmax) * n + right_area[i +1] * right_count[i +1];
+            if(cost < split_cost)
+            {
+                split_cost= cost;
+                split= i;
+            }
+        }
+    }
+
+    // cout d'une feuille vs cout du decoupage, 1 traversee == 1 intersection
+    float leaf_cost= count * area(pmin, pmax);
+    if(split < 0 || (split_cost + area(pmin, pmax) >= leaf_cost && count <= 4 * m_max_leaf))
+        return index;
+
+    // repartit les primitives
+    int *m= std::partition(m_primitives.data() + begin, m_primitives.data() + end,
+        [&]( const int id ) { return std::min(bins -1, int((m_centers[id](axis) - cmin(axis)) * scale)) <= split; });
+    int mid= int(m - m_primitives.data());
+    if(mid == begin || mid == end)
+        mid= (begin + end) / 2;
+
+    int left= build_node(begin, mid, depth +1);
+    int right= build_node(mid, end, depth +1);
+    m_nodes[index].left= left;
+    m_nodes[index].right= right;
+    return index;
+}
@@ -0,0 +1,192 @@
+
+#ifndef _BVH_H
+#define _BVH_H
+
+#include <vector>
+#include <algorithm>
+
+#include "vec.h"
+#include "mesh.h"
+
+
+//! \addtogroup objet3D
+///@{
+
+//! \file
+//! hierarchie de boites englobantes, construite sur cpu, parcours cpu ou gpu.
+
+/*! noeud du bvh. organisation identique a std430 en glsl :
+\code
+struct Node
+{
+    vec3 pmin;
+    int left;
+    vec3 pmax;
+    int right;
+};
+\endcode
+
+un noeud interne reference ses 2 fils, left et right. une feuille reference les primitives [left .. left - right), right < 0.
+ */
+struct alignas(16) BVHNode
+{
+    Point pmin;
+    int left;
+    Point pmax;
+    int right;
+
+    //! renvoie vrai si le noeud est une feuille.
+    bool leaf( ) const { return right < 0; }
+    //! indice de la premiere primitive de la feuille.
+    int begin( ) const { return left; }
+    //! indice de la derniere primitive de la feuille (exclue).
+    int end( ) const { return left - right; }
+
+    //! intersection rayon / boite, renvoie vrai si le rayon touche la boite entre 0 et tmax. invd= 1 / direction du rayon.
+    bool intersect( const Point& o, const Vector& invd, const float tmax, float& tnear ) const
+    {
+        Point t0= Point((pmin.x - o.x) * invd.x, (pmin.y - o.y) * invd.y, (pmin.z - o.z) * invd.z);
+        Point t1= Point((pmax.x - o.x) * invd.x, (pmax.y - o.y) * invd.y, (pmax.z - o.z) * invd.z);
+        Point tn= min(t0, t1);
+        Point tf= max(t0, t1);
+
+        tnear= std::max(std::max(tn.x, tn.y), std::max(tn.z, 0.f));
+        float tfar= std::min(std::min(tf.x, tf.y), std::min(tf.z, tmax));
+        return tnear <= tfar;
+    }
+};
+
+static_assert(sizeof(BVHNode) == 32, "BVHNode: layout std430 vec3 + int, vec3 + int");
+
+
+//! profondeur max du bvh, et taille de la pile de parcours.
+#define BVH_MAX_DEPTH 64
+
+//! hierarchie de boites englobantes, construction par decoupage SAH.
+class BVH
+{
+public:
+    BVH( ) : m_nodes(), m_primitives(), m_pmin(), m_pmax(), m_centers(), m_max_leaf(4) {}
+
+    //! construit le bvh des triangles d'un mesh. renvoie le nombre de noeuds.
+    int build( const Mesh& mesh, const int max_leaf= 4 );
+    //! construit le bvh d'un ensemble de boites englobantes. renvoie le nombre de noeuds.
+    int build( const std::vector<Point>& pmin, const std::vector<Point>& pmax, const int max_leaf= 4 );
+
+    //! renvoie les noeuds, la racine est nodes[0].
+    const std::vector<BVHNode>& nodes( ) const { return m_nodes; }
+    //! renvoie les indices des primitives dans l'ordre des feuilles.
+    const std::vector<int>& primitives( ) const { return m_primitives; }
+
+    /*! parcours le bvh. les feuilles touchees par le rayon appellent intersect( int index, float& tmax ) qui renvoie vrai et met a jour tmax si la primitive est plus proche.
+        index est l'indice de la primitive dans l'ordre des feuilles, primitives()[index] est son indice d'origine. les donnees des primitives rangees dans cet ordre sont lues sequentiellement, cf ShadingTable.
+        renvoie vrai si une primitive a ete touchee.
+     */
+    template < typename Intersect >
+    bool intersect( const Point& o, const Vector& d, float& tmax, Intersect&& intersect ) const
+    {
+        if(m_nodes.empty())
+            return false;
+
+        Vector invd= Vector(1 / d.x, 1 / d.y, 1 / d.z);
+
+        bool hit= false;
+        int stack[BVH_MAX_DEPTH +1];
+        int top= 0;
+        stack[top++]= 0;
+        while(top > 0)
+        {
+            const BVHNode& node= m_nodes[stack[--top]];
+
+            float t;
+            if(node.intersect(o, invd, tmax, t) == false)
+                continue;
+
+            if(node.leaf())
+            {
+                for(int i= node.begin(); i < node.end(); i++)
+                    if(intersect(i, tmax))
+                        hit= true;
+            }
+            else
+            {
+                // visite le fils le plus proche en premier
+                float tleft, tright;
+                bool left= m_nodes[node.left].intersect(o, invd, tmax, tleft);
+                bool right= m_nodes[node.right].intersect(o, invd, tmax, tright);
+                if(left && right)
+                {
+                    if(tleft < tright)
+                    {
+                        stack[top++]= node.right;
+                        stack[top++]= node.left;
+                    }
+                    else
+                    {
+                        stack[top++]= node.left;
+                        stack[top++]= node.right;
+                    }
+                }
+                else if(left)
+                    stack[top++]= node.left;
+                else if(right)
+                    stack[top++]= node.right;
+            }
+        }
+
+        return hit;
+    }
+
+    /*! parcours le bvh et s'arrete sur la premiere primitive touchee, pour les rayons d'ombre. intersect( int index, const float tmax ) renvoie vrai si la primitive est touchee avant tmax.
+        renvoie vrai si une primitive a ete touchee.
+     */
+    template < typename Intersect >
+    bool occluded( const Point& o, const Vector& d, const float tmax, Intersect&& intersect ) const
+    {
+        if(m_nodes.empty())
+            return false;
+
+        Vector invd= Vector(1 / d.x, 1 / d.y, 1 / d.z);
+
+        int stack[BVH_MAX_DEPTH +1];
+        int top= 0;
+        stack[top++]= 0;
+        while(top > 0)
+        {
+            const BVHNode& node= m_nodes[stack[--top]];
+
+            float t;
+            if(node.intersect(o, invd, tmax, t) == false)
+                continue;
+
+            if(node.leaf())
+            {
+                for(int i= node.begin(); i < node.end(); i++)
+                    if(intersect(i, tmax))
+                        return true;
+            }
+            else
+            {
+                stack[top++]= node.right;
+                stack[top++]= node.left;
+            }
+        }
+
+        return false;
+    }
+
+protected:
+    int build_node( const int begin, const int end, const int depth );
+
+    std::vector<BVHNode> m_nodes;
+    std::vector<int> m_primitives;
+
+    // construction
+    std::vector<Point> m_pmin;
+    std::vector<Point> m_pmax;
+    std::vector<Point> m_centers;
+    int m_max_leaf;
+};
+
+///@}
+#endif
@@ -0,0 +1,346 @@
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define USE_SSE
+#endif
+
+#include "cull.h"
+
+
+Frustum::Frustum( const Transform& m )
+{
+    // un point p est visible si -w <= x <= w, -w <= y <= w, -w <= z <= w, avec (x, y, z, w)= m * p
+    // cf "fast extraction of viewing frustum planes from the world-view-projection matrix", G. Gribb, K. Hartmann, 2001
+    for(int i= 0; i < 6; i++)
+    {
+        int row= i / 2;
+        float sign= (i & 1) ? -1 : 1;
+
+        float pa= m.m[3][0] + sign * m.m[row][0];
+        float pb= m.m[3][1] + sign * m.m[row][1];
+        float pc= m.m[3][2] + sign * m.m[row][2];
+        float pd= m.m[3][3] + sign * m.m[row][3];
+
+        // normalise les plans, pour tester les spheres
+        float l= std::sqrt(pa*pa + pb*pb + pc*pc);
+        if(l > 0)
+        {
+            pa/= l; pb/= l; pc/= l; pd/= l;
+        }
+
+        a[i]= pa; b[i]= pb; c[i]= pc; d[i]= pd;
+    }
+}
+
+bool Frustum::visible( const Point& pmin, const Point& pmax ) const
+{
+    Point center= ::center(pmin, pmax);
+    Vector extent= (pmax - pmin) / 2;
+    for(int i= 0; i < 6; i++)
+    {
+        float distance= (a[i] * center.x + b[i] * center.y) + (c[i] * center.z + d[i]);
+        float radius= std::abs(a[i]) * extent.x + std::abs(b[i]) * extent.y + std::abs(c[i]) * extent.z;
+        if(distance + radius < 0)
+            return false;
+    }
+
+    return true;
+}
+
+bool Frustum::visible( const Point& center, const float radius ) const
+{
+    for(int i= 0; i < 6; i++)
+    {
+        float distance= (a[i] * center.x + b[i] * center.y) + (c[i] * center.z + d[i]);
+        if(distance + radius < 0)
+            return false;
+    }
+
+    return true;
+}
+
+
+void CullBoxes::push( const Point& pmin, const Point& pmax )
+{
+    cx.push_back((pmin.x + pmax.x) / 2); ex.push_back((pmax.x - pmin.x) / 2);
+    cy.push_back((pmin.y + pmax.y) / 2); ey.push_back((pmax.y - pmin.y) / 2);
+    cz.push_back((pmin.z + pmax.z) / 2); ez.push_back((pmax.z - pmin.z) / 2);
+}
+
+void CullBoxes::clear( )
+{
+    cx.clear(); cy.clear(); cz.clear();
+    ex.clear(); ey.clear(); ez.clear();
+}
+
+void CullSpheres::push( const Point& center, const float radius )
+{
+    x.push_back(center.x);
+    y.push_back(center.y);
+    z.push_back(center.z);
+    r.push_back(radius);
+}
+
+void CullSpheres::clear( )
+{
+    x.clear(); y.clear(); z.clear();
+    r.clear();
+}
+
+
+// version scalaire des tests, pour les derniers elements d'un bloc, et version de reference.
+// les operations sont evaluees dans le meme ordre que les versions simd.
+static
+bool box_visible( const Frustum& frustum, const CullBoxes& boxes, const int i )
+{
+    for(int p= 0; p < 6; p++)
+    {
+        float distance= (frustum.a[p] * boxes.cx[i] + frustum.b[p] * boxes.cy[i]) + (frustum.c[p] * boxes.cz[i] + frustum.d[p]);
+        float radius= std::abs(frustum.a[p]) * boxes.ex[i] + std::abs(frustum.b[p]) * boxes.ey[i] + std::abs(frustum.c[p]) * boxes.ez[i];
+        if(distance + radius < 0)
+            return false;
+    }
+
+    return true;
+}
+
+static
+bool sphere_visible( const Frustum& frustum, const CullSpheres& spheres, const int i )
+{
+    for(int p= 0; p < 6; p++)
+    {
+        float distance= (frustum.a[p] * spheres.x[i] + frustum.b[p] * spheres.y[i]) + (frustum.c[p] * spheres.z[i] + frustum.d[p]);
+        if(distance + spheres.r[i] < 0)
+            return false;
+    }
+
+    return true;
+}
+
+
+// teste les elements [begin end), ecrit les indices des elements visibles dans visible, renvoie leur nombre
+static
+int cull_boxes( const Frustum& frustum, const CullBoxes& boxes, const int begin, const int end, unsigned int *visible )
+{
+    int n= 0;
+    int i= begin;
+
+#if defined(__AVX__)
+    // 8 boites a la fois
+    for(; i + 8 <= end; i+= 8)
+    {
+        __m256 cx= _mm256_loadu_ps(&boxes.cx[i]);
+        __m256 cy= _mm256_loadu_ps(&boxes.cy[i]);
+        __m256 cz= _mm256_loadu_ps(&boxes.cz[i]);
+        __m256 ex= _mm256_loadu_ps(&boxes.ex[i]);
+        __m256 ey= _mm256_loadu_ps(&boxes.ey[i]);
+        __m256 ez= _mm256_loadu_ps(&boxes.ez[i]);
+
+        __m256 inside= _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for(int p= 0; p < 6; p++)
+        {
+            __m256 distance= _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(frustum.a[p]), cx), _mm256_mul_ps(_mm256_set1_ps(frustum.b[p]), cy)),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(frustum.c[p]), cz), _mm256_set1_ps(frustum.d[p])));
+            __m256 radius= _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(frustum.a[p])), ex), _mm256_mul_ps(_mm256_set1_ps(std::abs(frustum.b[p])), ey)),
+                _mm256_mul_ps(_mm256_set1_ps(std::abs(frustum.c[p])), ez));
+
+            inside= _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        // ecrit les indices des boites visibles
+        int mask= _mm256_movemask_ps(inside);
+        for(int k= 0; k < 8; k++)
+            if(mask & (1 << k))
+                visible[n++]= i + k;
+    }
+
+#elif defined(USE_SSE)
+    // 4 boites a la fois
+    for(; i + 4 <= end; i+= 4)
+    {
+        __m128 cx= _mm_loadu_ps(&boxes.cx[i]);
+        __m128 cy= _mm_loadu_ps(&boxes.cy[i]);
+        __m128 cz= _mm_loadu_ps(&boxes.cz[i]);
+        __m128 ex= _mm_loadu_ps(&boxes.ex[i]);
+        __m128 ey= _mm_loadu_ps(&boxes.ey[i]);
+        __m128 ez= _mm_loadu_ps(&boxes.ez[i]);
+
+        __m128 inside= _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for(int p= 0; p < 6; p++)
+        {
+            __m128 distance= _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.a[p]), cx), _mm_mul_ps(_mm_set1_ps(frustum.b[p]), cy)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.c[p]), cz), _mm_set1_ps(frustum.d[p])));
+            __m128 radius= _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(frustum.a[p])), ex), _mm_mul_ps(_mm_set1_ps(std::abs(frustum.b[p])), ey)),
+                _mm_mul_ps(_mm_set1_ps(std::abs(frustum.c[p])), ez));
+
+            inside= _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+
+        int mask= _mm_movemask_ps(inside);
+        for(int k= 0; k < 4; k++)
+            if(mask & (1 << k))
+                visible[n++]= i + k;
+    }
+#endif
+
+    // derniers elements
+    for(; i < end; i++)
+        if(box_visible(frustum, boxes, i))
+            visible[n++]= i;
+
+    return n;
+}
+
+static
+int cull_spheres( const Frustum& frustum, const CullSpheres& spheres, const int begin, const int end, unsigned int *visible )
+{
+    int n= 0;
+    int i= begin;
+
+#if defined(__AVX__)
+    for(; i + 8 <= end; i+= 8)
+    {
+        __m256 x= _mm256_loadu_ps(&spheres.x[i]);
+        __m256 y= _mm256_loadu_ps(&spheres.y[i]);
+        __m256 z= _mm256_loadu_ps(&spheres.z[i]);
+        __m256 r= _mm256_loadu_ps(&spheres.r[i]);
+
+        __m256 inside= _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for(int p= 0; p < 6; p++)
+        {
+            __m256 distance= _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(frustum.a[p]), x), _mm256_mul_ps(_mm256_set1_ps(frustum.b[p]), y)),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(frustum.c[p]), z), _mm256_set1_ps(frustum.d[p])));
+
+            inside= _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        int mask= _mm256_movemask_ps(inside);
+        for(int k= 0; k < 8; k++)
+            if(mask & (1 << k))
+                visible[n++]= i + k;
+    }
+
+#elif defined(USE_SSE)
+    for(; i + 4 <= end; i+= 4)
+    {
+        __m128 x= _mm_loadu_ps(&spheres.x[i]);
+        __m128 y= _mm_loadu_ps(&spheres.y[i]);
+        __m128 z= _mm_loadu_ps(&spheres.z[i]);
+        __m128 r= _mm_loadu_ps(&spheres.r[i]);
+
+        __m128 inside= _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for(int p= 0; p < 6; p++)
+        {
+            __m128 distance= _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.a[p]), x), _mm_mul_ps(_mm_set1_ps(frustum.b[p]), y)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.c[p]), z), _mm_set1_ps(frustum.d[p])));
+
+            inside= _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), _mm_setzero_ps()));
+        }
+
+        int mask= _mm_movemask_ps(inside);
+        for(int k= 0; k < 4; k++)
+            if(mask & (1 << k))
+                visible[n++]= i + k;
+    }
+#endif
+
+    for(; i < end; i++)
+        if(sphere_visible(frustum, spheres, i))
+            visible[n++]= i;
+
+    return n;
+}
+
+
+// taille des blocs traites par chaque thread
+static const int chunk_size= 16384;
+
+// decoupe les elements en blocs, teste les blocs en parallele, et compacte les resultats
+template < typename Objects, typename Test >
+static
+int cull_chunks( const Frustum& frustum, const Objects& objects, std::vector<unsigned int>& visible, Test test )
+{
+    int n= objects.size();
+    visible.resize(n);
+
+    int chunks= (n + chunk_size -1) / chunk_size;
+    std::vector<int> counts(chunks);
+
+    // chaque bloc ecrit ses resultats a partir de son premier element...
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int i= 0; i < chunks; i++)
+    {
+        int begin= i * chunk_size;
+        int end= std::min(begin + chunk_size, n);
+        counts[i]= test(frustum, objects, begin, end, visible.data() + begin);
+    }
+
+    // ... et les resultats sont regroupes au debut du tableau
+    int count= 0;
+    for(int i= 0; i < chunks; i++)
+    {
+        if(count != i * chunk_size)
+            memmove(visible.data() + count, visible.data() + i * chunk_size, counts[i] * sizeof(unsigned int));
+        count+= counts[i];
+    }
+
+    visible.resize(count);
+    return count;
+}
+
+int cull( const Frustum& frustum, const CullBoxes& boxes, std::vector<unsigned int>& visible )
+{
+    return cull_chunks(frustum, boxes, visible, cull_boxes);
+}
+
+int cull( const Frustum& frustum, const CullSpheres& spheres, std::vector<unsigned int>& visible )
+{
+    return cull_chunks(frustum, spheres, visible, cull_spheres);
+}
+
+
+int cull_scalar( const Frustum& frustum, const CullBoxes& boxes, std::vector<unsigned int>& visible )
+{
+    visible.clear();
+    for(int i= 0; i < boxes.size(); i++)
+        if(box_visible(frustum, boxes, i))
+            visible.push_back(i);
+
+    return int(visible.size());
+}
+
+int cull_scalar( const Frustum& frustum, const CullSpheres& spheres, std::vector<unsigned int>& visible )
+{
+    visible.clear();
+    for(int i= 0; i < spheres.size(); i++)
+        if(sphere_visible(frustum, spheres, i))
+            visible.push_back(i);
+
+    return int(visible.size());
+}
+
+
+int build_indirect( const std::vector<unsigned int>& visible, const unsigned int vertex_count, std::vector<IndirectParam>& params )
+{
+    params.clear();
+    for(unsigned int i= 0; i < visible.size(); i++)
+    {
+        // prolonge le draw precedent, si les instances sont consecutives
+        if(!params.empty() && params.back().first_instance + params.back().instance_count == visible[i])
+            params.back().instance_count++;
+        else
+            params.push_back( { vertex_count, 1, 0, visible[i] } );
+    }
+
+    return int(params.size());
+}
@@ -0,0 +1,110 @@
+
+#ifndef _CULL_H
+#define _CULL_H
+
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "aligned.h"
+
+
+//! \addtogroup objet3D
+///@{
+
+//! \file
+/*! elimination, sur le cpu, des objets en dehors de la region visible par une camera.
+
+    les boites et les spheres englobantes sont stockees dans des tableaux separes (SoA), les tests utilisent les instructions SSE, ou AVX si le compilateur les utilise (-mavx, -march=native),
+    et decoupent les tableaux en blocs traites en parallele (openMP).
+    les fonctions *_scalar( ) sont les versions de reference, sans instructions simd ni threads.
+
+    exemple :
+\code
+CullBoxes boxes;
+for(...)
+    boxes.push(pmin, pmax);
+
+Frustum frustum(projection * view);
+std::vector<unsigned int> visible;
+int n= cull(frustum, boxes, visible);
+
+std::vector<IndirectParam> params;
+build_indirect(visible, mesh.vertex_count(), params);
+glBufferData(GL_DRAW_INDIRECT_BUFFER, params.size() * sizeof(IndirectParam), params.data(), GL_STREAM_DRAW);
+glMultiDrawArraysIndirect(GL_TRIANGLES, 0, params.size(), 0);
+\endcode
+ */
+
+//! plans de la region visible par une camera, normalises et orientes vers l'interieur : un point p est du bon cote du plan si dot(n, p) + d >= 0.
+struct Frustum
+{
+    //! construit les plans de la region visible, m est la transformation vers le repere projectif, projection * view, ou projection * view * model.
+    Frustum( const Transform& m );
+
+    float a[6], b[6], c[6], d[6];
+
+    //! renvoie vrai si la boite est au moins partiellement du bon cote de tous les plans.
+    bool visible( const Point& pmin, const Point& pmax ) const;
+    //! renvoie vrai si la sphere est au moins partiellement du bon cote de tous les plans.
+    bool visible( const Point& center, const float radius ) const;
+};
+
+
+//! boites englobantes alignees sur les axes, stockees par centre et demi-diagonale.
+struct CullBoxes
+{
+    aligned_vector<float> cx, cy, cz;
+    aligned_vector<float> ex, ey, ez;
+
+    //! ajoute une boite.
+    void push( const Point& pmin, const Point& pmax );
+    //! renvoie le nombre de boites.
+    int size( ) const { return int(cx.size()); }
+    //! vide les tableaux.
+    void clear( );
+};
+
+//! spheres englobantes.
+struct CullSpheres
+{
+    aligned_vector<float> x, y, z;
+    aligned_vector<float> r;
+
+    //! ajoute une sphere.
+    void push( const Point& center, const float radius );
+    //! renvoie le nombre de spheres.
+    int size( ) const { return int(x.size()); }
+    //! vide les tableaux.
+    void clear( );
+};
+
+
+//! teste les boites, visible contient les indices des boites visibles, dans l'ordre croissant. renvoie le nombre de boites visibles.
+int cull( const Frustum& frustum, const CullBoxes& boxes, std::vector<unsigned int>& visible );
+//! teste les spheres, visible contient les indices des spheres visibles, dans l'ordre croissant. renvoie le nombre de spheres visibles.
+int cull( const Frustum& frustum, const CullSpheres& spheres, std::vector<unsigned int>& visible );
+
+//! version de reference de cull( ).
+int cull_scalar( const Frustum& frustum, const CullBoxes& boxes, std::vector<unsigned int>& visible );
+//! version de reference de cull( ).
+int cull_scalar( const Frustum& frustum, const CullSpheres& spheres, std::vector<unsigned int>& visible );
+
+
+//! parametres d'un draw indirect, cf glDrawArraysIndirect( ) et glMultiDrawArraysIndirect( ).
+struct IndirectParam
+{
+    unsigned int vertex_count;
+    unsigned int instance_count;
+    unsigned int first_vertex;
+    unsigned int first_instance;
+};
+
+/*! construit les parametres des draws des instances visibles, les instances consecutives sont dessinees par le meme draw.
+    gl_InstanceID + first_instance, ou gl_BaseInstance, est l'indice de l'instance, les attributs d'instance (glVertexAttribDivisor( )) sont lus a partir de first_instance.
+    renvoie le nombre de draws.
+ */
+int build_indirect( const std::vector<unsigned int>& visible, const unsigned int vertex_count, std::vector<IndirectParam>& params );
+
+///@}
+#endif
@@ -1,6 +1,9 @@
 
+#include <algorithm>
+
 #include "draw.h"
 #include "window.h"
+#include "uniforms.h"
 
 
 void draw( Mesh& m, const Transform& model, const Transform& view, const Transform& projection, const GLuint texture )
@@ -45,6 +48,12 @@ void draw( Mesh& m, const GLuint program, const bool use_position, const bool us
 
 void DrawParam::draw( Mesh& mesh ) const
 {
+    if(m_queue)
+    {
+        m_queue->draw(mesh, *this);
+        return;
+    }
+    
     mesh.draw(m_model, m_view, m_projection, m_use_light, m_light, m_light_color, m_use_texture, m_texture, m_use_alpha_test, m_alpha_min);
 }
 
@@ -52,3 +61,157 @@ void draw( Mesh& m, const DrawParam& param )
 {
     param.draw(m);
 }
+
+
+void DrawQueue::draw( Mesh& mesh, const DrawParam& param )
+{
+    // selectionne le shader et construit les buffers, avant de trier les draws
+    GLuint program= mesh.draw_program(param.m_use_light, param.m_use_texture, param.m_texture, param.m_use_alpha_test);
+    bool use_texture= (param.m_texture && param.m_use_texture && mesh.has_texcoord());
+    
+    m_commands.push_back( { &mesh, program, mesh.vao(), use_texture ? param.m_texture : 0, param } );
+}
+
+static
+bool equal( const Color& a, const Color& b )
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+static
+bool equal( const Point& a, const Point& b )
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+// derniers uniforms modifies du shader selectionne
+struct UniformState
+{
+    bool mesh_color_valid;
+    bool light_valid;
+    bool alpha_min_valid;
+    bool sampler_valid;
+    
+    Color mesh_color;
+    Point light;
+    Color light_color;
+    float alpha_min;
+};
+
+int DrawQueue::flush( )
+{
+    m_stats= DrawQueueStats();
+    
+    // trie les draws par shader, texture puis vao. conserve l'ordre des draws qui utilisent les memes parametres
+    std::stable_sort(m_commands.begin(), m_commands.end(), 
+        []( const Command& a, const Command& b ) 
+        {
+            if(a.program != b.program) return a.program < b.program;
+            if(a.texture != b.texture) return a.texture < b.texture;
+            return a.vao < b.vao;
+        });
+    
+    // les textures sont toujours sur l'unite 0, avec les parametres de filtrage de la texture
+    glActiveTexture(GL_TEXTURE0);
+    glBindSampler(0, 0);
+    
+    GLuint program= 0;
+    GLuint texture= 0;
+    GLuint vao= 0;
+    UniformState state= { };
+    for(unsigned int i= 0; i < m_commands.size(); i++)
+    {
+        const Command& command= m_commands[i];
+        const DrawParam& param= command.param;
+        Mesh& mesh= *command.mesh;
+        
+        if(command.program != program)
+        {
+            program= command.program;
+            glUseProgram(program);
+            m_stats.programs++;
+            
+            // les uniforms du shader ont pu etre modifies par un autre draw
+            state= UniformState();
+        }
+        
+        if(command.texture && command.texture != texture)
+        {
+            texture= command.texture;
+            glBindTexture(GL_TEXTURE_2D, texture);
+            m_stats.textures++;
+        }
+        
+        if(command.vao != vao)
+        {
+            vao= command.vao;
+            glBindVertexArray(vao);
+            m_stats.vaos++;
+        }
+        
+        // uniforms partages par plusieurs draws, cf Mesh::draw( )
+        if(!state.mesh_color_valid || !equal(state.mesh_color, mesh.default_color()))
+        {
+            state.mesh_color= mesh.default_color();
+            state.mesh_color_valid= true;
+            program_uniform(program, "mesh_color", state.mesh_color);
+            m_stats.uniforms++;
+        }
+        
+        if(command.texture && !state.sampler_valid)
+        {
+            state.sampler_valid= true;
+            program_uniform(program, "diffuse_color", 0);
+            m_stats.uniforms++;
+        }
+        
+        if(param.m_use_light)
+        {
+            // transforme la position de la source dans le repere camera
+            Point light= param.m_view(param.m_light);
+            if(!state.light_valid || !equal(state.light, light) || !equal(state.light_color, param.m_light_color))
+            {
+                state.light= light;
+                state.light_color= param.m_light_color;
+                state.light_valid= true;
+                program_uniform(program, "light", state.light);
+                program_uniform(program, "light_color", state.light_color);
+                m_stats.uniforms+= 2;
+            }
+        }
+        
+        if(param.m_use_alpha_test && (!state.alpha_min_valid || state.alpha_min != param.m_alpha_min))
+        {
+            state.alpha_min= param.m_alpha_min;
+            state.alpha_min_valid= true;
+            program_uniform(program, "alpha_min", state.alpha_min);
+            m_stats.uniforms++;
+        }
+        
+        // transformations de chaque draw
+        Transform mv= param.m_view * param.m_model;
+        Transform mvp= param.m_projection * mv;
+        Transform normal= mv.normal();
+        if(mesh.is_compact())
+        {
+            // decode les positions compactes
+            mv= mv * mesh.compact_transform();
+            mvp= mvp * mesh.compact_transform();
+        }
+        
+        program_uniform(program, "mvpMatrix", mvp);
+        program_uniform(program, "mvMatrix", mv);
+        m_stats.uniforms+= 2;
+        if(mesh.has_normal())
+        {
+            program_uniform(program, "normalMatrix", normal);
+            m_stats.uniforms++;
+        }
+        
+        mesh.draw_primitives();
+        m_stats.draws++;
+    }
+    
+    m_commands.clear();
+    return m_stats.state_changes();
+}
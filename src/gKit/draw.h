@@ -2,6 +2,8 @@
 #ifndef _DRAW_H
 #define _DRAW_H
 
+#include <vector>
+
 #include "mesh.h"
 #include "orbiter.h"
 #include "window.h"
@@ -31,6 +33,8 @@ void draw( Mesh& m, const Transform& model, const Orbiter& camera, const GLuint
 //! dessine l'objet avec un shader program "specifique"
 void draw( Mesh& m, const GLuint program, const bool use_position= true, const bool use_texcoord= true, const bool use_normal= true, const bool use_color= true );
 
+class DrawQueue;
+
 /*! representation des options / parametres d'un draw.
     permet de donner tous les parametres d'un draw de maniere flexible.
 
@@ -49,6 +53,8 @@ void draw( Mesh& m, const GLuint program, const bool use_position= true, const b
     DrawParam().light(Point(0, 20, 0), Red()).model(m).camera(orbiter).draw(objet);
     \endcode
     les parametres peuvent etre decrits dans un ordre quelconque, mais DrawParam::draw() doit etre appele en dernier.
+    
+    le draw peut aussi etre differe, cf queue( ) et DrawQueue.
  */
 class DrawParam
 {
@@ -57,7 +63,8 @@ public:
     DrawParam( ) : m_model(), m_view(), m_projection(),
         m_use_light(false), m_light(), m_light_color(),
         m_use_texture(false), m_texture(0),
-        m_use_alpha_test(false), m_alpha_min(0.3f)
+        m_use_alpha_test(false), m_alpha_min(0.3f),
+        m_queue(nullptr)
     {}
 
     //! modifie la transformation model utilisee pour afficher l'objet.
@@ -82,7 +89,10 @@ public:
     //! Use light: on/off
     DrawParam& lighting(bool use_light=true) { m_use_light=use_light;  return *this; }
 
-    //! dessine l'objet avec l'ensemble des parametres definis.
+    //! enregistre les draws dans une file, au lieu de dessiner immediatement, cf DrawQueue.
+    DrawParam& queue( DrawQueue& q ) { m_queue= &q; return *this; }
+
+    //! dessine l'objet avec l'ensemble des parametres definis, ou l'enregistre dans la file, cf queue( ).
     void draw( Mesh& mesh ) const;
 
     //! renvoie la position de la lumire
@@ -102,10 +112,81 @@ protected:
 
     bool m_use_alpha_test;
     float m_alpha_min;
+
+    DrawQueue *m_queue;
+
+    friend class DrawQueue;
 };
 
 //! dessine l'objet avec l'ensemble des parametres definis.
 void draw( Mesh& mesh, const DrawParam& param );
 
+
+//! nombre de draws et de changements d'etats d'un DrawQueue::flush( ).
+struct DrawQueueStats
+{
+    int draws;          //!< nombre de draws.
+    int programs;       //!< nombre de shaders selectionnes.
+    int vaos;           //!< nombre de vertex array objects selectionnes.
+    int textures;       //!< nombre de textures selectionnees.
+    int uniforms;       //!< nombre d'uniforms modifies.
+
+    //! renvoie le nombre de changements d'etats : shaders, vaos et textures.
+    int state_changes( ) const { return programs + vaos + textures; }
+};
+
+/*! file de draws, triee par shader, texture et vao avant de dessiner les objets.
+    les shaders, textures, vaos et uniforms ne sont selectionnes / modifies que lorsqu'ils changent.
+    
+    exemple :
+    \code
+    DrawQueue queue;
+    
+    // a chaque image
+    DrawParam param;
+    param.light(Point(0, 20, 0)).camera(orbiter).queue(queue);
+    for(int i= 0; i < n; i++)
+        param.model(transforms[i]).draw(objets[i]);
+    
+    queue.flush();
+    printf("%d draws, %d changements d'etats\n", queue.stats().draws, queue.stats().state_changes());
+    \endcode
+    
+    les objets doivent exister jusqu'a flush( ). l'ordre des draws n'est conserve que pour des objets qui utilisent le meme shader, la meme texture et le meme vao :
+    a utiliser pour des objets opaques, avec le test de profondeur.
+ */
+class DrawQueue
+{
+public:
+    //! constructeur par defaut.
+    DrawQueue( ) : m_commands(), m_stats() {}
+
+    //! enregistre le draw d'un objet. prepare le shader et les buffers de l'objet, cf Mesh::draw_program( ).
+    void draw( Mesh& mesh, const DrawParam& param );
+    
+    //! trie et dessine les objets enregistres, puis vide la file. renvoie le nombre de changements d'etats, cf stats( ).
+    int flush( );
+    //! vide la file, sans dessiner les objets.
+    void clear( ) { m_commands.clear(); }
+    
+    //! renvoie le nombre de draws enregistres.
+    int size( ) const { return int(m_commands.size()); }
+    //! renvoie les statistiques du dernier flush( ).
+    const DrawQueueStats& stats( ) const { return m_stats; }
+
+protected:
+    struct Command
+    {
+        Mesh *mesh;
+        GLuint program;
+        GLuint vao;
+        GLuint texture;     //!< 0 si l'objet n'utilise pas de texture.
+        DrawParam param;
+    };
+
+    std::vector<Command> m_commands;
+    DrawQueueStats m_stats;
+};
+
 ///@}
 #endif
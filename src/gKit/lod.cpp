@@ -0,0 +1,237 @@
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include "lod.h"
+#include "simplify.h"
+#include "mesh_optimize.h"
+
+
+void MeshLOD::bounds( const Mesh& mesh )
+{
+    const std::vector<vec3>& positions= mesh.positions();
+    if(positions.empty())
+    {
+        m_center= Point();
+        m_radius= 0;
+        return;
+    }
+
+    Point pmin= Point(positions[0]);
+    Point pmax= pmin;
+    for(unsigned int i= 1; i < positions.size(); i++)
+    {
+        pmin= min(pmin, Point(positions[i]));
+        pmax= max(pmax, Point(positions[i]));
+    }
+
+    m_center= ::center(pmin, pmax);
+    m_radius= 0;
+    for(unsigned int i= 0; i < positions.size(); i++)
+        m_radius= std::max(m_radius, distance(m_center, Point(positions[i])));
+}
+
+
+int MeshLOD::build( const Mesh& mesh, const int levels, const float ratio, const char *cache )
+{
+    m_levels.clear();
+    m_indices.clear();
+    bounds(mesh);
+
+    if(mesh.primitives() != GL_TRIANGLES || levels < 1)
+        return -1;
+
+    if(mesh.indices().empty())
+    {
+        // les niveaux doivent partager les sommets, utiliser read_indexed_mesh( )...
+        printf("[warning] MeshLOD: non indexed mesh, no simplification...\n");
+
+        m_indices.resize(mesh.vertex_count());
+        for(unsigned int i= 0; i < m_indices.size(); i++)
+            m_indices[i]= i;
+        m_levels.push_back( { 0, unsigned(m_indices.size()), 0 } );
+        return 1;
+    }
+
+    if(cache && read_lod(cache, mesh, levels, ratio) == 0)
+        return int(m_levels.size());
+
+    printf("building %d levels of details...\n", levels);
+
+    const std::vector<unsigned int>& indices= mesh.indices();
+    const std::vector<vec3>& positions= mesh.positions();
+    const std::vector<unsigned int>& materials= mesh.materials();
+    int triangle_count= mesh.triangle_count();
+
+    // simplifie le maillage d'origine pour chaque niveau, independamment
+    std::vector< std::vector<unsigned int> > lods(levels);
+    std::vector<float> errors(levels, 0);
+    lods[0]= indices;
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int i= 1; i < levels; i++)
+    {
+        int target= int(triangle_count * std::pow(ratio, float(i)));
+        std::vector<unsigned int> simplified_materials;
+        lods[i]= simplify(indices, positions, materials, std::max(target, 1), simplified_materials, errors[i]);
+
+        // re-ordonne les triangles pour le cache de sommets
+        std::vector<int> clusters;
+        std::vector<int> order= vertex_cache_order(lods[i], mesh.vertex_count(), 16, clusters);
+        lods[i]= reorder_triangles(lods[i], order);
+    }
+
+    for(int i= 0; i < levels; i++)
+    {
+        // conserve une erreur croissante, un niveau plus simple ne peut pas etre plus precis...
+        if(i > 0)
+            errors[i]= std::max(errors[i], m_levels[i -1].error);
+
+        m_levels.push_back( { unsigned(m_indices.size()), unsigned(lods[i].size()), errors[i] } );
+        m_indices.insert(m_indices.end(), lods[i].begin(), lods[i].end());
+
+        printf("  level %d: %d triangles, error %f\n", i, int(lods[i].size() / 3), errors[i]);
+    }
+
+    if(cache)
+        write_lod(cache, mesh, ratio);
+
+    return int(m_levels.size());
+}
+
+
+float MeshLOD::pixels( const Transform& model, const Transform& view, const Transform& projection, const float height ) const
+{
+    Transform mv= view * model;
+
+    // echelle de la transformation de l'objet
+    float scale= std::max(length(mv[0]), std::max(length(mv[1]), length(mv[2])));
+
+    // profondeur du point de la sphere englobante le plus proche de la camera
+    Point c= mv(m_center);
+    c.z= c.z + m_radius * scale;
+
+    // w, apres projection, cf Perspective( ) et Ortho( )
+    float w= projection.m[3][0] * c.x + projection.m[3][1] * c.y + projection.m[3][2] * c.z + projection.m[3][3];
+    if(w <= 0)
+        return FLT_MAX;    // la camera est dans la sphere englobante
+
+    return scale * projection.m[1][1] * height / 2 / w;
+}
+
+
+int MeshLOD::select( const Transform& model, const Transform& view, const Transform& projection, const float height, const float threshold ) const
+{
+    float size= pixels(model, view, projection, height);
+
+    int id= 0;
+    for(int i= 1; i < int(m_levels.size()); i++)
+        if(m_levels[i].error * size <= threshold)
+            id= i;
+
+    return id;
+}
+
+
+// entete du fichier cache
+static const char lod_magic[8]= { 'g', 'K', 'i', 't', 'L', 'O', 'D', '1' };
+
+struct LODHeader
+{
+    char magic[8];
+    unsigned int vertex_count;
+    unsigned int index_count;
+    unsigned int levels;
+    float ratio;
+    unsigned int total_count;
+};
+
+int MeshLOD::read_lod( const char *filename, const Mesh& mesh, const int levels, const float ratio )
+{
+    FILE *in= fopen(filename, "rb");
+    if(in == NULL)
+        return -1;
+
+    LODHeader header;
+    bool errors= (fread(&header, sizeof(header), 1, in) != 1);
+    if(!errors)
+        errors= memcmp(header.magic, lod_magic, sizeof(lod_magic)) != 0
+            || header.vertex_count != unsigned(mesh.vertex_count())
+            || header.index_count != unsigned(mesh.index_count())
+            || header.levels != unsigned(levels)
+            || header.ratio != ratio;
+
+    std::vector<LODLevel> lods;
+    std::vector<unsigned int> indices;
+    if(!errors)
+    {
+        lods.resize(header.levels);
+        indices.resize(header.total_count);
+        errors= fread(lods.data(), sizeof(LODLevel), lods.size(), in) != lods.size()
+            || fread(indices.data(), sizeof(unsigned int), indices.size(), in) != indices.size();
+    }
+    fclose(in);
+
+    // verifie le contenu, le niveau 0 doit etre le maillage d'origine
+    if(!errors)
+    {
+        for(unsigned int i= 0; i < lods.size(); i++)
+            if(size_t(lods[i].first) + lods[i].count > indices.size())
+                errors= true;
+
+        if(!errors)
+            errors= lods[0].count != unsigned(mesh.index_count())
+                || !std::equal(mesh.indices().begin(), mesh.indices().end(), indices.begin() + lods[0].first);
+
+        for(unsigned int i= 0; i < indices.size() && !errors; i++)
+            if(indices[i] >= header.vertex_count)
+                errors= true;
+    }
+
+    if(errors)
+    {
+        printf("[warning] ignoring levels of details '%s'...\n", filename);
+        return -1;
+    }
+
+    printf("loading levels of details '%s'...\n", filename);
+    m_levels.swap(lods);
+    m_indices.swap(indices);
+    return 0;
+}
+
+int MeshLOD::write_lod( const char *filename, const Mesh& mesh, const float ratio ) const
+{
+    FILE *out= fopen(filename, "wb");
+    if(out == NULL)
+    {
+        printf("[error] writing levels of details '%s'...\n", filename);
+        return -1;
+    }
+
+    printf("writing levels of details '%s'...\n", filename);
+
+    LODHeader header;
+    memcpy(header.magic, lod_magic, sizeof(lod_magic));
+    header.vertex_count= mesh.vertex_count();
+    header.index_count= mesh.index_count();
+    header.levels= m_levels.size();
+    header.ratio= ratio;
+    header.total_count= m_indices.size();
+
+    bool errors= fwrite(&header, sizeof(header), 1, out) != 1
+        || fwrite(m_levels.data(), sizeof(LODLevel), m_levels.size(), out) != m_levels.size()
+        || fwrite(m_indices.data(), sizeof(unsigned int), m_indices.size(), out) != m_indices.size();
+
+    fclose(out);
+    if(errors)
+    {
+        printf("[error] writing levels of details '%s'...\n", filename);
+        return -1;
+    }
+
+    return 0;
+}
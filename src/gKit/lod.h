@@ -0,0 +1,102 @@
+
+#ifndef _LOD_H
+#define _LOD_H
+
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "mesh.h"
+
+
+//! \addtogroup objet3D
+///@{
+
+//! \file
+/*! niveaux de details d'un maillage indexe, construits par simplify( ).
+
+    chaque niveau est une suite d'indices, dans le meme index buffer, qui reference les sommets du maillage d'origine : tous les niveaux partagent le meme vertex buffer,
+    et se dessinent avec glDrawElements(GL_TRIANGLES, level.count, GL_UNSIGNED_INT, level.first * sizeof(unsigned int)), ou avec un draw indirect.
+
+    le niveau est choisi en fonction de la taille en pixels de l'erreur de simplification, a la distance de la sphere englobante de l'objet, cf select( ).
+
+    exemple :
+\code
+Mesh mesh= read_indexed_mesh("data/bigguy.obj");
+MeshLOD lod;
+lod.build(mesh, 5, 0.5f, "data/bigguy.lod");     // 5 niveaux, chaque niveau divise par 2 le nombre de triangles, conserves dans data/bigguy.lod
+
+// index buffer avec tous les niveaux
+glBufferData(GL_ELEMENT_ARRAY_BUFFER, lod.indices().size() * sizeof(unsigned int), lod.indices().data(), GL_STATIC_DRAW);
+
+int id= lod.select(model, camera.view(), camera.projection(window_width(), window_height(), 45), window_height());
+const LODLevel& level= lod.level(id);
+glDrawElements(GL_TRIANGLES, level.count, GL_UNSIGNED_INT, (const void *) (level.first * sizeof(unsigned int)));
+\endcode
+ */
+
+//! description d'un niveau de details.
+struct LODLevel
+{
+    unsigned int first;     //!< indice du premier indice du niveau.
+    unsigned int count;     //!< nombre d'indices du niveau.
+    float error;            //!< erreur de simplification, dans le repere de l'objet.
+};
+
+//! representation des niveaux de details d'un maillage indexe.
+class MeshLOD
+{
+public:
+    MeshLOD( ) : m_levels(), m_indices(), m_center(), m_radius(0) {}
+
+    /*! construit levels niveaux de details, le niveau 0 est le maillage d'origine, le niveau i + 1 conserve ratio fois les triangles du niveau i.
+        les niveaux sont construits en parallele.
+        si cache n'est pas nul, relit les niveaux deja construits pour le meme maillage, ou les ecrit.
+        renvoie le nombre de niveaux, ou -1 en cas d'erreur.
+     */
+    int build( const Mesh& mesh, const int levels= 5, const float ratio= 0.5f, const char *cache= nullptr );
+
+    //! renvoie le nombre de niveaux.
+    int levels( ) const { return int(m_levels.size()); }
+    //! renvoie la description du niveau id.
+    const LODLevel& level( const int id ) const { return m_levels[id]; }
+    //! renvoie le nombre de triangles du niveau id.
+    int triangle_count( const int id ) const { return int(m_levels[id].count / 3); }
+    //! renvoie les indices de tous les niveaux.
+    const std::vector<unsigned int>& indices( ) const { return m_indices; }
+
+    //! renvoie le centre de la sphere englobante de l'objet.
+    Point center( ) const { return m_center; }
+    //! renvoie le rayon de la sphere englobante de l'objet.
+    float radius( ) const { return m_radius; }
+
+    /*! renvoie la taille en pixels d'une longueur de 1 dans le repere de l'objet, a la distance de la sphere englobante.
+        projection est la projection de la camera, cf Orbiter::projection( ), height est la hauteur de l'image en pixels.
+     */
+    float pixels( const Transform& model, const Transform& view, const Transform& projection, const float height ) const;
+
+    //! renvoie le rayon de la sphere englobante projetee, en pixels.
+    float screen_radius( const Transform& model, const Transform& view, const Transform& projection, const float height ) const
+    {
+        return m_radius * pixels(model, view, projection, height);
+    }
+
+    //! renvoie le niveau le plus simple dont l'erreur projetee est inferieure a threshold pixels.
+    int select( const Transform& model, const Transform& view, const Transform& projection, const float height, const float threshold= 1 ) const;
+
+    //! relit les niveaux construits pour mesh. renvoie -1 si le fichier n'existe pas ou ne correspond pas a mesh.
+    int read_lod( const char *filename, const Mesh& mesh, const int levels, const float ratio );
+    //! ecrit les niveaux.
+    int write_lod( const char *filename, const Mesh& mesh, const float ratio ) const;
+
+protected:
+    void bounds( const Mesh& mesh );
+
+    std::vector<LODLevel> m_levels;
+    std::vector<unsigned int> m_indices;
+    Point m_center;
+    float m_radius;
+};
+
+///@}
+#endif
@@ -1,11 +1,14 @@
 
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 #include <string>
 #include <algorithm>
 
 #include "vec.h"
 #include "mesh.h"
+#include "mesh_optimize.h"
+#include "vertex_codec.h"
 
 #include "program.h"
 #include "uniforms.h"
@@ -19,16 +22,69 @@ int Mesh::create( const GLenum primitives )
     return 0;
 }
 
+// shaders de draw( ) partages par tous les objets, identifies par leurs options, cf program_key( )
+struct SharedProgram
+{
+    GLuint program;
+    int count;
+};
+
+static std::unordered_map<unsigned int, SharedProgram> shared_programs;
+
+static
+void release_shared_program( const unsigned int key )
+{
+    auto found= shared_programs.find(key);
+    if(found == shared_programs.end())
+        return;
+    
+    // detruit le shader lorsque le dernier objet qui l'utilise est detruit
+    found->second.count--;
+    if(found->second.count > 0)
+        return;
+    
+    release_program(found->second.program);
+    shared_programs.erase(found);
+}
+
+static
+void acquire_shared_programs( const MeshPrograms& programs )
+{
+    for(auto it= programs.begin(); it != programs.end(); ++it)
+        if(it->second > 0)
+            shared_programs[it->first].count++;
+}
+
+MeshPrograms::MeshPrograms( const MeshPrograms& programs ) : std::unordered_map<unsigned int, GLuint>(programs)
+{
+    acquire_shared_programs(programs);
+}
+
+MeshPrograms& MeshPrograms::operator= ( const MeshPrograms& programs )
+{
+    // conserve les nouveaux shaders avant de rendre les anciens, si programs et *this sont les memes...
+    acquire_shared_programs(programs);
+    for(auto it= begin(); it != end(); ++it)
+        if(it->second > 0)
+            release_shared_program(it->first);
+
+    std::unordered_map<unsigned int, GLuint>::operator=(programs);
+    return *this;
+}
+
 void Mesh::release( )
 {
     glDeleteVertexArrays(1, &m_vao);
     glDeleteBuffers(1, &m_buffer);
     glDeleteBuffers(1, &m_index_buffer);
 
-    // detruit tous les shaders crees...
+    // rend tous les shaders utilises...
     for(auto it= m_state_map.begin(); it != m_state_map.end(); ++it)
         if(it->second > 0)
-            release_program(it->second);
+            release_shared_program(it->first);
+    m_state_map.clear();
+    m_program= 0;
+    m_state= 0;
 }
 
 // definit les attributs du prochain sommet
@@ -95,7 +151,7 @@ unsigned int Mesh::vertex( const vec3& position )
 Mesh& Mesh::color( const unsigned int id, const vec4& c )
 {
     assert(id < m_colors.size());
-    m_update_buffers= true;
+    modified(id);
     m_colors[id]= c;
     return *this;
 }
@@ -103,7 +159,7 @@ Mesh& Mesh::color( const unsigned int id, const vec4& c )
 Mesh& Mesh::normal( const unsigned int id, const vec3& n )
 {
     assert(id < m_normals.size());
-    m_update_buffers= true;
+    modified(id);
     m_normals[id]= n;
     return *this;
 }
@@ -111,7 +167,7 @@ Mesh& Mesh::normal( const unsigned int id, const vec3& n )
 Mesh& Mesh::texcoord( const unsigned int id, const vec2& uv )
 {
     assert(id < m_texcoords.size());
-    m_update_buffers= true;
+    modified(id);
     m_texcoords[id]= uv;
     return *this;
 }
@@ -119,7 +175,7 @@ Mesh& Mesh::texcoord( const unsigned int id, const vec2& uv )
 void Mesh::vertex( const unsigned int id, const vec3& p )
 {
     assert(id < m_positions.size());
-    m_update_buffers= true;
+    modified(id);
     m_positions[id]= p;
 }
 
@@ -132,6 +188,10 @@ Mesh& Mesh::triangle( const unsigned int a, const unsigned int b, const unsigned
     m_indices.push_back(a);
     m_indices.push_back(b);
     m_indices.push_back(c);
+    
+    // copie la matiere courante, uniquement si elle est definie
+    if(m_triangle_materials.size() > 0 && (size_t) triangle_count() > m_triangle_materials.size())
+        m_triangle_materials.push_back(m_triangle_materials.back());
     return *this;
 }
 
@@ -143,6 +203,10 @@ Mesh& Mesh::triangle_last( const int a, const int b, const int c )
     m_indices.push_back((int) m_positions.size() + a);
     m_indices.push_back((int) m_positions.size() + b);
     m_indices.push_back((int) m_positions.size() + c);
+    
+    // copie la matiere courante, uniquement si elle est definie
+    if(m_triangle_materials.size() > 0 && (size_t) triangle_count() > m_triangle_materials.size())
+        m_triangle_materials.push_back(m_triangle_materials.back());
     return *this;
 }
 
@@ -272,6 +336,45 @@ TriangleData Mesh::triangle( const unsigned int id ) const
     return triangle;
 }
 
+Mesh& Mesh::optimize( const int cache_size )
+{
+    if(m_primitives != GL_TRIANGLES || m_indices.empty())
+        return *this;   // uniquement les triangles indexes
+    
+    float acmr_before= acmr(m_indices, cache_size);
+    float atvr_before= atvr(m_indices, vertex_count(), cache_size);
+    
+    // re-ordonne les triangles
+    std::vector<int> clusters;
+    std::vector<int> order= vertex_cache_order(m_indices, vertex_count(), cache_size, clusters);
+    order= overdraw_order(m_indices, m_positions, order, clusters);
+    m_indices= reorder_triangles(m_indices, order);
+    
+    if(m_triangle_materials.size() == order.size())
+    {
+        std::vector<unsigned int> materials(order.size());
+        for(unsigned int i= 0; i < order.size(); i++)
+            materials[i]= m_triangle_materials[order[i]];
+        m_triangle_materials.swap(materials);
+    }
+    
+    // re-ordonne les sommets
+    int count= vertex_count();
+    std::vector<int> remap= vertex_fetch_order(m_indices, count);
+    m_positions= remap_vertices(m_positions, remap);
+    if(m_texcoords.size() == (size_t) count)
+        m_texcoords= remap_vertices(m_texcoords, remap);
+    if(m_normals.size() == (size_t) count)
+        m_normals= remap_vertices(m_normals, remap);
+    if(m_colors.size() == (size_t) count)
+        m_colors= remap_vertices(m_colors, remap);
+    
+    printf("optimize: acmr %.3f -> %.3f, atvr %.3f -> %.3f\n", 
+        acmr_before, acmr(m_indices, cache_size), atvr_before, atvr(m_indices, vertex_count(), cache_size));
+    
+    return *this;
+}
+
 void Mesh::bounds( Point& pmin, Point& pmax )
 {
     if(m_positions.size() < 1)
@@ -288,6 +391,176 @@ void Mesh::bounds( Point& pmin, Point& pmax )
     }
 }
 
+Mesh& Mesh::compact( const bool enable )
+{
+    if(m_vao)
+        printf("[warning] mesh: compact( ) after create_buffers( )...\n");
+    
+    m_compact= enable;
+    return *this;
+}
+
+Transform Mesh::compact_transform( ) const
+{
+    if(!m_compact)
+        return Identity();
+    
+    Vector d= m_compact_pmax - m_compact_pmin;
+    return Translation(Vector(m_compact_pmin)) * Scale(d.x, d.y, d.z);
+}
+
+Mesh& Mesh::interleaved( const bool enable )
+{
+    if(m_vao)
+        printf("[warning] mesh: interleaved( ) after create_buffers( )...\n");
+    
+    m_interleaved= enable;
+    return *this;
+}
+
+void Mesh::modified( const unsigned int id )
+{
+    if(!m_update_buffers)
+    {
+        m_dirty_begin= id;
+        m_dirty_end= id +1;
+    }
+    else
+    {
+        m_dirty_begin= std::min(m_dirty_begin, id);
+        m_dirty_end= std::max(m_dirty_end, id +1);
+    }
+    
+    m_update_buffers= true;
+}
+
+
+Mesh::BufferLayout Mesh::buffer_layout( const bool use_texcoord, const bool use_normal, const bool use_color ) const
+{
+    BufferLayout layout= { };
+    
+    std::size_t n= m_positions.size();
+    layout.sizes[0]= m_compact ? sizeof(Unorm16x4) : sizeof(vec3);
+    if(m_texcoords.size() == n && use_texcoord)
+        layout.sizes[1]= m_compact ? sizeof(Half2) : sizeof(vec2);
+    if(m_normals.size() == n && use_normal)
+        layout.sizes[2]= m_compact ? sizeof(Snorm16x2) : sizeof(vec3);
+    if(m_colors.size() == n && use_color)
+        layout.sizes[3]= m_compact ? sizeof(Rgba8) : sizeof(vec4);
+    
+    if(m_interleaved)
+    {
+        // position, texcoord, normale, couleur du sommet 0, puis du sommet 1, etc.
+        std::size_t stride= 0;
+        for(int i= 0; i < 4; i++)
+        {
+            layout.offsets[i]= stride;
+            stride= stride + layout.sizes[i];
+        }
+        
+        for(int i= 0; i < 4; i++)
+            layout.strides[i]= stride;
+        layout.size= n * stride;
+    }
+    else
+    {
+        // toutes les positions, puis toutes les texcoords, etc.
+        std::size_t offset= 0;
+        for(int i= 0; i < 4; i++)
+        {
+            layout.offsets[i]= offset;
+            layout.strides[i]= layout.sizes[i];
+            offset= offset + n * layout.sizes[i];
+        }
+        
+        layout.size= offset;
+    }
+    
+    return layout;
+}
+
+void Mesh::encode_attribute( const int attribute, const unsigned int begin, const unsigned int end, unsigned char *data, const std::size_t stride ) const
+{
+    for(unsigned int i= begin; i < end; i++, data+= stride)
+    {
+        switch(attribute)
+        {
+            case 0:
+                if(m_compact)
+                {
+                    Unorm16x4 p= encode_position(m_positions[i], m_compact_pmin, m_compact_pmax);
+                    memcpy(data, &p, sizeof(p));
+                }
+                else
+                    memcpy(data, &m_positions[i], sizeof(vec3));
+                break;
+            case 1:
+                if(m_compact)
+                {
+                    Half2 t= encode_texcoord(m_texcoords[i]);
+                    memcpy(data, &t, sizeof(t));
+                }
+                else
+                    memcpy(data, &m_texcoords[i], sizeof(vec2));
+                break;
+            case 2:
+                if(m_compact)
+                {
+                    Snorm16x2 n= encode_normal16(m_normals[i]);
+                    memcpy(data, &n, sizeof(n));
+                }
+                else
+                    memcpy(data, &m_normals[i], sizeof(vec3));
+                break;
+            case 3:
+                if(m_compact)
+                {
+                    Rgba8 c= encode_color(m_colors[i]);
+                    memcpy(data, &c, sizeof(c));
+                }
+                else
+                    memcpy(data, &m_colors[i], sizeof(vec4));
+                break;
+        }
+    }
+}
+
+void Mesh::upload_buffers( const BufferLayout& layout )
+{
+    // les positions compactes sont quantifiees dans l'englobant de l'objet
+    if(m_compact)
+        bounds(m_compact_pmin, m_compact_pmax);
+    
+    // construit le contenu du buffer, et le transfere en une seule fois
+    std::vector<unsigned char> data(layout.size);
+    for(int i= 0; i < 4; i++)
+        if(layout.sizes[i])
+            encode_attribute(i, 0, (unsigned int) m_positions.size(), data.data() + layout.offsets[i], layout.strides[i]);
+    
+    glBufferData(GL_ARRAY_BUFFER, layout.size, data.data(), GL_STATIC_DRAW);
+    m_buffer_size= layout.size;
+    
+    // configure le format de sommet (vao)
+    static const GLint float_sizes[]= { 3, 2, 3, 4 };
+    static const GLint compact_sizes[]= { 3, 2, 2, 4 };
+    static const GLenum compact_types[]= { GL_UNSIGNED_SHORT, GL_HALF_FLOAT, GL_SHORT, GL_UNSIGNED_BYTE };
+    static const GLboolean compact_normalized[]= { GL_TRUE, GL_FALSE, GL_TRUE, GL_TRUE };
+    for(int i= 0; i < 4; i++)
+    {
+        if(layout.sizes[i] == 0)
+        {
+            glDisableVertexAttribArray(i);
+            continue;
+        }
+        
+        if(m_compact)
+            glVertexAttribPointer(i, compact_sizes[i], compact_types[i], compact_normalized[i], (GLsizei) layout.strides[i], (const void *) layout.offsets[i]);
+        else
+            glVertexAttribPointer(i, float_sizes[i], GL_FLOAT, GL_FALSE, (GLsizei) layout.strides[i], (const void *) layout.offsets[i]);
+        glEnableVertexAttribArray(i);
+    }
+}
+
 GLuint Mesh::create_buffers( const bool use_texcoord, const bool use_normal, const bool use_color )
 {
     if(m_positions.size() == 0)
@@ -305,46 +578,10 @@ GLuint Mesh::create_buffers( const bool use_texcoord, const bool use_normal, con
     glGenVertexArrays(1, &m_vao);
     glBindVertexArray(m_vao);
     
-    // determine la taille du buffer pour stocker tous les attributs et les indices
-    size_t size= vertex_buffer_size() + texcoord_buffer_size() + normal_buffer_size() + color_buffer_size();
-    // allouer le buffer
+    // allouer le buffer, transferer les attributs et configurer le format de sommet (vao)
     glGenBuffers(1, &m_buffer);
     glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
-    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
-    
-    // transferer les attributs et configurer le format de sommet (vao)
-    size_t offset= 0;
-    size= vertex_buffer_size();
-    glBufferSubData(GL_ARRAY_BUFFER, offset, size, vertex_buffer());
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const void *) offset);
-    glEnableVertexAttribArray(0);
-    
-    if(m_texcoords.size() == m_positions.size() && use_texcoord)
-    {
-        offset= offset + size;
-        size= texcoord_buffer_size();
-        glBufferSubData(GL_ARRAY_BUFFER, offset, size, texcoord_buffer());
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (const void *) offset);
-        glEnableVertexAttribArray(1);
-    }
-    
-    if(m_normals.size() == m_positions.size() && use_normal)
-    {
-        offset= offset + size;
-        size= normal_buffer_size();
-        glBufferSubData(GL_ARRAY_BUFFER, offset, size, normal_buffer());
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (const void *) offset);
-        glEnableVertexAttribArray(2);
-    }
-    
-    if(m_colors.size() == m_positions.size() && use_color)
-    {
-        offset= offset + size;
-        size= color_buffer_size();
-        glBufferSubData(GL_ARRAY_BUFFER, offset, size, color_buffer());
-        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 0, (const void *) offset);
-        glEnableVertexAttribArray(3);
-    }
+    upload_buffers( buffer_layout(use_texcoord, use_normal, use_color) );
     
     // allouer l'index buffer
     if(index_buffer_size())
@@ -371,29 +608,58 @@ int Mesh::update_buffers( const bool use_texcoord, const bool use_normal, const
     
     glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
     
-    size_t offset= 0;
-    size_t size= vertex_buffer_size();
-    glBufferSubData(GL_ARRAY_BUFFER, offset, size, vertex_buffer());
+    BufferLayout layout= buffer_layout(use_texcoord, use_normal, use_color);
     
-    if(m_texcoords.size() == m_positions.size() && use_texcoord)
+    bool full= (layout.size != m_buffer_size);     // nouveaux sommets
+    if(m_compact)
     {
-        offset= offset + size;
-        size= texcoord_buffer_size();
-        glBufferSubData(GL_ARRAY_BUFFER, offset, size, texcoord_buffer());
+        // les positions sont sorties de l'englobant ?
+        Point pmin, pmax;
+        bounds(pmin, pmax);
+        full= full
+            || pmin.x < m_compact_pmin.x || pmin.y < m_compact_pmin.y || pmin.z < m_compact_pmin.z
+            || pmax.x > m_compact_pmax.x || pmax.y > m_compact_pmax.y || pmax.z > m_compact_pmax.z;
     }
     
-    if(m_normals.size() == m_positions.size() && use_normal)
+    if(full)
     {
-        offset= offset + size;
-        size= normal_buffer_size();
-        glBufferSubData(GL_ARRAY_BUFFER, offset, size, normal_buffer());
+        // re-alloue et re-transfere tout le buffer, re-configure le vao
+        glBindVertexArray(m_vao);
+        upload_buffers(layout);
+        glBindVertexArray(0);
     }
-    
-    if(m_colors.size() == m_positions.size() && use_color)
+    else
     {
-        offset= offset + size;
-        size= color_buffer_size();
-        glBufferSubData(GL_ARRAY_BUFFER, offset, size, color_buffer());
+        // ne transfere que les sommets modifies
+        unsigned int begin= m_dirty_begin;
+        unsigned int end= std::min(m_dirty_end, (unsigned int) m_positions.size());
+        assert(begin < end);
+        
+        if(m_interleaved)
+        {
+            // les sommets modifies sont consecutifs dans le buffer
+            std::size_t stride= layout.strides[0];
+            std::vector<unsigned char> data((end - begin) * stride);
+            for(int i= 0; i < 4; i++)
+                if(layout.sizes[i])
+                    encode_attribute(i, begin, end, data.data() + layout.offsets[i], stride);
+            
+            glBufferSubData(GL_ARRAY_BUFFER, begin * stride, data.size(), data.data());
+        }
+        else
+        {
+            // un intervalle par attribut
+            std::vector<unsigned char> data;
+            for(int i= 0; i < 4; i++)
+            {
+                if(layout.sizes[i] == 0)
+                    continue;
+                
+                data.resize((end - begin) * layout.sizes[i]);
+                encode_attribute(i, begin, end, data.data(), layout.sizes[i]);
+                glBufferSubData(GL_ARRAY_BUFFER, layout.offsets[i] + begin * layout.strides[i], data.size(), data.data());
+            }
+        }
     }
     
     m_update_buffers= false;
@@ -401,7 +667,7 @@ int Mesh::update_buffers( const bool use_texcoord, const bool use_normal, const
 }
 
 
-GLuint Mesh::create_program( const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_light, const bool use_alpha_test )
+GLuint Mesh::create_program( const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_light, const bool use_alpha_test, const bool async )
 {
     std::string definitions;
 
@@ -415,27 +681,22 @@ GLuint Mesh::create_program( const bool use_texcoord, const bool use_normal, con
         definitions.append("#define USE_LIGHT\n");
     if(use_texcoord && use_alpha_test)
         definitions.append("#define USE_ALPHATEST\n");
+    if(m_compact)
+        definitions.append("#define USE_COMPACT\n");
 
     //~ printf("--\n%s", definitions.c_str());
     bool use_mesh_color= (m_primitives == GL_POINTS || m_primitives == GL_LINES || m_primitives == GL_LINE_STRIP || m_primitives == GL_LINE_LOOP);
-    if(!use_mesh_color)
-        m_program= read_program( smart_path("data/shaders/mesh.glsl"), definitions.c_str());
+    const char *filename= use_mesh_color ? smart_path("data/shaders/mesh_color.glsl") : smart_path("data/shaders/mesh.glsl");
+    if(async)
+        return read_program_async(filename, definitions.c_str());
     else
-        m_program= read_program( smart_path("data/shaders/mesh_color.glsl"), definitions.c_str());
-    return m_program;
+        return read_program(filename, definitions.c_str());
 }
 
-
-void Mesh::draw( const Transform& model, const Transform& view, const Transform& projection,
-    const bool use_light, const Point& light, const Color& light_color,
-    const bool use_texture, const GLuint texture,
-    const bool use_alpha_test, const float alpha_min )
+// identifie le shader utilise par draw( )
+static
+unsigned int program_key( const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_texture, const bool use_light, const bool use_alpha_test, const bool compact, const bool mesh_color )
 {
-    bool use_texcoord= (m_texcoords.size() == m_positions.size() && texture > 0);
-    bool use_normal= (m_normals.size() == m_positions.size());
-    bool use_color= (m_colors.size() == m_positions.size());
-    
-    // etape 1 : construit le program en fonction des attributs du mesh et des options choisies
     unsigned int key= 0;
     if(use_texcoord) key= key | 1;
     if(use_normal) key= key | 2;
@@ -443,64 +704,130 @@ void Mesh::draw( const Transform& model, const Transform& view, const Transform&
     if(use_texture) key= key | 8;
     if(use_light) key= key | 16;
     if(use_alpha_test) key= key | 32;
+    if(compact) key= key | 64;
+    if(mesh_color) key= key | 128;
+    return key;
+}
 
-    if(m_state != key)
-        // recherche un shader deja compile pour ce type de draw
-        m_program= m_state_map[key];
-
-    if(m_program == 0)
+GLuint Mesh::state_program( const unsigned int key, const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_light, const bool use_alpha_test, const bool async )
+{
+    GLuint& program= m_state_map[key];
+    if(program > 0)
+        return program;
+    
+    // recherche un shader deja compile par un autre objet
+    SharedProgram& shared= shared_programs[key];
+    if(shared.program == 0)
     {
         // pas de shader pour ce type de draw
-        create_program(use_texcoord, use_normal, use_color, use_light, use_alpha_test);
-        program_print_errors(m_program);
-
-        // conserver le shader
-        m_state_map[key]= m_program;
+        shared.program= create_program(use_texcoord, use_normal, use_color, use_light, use_alpha_test, async);
+        shared.count= 0;
+        if(!async)
+            program_print_errors(shared.program);
     }
+    
+    // conserver le shader
+    shared.count++;
+    program= shared.program;
+    return program;
+}
+
+void Mesh::preload_program( const bool use_light, const bool use_texture, const bool use_alpha_test )
+{
+    bool use_texcoord= (has_texcoord() && use_texture);
+    bool use_mesh_color= (m_primitives == GL_POINTS || m_primitives == GL_LINES || m_primitives == GL_LINE_STRIP || m_primitives == GL_LINE_LOOP);
+    
+    unsigned int key= program_key(use_texcoord, has_normal(), has_color(), use_texture, use_light, use_alpha_test, m_compact, use_mesh_color);
+    state_program(key, use_texcoord, has_normal(), has_color(), use_light, use_alpha_test, true);
+}
+
 
+GLuint Mesh::draw_program( const bool use_light, const bool use_texture, const GLuint texture, const bool use_alpha_test )
+{
+    bool use_texcoord= (has_texcoord() && texture > 0);
+    bool use_mesh_color= (m_primitives == GL_POINTS || m_primitives == GL_LINES || m_primitives == GL_LINE_STRIP || m_primitives == GL_LINE_LOOP);
+    
+    // etape 1 : construit le program en fonction des attributs du mesh et des options choisies
+    unsigned int key= program_key(use_texcoord, has_normal(), has_color(), use_texture, use_light, use_alpha_test, m_compact, use_mesh_color);
+    if(m_state != key || m_program == 0)
+    {
+        // recherche un shader deja compile pour ce type de draw, partage par tous les objets
+        m_program= state_program(key, use_texcoord, has_normal(), has_color(), use_light, use_alpha_test, false);
+        
+        // termine la compilation, cf preload_program()
+        if(program_wait(m_program) < 0)
+            program_print_errors(m_program);
+    }
+    
     // conserve la config du shader selectionne.
     assert(m_program != 0);
     m_state= key;
+    
+    // etape  2 : cree les buffers et le vao, avant les transformations qui decodent les positions compactes
+    if(m_vao == 0)
+        create_buffers(true, true, true);
+    
+    assert(m_vao != 0);
+    if(m_update_buffers)
+        update_buffers(true, true, true);
+    
+    return m_program;
+}
 
-    glUseProgram(m_program);
-    program_uniform(m_program, "mesh_color", default_color());
+void Mesh::draw_primitives( ) const
+{
+    if(m_indices.size() > 0)
+        glDrawElements(m_primitives, (GLsizei) m_indices.size(), GL_UNSIGNED_INT, 0);
+    else
+        glDrawArrays(m_primitives, 0, (GLsizei) m_positions.size());
+}
+
+void Mesh::draw( const Transform& model, const Transform& view, const Transform& projection,
+    const bool use_light, const Point& light, const Color& light_color,
+    const bool use_texture, const GLuint texture,
+    const bool use_alpha_test, const float alpha_min )
+{
+    bool use_texcoord= (has_texcoord() && texture > 0);
+    bool use_normal= has_normal();
+    
+    // etapes 1 et 2 : shader, buffers et vao
+    GLuint program= draw_program(use_light, use_texture, texture, use_alpha_test);
+    
+    glUseProgram(program);
+    program_uniform(program, "mesh_color", default_color());
 
     Transform mv= view * model;
     Transform mvp= projection * mv;
+    Transform normal= mv.normal();
+    if(m_compact)
+    {
+        // decode les positions compactes, les normales ne sont pas concernees
+        mv= mv * compact_transform();
+        mvp= mvp * compact_transform();
+    }
 
-    program_uniform(m_program, "mvpMatrix", mvp);
-    program_uniform(m_program, "mvMatrix", mv);
+    program_uniform(program, "mvpMatrix", mvp);
+    program_uniform(program, "mvMatrix", mv);
     if(use_normal)
-        program_uniform(m_program, "normalMatrix", mv.normal()); // transforme les normales dans le repere camera.
+        program_uniform(program, "normalMatrix", normal); // transforme les normales dans le repere camera.
 
     // utiliser une texture, elle ne sera visible que si le mesh a des texcoords...
     if(texture && use_texcoord && use_texture)
-        program_use_texture(m_program, "diffuse_color", 0, texture);
+        program_use_texture(program, "diffuse_color", 0, texture);
 
     if(use_light)
     {
-        program_uniform(m_program, "light", view(light));       // transforme la position de la source dans le repere camera, comme les normales
-        program_uniform(m_program, "light_color", light_color);
+        program_uniform(program, "light", view(light));       // transforme la position de la source dans le repere camera, comme les normales
+        program_uniform(program, "light_color", light_color);
     }
     
     if(use_alpha_test)
-        program_uniform(m_program, "alpha_min", alpha_min);
-    
-    // etape  2 : cree les buffers et le vao
-    if(m_vao == 0)
-        create_buffers(true, true, true);
-    
-    assert(m_vao != 0);
-    if(m_update_buffers)
-        update_buffers(true, true, true);
+        program_uniform(program, "alpha_min", alpha_min);
     
     glBindVertexArray(m_vao);
     
     // etape 3 : dessiner
-    if(m_indices.size() > 0)
-        glDrawElements(m_primitives, (GLsizei) m_indices.size(), GL_UNSIGNED_INT, 0);
-    else
-        glDrawArrays(m_primitives, 0, (GLsizei) m_positions.size());
+    draw_primitives();
 }
 
 void Mesh::draw( const GLuint program, const bool use_position, const bool use_texcoord, const bool use_normal, const bool use_color )
@@ -572,7 +899,9 @@ void Mesh::draw( const GLuint program, const bool use_position, const bool use_t
         {
             if(!use_normal || !normal_buffer_size())
                 printf("[oops]  no normal '%s' attribute in mesh... can't draw !!\n", name);
-            if(glsl_size != 1 || glsl_type != GL_FLOAT_VEC3)
+            if(m_compact && (glsl_size != 1 || glsl_type != GL_FLOAT_VEC2))
+                printf("[oops]  compact attribute '%s' is not declared as a vec2... can't draw !!\n", name);
+            if(!m_compact && (glsl_size != 1 || glsl_type != GL_FLOAT_VEC3))
                 printf("[oops]  attribute '%s' is not declared as a vec3... can't draw !!\n", name);
         }
         else if(location == 3)  // attribut color necessaire
@@ -104,6 +104,16 @@ struct TriangleData
 };
 
 
+/*! shaders partages utilises par un objet, cf Mesh::state_program( ).
+    la copie d'un objet conserve aussi ses shaders, sinon Mesh::release( ) les rendrait plusieurs fois.
+ */
+struct MeshPrograms : public std::unordered_map<unsigned int, GLuint>
+{
+    MeshPrograms( ) : std::unordered_map<unsigned int, GLuint>() {}
+    MeshPrograms( const MeshPrograms& programs );
+    MeshPrograms& operator= ( const MeshPrograms& programs );
+};
+
 //! representation d'un objet / maillage.
 class Mesh
 {
@@ -112,11 +122,13 @@ public:
     //@{
     //! constructeur par defaut.
     Mesh( ) : m_positions(), m_texcoords(), m_normals(), m_colors(), m_indices(), m_state_map(), m_state(0),
-        m_color(White()), m_primitives(GL_POINTS), m_vao(0), m_buffer(0), m_index_buffer(0), m_program(0), m_update_buffers(false) {}
+        m_color(White()), m_primitives(GL_POINTS), m_vao(0), m_buffer(0), m_index_buffer(0), m_program(0), m_update_buffers(false),
+        m_compact(false), m_compact_pmin(), m_compact_pmax(), m_interleaved(false), m_buffer_size(0), m_dirty_begin(0), m_dirty_end(0) {}
     
     //! constructeur.
     Mesh( const GLenum primitives ) : m_positions(), m_texcoords(), m_normals(), m_colors(), m_indices(), m_state_map(), m_state(0),
-        m_color(White()), m_primitives(primitives), m_vao(0), m_buffer(0), m_index_buffer(0), m_program(0), m_update_buffers(false) {}
+        m_color(White()), m_primitives(primitives), m_vao(0), m_buffer(0), m_index_buffer(0), m_program(0), m_update_buffers(false),
+        m_compact(false), m_compact_pmin(), m_compact_pmax(), m_interleaved(false), m_buffer_size(0), m_dirty_begin(0), m_dirty_end(0) {}
     
     //! construit les objets openGL.
     int create( const GLenum primitives );
@@ -243,6 +255,27 @@ public:
     //! renvoie min et max les coordonnees des extremites des positions des sommets de l'objet (boite englobante alignee sur les axes, aabb).
     void bounds( Point& pmin, Point& pmax );
     
+    /*! re-ordonne les triangles et les sommets d'un mesh indexe : cache de sommets, overdraw puis ordre d'acces aux sommets, cf mesh_optimize.h. 
+        triangle(id) et triangle_material(id) suivent le nouvel ordre des triangles. a utiliser avant de construire les buffers.
+     */
+    Mesh& optimize( const int cache_size= 16 );
+    
+    /*! utilise un format de sommet compact pour les buffers openGL, cf vertex_codec.h : positions 16 bits dans l'englobant de l'objet, normales en projection octaedrique 2x16 bits, texcoords en half float, couleurs rgba8. 20 octets par sommet au lieu de 48.
+        a utiliser avant de construire les buffers. draw( model, view, projection, ...) decode les sommets. un shader fourni par l'application doit utiliser compact_transform( ) pour decoder les positions et decoder les normales, cf oct_decode( ) dans data/shaders/mesh.glsl.
+     */
+    Mesh& compact( const bool enable= true );
+    //! renvoie vrai si les buffers utilisent le format compact.
+    bool is_compact( ) const { return m_compact; }
+    //! renvoie la transformation qui decode les positions compactes, a composer avec la transformation model : model * compact_transform( ). valide apres create_buffers( ), identite si le format compact n'est pas utilise.
+    Transform compact_transform( ) const;
+    
+    /*! range les attributs des sommets de maniere entrelacee dans le vertex buffer : position, texcoord, normale et couleur de chaque sommet sont consecutifs, au lieu d'un tableau par attribut. 
+        a utiliser avant de construire les buffers. compatible avec compact( ).
+     */
+    Mesh& interleaved( const bool enable= true );
+    //! renvoie vrai si les attributs sont entrelaces dans le vertex buffer.
+    bool is_interleaved( ) const { return m_interleaved; }
+    
     //! renvoie la couleur par defaut du mesh, utilisee si les sommets n'ont pas de couleur associee.
     Color default_color( ) const { return m_color; }
     //! modifie la couleur par defaut, utilisee si les sommets n'ont pas de couleur associee.
@@ -255,6 +288,13 @@ public:
     //! renvoie le nombre d'indices de sommets.
     int index_count( ) const { return (int) m_indices.size(); }
     
+    //! renvoie vrai si tous les sommets ont des coordonnees de texture.
+    bool has_texcoord( ) const { return !m_positions.empty() && m_texcoords.size() == m_positions.size(); }
+    //! renvoie vrai si tous les sommets ont une normale.
+    bool has_normal( ) const { return !m_positions.empty() && m_normals.size() == m_positions.size(); }
+    //! renvoie vrai si tous les sommets ont une couleur.
+    bool has_color( ) const { return !m_positions.empty() && m_colors.size() == m_positions.size(); }
+    
     //! renvoie l'adresse de la position du premier sommet. permet de construire les vertex buffers openGL. par convention, la position est un vec3, 3 GL_FLOAT.
     const float *vertex_buffer( ) const { return &m_positions.front().x; }
     //! renvoie la longueur (en octets) du vertex buffer.
@@ -325,6 +365,20 @@ public:
         const bool use_texture, const GLuint texture,
         const bool use_alpha_test, const float alpha_min );
     
+    /*! prepare le shader utilise par draw( ) avec ces options, sans attendre la fin de la compilation.
+        les shaders de plusieurs options, ou de plusieurs objets, sont compiles en parallele. a utiliser apres le chargement de l'objet, avant le premier affichage.
+     */
+    void preload_program( const bool use_light, const bool use_texture, const bool use_alpha_test= false );
+    
+    /*! selectionne le shader utilise par draw( ) avec ces options et construit les buffers, sans dessiner. renvoie le shader.
+        les shaders sont partages par tous les objets qui utilisent les memes options, cf DrawQueue.
+     */
+    GLuint draw_program( const bool use_light, const bool use_texture, const GLuint texture, const bool use_alpha_test );
+    //! renvoie le vertex array object de l'objet, 0 s'il n'est pas encore construit, cf create_buffers( ) et draw_program( ).
+    GLuint vao( ) const { return m_vao; }
+    //! dessine les primitives de l'objet. le shader et le vao doivent deja etre selectionnes, cf DrawQueue.
+    void draw_primitives( ) const;
+    
     //! dessine l'objet avec un shader fourni par l'application. les uniforms du shader doivent deja etre configure, cf transformations...
     void draw( const GLuint program, const bool use_position= true, const bool use_texcoord= true, const bool use_normal= true, const bool use_color= true );
     
@@ -338,11 +392,32 @@ protected:
     \param use_color force l'utilisation des couleurs 
     \param use_light force l'utilisation d'un source de lumiere 
     \param use_alpha_test force l'utilisation d'un test de transparence, cf utilisation d'une texture avec un canal alpha
+    \param async n'attend pas la fin de la compilation, cf read_program_async( )
      */
-    GLuint create_program( const bool use_texcoord= true, const bool use_normal= true, const bool use_color= true, const bool use_light= false, const bool use_alpha_test= false );
+    GLuint create_program( const bool use_texcoord= true, const bool use_normal= true, const bool use_color= true, const bool use_light= false, const bool use_alpha_test= false, const bool async= false );
+    
+    //! renvoie le shader partage identifie par key, le compile si necessaire, cf draw_program( ).
+    GLuint state_program( const unsigned int key, const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_light, const bool use_alpha_test, const bool async );
     
     //! modifie les buffers openGL, si necessaire.
     int update_buffers( const bool use_texcoord, const bool use_normal, const bool use_color );
+    //! organisation des attributs dans le vertex buffer : l'attribut i du sommet v est a l'adresse offsets[i] + v * strides[i].
+    struct BufferLayout
+    {
+        std::size_t offsets[4];     //!< position, texcoord, normale, couleur.
+        std::size_t strides[4];
+        std::size_t sizes[4];       //!< taille d'un attribut, 0 s'il n'est pas utilise.
+        std::size_t size;           //!< taille du buffer.
+    };
+    
+    //! construit l'organisation du vertex buffer, planaire ou entrelacee, format float ou compact.
+    BufferLayout buffer_layout( const bool use_texcoord, const bool use_normal, const bool use_color ) const;
+    //! encode l'attribut i des sommets [begin .. end) dans data.
+    void encode_attribute( const int i, const unsigned int begin, const unsigned int end, unsigned char *data, const std::size_t stride ) const;
+    //! alloue le vertex buffer, transfere tous les attributs en une fois et configure le vao selectionne.
+    void upload_buffers( const BufferLayout& layout );
+    //! note la modification du sommet id, cf update_buffers( ).
+    void modified( const unsigned int id );
     
     //
     std::vector<vec3> m_positions;
@@ -355,7 +430,7 @@ protected:
     std::vector<Material> m_materials;
     std::vector<unsigned int> m_triangle_materials;
 
-    std::unordered_map<unsigned int, GLuint> m_state_map;
+    MeshPrograms m_state_map;     //!< shaders partages utilises par l'objet, cf state_program( ).
     unsigned int m_state;
 
     Color m_color;
@@ -367,6 +442,15 @@ protected:
     GLuint m_program;
     
     bool m_update_buffers;
+    
+    bool m_compact;
+    Point m_compact_pmin;
+    Point m_compact_pmax;
+    
+    bool m_interleaved;
+    std::size_t m_buffer_size;
+    unsigned int m_dirty_begin;
+    unsigned int m_dirty_end;
 };
 
 ///@}
@@ -0,0 +1,274 @@
+
+#include <cassert>
+#include <algorithm>
+
+#include "mesh_optimize.h"
+
+
+int vertex_cache_misses( const std::vector<unsigned int>& indices, const int cache_size )
+{
+    unsigned int vertex_count= 0;
+    for(unsigned int i= 0; i < indices.size(); i++)
+        vertex_count= std::max(vertex_count, indices[i] +1);
+
+    // date d'insertion de chaque sommet dans le cache
+    std::vector<int> stamps(vertex_count, -1);
+    int misses= 0;
+    for(unsigned int i= 0; i < indices.size(); i++)
+    {
+        unsigned int v= indices[i];
+        if(stamps[v] >= 0 && misses - stamps[v] < cache_size)
+            continue;   // le sommet est dans le cache
+
+        stamps[v]= misses;
+        misses++;
+    }
+
+    return misses;
+}
+
+float acmr( const std::vector<unsigned int>& indices, const int cache_size )
+{
+    if(indices.size() < 3)
+        return 0;
+    return float(vertex_cache_misses(indices, cache_size)) / float(indices.size() / 3);
+}
+
+float atvr( const std::vector<unsigned int>& indices, const int vertex_count, const int cache_size )
+{
+    if(vertex_count == 0)
+        return 0;
+    return float(vertex_cache_misses(indices, cache_size)) / float(vertex_count);
+}
+
+
+// tipsify : choisit le prochain sommet a utiliser comme centre de l'eventail de triangles.
+static
+int skip_dead_end( const std::vector<int>& live, std::vector<int>& dead_end, int& cursor )
+{
+    // sommets recemment utilises
+    while(!dead_end.empty())
+    {
+        int v= dead_end.back();
+        dead_end.pop_back();
+        if(live[v] > 0)
+            return v;
+    }
+
+    // sommet suivant dans l'ordre
+    while(cursor < int(live.size()))
+    {
+        if(live[cursor] > 0)
+            return cursor;
+        cursor++;
+    }
+
+    return -1;
+}
+
+static
+int next_vertex( const std::vector<int>& candidates, const std::vector<int>& live, const std::vector<int>& stamps, const int time, const int cache_size )
+{
+    int best= -1;
+    int priority= -1;
+    for(unsigned int i= 0; i < candidates.size(); i++)
+    {
+        int v= candidates[i];
+        if(live[v] > 0)
+        {
+            // le sommet sera encore dans le cache apres avoir emis tous ses triangles ?
+            int p= 0;
+            if(time - stamps[v] + 2 * live[v] <= cache_size)
+                p= time - stamps[v];    // le plus ancien
+
+            if(p > priority)
+            {
+                priority= p;
+                best= v;
+            }
+        }
+    }
+
+    return best;
+}
+
+std::vector<int> vertex_cache_order( const std::vector<unsigned int>& indices, const int vertex_count, const int cache_size, std::vector<int>& clusters )
+{
+    int triangle_count= int(indices.size() / 3);
+    clusters.clear();
+
+    std::vector<int> order;
+    order.reserve(triangle_count);
+    if(triangle_count == 0)
+        return order;
+
+    // adjacence sommet / triangles
+    std::vector<int> live(vertex_count, 0);
+    for(unsigned int i= 0; i < indices.size(); i++)
+        live[indices[i]]++;
+
+    std::vector<int> offsets(vertex_count +1, 0);
+    for(int i= 0; i < vertex_count; i++)
+        offsets[i +1]= offsets[i] + live[i];
+
+    std::vector<int> adjacency(indices.size());
+    {
+        std::vector<int> fill(offsets.begin(), offsets.end() -1);
+        for(unsigned int i= 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++]= i / 3;
+    }
+
+    std::vector<int> stamps(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<int> dead_end;
+    std::vector<int> candidates;
+
+    int time= cache_size +1;
+    int cursor= 0;
+    int fan= skip_dead_end(live, dead_end, cursor);
+    clusters.push_back(0);
+    while(fan >= 0)
+    {
+        candidates.clear();
+
+        // emet les triangles de l'eventail
+        for(int i= offsets[fan]; i < offsets[fan +1]; i++)
+        {
+            int t= adjacency[i];
+            if(emitted[t])
+                continue;
+
+            emitted[t]= true;
+            order.push_back(t);
+            for(int k= 0; k < 3; k++)
+            {
+                int v= indices[3*t +k];
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+
+                if(time - stamps[v] > cache_size)
+                {
+                    stamps[v]= time;
+                    time++;
+                }
+            }
+        }
+
+        fan= next_vertex(candidates, live, stamps, time, cache_size);
+        if(fan < 0)
+        {
+            // impasse, commence un nouveau groupe
+            fan= skip_dead_end(live, dead_end, cursor);
+            if(fan >= 0 && int(order.size()) < triangle_count)
+                clusters.push_back(int(order.size()));
+        }
+    }
+
+    assert(int(order.size()) == triangle_count);
+    return order;
+}
+
+
+std::vector<int> overdraw_order( const std::vector<unsigned int>& indices, const std::vector<vec3>& positions, const std::vector<int>& order, const std::vector<int>& clusters )
+{
+    int cluster_count= int(clusters.size());
+    if(cluster_count < 2)
+        return order;
+
+    // centre et normale de chaque groupe, ponderes par l'aire des triangles
+    std::vector<Point> centers(cluster_count);
+    std::vector<Vector> normals(cluster_count);
+    Vector mesh_center;
+    float mesh_area= 0;
+    for(int c= 0; c < cluster_count; c++)
+    {
+        int begin= clusters[c];
+        int end= (c +1 < cluster_count) ? clusters[c +1] : int(order.size());
+
+        Vector center;
+        Vector normal;
+        float area= 0;
+        for(int i= begin; i < end; i++)
+        {
+            int t= order[i];
+            Point a= Point(positions[indices[3*t]]);
+            Point b= Point(positions[indices[3*t +1]]);
+            Point c= Point(positions[indices[3*t +2]]);
+
+            Vector n= cross(b - a, c - a);
+            float w= length(n) / 2;
+            center= center + w * (Vector(a) + Vector(b) + Vector(c)) / 3;
+            normal= normal + n;
+            area= area + w;
+        }
+
+        mesh_center= mesh_center + center;
+        mesh_area= mesh_area + area;
+
+        centers[c]= (area > 0) ? Point(center / area) : Point(positions[indices[3*order[begin]]]);
+        normals[c]= normal;
+    }
+
+    if(mesh_area > 0)
+        mesh_center= mesh_center / mesh_area;
+
+    // trie les groupes, les groupes orientes vers l'exterieur en premier
+    std::vector<float> keys(cluster_count);
+    for(int c= 0; c < cluster_count; c++)
+    {
+        float l= length(normals[c]);
+        keys[c]= (l > 0) ? dot(centers[c] - Point(mesh_center), normals[c] / l) : 0;
+    }
+
+    std::vector<int> sorted(cluster_count);
+    for(int c= 0; c < cluster_count; c++)
+        sorted[c]= c;
+    std::stable_sort(sorted.begin(), sorted.end(),
+        [&]( const int a, const int b ) { return keys[a] > keys[b]; });
+
+    std::vector<int> reordered;
+    reordered.reserve(order.size());
+    for(int k= 0; k < cluster_count; k++)
+    {
+        int c= sorted[k];
+        int begin= clusters[c];
+        int end= (c +1 < cluster_count) ? clusters[c +1] : int(order.size());
+        reordered.insert(reordered.end(), order.begin() + begin, order.begin() + end);
+    }
+
+    return reordered;
+}
+
+
+std::vector<unsigned int> reorder_triangles( const std::vector<unsigned int>& indices, const std::vector<int>& order )
+{
+    std::vector<unsigned int> reordered;
+    reordered.reserve(order.size() * 3);
+    for(unsigned int i= 0; i < order.size(); i++)
+    {
+        int t= order[i];
+        reordered.push_back(indices[3*t]);
+        reordered.push_back(indices[3*t +1]);
+        reordered.push_back(indices[3*t +2]);
+    }
+
+    return reordered;
+}
+
+
+std::vector<int> vertex_fetch_order( std::vector<unsigned int>& indices, const int vertex_count )
+{
+    std::vector<int> remap(vertex_count, -1);
+    int count= 0;
+    for(unsigned int i= 0; i < indices.size(); i++)
+    {
+        unsigned int v= indices[i];
+        if(remap[v] < 0)
+            remap[v]= count++;
+
+        indices[i]= remap[v];
+    }
+
+    return remap;
+}
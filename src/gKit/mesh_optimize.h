@@ -0,0 +1,69 @@
+
+#ifndef _MESH_OPTIMIZE_H
+#define _MESH_OPTIMIZE_H
+
+#include <vector>
+
+#include "vec.h"
+
+
+//! \addtogroup objet3D
+///@{
+
+//! \file
+/*! re-ordonne les triangles et les sommets d'un maillage indexe, pour limiter le nombre de sommets transformes par le vertex shader, l'overdraw, et ameliorer l'ordre d'acces aux attributs des sommets.
+
+    cf "fast triangle reordering for vertex locality and reduced overdraw", P. Sander, D. Nehab, J. Barczak, 2007
+    http://gfx.cs.princeton.edu/pubs/Sander_2007_%3ETR/tipsy.pdf
+
+    exemple :
+\code
+std::vector<int> clusters;
+std::vector<int> order= vertex_cache_order(indices, vertex_count, 16, clusters);
+order= overdraw_order(indices, positions, order, clusters);
+indices= reorder_triangles(indices, order);
+
+std::vector<int> remap= vertex_fetch_order(indices, vertex_count);
+positions= remap_vertices(positions, remap);
+\endcode
+ */
+
+//! simule un cache fifo de cache_size sommets, et renvoie le nombre de sommets transformes.
+int vertex_cache_misses( const std::vector<unsigned int>& indices, const int cache_size= 16 );
+//! average cache miss ratio, nombre moyen de sommets transformes par triangle. entre 0.5 et 3.
+float acmr( const std::vector<unsigned int>& indices, const int cache_size= 16 );
+//! average transform to vertex ratio, nombre moyen de transformations par sommet. 1 au mieux.
+float atvr( const std::vector<unsigned int>& indices, const int vertex_count, const int cache_size= 16 );
+
+/*! algorithme tipsify, renvoie l'ordre des triangles.
+    clusters contient l'indice du premier triangle de chaque groupe (dans l'ordre renvoye), les groupes peuvent etre re-ordonnes sans modifier le cache de sommets.
+ */
+std::vector<int> vertex_cache_order( const std::vector<unsigned int>& indices, const int vertex_count, const int cache_size, std::vector<int>& clusters );
+
+//! re-ordonne les groupes de triangles construits par vertex_cache_order( ), les groupes orientes vers l'exterieur de l'objet sont dessines en premier.
+std::vector<int> overdraw_order( const std::vector<unsigned int>& indices, const std::vector<vec3>& positions, const std::vector<int>& order, const std::vector<int>& clusters );
+
+//! renvoie les indices des sommets des triangles dans l'ordre order.
+std::vector<unsigned int> reorder_triangles( const std::vector<unsigned int>& indices, const std::vector<int>& order );
+
+//! re-numerote les sommets dans l'ordre d'utilisation par les triangles, modifie indices et renvoie remap, remap[ancien indice]= nouvel indice, ou -1 si le sommet n'est pas utilise.
+std::vector<int> vertex_fetch_order( std::vector<unsigned int>& indices, const int vertex_count );
+
+//! re-ordonne un attribut de sommet, cf vertex_fetch_order( ).
+template < typename T >
+std::vector<T> remap_vertices( const std::vector<T>& attribute, const std::vector<int>& remap )
+{
+    int count= 0;
+    for(unsigned int i= 0; i < remap.size(); i++)
+        if(remap[i] >= count) count= remap[i] +1;
+
+    std::vector<T> data(count);
+    for(unsigned int i= 0; i < remap.size() && i < attribute.size(); i++)
+        if(remap[i] >= 0)
+            data[remap[i]]= attribute[i];
+
+    return data;
+}
+
+///@}
+#endif
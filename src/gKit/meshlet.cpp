@@ -0,0 +1,283 @@
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <unordered_map>
+
+#include "meshlet.h"
+
+
+// indice des positions de chaque sommet, les sommets de meme position partagent le meme indice.
+static
+std::vector<unsigned int> position_ids( const std::vector<vec3>& positions, unsigned int& count )
+{
+    struct PositionHash
+    {
+        size_t operator() ( const vec3& p ) const
+        {
+            uint32_t h[3];
+            memcpy(h, &p.x, sizeof(h));
+            return size_t(h[0] * 73856093u ^ h[1] * 19349663u ^ h[2] * 83492791u);
+        }
+    };
+
+    struct PositionEqual
+    {
+        bool operator() ( const vec3& a, const vec3& b ) const { return a.x == b.x && a.y == b.y && a.z == b.z; }
+    };
+
+    std::unordered_map<vec3, unsigned int, PositionHash, PositionEqual> map;
+    map.reserve(positions.size());
+
+    std::vector<unsigned int> ids(positions.size());
+    count= 0;
+    for(unsigned int i= 0; i < positions.size(); i++)
+    {
+        auto found= map.insert( { positions[i], count } );
+        if(found.second)
+            count++;
+        ids[i]= found.first->second;
+    }
+
+    return ids;
+}
+
+
+// boite englobante et cone des normales des triangles d'un groupe
+static
+void meshlet_bounds( Meshlet& meshlet, const std::vector<unsigned int>& cluster_indices, const std::vector<vec3>& positions )
+{
+    meshlet.pmin= Point(positions[cluster_indices[meshlet.first]]);
+    meshlet.pmax= meshlet.pmin;
+
+    std::vector<Vector> normals;
+    Vector axis;
+    for(unsigned int i= meshlet.first; i < meshlet.first + meshlet.count; i+= 3)
+    {
+        Point a= Point(positions[cluster_indices[i]]);
+        Point b= Point(positions[cluster_indices[i +1]]);
+        Point c= Point(positions[cluster_indices[i +2]]);
+
+        meshlet.pmin= min(meshlet.pmin, min(a, min(b, c)));
+        meshlet.pmax= max(meshlet.pmax, max(a, max(b, c)));
+
+        Vector n= cross(b - a, c - a);
+        float l= length(n);
+        if(l == 0)
+            continue;   // triangle degenere, pas d'orientation
+
+        axis= axis + n;     // moyenne ponderee par l'aire
+        normals.push_back(n / l);
+    }
+
+    // pas de cone si les normales sont trop dispersees
+    meshlet.cone_axis= Vector(0, 0, 1);
+    meshlet.cone_cutoff= 1;
+
+    float l= length(axis);
+    if(l == 0 || normals.empty())
+        return;
+    axis= axis / l;
+
+    float mindp= 1;
+    for(unsigned int i= 0; i < normals.size(); i++)
+        mindp= std::min(mindp, dot(normals[i], axis));
+
+    meshlet.cone_axis= axis;
+    if(mindp > 0)
+        meshlet.cone_cutoff= std::sqrt(1 - mindp * mindp);
+}
+
+
+std::vector<Meshlet> build_meshlets( const std::vector<unsigned int>& indices, const std::vector<vec3>& positions, std::vector<unsigned int>& cluster_indices,
+    const int max_triangles, const int max_vertices )
+{
+    assert(max_triangles > 0 && max_vertices >= 3);
+
+    std::vector<Meshlet> meshlets;
+    cluster_indices.clear();
+
+    int triangle_count= indices.empty() ? int(positions.size() / 3) : int(indices.size() / 3);
+    if(triangle_count == 0)
+        return meshlets;
+
+    auto vertex= [&]( const int t, const int k ) { return indices.empty() ? unsigned(3*t + k) : indices[3*t + k]; };
+
+    // les sommets des triangles voisins sont soudes, meme si le maillage n'est pas indexe
+    unsigned int position_count= 0;
+    std::vector<unsigned int> ids= position_ids(positions, position_count);
+
+    // adjacence positions / triangles
+    std::vector<int> offsets(position_count +1, 0);
+    for(int t= 0; t < triangle_count; t++)
+        for(int k= 0; k < 3; k++)
+            offsets[ids[vertex(t, k)] +1]++;
+    for(unsigned int p= 0; p < position_count; p++)
+        offsets[p +1]+= offsets[p];
+
+    std::vector<int> adjacency(3 * triangle_count);
+    {
+        std::vector<int> fill(offsets.begin(), offsets.end() -1);
+        for(int t= 0; t < triangle_count; t++)
+            for(int k= 0; k < 3; k++)
+                adjacency[fill[ids[vertex(t, k)]]++]= t;
+    }
+
+    // normale de chaque triangle
+    std::vector<Vector> normals(triangle_count);
+    for(int t= 0; t < triangle_count; t++)
+    {
+        Point a= Point(positions[vertex(t, 0)]);
+        Point b= Point(positions[vertex(t, 1)]);
+        Point c= Point(positions[vertex(t, 2)]);
+
+        Vector n= cross(b - a, c - a);
+        float l= length(n);
+        normals[t]= (l > 0) ? n / l : Vector();
+    }
+
+    std::vector<char> used(triangle_count, 0);
+    std::vector<int> stamp(position_count, -1);     // indice du groupe qui utilise la position
+    std::vector<int> candidates;
+
+    cluster_indices.reserve(3 * triangle_count);
+    int seed= 0;
+    for(;;)
+    {
+        // premier triangle du groupe : le suivant dans l'ordre du maillage
+        while(seed < triangle_count && used[seed])
+            seed++;
+        if(seed == triangle_count)
+            break;
+
+        int id= int(meshlets.size());
+        Meshlet meshlet;
+        meshlet.first= unsigned(cluster_indices.size());
+        meshlet.count= 0;
+
+        int vertex_count= 0;
+        Vector axis;
+        candidates.clear();
+        candidates.push_back(seed);
+
+        while(int(meshlet.count / 3) < max_triangles)
+        {
+            // choisit le triangle voisin qui ajoute le moins de sommets, et qui est le mieux oriente
+            int best= -1;
+            int best_new= 0;
+            float best_score= 0;
+            for(unsigned int i= 0; i < candidates.size(); i++)
+            {
+                int t= candidates[i];
+                if(used[t])
+                    continue;
+
+                int new_vertices= 0;
+                for(int k= 0; k < 3; k++)
+                    if(stamp[ids[vertex(t, k)]] != id)
+                        new_vertices++;
+                if(vertex_count + new_vertices > max_vertices)
+                    continue;
+
+                float score= float(new_vertices);
+                if(meshlet.count > 0)
+                {
+                    float l= length(axis);
+                    if(l > 0)
+                        score+= 2 * (1 - dot(normals[t], axis / l));
+                }
+
+                if(best < 0 || score < best_score)
+                {
+                    best= t;
+                    best_new= new_vertices;
+                    best_score= score;
+                }
+            }
+
+            if(best < 0)
+                break;  // plus de voisins
+
+            // ajoute le triangle au groupe
+            used[best]= 1;
+            vertex_count+= best_new;
+            axis= axis + normals[best];
+            for(int k= 0; k < 3; k++)
+            {
+                unsigned int v= vertex(best, k);
+                cluster_indices.push_back(v);
+
+                unsigned int p= ids[v];
+                if(stamp[p] == id)
+                    continue;
+                stamp[p]= id;
+
+                // les voisins du triangle deviennent candidats
+                for(int a= offsets[p]; a < offsets[p +1]; a++)
+                    if(!used[adjacency[a]])
+                        candidates.push_back(adjacency[a]);
+            }
+            meshlet.count+= 3;
+
+            // elimine les candidats deja utilises
+            if(candidates.size() > 4u * unsigned(max_triangles))
+                candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&]( const int t ) { return used[t] != 0; }), candidates.end());
+        }
+
+        meshlet_bounds(meshlet, cluster_indices, positions);
+        meshlets.push_back(meshlet);
+    }
+
+    assert(int(cluster_indices.size()) == 3 * triangle_count);
+    return meshlets;
+}
+
+
+bool meshlet_visible( const Meshlet& meshlet, const Transform& mvp )
+{
+    int planes[6]= { };
+
+    // enumere les 8 sommets de la boite englobante
+    for(unsigned int i= 0; i < 8; i++)
+    {
+        Point p= meshlet.pmin;
+        if(i & 1) p.x= meshlet.pmax.x;
+        if(i & 2) p.y= meshlet.pmax.y;
+        if(i & 4) p.z= meshlet.pmax.z;
+
+        // transformation du point homogene (x, y, z, w= 1)
+        vec4 h= mvp(vec4(p));
+
+        // teste la position du point homogene par rapport aux 6 faces de la region visible
+        if(h.x < -h.w) planes[0]++;     // trop a gauche
+        if(h.x > h.w) planes[1]++;      // trop a droite
+
+        if(h.y < -h.w) planes[2]++;     // trop bas
+        if(h.y > h.w) planes[3]++;      // trop haut
+
+        if(h.z < -h.w) planes[4]++;     // trop pres
+        if(h.z > h.w) planes[5]++;      // trop loin
+    }
+
+    // tous les sommets sont du "mauvais cote" d'une seule face ?
+    for(unsigned int i= 0; i < 6; i++)
+        if(planes[i] == 8)
+            return false;
+
+    return true;
+}
+
+
+bool meshlet_backfacing( const Meshlet& meshlet, const Point& camera )
+{
+    // sphere englobante de la boite
+    Point center= ::center(meshlet.pmin, meshlet.pmax);
+    float radius= distance(meshlet.pmin, meshlet.pmax) / 2;
+
+    // la camera est derriere tous les triangles du groupe, meme en deplacant le sommet du cone dans la sphere englobante
+    // cf "meshoptimizer", A. Kapoulkine, meshopt_computeClusterBounds( )
+    Vector d= center - camera;
+    return dot(d, meshlet.cone_axis) >= meshlet.cone_cutoff * length(d) + radius;
+}
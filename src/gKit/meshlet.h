@@ -0,0 +1,59 @@
+
+#ifndef _MESHLET_H
+#define _MESHLET_H
+
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+
+
+//! \addtogroup objet3D
+///@{
+
+//! \file
+/*! decoupe un maillage en groupes de triangles voisins (meshlets / clusters), avec leur boite englobante et leur cone de normales.
+    chaque groupe peut etre elimine separement : s'il est en dehors de la region visible par la camera ou s'il est oriente dans la direction opposee a la camera.
+
+    cf "optimizing the graphics pipeline with compute", G. Wihlidal, 2016
+    https://frostbite-wp-prd.s3.amazonaws.com/wp-content/uploads/2016/03/29204330/GDC_2016_Compute.pdf
+
+    les tests de visibilite n'utilisent pas openGL, ils sont reproduits par le compute shader tutos/M2/indirect_cull.glsl.
+
+    exemple :
+\code
+std::vector<unsigned int> cluster_indices;
+std::vector<Meshlet> meshlets= build_meshlets(mesh.indices(), mesh.positions(), cluster_indices);
+
+for(auto& meshlet : meshlets)
+    if(meshlet_visible(meshlet, mvp) && !meshlet_backfacing(meshlet, camera))   // camera dans le repere de l'objet
+        glDrawElements(GL_TRIANGLES, meshlet.count, GL_UNSIGNED_INT, (const void *) (meshlet.first * sizeof(unsigned int)));
+\endcode
+ */
+
+//! groupe de triangles.
+struct Meshlet
+{
+    unsigned int first;     //!< premier indice du groupe.
+    unsigned int count;     //!< nombre d'indices du groupe, 3 par triangle.
+    Point pmin;             //!< boite englobante.
+    Point pmax;             //!< boite englobante.
+    Vector cone_axis;       //!< direction moyenne des normales des triangles.
+    float cone_cutoff;      //!< sinus de l'angle entre cone_axis et les normales, 1 si le groupe ne peut pas etre elimine.
+};
+
+/*! construit des groupes de triangles voisins d'au plus max_triangles triangles et max_vertices sommets.
+    indices peut etre vide pour un maillage non indexe.
+    cluster_indices contient les indices des sommets des triangles, dans l'ordre des groupes.
+    renvoie les groupes.
+ */
+std::vector<Meshlet> build_meshlets( const std::vector<unsigned int>& indices, const std::vector<vec3>& positions, std::vector<unsigned int>& cluster_indices,
+    const int max_triangles= 124, const int max_vertices= 64 );
+
+//! renvoie vrai si la boite englobante du groupe est au moins partiellement visible. mvp est la transformation du repere de l'objet vers le repere projectif de la camera.
+bool meshlet_visible( const Meshlet& meshlet, const Transform& mvp );
+//! renvoie vrai si tous les triangles du groupe sont orientes dans la direction opposee a la camera. camera est la position de la camera dans le repere de l'objet.
+bool meshlet_backfacing( const Meshlet& meshlet, const Point& camera );
+
+///@}
+#endif
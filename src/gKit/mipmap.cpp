@@ -0,0 +1,352 @@
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define USE_SSE
+#endif
+
+#include "mipmap.h"
+
+
+// les pixels sont filtres en float, 4 canaux par pixel, meme s'ils ne sont pas tous utilises
+static
+void box_level( const float *src, const int sw, const int sh, float *dst, const int dw, const int dh )
+{
+#pragma omp parallel for schedule(static)
+    for(int y= 0; y < dh; y++)
+    {
+        const float *row0= src + std::size_t(std::min(2*y, sh -1)) * sw * 4;
+        const float *row1= src + std::size_t(std::min(2*y +1, sh -1)) * sw * 4;
+        float *out= dst + std::size_t(y) * dw * 4;
+        for(int x= 0; x < dw; x++)
+        {
+            int x0= std::min(2*x, sw -1) * 4;
+            int x1= std::min(2*x +1, sw -1) * 4;
+        #ifdef USE_SSE
+            __m128 sum= _mm_add_ps(
+                _mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+                _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+            _mm_storeu_ps(out + 4*x, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+        #else
+            for(int i= 0; i < 4; i++)
+                out[4*x + i]= (row0[x0 + i] + row0[x1 + i] + row1[x0 + i] + row1[x1 + i]) * 0.25f;
+        #endif
+        }
+    }
+}
+
+
+// filtre de kaiser, cf "mipmapping part 1", I. Castano, 2011 / nvidia texture tools
+static const int kaiser_taps= 12;
+static const float kaiser_width= 3;
+static const float kaiser_alpha= 4;
+
+// fonction de bessel modifiee, premiere espece, ordre 0
+static
+double bessel0( const double x )
+{
+    double sum= 1;
+    double term= 1;
+    for(int k= 1; k < 32; k++)
+    {
+        term= term * (x / (2*k)) * (x / (2*k));
+        sum= sum + term;
+    }
+    return sum;
+}
+
+static
+double sinc( const double x )
+{
+    if(std::abs(x) < 1e-6)
+        return 1;
+    return std::sin(M_PI * x) / (M_PI * x);
+}
+
+// poids des pixels 2x-5 .. 2x+6 pour le pixel x du niveau suivant, dont le centre est en 2x+1
+static
+void kaiser_weights( float weights[kaiser_taps] )
+{
+    double sum= 0;
+    double w[kaiser_taps];
+    for(int k= 0; k < kaiser_taps; k++)
+    {
+        double t= (k - kaiser_taps / 2 + 0.5) / 2;      // distance au centre, en pixels du niveau suivant
+        double u= t / kaiser_width;
+        w[k]= sinc(t) * bessel0(kaiser_alpha * std::sqrt(std::max(0.0, 1 - u*u))) / bessel0(kaiser_alpha);
+        sum= sum + w[k];
+    }
+
+    for(int k= 0; k < kaiser_taps; k++)
+        weights[k]= float(w[k] / sum);
+}
+
+// reduit les lignes : src sw x h, dst dw x h
+static
+void kaiser_rows( const float *src, const int sw, const int h, float *dst, const int dw, const float weights[kaiser_taps] )
+{
+#pragma omp parallel for schedule(static)
+    for(int y= 0; y < h; y++)
+    {
+        const float *row= src + std::size_t(y) * sw * 4;
+        float *out= dst + std::size_t(y) * dw * 4;
+        for(int x= 0; x < dw; x++)
+        {
+            int first= 2*x - kaiser_taps / 2 +1;
+        #ifdef USE_SSE
+            __m128 sum= _mm_setzero_ps();
+            for(int k= 0; k < kaiser_taps; k++)
+            {
+                int i= std::min(std::max(first + k, 0), sw -1);
+                sum= _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(row + 4*i)));
+            }
+            _mm_storeu_ps(out + 4*x, sum);
+        #else
+            float sum[4]= { 0, 0, 0, 0 };
+            for(int k= 0; k < kaiser_taps; k++)
+            {
+                int i= std::min(std::max(first + k, 0), sw -1);
+                for(int c= 0; c < 4; c++)
+                    sum[c]+= weights[k] * row[4*i + c];
+            }
+            for(int c= 0; c < 4; c++)
+                out[4*x + c]= sum[c];
+        #endif
+        }
+    }
+}
+
+// reduit les colonnes : src w x sh, dst w x dh. le filtre peut produire des valeurs negatives, elles sont annulees
+static
+void kaiser_columns( const float *src, const int w, const int sh, float *dst, const int dh, const float weights[kaiser_taps] )
+{
+#pragma omp parallel for schedule(static)
+    for(int y= 0; y < dh; y++)
+    {
+        const float *rows[kaiser_taps];
+        int first= 2*y - kaiser_taps / 2 +1;
+        for(int k= 0; k < kaiser_taps; k++)
+            rows[k]= src + std::size_t(std::min(std::max(first + k, 0), sh -1)) * w * 4;
+
+        float *out= dst + std::size_t(y) * w * 4;
+        for(int x= 0; x < w; x++)
+        {
+        #ifdef USE_SSE
+            __m128 sum= _mm_setzero_ps();
+            for(int k= 0; k < kaiser_taps; k++)
+                sum= _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + 4*x)));
+            _mm_storeu_ps(out + 4*x, _mm_max_ps(sum, _mm_setzero_ps()));
+        #else
+            float sum[4]= { 0, 0, 0, 0 };
+            for(int k= 0; k < kaiser_taps; k++)
+                for(int c= 0; c < 4; c++)
+                    sum[c]+= weights[k] * rows[k][4*x + c];
+            for(int c= 0; c < 4; c++)
+                out[4*x + c]= std::max(sum[c], 0.f);
+        #endif
+        }
+    }
+}
+
+static
+void kaiser_level( const float *src, const int sw, const int sh, float *dst, const int dw, const int dh, std::vector<float>& tmp )
+{
+    float weights[kaiser_taps];
+    kaiser_weights(weights);
+
+    // filtre separable, les lignes puis les colonnes. une dimension deja reduite a 1 pixel est simplement copiee
+    const float *rows= src;
+    if(dw < sw)
+    {
+        tmp.resize(std::size_t(dw) * sh * 4);
+        kaiser_rows(src, sw, sh, tmp.data(), dw, weights);
+        rows= tmp.data();
+    }
+
+    if(dh < sh)
+        kaiser_columns(rows, dw, sh, dst, dh, weights);
+    else
+        for(std::size_t i= 0; i < std::size_t(dw) * dh * 4; i++)
+            dst[i]= std::max(rows[i], 0.f);
+}
+
+// calcule le niveau suivant
+static
+void next_level( const std::vector<float>& src, const int sw, const int sh, std::vector<float>& dst, const int dw, const int dh, const MipmapFilter filter, std::vector<float>& tmp )
+{
+    dst.resize(std::size_t(dw) * dh * 4);
+    if(filter == MIPMAP_KAISER)
+        kaiser_level(src.data(), sw, sh, dst.data(), dw, dh, tmp);
+    else
+        box_level(src.data(), sw, sh, dst.data(), dw, dh);
+}
+
+
+static
+float srgb_linear( const float v )
+{
+    return (v <= 0.04045f) ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+static
+float linear_srgb( const float v )
+{
+    return (v <= 0.0031308f) ? v * 12.92f : 1.055f * std::pow(v, 1 / 2.4f) - 0.055f;
+}
+
+// conversions 8 bits / float, par tables
+static const int encode_size= 1 << 14;
+
+struct Conversion
+{
+    float decode[4][256];                       // 8 bits vers float, par canal
+    unsigned char encode[4][encode_size +1];    // float [0 1] vers 8 bits, par canal
+};
+
+static
+void conversion( Conversion& tables, const int channels, const bool srgb )
+{
+    // l'alpha n'est pas une couleur : 4ieme canal des images rgba, ou 2ieme canal des images "grise + alpha"
+    int alpha= (channels == 4) ? 3 : (channels == 2) ? 1 : -1;
+    for(int c= 0; c < 4; c++)
+    {
+        bool color= srgb && c != alpha;
+        for(int i= 0; i < 256; i++)
+            tables.decode[c][i]= color ? srgb_linear(i / 255.f) : i / 255.f;
+        for(int i= 0; i <= encode_size; i++)
+        {
+            float v= float(i) / encode_size;
+            tables.encode[c][i]= (unsigned char) (255 * (color ? linear_srgb(v) : v) + 0.5f);
+        }
+    }
+}
+
+static
+void decode_level( const ImageData& image, const Conversion& tables, std::vector<float>& dst )
+{
+    int channels= image.channels;
+    dst.assign(std::size_t(image.width) * image.height * 4, 0.f);
+
+#pragma omp parallel for schedule(static)
+    for(int y= 0; y < image.height; y++)
+    {
+        const unsigned char *row= image.data.data() + std::size_t(y) * image.width * channels;
+        float *out= dst.data() + std::size_t(y) * image.width * 4;
+        for(int x= 0; x < image.width; x++)
+            for(int c= 0; c < channels; c++)
+                out[4*x + c]= tables.decode[c][row[channels*x + c]];
+    }
+}
+
+static
+void encode_level( const std::vector<float>& src, const int width, const int height, const Conversion& tables, ImageData& image )
+{
+    int channels= image.channels;
+    image.width= width;
+    image.height= height;
+    image.data.resize(std::size_t(width) * height * channels);
+
+#pragma omp parallel for schedule(static)
+    for(int y= 0; y < height; y++)
+    {
+        const float *row= src.data() + std::size_t(y) * width * 4;
+        unsigned char *out= image.data.data() + std::size_t(y) * width * channels;
+        for(int x= 0; x < width; x++)
+            for(int c= 0; c < channels; c++)
+            {
+                float v= std::min(std::max(row[4*x + c], 0.f), 1.f);
+                out[channels*x + c]= tables.encode[c][int(v * encode_size + 0.5f)];
+            }
+    }
+}
+
+
+std::vector<ImageData> mipmap_levels( const ImageData& image, const MipmapFilter filter, const bool srgb )
+{
+    std::vector<ImageData> levels;
+    if(image.data.empty())
+        return levels;
+    if(image.size != 1 || image.channels < 1 || image.channels > 4)
+    {
+        printf("[error] mipmap_levels( ): 8 bits images, 1 to 4 channels...\n");
+        return levels;
+    }
+
+    Conversion *tables= new Conversion;
+    conversion(*tables, image.channels, srgb);
+
+    levels.push_back(image);
+
+    std::vector<float> src;
+    std::vector<float> dst;
+    std::vector<float> tmp;
+    decode_level(image, *tables, src);
+
+    int w= image.width;
+    int h= image.height;
+    while(w > 1 || h > 1)
+    {
+        // chaque niveau est calcule a partir du precedent, sans quantification
+        int dw= std::max(1, w / 2);
+        int dh= std::max(1, h / 2);
+        next_level(src, w, h, dst, dw, dh, filter, tmp);
+
+        levels.push_back( ImageData() );
+        levels.back().channels= image.channels;
+        levels.back().size= 1;
+        encode_level(dst, dw, dh, *tables, levels.back());
+
+        std::swap(src, dst);
+        w= dw;
+        h= dh;
+    }
+
+    delete tables;
+    return levels;
+}
+
+std::vector<Image> mipmap_levels( const Image& image, const MipmapFilter filter )
+{
+    std::vector<Image> levels;
+    if(image.size() == 0)
+        return levels;
+
+    // Color : 4 float par pixel, meme organisation que les niveaux
+    static_assert(sizeof(Color) == 4 * sizeof(float), "Color layout");
+
+    levels.push_back(image);
+
+    int w= image.width();
+    int h= image.height();
+    std::vector<float> src(std::size_t(w) * h * 4);
+    memcpy(src.data(), image.buffer(), src.size() * sizeof(float));
+
+    std::vector<float> dst;
+    std::vector<float> tmp;
+    while(w > 1 || h > 1)
+    {
+        int dw= std::max(1, w / 2);
+        int dh= std::max(1, h / 2);
+        next_level(src, w, h, dst, dw, dh, filter, tmp);
+
+        levels.push_back( Image(dw, dh) );
+        Image& level= levels.back();
+        for(int y= 0; y < dh; y++)
+        for(int x= 0; x < dw; x++)
+        {
+            const float *p= dst.data() + (std::size_t(y) * dw + x) * 4;
+            level(x, y)= Color(p[0], p[1], p[2], p[3]);
+        }
+
+        std::swap(src, dst);
+        w= dw;
+        h= dh;
+    }
+
+    return levels;
+}
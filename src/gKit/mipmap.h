@@ -0,0 +1,43 @@
+
+#ifndef _MIPMAP_H
+#define _MIPMAP_H
+
+#include <vector>
+
+#include "image.h"
+#include "image_io.h"
+
+
+//! \addtogroup image utilitaires pour manipuler des images
+///@{
+
+//! \file
+/*! construction des mipmaps d'une image sur le cpu, en une seule passe : chaque niveau est calcule a partir du precedent.
+    les pixels sont filtres en float, 4 canaux a la fois (sse, si disponible) et les lignes en parallele (openmp, si disponible).
+    les images 8 bits sont filtrees dans l'espace lineaire, si les couleurs sont codees en sRGB. l'alpha n'est jamais converti.
+
+    exemple :
+\code
+ImageData image= read_image_data("texture.png");
+std::vector<ImageData> levels= mipmap_levels(image, MIPMAP_KAISER);
+GLuint texture= make_texture(0, levels);        // cf texture.h, sans glGenerateMipmap( )
+\endcode
+ */
+
+//! filtres de reduction.
+enum MipmapFilter
+{
+    MIPMAP_BOX= 0,      //!< moyenne de 2x2 pixels, comme glGenerateMipmap( ).
+    MIPMAP_KAISER       //!< sinc fenetre par kaiser, 12 pixels par direction, plus net.
+};
+
+/*! renvoie tous les niveaux de mipmap d'une image 8 bits, de 1 a 4 canaux. levels[0] est l'image, le dernier niveau est 1x1.
+    \param srgb les couleurs sont converties dans l'espace lineaire avant d'etre filtrees.
+ */
+std::vector<ImageData> mipmap_levels( const ImageData& image, const MipmapFilter filter= MIPMAP_BOX, const bool srgb= true );
+
+//! renvoie tous les niveaux de mipmap d'une image float, les couleurs sont deja lineaires. levels[0] est l'image.
+std::vector<Image> mipmap_levels( const Image& image, const MipmapFilter filter= MIPMAP_BOX );
+
+///@}
+#endif
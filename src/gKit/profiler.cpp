@@ -0,0 +1,282 @@
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include "profiler.h"
+
+
+struct ProfileEvent
+{
+    const char *name;
+    int64_t begin;
+    int64_t end;
+};
+
+// mesures d'un thread, modifiees uniquement par le thread
+struct ThreadEvents
+{
+    std::vector<ProfileEvent> events;
+    std::string name;
+    int id;
+};
+
+// mesure gpu en attente du resultat des requetes
+struct GPUEvent
+{
+    const char *name;
+    GLuint begin;
+    GLuint end;
+    bool issued;
+};
+
+static std::atomic<bool> enabled(false);
+
+static std::mutex threads_mutex;
+static std::vector< std::unique_ptr<ThreadEvents> > threads;
+static thread_local ThreadEvents *thread_events= nullptr;
+
+// uniquement sur le thread du contexte openGL
+static std::vector<GPUEvent> gpu_pending;
+static std::vector<ProfileEvent> gpu_events;
+static std::vector<GLuint> gpu_queries;
+static int64_t gpu_offset= 0;
+static bool gpu_calibrated= false;
+
+static int64_t frame_begin= -1;
+
+
+int64_t profiler_time( )
+{
+    static const std::chrono::steady_clock::time_point start= std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static
+ThreadEvents *current_thread( )
+{
+    if(thread_events == nullptr)
+    {
+        // premiere mesure du thread, enregistre son buffer
+        std::lock_guard<std::mutex> lock(threads_mutex);
+
+        threads.push_back( std::unique_ptr<ThreadEvents>(new ThreadEvents) );
+        thread_events= threads.back().get();
+        thread_events->id= int(threads.size()) -1;
+        thread_events->name= "thread " + std::to_string(thread_events->id);
+        thread_events->events.reserve(4096);
+    }
+
+    return thread_events;
+}
+
+void profiler_event( const char *name, const int64_t begin, const int64_t end )
+{
+    current_thread()->events.push_back( { name, begin, end } );
+}
+
+void profiler_thread_name( const char *name )
+{
+    current_thread()->name= name;
+}
+
+
+void profiler_enable( const bool enable )
+{
+    enabled= enable;
+    gpu_calibrated= false;
+    frame_begin= -1;
+}
+
+bool profiler_enabled( )
+{
+    return enabled;
+}
+
+
+static
+GLuint gpu_query( )
+{
+    if(gpu_queries.empty())
+    {
+        GLuint queries[16];
+        glGenQueries(16, queries);
+        gpu_queries.insert(gpu_queries.end(), queries, queries + 16);
+    }
+
+    GLuint query= gpu_queries.back();
+    gpu_queries.pop_back();
+    return query;
+}
+
+GPUProfileScope::GPUProfileScope( const char *name ) : m_query(0)
+{
+    if(!enabled)
+        return;
+
+    if(!gpu_calibrated)
+    {
+        // decalage entre les horloges du cpu et du gpu
+        GLint64 now= 0;
+        glGetInteger64v(GL_TIMESTAMP, &now);
+        gpu_offset= int64_t(now) - profiler_time();
+        gpu_calibrated= true;
+    }
+
+    GPUEvent event= { name, gpu_query(), gpu_query(), false };
+    glQueryCounter(event.begin, GL_TIMESTAMP);
+    gpu_pending.push_back(event);
+    m_query= event.end;
+}
+
+GPUProfileScope::~GPUProfileScope( )
+{
+    if(m_query == 0)
+        return;
+
+    glQueryCounter(m_query, GL_TIMESTAMP);
+
+    // les blocs sont imbriques, la mesure est en general la derniere
+    for(int i= int(gpu_pending.size()) -1; i >= 0; i--)
+        if(gpu_pending[i].end == m_query)
+        {
+            gpu_pending[i].issued= true;
+            break;
+        }
+}
+
+// recupere les resultats des mesures gpu, dans l'ordre
+static
+void gpu_resolve( const bool wait )
+{
+    unsigned int n= 0;
+    for(; n < gpu_pending.size(); n++)
+    {
+        GPUEvent& event= gpu_pending[n];
+        if(!event.issued)
+            break;
+
+        if(!wait)
+        {
+            GLint available= 0;
+            glGetQueryObjectiv(event.end, GL_QUERY_RESULT_AVAILABLE, &available);
+            if(!available)
+                break;
+        }
+
+        GLint64 begin= 0;
+        GLint64 end= 0;
+        glGetQueryObjecti64v(event.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjecti64v(event.end, GL_QUERY_RESULT, &end);
+        gpu_events.push_back( { event.name, int64_t(begin) - gpu_offset, int64_t(end) - gpu_offset } );
+
+        gpu_queries.push_back(event.begin);
+        gpu_queries.push_back(event.end);
+    }
+
+    gpu_pending.erase(gpu_pending.begin(), gpu_pending.begin() + n);
+}
+
+
+void profiler_frame( )
+{
+    if(!gpu_pending.empty())
+        gpu_resolve(false);
+
+    if(!enabled)
+    {
+        frame_begin= -1;
+        return;
+    }
+
+    int64_t now= profiler_time();
+    if(frame_begin >= 0)
+        profiler_event("frame", frame_begin, now);
+    frame_begin= now;
+}
+
+void profiler_clear( )
+{
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    for(unsigned int i= 0; i < threads.size(); i++)
+        threads[i]->events.clear();
+
+    gpu_events.clear();
+}
+
+
+// chaine de caracteres json
+static
+std::string json_string( const char *str )
+{
+    std::string tmp;
+    for(int i= 0; str[i] != 0; i++)
+    {
+        if(str[i] == '"' || str[i] == '\\')
+            tmp.push_back('\\');
+        if((unsigned char) str[i] < 32)
+            tmp.push_back(' ');
+        else
+            tmp.push_back(str[i]);
+    }
+
+    return tmp;
+}
+
+static
+void write_events( FILE *out, const std::vector<ProfileEvent>& events, const int tid, bool& first )
+{
+    for(unsigned int i= 0; i < events.size(); i++)
+    {
+        // temps en microsecondes
+        fprintf(out, "%s\n{ \"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f }", first ? "" : ",",
+            json_string(events[i].name).c_str(), tid, double(events[i].begin) / 1000, double(events[i].end - events[i].begin) / 1000);
+        first= false;
+    }
+}
+
+int profiler_write( const char *filename )
+{
+    if(!gpu_pending.empty())
+        gpu_resolve(true);
+
+    FILE *out= fopen(filename, "wt");
+    if(out == nullptr)
+    {
+        printf("[error] writing trace '%s'...\n", filename);
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(threads_mutex);
+
+    const int gpu_tid= 1000;
+    size_t count= gpu_events.size();
+    bool first= true;
+    fprintf(out, "{ \"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for(unsigned int i= 0; i < threads.size(); i++)
+    {
+        fprintf(out, "%s\n{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %d, \"args\": { \"name\": \"%s\" } }", first ? "" : ",",
+            threads[i]->id, json_string(threads[i]->name.c_str()).c_str());
+        first= false;
+
+        write_events(out, threads[i]->events, threads[i]->id, first);
+        count+= threads[i]->events.size();
+    }
+
+    if(!gpu_events.empty())
+    {
+        fprintf(out, "%s\n{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %d, \"args\": { \"name\": \"gpu\" } }", first ? "" : ",", gpu_tid);
+        first= false;
+
+        write_events(out, gpu_events, gpu_tid, first);
+    }
+    fprintf(out, "\n] }\n");
+    fclose(out);
+
+    printf("writing trace '%s': %d events...\n", filename, int(count));
+    return 0;
+}
@@ -0,0 +1,94 @@
+
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include <cstdint>
+
+#include "glcore.h"
+
+
+//! \addtogroup application utilitaires pour creer une application
+///@{
+
+//! \file
+/*! mesure du temps d'execution de parties d'une application, sur le cpu et le gpu, et export au format chrome trace_event, a visualiser avec chrome://tracing ou https://ui.perfetto.dev.
+
+    les mesures cpu sont delimitees par un bloc, cf PROFILE_SCOPE( ), et peuvent etre utilisees par plusieurs threads :
+    chaque thread enregistre ses mesures dans son propre buffer, sans synchronisation.
+    les mesures gpu utilisent des requetes GL_TIMESTAMP, cf PROFILE_GPU_SCOPE( ), et ne peuvent etre utilisees que par le thread qui utilise le contexte openGL.
+    leurs resultats sont recuperes, sans attendre le gpu, par profiler_frame( ) qui marque aussi la fin de chaque image, cf App::run( ) et AppTime::run( ).
+
+    exemple :
+\code
+profiler_enable(true);
+
+{
+    PROFILE_SCOPE("shadow pass");
+    PROFILE_GPU_SCOPE("shadow pass");
+    glDraw(...);
+}
+
+// a la fin de l'execution
+profiler_write("trace.json");
+\endcode
+
+    les noms des mesures ne sont pas copies : utiliser des chaines de caracteres constantes.
+ */
+
+//! active ou desactive les mesures. les blocs de mesures ne coutent presque rien lorsque les mesures sont desactivees.
+void profiler_enable( const bool enable );
+//! renvoie vrai si les mesures sont actives.
+bool profiler_enabled( );
+
+//! marque la fin d'une image, et recupere les resultats disponibles des mesures gpu. a utiliser par le thread qui utilise le contexte openGL.
+void profiler_frame( );
+//! supprime toutes les mesures.
+void profiler_clear( );
+
+/*! exporte les mesures au format chrome trace_event json. renvoie -1 en cas d'erreur.
+    attend les resultats des mesures gpu. les autres threads ne doivent pas enregistrer de mesures pendant l'export.
+ */
+int profiler_write( const char *filename );
+
+//! nomme le thread courant dans l'export, "thread n" par defaut.
+void profiler_thread_name( const char *name );
+
+
+//! renvoie le temps ecoule depuis le demarrage, en nanosecondes.
+int64_t profiler_time( );
+//! enregistre une mesure cpu du thread courant.
+void profiler_event( const char *name, const int64_t begin, const int64_t end );
+
+//! mesure cpu, du constructeur au destructeur, cf PROFILE_SCOPE( ).
+class ProfileScope
+{
+public:
+    ProfileScope( const char *name ) : m_name(name), m_begin(profiler_enabled() ? profiler_time() : -1) {}
+    ~ProfileScope( ) { if(m_begin >= 0) profiler_event(m_name, m_begin, profiler_time()); }
+
+protected:
+    const char *m_name;
+    int64_t m_begin;
+};
+
+//! mesure gpu, des commandes openGL emises entre le constructeur et le destructeur, cf PROFILE_GPU_SCOPE( ).
+class GPUProfileScope
+{
+public:
+    GPUProfileScope( const char *name );
+    ~GPUProfileScope( );
+
+protected:
+    GLuint m_query;
+};
+
+#define PROFILE_CONCAT2( a, b ) a##b
+#define PROFILE_CONCAT( a, b ) PROFILE_CONCAT2(a, b)
+
+//! mesure le temps cpu jusqu'a la fin du bloc.
+#define PROFILE_SCOPE( name ) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+//! mesure le temps gpu des commandes openGL jusqu'a la fin du bloc.
+#define PROFILE_GPU_SCOPE( name ) GPUProfileScope PROFILE_CONCAT(profile_gpu_scope_, __LINE__)(name)
+
+///@}
+#endif
@@ -3,11 +3,22 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <algorithm>
 
 #include <climits>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#ifdef _WIN32
+    #include <direct.h>
+#else
+    #include <sys/stat.h>
+#endif
 
 #include "program.h"
+#include "uniforms.h"
 
 
 // charge un fichier texte.
@@ -136,22 +147,17 @@ GLuint compile_shader( const GLuint program, const GLenum shader_type, const std
     GLuint shader= glCreateShader(shader_type);
     glAttachShader(program, shader);
 
+    // ne verifie pas le resultat de la compilation, les shaders sont compiles en parallele, si possible
     const char *sources= source.c_str();
     glShaderSource(shader, 1, &sources, NULL);
     glCompileShader(shader);
-
-    GLint status;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-    return (status == GL_TRUE) ? shader : 0;
+    return shader;
 }
 
-
-int reload_program( GLuint program, const char *filename, const char *definitions )
+// detache et detruit les shaders du program
+static
+void release_shaders( const GLuint program )
 {
-    if(program == 0)
-        return -1;
-
-    // supprime les shaders attaches au program
     int shaders_max= 0;
     glGetProgramiv(program, GL_ATTACHED_SHADERS, &shaders_max);
     if(shaders_max > 0)
@@ -164,6 +170,204 @@ int reload_program( GLuint program, const char *filename, const char *definition
             glDeleteShader(shaders[i]);
         }
     }
+}
+
+
+// cache des programs compiles, cf program_cache()
+static std::string cache_directory= "cache";
+
+void program_cache( const char *directory )
+{
+    cache_directory= directory ? directory : "";
+}
+
+static
+bool program_binary_supported( )
+{
+    static int supported= -1;
+    if(supported < 0)
+    {
+        GLint formats= 0;
+    #ifndef NO_GLEW
+        if(GLEW_ARB_get_program_binary)
+    #endif
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        
+        supported= (formats > 0) ? 1 : 0;
+    }
+    
+    return supported == 1;
+}
+
+// fnv-1a 64 bits
+static
+uint64_t hash( uint64_t h, const char *data, const size_t size )
+{
+    for(size_t i= 0; i < size; i++)
+    {
+        h= h ^ (unsigned char) data[i];
+        h= h * 1099511628211u;
+    }
+    
+    return h;
+}
+
+// identifie les sources des shaders et le driver qui les compile
+static
+uint64_t program_key( const std::string *sources, const int count )
+{
+    uint64_t key= 14695981039346656037u;
+    for(int i= 0; i < count; i++)
+    {
+        key= hash(key, sources[i].data(), sources[i].size());
+        key= hash(key, "", 1);
+    }
+    
+    const GLenum strings[]= { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    for(int i= 0; i < 3; i++)
+    {
+        const char *string= (const char *) glGetString(strings[i]);
+        if(string)
+            key= hash(key, string, strlen(string) +1);
+    }
+    
+    return key;
+}
+
+static
+std::string cache_filename( const uint64_t key )
+{
+    char tmp[64];
+    sprintf(tmp, "/program_%016llx.bin", (unsigned long long) key);
+    return std::string(cache_directory).append(tmp);
+}
+
+struct BinaryHeader
+{
+    char magic[4];
+    uint32_t format;
+    uint64_t key;
+    uint32_t size;
+};
+
+// charge le program compile, renvoie faux s'il n'existe pas ou si le driver ne peut pas l'utiliser
+static
+bool read_program_binary( const GLuint program, const uint64_t key )
+{
+    if(cache_directory.empty() || !program_binary_supported())
+        return false;
+    
+    FILE *in= fopen(cache_filename(key).c_str(), "rb");
+    if(in == NULL)
+        return false;
+    
+    BinaryHeader header;
+    std::vector<char> binary;
+    if(fread(&header, sizeof(header), 1, in) == 1 && memcmp(header.magic, "gkpb", 4) == 0 && header.key == key)
+    {
+        binary.resize(header.size);
+        if(fread(binary.data(), 1, header.size, in) != header.size)
+            binary.clear();
+    }
+    fclose(in);
+    
+    if(binary.empty())
+        return false;
+    
+    glProgramBinary(program, header.format, binary.data(), GLsizei(binary.size()));
+    
+    // le format n'est plus reconnu apres une mise a jour du driver, par exemple
+    GLint status= GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+}
+
+static
+void write_program_binary( const GLuint program, const uint64_t key )
+{
+    if(cache_directory.empty() || !program_binary_supported())
+        return;
+    
+    GLint size= 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if(size <= 0)
+        return;
+    
+    BinaryHeader header= { { 'g', 'k', 'p', 'b' }, 0, key, 0 };
+    std::vector<char> binary(size);
+    GLenum format= 0;
+    glGetProgramBinary(program, size, &size, &format, binary.data());
+    header.format= format;
+    header.size= size;
+    
+#ifdef _WIN32
+    _mkdir(cache_directory.c_str());
+#else
+    mkdir(cache_directory.c_str(), 0755);
+#endif
+    
+    FILE *out= fopen(cache_filename(key).c_str(), "wb");
+    if(out == NULL)
+    {
+        printf("[error] writing program cache '%s'...\n", cache_filename(key).c_str());
+        return;
+    }
+    
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(binary.data(), 1, size, out);
+    fclose(out);
+}
+
+
+// compilation en parallele, si le driver le permet
+static
+bool parallel_compile_supported( )
+{
+    static int supported= -1;
+    if(supported < 0)
+    {
+        supported= 0;
+    #if !defined(NO_GLEW) && defined(GL_KHR_parallel_shader_compile)
+        if(GLEW_KHR_parallel_shader_compile)
+        {
+            // utilise autant de threads que possible
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+            supported= 1;
+        }
+    #endif
+    #if !defined(NO_GLEW) && defined(GL_ARB_parallel_shader_compile)
+        if(!supported && GLEW_ARB_parallel_shader_compile)
+        {
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+            supported= 1;
+        }
+    #endif
+    }
+    
+    return supported == 1;
+}
+
+// renvoie vrai si la compilation et l'edition de liens sont terminees. sans compilation parallele, la verification du resultat attend la fin de la compilation.
+static
+bool program_completed( const GLuint program )
+{
+    if(!parallel_compile_supported())
+        return true;
+    
+    GLint status= GL_TRUE;
+#ifdef GL_COMPLETION_STATUS_KHR
+    glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &status);
+#endif
+    return status == GL_TRUE;
+}
+
+// charge les sources, compile les shaders et linke le program, sans attendre le resultat.
+// renvoie vrai si le program est charge depuis le cache, cf program_cache().
+static
+bool compile_program( const GLuint program, const char *filename, const char *definitions, uint64_t& key )
+{
+    // supprime les shaders attaches au program
+    release_shaders(program);
 
 #ifdef GL_VERSION_4_3
     glObjectLabel(GL_PROGRAM, program, -1, filename);
@@ -171,30 +375,103 @@ int reload_program( GLuint program, const char *filename, const char *definition
 
     // prepare les sources
     std::string common_source= read(filename);
+    std::string sources[shader_keys_max];
     for(int i = 0; i < shader_keys_max; i++)
     {
         if(common_source.find(shader_keys[i]) != std::string::npos)
-        {
-            // cree et compile les shaders detectes dans le source
-            std::string source= prepare_source(common_source, std::string(definitions).append("#define ").append(shader_keys[i]).append("\n"));
-            GLuint shader= compile_shader(program, shader_types[i], source);
-            if(shader == 0)
-                printf("[error] compiling %s...\n%s\n", shader_string(shader_types[i]), definitions);
-        }
+            sources[i]= prepare_source(common_source, std::string(definitions).append("#define ").append(shader_keys[i]).append("\n"));
     }
     
+    // utilise le program deja compile, s'il existe
+    key= program_key(sources, shader_keys_max);
+    if(!common_source.empty() && read_program_binary(program, key))
+        return true;
+    
+    // cree et compile les shaders detectes dans le source
+    parallel_compile_supported();
+    for(int i = 0; i < shader_keys_max; i++)
+        compile_shader(program, shader_types[i], sources[i]);
+    
     // linke les shaders
+    if(program_binary_supported())
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(program);
+    return false;
+}
 
-    // verifie les erreurs
+// verifie le resultat de compile_program( ), attend la fin de la compilation, si necessaire.
+static
+int link_status( const GLuint program, const char *filename, const char *definitions )
+{
     GLint status;
     glGetProgramiv(program, GL_LINK_STATUS, &status);
-    if(status == GL_FALSE)
+    if(status == GL_TRUE)
+        return 0;
+    
+    // affiche les shaders qui ne compilent pas
+    int shaders_max= 0;
+    glGetProgramiv(program, GL_ATTACHED_SHADERS, &shaders_max);
+    std::vector<GLuint> shaders(shaders_max +1, 0);
+    glGetAttachedShaders(program, shaders_max, NULL, &shaders.front());
+    for(int i= 0; i < shaders_max; i++)
     {
-        printf("[error] linking program %u '%s'...\n", program, filename);
+        GLint value;
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &value);
+        if(value == GL_FALSE)
+        {
+            glGetShaderiv(shaders[i], GL_SHADER_TYPE, &value);
+            printf("[error] compiling %s...\n%s\n", shader_string(value), definitions);
+        }
+    }
+    
+    printf("[error] linking program %u '%s'...\n", program, filename);
+    return -1;
+}
+
+
+// programs en cours de compilation, cf read_program_async() et reload_program_async()
+struct AsyncProgram
+{
+    GLuint pending;             // nouvelle version du program, 0 pour read_program_async()
+    uint64_t key;
+    std::string filename;
+    std::string definitions;
+    std::string errors;         // erreurs de la derniere compilation, si le program precedent est conserve
+    int first_error;
+    bool compiling;
+};
+
+static std::unordered_map<GLuint, AsyncProgram> async_programs;
+
+
+int reload_program( GLuint program, const char *filename, const char *definitions )
+{
+    if(program == 0)
         return -1;
+
+    // les identifiants des uniforms changent apres l'edition de liens
+    clear_uniform_locations(program);
+    
+    // abandonne la compilation en cours, cf reload_program_async()
+    auto found= async_programs.find(program);
+    if(found != async_programs.end())
+    {
+        if(found->second.pending)
+            release_program(found->second.pending);
+        async_programs.erase(found);
     }
 
+    uint64_t key= 0;
+    if(!compile_program(program, filename, definitions, key))
+    {
+        // verifie les erreurs
+        if(link_status(program, filename, definitions) < 0)
+            return -1;
+        
+        // conserve le program compile pour les prochaines executions
+        write_program_binary(program, key);
+    }
+    
     // pour etre coherent avec les autres fonctions de creation, active l'objet gl qui vient d'etre cree.
     glUseProgram(program);
     return 0;
@@ -207,27 +484,162 @@ GLuint read_program( const char *filename, const char *definitions )
     return program;
 }
 
-int release_program( const GLuint program )
+
+GLuint read_program_async( const char *filename, const char *definitions )
+{
+    GLuint program= glCreateProgram();
+    
+    AsyncProgram& async= async_programs[program];
+    async= { 0, 0, filename, definitions, "", 0, true };
+    if(compile_program(program, filename, definitions, async.key))
+        // deja compile, pas la peine de le conserver de nouveau dans le cache
+        async.key= 0;
+    
+    return program;
+}
+
+int reload_program_async( const GLuint program, const char *filename, const char *definitions )
 {
     if(program == 0)
         return -1;
+    
+    AsyncProgram& async= async_programs[program];
+    if(async.compiling && async.pending == 0)
+        // premiere compilation en cours, le program n'est pas encore utilisable, pas la peine de le conserver
+        program_wait(program);
+    
+    // compile une nouvelle version, le program actuel reste utilisable
+    if(async.pending)
+        release_program(async.pending);
+    async.pending= glCreateProgram();
+    
+    async.filename= filename;
+    async.definitions= definitions;
+    async.compiling= true;
+    if(compile_program(async.pending, filename, definitions, async.key))
+        async.key= 0;
+    
+    return 0;
+}
 
-    // recupere les shaders
-    int shaders_max= 0;
-    glGetProgramiv(program, GL_ATTACHED_SHADERS, &shaders_max);
-
-    if(shaders_max > 0)
+// installe la nouvelle version du program, ou conserve les erreurs
+static
+int finish_program( const GLuint program, AsyncProgram& async )
+{
+    async.compiling= false;
+    
+    GLuint target= async.pending ? async.pending : program;
+    if(link_status(target, async.filename.c_str(), async.definitions.c_str()) < 0)
     {
-        std::vector<GLuint> shaders(shaders_max, 0);
-        glGetAttachedShaders(program, shaders_max, NULL, &shaders.front());
-        for(int i= 0; i < shaders_max; i++)
+        // conserve les erreurs, et le program precedent, s'il existe
+        std::string errors;
+        async.first_error= program_format_errors(target, errors);
+        async.errors= errors;
+        
+        if(async.pending)
+            release_program(async.pending);
+        async.pending= 0;
+        return -1;
+    }
+    
+    if(async.key)
+        write_program_binary(target, async.key);
+    async.errors.clear();
+    
+    if(async.pending)
+    {
+        // remplace le program, l'identifiant ne change pas
+        clear_uniform_locations(program);
+        release_shaders(program);
+        
+        GLint size= 0;
+        if(program_binary_supported())
+            glGetProgramiv(async.pending, GL_PROGRAM_BINARY_LENGTH, &size);
+        
+        if(size > 0)
         {
-            glDetachShader(program, shaders[i]);
-            glDeleteShader(shaders[i]);
+            // copie le code compile
+            std::vector<char> binary(size);
+            GLenum format= 0;
+            glGetProgramBinary(async.pending, size, &size, &format, binary.data());
+            glProgramBinary(program, format, binary.data(), size);
         }
+        else
+        {
+            // ou re-linke les shaders deja compiles
+            int shaders_max= 0;
+            glGetProgramiv(async.pending, GL_ATTACHED_SHADERS, &shaders_max);
+            std::vector<GLuint> shaders(shaders_max +1, 0);
+            glGetAttachedShaders(async.pending, shaders_max, NULL, &shaders.front());
+            for(int i= 0; i < shaders_max; i++)
+            {
+                glDetachShader(async.pending, shaders[i]);
+                glAttachShader(program, shaders[i]);
+            }
+            glLinkProgram(program);
+        }
+        
+        glDeleteProgram(async.pending);
+        async.pending= 0;
+        
+    #ifdef GL_VERSION_4_3
+        glObjectLabel(GL_PROGRAM, program, -1, async.filename.c_str());
+    #endif
+        return link_status(program, async.filename.c_str(), async.definitions.c_str());
     }
+    
+    return 0;
+}
+
+int program_ready( const GLuint program )
+{
+    auto found= async_programs.find(program);
+    if(found == async_programs.end())
+        return 1;
+    
+    AsyncProgram& async= found->second;
+    if(async.compiling)
+    {
+        if(!program_completed(async.pending ? async.pending : program))
+            return 0;
+        
+        finish_program(program, async);
+    }
+    
+    return async.errors.empty() ? 1 : -1;
+}
+
+int program_wait( const GLuint program )
+{
+    auto found= async_programs.find(program);
+    if(found == async_programs.end())
+        return 0;
+    
+    AsyncProgram& async= found->second;
+    if(async.compiling)
+        finish_program(program, async);
+    
+    return async.errors.empty() ? 0 : -1;
+}
+
+int release_program( const GLuint program )
+{
+    if(program == 0)
+        return -1;
+
+    auto found= async_programs.find(program);
+    if(found != async_programs.end())
+    {
+        if(found->second.pending)
+            release_program(found->second.pending);
+        async_programs.erase(found);
+    }
+
+    // detruit les shaders
+    release_shaders(program);
 
     glDeleteProgram(program);
+    clear_uniform_locations(program);
     return 0;
 }
 
@@ -318,6 +730,14 @@ int print_errors( std::string& errors, const char *log, const char *source )
 int program_format_errors( const GLuint program, std::string& errors )
 {
     errors.clear();
+    
+    // erreurs de la derniere compilation, cf reload_program_async()
+    auto found= async_programs.find(program);
+    if(found != async_programs.end() && !found->second.errors.empty())
+    {
+        errors= found->second.errors;
+        return found->second.first_error;
+    }
 
     if(program == 0)
     {
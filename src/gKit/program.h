@@ -23,12 +23,35 @@ GLuint read_program( const char *filename, const char *definitions= "" );
 //! detruit les shaders et le program.
 int release_program( const GLuint program );
 
+/*! cree un shader program, comme read_program( ), mais n'attend pas la fin de la compilation.
+    les shaders sont compiles en parallele si le driver le permet (GL_KHR_parallel_shader_compile), sinon la compilation se termine lors de la verification du resultat.
+    le program n'est utilisable que lorsque program_ready( ) renvoie 1, ou apres program_wait( ).
+ */
+GLuint read_program_async( const char *filename, const char *definitions= "" );
+
+/*! recompile un shader program, comme reload_program( ), mais n'attend pas la fin de la compilation.
+    le program reste utilisable, avec les shaders precedents, jusqu'a ce que la nouvelle version soit prete, cf program_ready( ).
+    en cas d'erreur, les shaders precedents sont conserves, et les erreurs sont renvoyees par program_format_errors( ).
+ */
+int reload_program_async( const GLuint program, const char *filename, const char *definitions= "" );
+
+//! renvoie 1 si le program est pret, 0 si la compilation n'est pas terminee, -1 en cas d'erreur. n'attend pas la fin de la compilation.
+int program_ready( const GLuint program );
+//! attend la fin de la compilation. renvoie -1 en cas d'erreur.
+int program_wait( const GLuint program );
+
 //! recharge les sources et recompile un shader program.
 //! \param program shader program a modifier
 //! \param filename nom du fichier source a charger
 //! \param definitions cf read_program
 int reload_program( const GLuint program, const char *filename, const char *definitions= "" );
 
+/*! active le cache des programs compiles, dans le repertoire directory, "cache" par defaut. nullptr desactive le cache.
+    les programs sont identifies par leurs sources, definitions comprises, et par le driver openGL.
+    les programs du cache sont recompiles si le driver ne les reconnait plus.
+ */
+void program_cache( const char *directory );
+
 //! renvoie les erreurs de compilation.
 int program_format_errors( const GLuint program, std::string& errors );
 
@@ -0,0 +1,75 @@
+
+#include <cstdio>
+#include <cassert>
+
+#include "shading_table.h"
+
+
+int ShadingTable::build( const Mesh& mesh, const std::vector<int>& order )
+{
+    int n= mesh.triangle_count();
+    assert(order.empty() || int(order.size()) == n);
+
+    const std::vector<vec3>& positions= mesh.positions();
+    const std::vector<vec3>& normals= mesh.normals();
+    const std::vector<vec2>& texcoords= mesh.texcoords();
+    const std::vector<unsigned int>& indices= mesh.indices();
+    const std::vector<unsigned int>& materials= mesh.materials();
+
+    bool use_normals= (normals.size() == positions.size());
+    bool use_texcoords= (texcoords.size() == positions.size());
+    bool use_materials= (int(materials.size()) >= n && mesh.mesh_material_count() > 0);
+
+    m_na.clear(); m_nb.clear(); m_nc.clear();
+    m_ta.clear(); m_tb.clear(); m_tc.clear();
+    if(use_normals)
+    {
+        m_na.resize(n); m_nb.resize(n); m_nc.resize(n);
+    }
+    if(use_texcoords)
+    {
+        m_ta.resize(n); m_tb.resize(n); m_tc.resize(n);
+    }
+    m_ng.resize(n);
+    m_materials.resize(n);
+    m_ids.resize(n);
+
+    for(int i= 0; i < n; i++)
+    {
+        int id= order.empty() ? i : order[i];
+        m_ids[i]= id;
+
+        unsigned int a= 3*id;
+        unsigned int b= 3*id +1;
+        unsigned int c= 3*id +2;
+        if(!indices.empty())
+        {
+            a= indices[a];
+            b= indices[b];
+            c= indices[c];
+        }
+
+        Vector ab= Point(positions[b]) - Point(positions[a]);
+        Vector ac= Point(positions[c]) - Point(positions[a]);
+        m_ng[i]= vec3(normalize(cross(ab, ac)));
+
+        if(use_normals)
+        {
+            m_na[i]= normals[a];
+            m_nb[i]= normals[b];
+            m_nc[i]= normals[c];
+        }
+
+        if(use_texcoords)
+        {
+            m_ta[i]= texcoords[a];
+            m_tb[i]= texcoords[b];
+            m_tc[i]= texcoords[c];
+        }
+
+        m_materials[i]= use_materials ? int(materials[id]) : -1;
+    }
+
+    m_mesh_materials= mesh.mesh_materials();
+    return n;
+}
@@ -0,0 +1,98 @@
+
+#ifndef _SHADING_TABLE_H
+#define _SHADING_TABLE_H
+
+#include <vector>
+
+#include "vec.h"
+#include "mesh.h"
+#include "aligned.h"
+
+
+//! \addtogroup objet3D
+///@{
+
+//! \file
+/*! table des informations necessaires pour calculer la matiere d'un point d'intersection : normales et texcoords des sommets, normale geometrique et matiere de chaque triangle.
+    construite une seule fois, au lieu d'appeller Mesh::triangle( ) et Mesh::triangle_material( ) pour chaque intersection.
+
+    chaque information est stockee dans un tableau separe (SoA) aligne sur une ligne de cache, dans l'ordre des feuilles d'un bvh, par exemple.
+    les rayons voisins touchent des triangles voisins dans la meme feuille et lisent des donnees consecutives.
+
+    exemple :
+\code
+BVH bvh;
+bvh.build(mesh);
+
+ShadingTable shading;
+shading.build(mesh, bvh.primitives());
+
+bvh.intersect(o, d, tmax, [&]( const int index, float& tmax ) { ... });   // index dans l'ordre des feuilles
+Vector n= shading.normal(index, u, v);
+const Material& material= shading.material(index);
+\endcode
+ */
+class ShadingTable
+{
+public:
+    ShadingTable( ) : m_na(), m_nb(), m_nc(), m_ta(), m_tb(), m_tc(), m_ng(), m_materials(), m_ids(), m_mesh_materials(), m_default_material() {}
+
+    /*! construit la table des triangles du mesh dans l'ordre order, cf BVH::primitives( ), ou dans l'ordre du mesh si order est vide.
+        renvoie le nombre de triangles.
+     */
+    int build( const Mesh& mesh, const std::vector<int>& order= std::vector<int>() );
+
+    //! renvoie le nombre de triangles.
+    int size( ) const { return int(m_ids.size()); }
+    //! renvoie l'indice dans le mesh du triangle index.
+    int triangle_id( const int index ) const { return m_ids[index]; }
+
+    //! renvoie la normale geometrique, normalisee, du triangle index.
+    Vector geometric_normal( const int index ) const { return Vector(m_ng[index]); }
+
+    //! renvoie la normale interpolee, normalisee, du triangle index au point de coordonnees barycentriques (u, v). convention p(u, v)= (1 - u - v) * a + u * b + v * c.
+    Vector normal( const int index, const float u, const float v ) const
+    {
+        if(m_na.empty())
+            return Vector(m_ng[index]);
+
+        float w= 1 - u - v;
+        return normalize(w * Vector(m_na[index]) + u * Vector(m_nb[index]) + v * Vector(m_nc[index]));
+    }
+
+    //! renvoie les coordonnees de texture interpolees du triangle index. (0, 0) si le mesh n'a pas de texcoords.
+    vec2 texcoord( const int index, const float u, const float v ) const
+    {
+        if(m_ta.empty())
+            return vec2(0, 0);
+
+        float w= 1 - u - v;
+        return vec2(w * m_ta[index].x + u * m_tb[index].x + v * m_tc[index].x, w * m_ta[index].y + u * m_tb[index].y + v * m_tc[index].y);
+    }
+
+    //! renvoie l'indice de la matiere du triangle index, -1 si le mesh ne definit pas de matieres.
+    int material_id( const int index ) const { return m_materials[index]; }
+    //! renvoie la matiere du triangle index, ou une matiere par defaut.
+    const Material& material( const int index ) const
+    {
+        int id= m_materials[index];
+        return (id < 0) ? m_default_material : m_mesh_materials[id];
+    }
+
+protected:
+    aligned_vector<vec3> m_na;
+    aligned_vector<vec3> m_nb;
+    aligned_vector<vec3> m_nc;
+    aligned_vector<vec2> m_ta;
+    aligned_vector<vec2> m_tb;
+    aligned_vector<vec2> m_tc;
+    aligned_vector<vec3> m_ng;
+    aligned_vector<int> m_materials;
+    aligned_vector<int> m_ids;
+
+    std::vector<Material> m_mesh_materials;
+    Material m_default_material;
+};
+
+///@}
+#endif
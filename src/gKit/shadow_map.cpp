@@ -0,0 +1,287 @@
+
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+#include "shadow_map.h"
+#include "uniforms.h"
+
+
+static
+GLuint create_depth_array( const int size, const int layers )
+{
+    GLuint texture= 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, size, size, layers);
+
+    // filtrage lineaire + comparaison : pcf 2x2 par le materiel, cf sampler2DArrayShadow
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    // pas d'ombre en dehors de la shadow map
+    float border[4]= { 1, 1, 1, 1 };
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return texture;
+}
+
+int CascadedShadowMap::create( const int size, const int cascades )
+{
+    assert(cascades > 0);
+    release();
+
+    if(cascades > MAX_CASCADES)
+    {
+        printf("[error] CascadedShadowMap: %d cascades, max %d...\n", cascades, int(MAX_CASCADES));
+        return -1;
+    }
+
+    m_size= size;
+    m_cascades= cascades;
+    m_static_valid= false;
+    for(int i= 0; i < MAX_CASCADES; i++)
+    {
+        m_transforms[i]= Identity();
+        m_splits[i]= FLT_MAX;
+        m_texels[i]= 0;
+    }
+
+    m_texture= create_depth_array(size, cascades);
+    m_static_texture= create_depth_array(size, cascades);
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture, 0, 0);
+    glDrawBuffer(GL_NONE);      // pas de couleur, uniquement la profondeur
+
+    GLenum status= glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    if(status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        printf("[error] CascadedShadowMap: framebuffer...\n");
+        release();
+        return -1;
+    }
+
+    return 0;
+}
+
+void CascadedShadowMap::release( )
+{
+    if(m_texture)
+        glDeleteTextures(1, &m_texture);
+    if(m_static_texture)
+        glDeleteTextures(1, &m_static_texture);
+    if(m_framebuffer)
+        glDeleteFramebuffers(1, &m_framebuffer);
+
+    m_texture= 0;
+    m_static_texture= 0;
+    m_framebuffer= 0;
+    m_cascades= 0;
+    m_static_valid= false;
+}
+
+size_t CascadedShadowMap::memory( ) const
+{
+    // 2 textures, shadow maps + shadow maps statiques, profondeur 24 bits stockee sur 32 bits
+    return 2 * size_t(m_size) * size_t(m_size) * size_t(m_cascades) * 4;
+}
+
+
+bool CascadedShadowMap::fit( const Transform& view, const Transform& projection, const Vector& direction, const Point& pmin, const Point& pmax, const float lambda )
+{
+    if(m_cascades == 0)
+        return false;
+
+    // near et far de la projection perspective, cf Perspective( )
+    float znear= projection.m[2][3] / (projection.m[2][2] - 1);
+    float zfar= projection.m[2][3] / (projection.m[2][2] + 1);
+
+    // sommets de l'englobant des objets
+    Point corners[8];
+    for(int i= 0; i < 8; i++)
+        corners[i]= Point((i & 1) ? pmax.x : pmin.x, (i & 2) ? pmax.y : pmin.y, (i & 4) ? pmax.z : pmin.z);
+
+    // ne decoupe que la partie de la region visible qui contient des objets
+    float dmin= FLT_MAX;
+    float dmax= -FLT_MAX;
+    for(int i= 0; i < 8; i++)
+    {
+        float d= -view(corners[i]).z;
+        dmin= std::min(dmin, d);
+        dmax= std::max(dmax, d);
+    }
+
+    float n= std::max(znear, dmin);
+    float f= std::min(zfar, dmax);
+    if(f <= n)
+    {
+        n= znear;
+        f= zfar;
+    }
+
+    // aretes de la region visible, dans le repere monde
+    Transform inv= Inverse(projection * view);
+    Point near_corners[4];
+    Point far_corners[4];
+    for(int i= 0; i < 4; i++)
+    {
+        float x= (i & 1) ? 1 : -1;
+        float y= (i & 2) ? 1 : -1;
+        near_corners[i]= inv(Point(x, y, -1));
+        far_corners[i]= inv(Point(x, y, 1));
+    }
+
+    // repere de la lumiere, centre sur les objets
+    Vector d= normalize(direction);
+    Vector up= (std::abs(d.y) > 0.99f) ? Vector(0, 0, 1) : Vector(0, 1, 0);
+    Point c= center(pmin, pmax);
+    Transform light= Lookat(c - d, c, up);
+
+    // englobant des objets dans le repere de la lumiere
+    Point lmin= light(corners[0]);
+    Point lmax= lmin;
+    for(int i= 1; i < 8; i++)
+    {
+        Point p= light(corners[i]);
+        lmin= min(lmin, p);
+        lmax= max(lmax, p);
+    }
+
+    Transform transforms[MAX_CASCADES];
+    float begin= n;
+    for(int i= 0; i < m_cascades; i++)
+    {
+        // decoupe logarithmique / uniforme, cf "parallel-split shadow maps", Zhang 2006
+        float t= float(i +1) / float(m_cascades);
+        float end= lambda * n * std::pow(f / n, t) + (1 - lambda) * (n + (f - n) * t);
+        if(i == m_cascades -1)
+            end= f;
+
+        // sommets de la tranche : interpoles sur les aretes de la region visible, en fonction de la distance a la camera
+        float t0= (begin - znear) / (zfar - znear);
+        float t1= (end - znear) / (zfar - znear);
+        Point slice[8];
+        for(int k= 0; k < 4; k++)
+        {
+            Vector edge= far_corners[k] - near_corners[k];
+            slice[2*k]= near_corners[k] + edge * t0;
+            slice[2*k +1]= near_corners[k] + edge * t1;
+        }
+
+        // sphere englobante de la tranche : ne change pas lorsque la camera tourne ou se deplace
+        Point sc= Point(0, 0, 0);
+        for(int k= 0; k < 8; k++)
+            sc= sc + Vector(slice[k]) / 8;
+        float r= 0;
+        for(int k= 0; k < 8; k++)
+            r= std::max(r, distance(sc, slice[k]));
+
+        // arrondi le rayon, 16 valeurs par puissance de 2, pour garder la meme taille de texel, meme si near / far changent un peu
+        float step= std::exp2(std::ceil(std::log2(std::max(r, 1e-6f)))) / 16;
+        r= std::ceil(r / step) * step;
+
+        float xmin, xmax, ymin, ymax;
+        if(std::max(lmax.x - lmin.x, lmax.y - lmin.y) <= 2*r)
+        {
+            // tous les objets sont dans la shadow map, les cascades ne dependent plus de la camera
+            float size= std::max(lmax.x - lmin.x, lmax.y - lmin.y) / 2;
+            Point lc= center(lmin, lmax);
+            xmin= lc.x - size; xmax= lc.x + size;
+            ymin= lc.y - size; ymax= lc.y + size;
+            m_texels[i]= 2*size / float(m_size);
+        }
+        else
+        {
+            // centre aligne sur une grille de SNAP_TEXELS texels : les objets statiques sont toujours dessines sur les memes texels,
+            // les shadow maps statiques restent valides tant que la camera se deplace de moins d'une demi case, la marge autour de la sphere.
+            int texels= std::max(m_size - int(SNAP_TEXELS), m_size / 2);
+            float texel= 2*r / float(texels);
+            float grid= float(m_size - texels) * texel;
+            Point lc= light(sc);
+            float x= std::floor(lc.x / grid + 0.5f) * grid;
+            float y= std::floor(lc.y / grid + 0.5f) * grid;
+            float size= float(m_size) * texel / 2;
+            xmin= x - size; xmax= x + size;
+            ymin= y - size; ymax= y + size;
+            m_texels[i]= texel;
+        }
+
+        // profondeur : tous les objets, meme en dehors de la tranche, peuvent projeter une ombre dans la tranche
+        transforms[i]= Ortho(xmin, xmax, ymin, ymax, -lmax.z, -lmin.z) * light;
+        m_splits[i]= end;
+        begin= end;
+    }
+
+    bool changed= (memcmp(transforms, m_transforms, sizeof(Transform) * m_cascades) != 0);
+    if(changed)
+    {
+        for(int i= 0; i < m_cascades; i++)
+            m_transforms[i]= transforms[i];
+        m_static_valid= false;
+    }
+
+    return changed;
+}
+
+
+void CascadedShadowMap::bind_static( const int cascade )
+{
+    assert(cascade >= 0 && cascade < m_cascades);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_static_texture, 0, cascade);
+    glViewport(0, 0, m_size, m_size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void CascadedShadowMap::bind( const int cascade )
+{
+    assert(cascade >= 0 && cascade < m_cascades);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture, 0, cascade);
+    glViewport(0, 0, m_size, m_size);
+
+    if(m_static_valid)
+        // recopie la profondeur des objets statiques, au lieu de les dessiner
+        glCopyImageSubData(m_static_texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, cascade,
+            m_texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, cascade, m_size, m_size, 1);
+    else
+        glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+
+void CascadedShadowMap::use( const GLuint program, const int unit )
+{
+    // transformations vers le repere [0 1] des shadow maps
+    Transform matrices[MAX_CASCADES];
+    float splits[MAX_CASCADES];
+    float bias[MAX_CASCADES];
+    for(int i= 0; i < MAX_CASCADES; i++)
+    {
+        matrices[i]= Viewport(1, 1) * m_transforms[std::min(i, m_cascades -1)];
+        splits[i]= (i < m_cascades -1) ? m_splits[i] : FLT_MAX;
+        // decale les points le long de la normale, d'un peu plus d'un texel
+        bias[i]= 1.5f * m_texels[std::min(i, m_cascades -1)];
+    }
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+    glBindSampler(unit, 0);
+
+    glUniform1i(uniform_location(program, "shadowMap"), unit);
+    glUniformMatrix4fv(uniform_location(program, "shadowMatrices"), MAX_CASCADES, GL_TRUE, matrices[0].buffer());
+    glUniform4fv(uniform_location(program, "shadowSplits"), 1, splits);
+    glUniform4fv(uniform_location(program, "shadowBias"), 1, bias);
+}
@@ -0,0 +1,134 @@
+
+#ifndef _SHADOW_MAP_H
+#define _SHADOW_MAP_H
+
+#include "glcore.h"
+
+#include "vec.h"
+#include "mat.h"
+
+
+//! \addtogroup openGL utilitaires openGL
+///@{
+
+//! \file
+/*! shadow maps en cascades pour une source de lumiere directionnelle.
+
+    la region visible par la camera est decoupee en plusieurs tranches, chaque tranche utilise sa propre shadow map, de meme resolution :
+    les tranches proches de la camera sont plus petites, et les ombres plus precises.
+    la projection orthographique de chaque tranche est ajustee sur la sphere englobante de la tranche, ou sur l'englobant des objets qui projettent des ombres, s'il est plus petit.
+    la taille et la position de chaque projection sont arrondies sur les texels de la shadow map : les ombres ne scintillent pas lorsque la camera se deplace.
+
+    les objets statiques sont dessines dans une copie des shadow maps, re-utilisee tant que les cascades ne changent pas (la camera bouge peu) :
+    a chaque image, seuls les objets dynamiques sont dessines, apres avoir recopie les shadow maps statiques.
+
+    exemple :
+\code
+CascadedShadowMap shadows;
+shadows.create(1024, 3);
+
+// a chaque image
+shadows.fit(view, projection, light_direction, casters_min, casters_max);
+if(!shadows.static_valid())
+{
+    for(int i= 0; i < shadows.cascades(); i++)
+    {
+        shadows.bind_static(i);
+        // dessine les objets statiques avec shadows.transform(i) * model
+    }
+    shadows.validate_static();
+}
+
+for(int i= 0; i < shadows.cascades(); i++)
+{
+    shadows.bind(i);
+    // dessine les objets dynamiques avec shadows.transform(i) * model
+}
+
+glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+glViewport(0, 0, window_width(), window_height());
+
+// utilise les shadow maps, cf shadowMap, shadowMatrices, shadowSplits, shadowBias dans le shader
+glUseProgram(program);
+shadows.use(program, 0);
+\endcode
+
+    cote shader :
+\code
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[4];     // repere monde vers repere [0 1] de chaque shadow map
+uniform vec4 shadowSplits;          // distance a la camera de la fin de chaque cascade
+uniform vec4 shadowBias;            // taille d'un texel de chaque shadow map, dans le repere monde
+
+float shadow( const vec3 p, const vec3 n, const float depth )
+{
+    int cascade= 0;
+    while(cascade < 3 && depth > shadowSplits[cascade])
+        cascade++;
+
+    vec4 s= shadowMatrices[cascade] * vec4(p + n * shadowBias[cascade], 1);
+    return texture(shadowMap, vec4(s.xy, cascade, s.z));
+}
+\endcode
+ */
+class CascadedShadowMap
+{
+public:
+    //! nombre maximum de cascades.
+    enum { MAX_CASCADES= 4 };
+    //! marge des cascades, en texels, cf fit( ).
+    enum { SNAP_TEXELS= 32 };
+
+    CascadedShadowMap( ) : m_texture(0), m_static_texture(0), m_framebuffer(0), m_size(0), m_cascades(0), m_static_valid(false) {}
+
+    //! cree les shadow maps, cascades textures de size x size texels. renvoie -1 en cas d'erreur.
+    int create( const int size= 1024, const int cascades= 3 );
+    //! detruit les shadow maps.
+    void release( );
+
+    /*! ajuste les cascades sur la region visible par la camera, view et projection, cf Orbiter::view( ) et Orbiter::projection( ).
+        direction est la direction de la lumiere, de la source vers les objets, pmin et pmax l'englobant des objets qui projettent des ombres, dans le repere monde.
+        renvoie vrai si les cascades ont change, les shadow maps statiques sont invalidees dans ce cas.
+     */
+    bool fit( const Transform& view, const Transform& projection, const Vector& direction, const Point& pmin, const Point& pmax, const float lambda= 0.75f );
+
+    //! renvoie vrai si les shadow maps statiques sont a jour.
+    bool static_valid( ) const { return m_static_valid; }
+    //! selectionne la shadow map statique d'une cascade pour dessiner les objets statiques.
+    void bind_static( const int cascade );
+    //! termine les shadow maps statiques.
+    void validate_static( ) { m_static_valid= true; }
+    //! invalide les shadow maps statiques, si les objets statiques ont change.
+    void invalidate_static( ) { m_static_valid= false; }
+
+    //! selectionne la shadow map d'une cascade pour dessiner les objets dynamiques, la shadow map est initialisee avec les objets statiques.
+    void bind( const int cascade );
+
+    //! configure un shader program pour utiliser les shadow maps sur l'unite de texture unit. le program doit etre selectionne, cf glUseProgram( ).
+    void use( const GLuint program, const int unit );
+
+    //! renvoie le nombre de cascades.
+    int cascades( ) const { return m_cascades; }
+    //! renvoie la transformation du repere monde vers le repere projectif de la lumiere d'une cascade.
+    const Transform& transform( const int cascade ) const { return m_transforms[cascade]; }
+    //! renvoie la distance a la camera de la fin d'une cascade.
+    float split( const int cascade ) const { return m_splits[cascade]; }
+    //! renvoie la texture 2d array des shadow maps.
+    GLuint texture( ) const { return m_texture; }
+    //! renvoie la taille des shadow maps, en octets.
+    size_t memory( ) const;
+
+protected:
+    Transform m_transforms[MAX_CASCADES];
+    float m_splits[MAX_CASCADES];
+    float m_texels[MAX_CASCADES];
+    GLuint m_texture;
+    GLuint m_static_texture;
+    GLuint m_framebuffer;
+    int m_size;
+    int m_cascades;
+    bool m_static_valid;
+};
+
+///@}
+#endif
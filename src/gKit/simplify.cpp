@@ -0,0 +1,514 @@
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <unordered_map>
+
+#include "simplify.h"
+
+
+// quadrique symetrique, somme ponderee des carres des distances a des plans.
+struct Quadric
+{
+    double a2, ab, ac, ad;
+    double b2, bc, bd;
+    double c2, cd;
+    double d2;
+    double w;
+
+    Quadric( ) : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0), w(0) {}
+
+    // plan ax + by + cz + d = 0, normale normalisee
+    Quadric( const double a, const double b, const double c, const double d, const double weight ) :
+        a2(a*a*weight), ab(a*b*weight), ac(a*c*weight), ad(a*d*weight),
+        b2(b*b*weight), bc(b*c*weight), bd(b*d*weight),
+        c2(c*c*weight), cd(c*d*weight),
+        d2(d*d*weight), w(weight) {}
+
+    Quadric& operator+= ( const Quadric& q )
+    {
+        a2+= q.a2; ab+= q.ab; ac+= q.ac; ad+= q.ad;
+        b2+= q.b2; bc+= q.bc; bd+= q.bd;
+        c2+= q.c2; cd+= q.cd;
+        d2+= q.d2;
+        w+= q.w;
+        return *this;
+    }
+
+    // somme ponderee des carres des distances de p aux plans
+    double operator( ) ( const vec3& p ) const
+    {
+        double x= p.x, y= p.y, z= p.z;
+        double e= a2*x*x + b2*y*y + c2*z*z + 2*(ab*x*y + ac*x*z + bc*y*z) + 2*(ad*x + bd*y + cd*z) + d2;
+        return std::max(e, 0.0);
+    }
+};
+
+static
+Quadric plane_quadric( const Point& p, const Vector& n, const double weight )
+{
+    return Quadric(n.x, n.y, n.z, -dot(n, Vector(p)), weight);
+}
+
+
+// type de sommet, cf allowed( )
+enum VertexKind
+{
+    kind_manifold= 0,   // sommet interieur, un seul jeu d'attributs
+    kind_border,        // sommet sur un bord
+    kind_seam,          // sommet sur une couture, 2 jeux d'attributs
+    kind_material,      // sommet sur une limite entre 2 matieres
+    kind_locked         // tous les autres cas, le sommet ne bouge pas
+};
+
+// type d'arete
+enum
+{
+    edge_border= 1,
+    edge_seam= 2,
+    edge_material= 4,
+    edge_complex= 8
+};
+
+struct EdgeInfo
+{
+    unsigned int va, vb;    // sommets du premier triangle, va sur la plus petite position
+    unsigned int material;
+    int count;
+    int flags;
+};
+
+static
+uint64_t edge_key( const unsigned int a, const unsigned int b )
+{
+    return (a < b) ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+}
+
+
+// soude les sommets de meme position, renvoie l'indice de la position de chaque sommet.
+static
+std::vector<unsigned int> weld_positions( const std::vector<vec3>& positions, unsigned int& count )
+{
+    struct PositionHash
+    {
+        size_t operator() ( const vec3& p ) const
+        {
+            uint32_t h[3];
+            memcpy(h, &p.x, sizeof(h));
+            return size_t(h[0] * 73856093u ^ h[1] * 19349663u ^ h[2] * 83492791u);
+        }
+    };
+
+    struct PositionEqual
+    {
+        bool operator() ( const vec3& a, const vec3& b ) const { return a.x == b.x && a.y == b.y && a.z == b.z; }
+    };
+
+    std::unordered_map<vec3, unsigned int, PositionHash, PositionEqual> map;
+    map.reserve(positions.size());
+
+    std::vector<unsigned int> remap(positions.size());
+    count= 0;
+    for(unsigned int i= 0; i < positions.size(); i++)
+    {
+        auto found= map.insert( { positions[i], count } );
+        if(found.second)
+            count++;
+        remap[i]= found.first->second;
+    }
+
+    return remap;
+}
+
+
+std::vector<unsigned int> simplify( const std::vector<unsigned int>& indices, const std::vector<vec3>& positions, const std::vector<unsigned int>& materials,
+    const int target_triangle_count, std::vector<unsigned int>& simplified_materials, float& error )
+{
+    assert(indices.size() % 3 == 0);
+    assert(materials.empty() || materials.size() == indices.size() / 3);
+
+    error= 0;
+
+    // triangles et sommets courants
+    std::vector<unsigned int> triangles= indices;
+    std::vector<unsigned int> triangle_materials= materials;
+    int triangle_count= int(triangles.size() / 3);
+    bool use_materials= !materials.empty();
+
+    unsigned int position_count= 0;
+    std::vector<unsigned int> position= weld_positions(positions, position_count);
+
+    // une quadrique par position, plans des triangles ponderes par leur aire
+    std::vector<Quadric> quadrics(position_count);
+    for(int t= 0; t < triangle_count; t++)
+    {
+        Point a= Point(positions[triangles[3*t]]);
+        Point b= Point(positions[triangles[3*t +1]]);
+        Point c= Point(positions[triangles[3*t +2]]);
+
+        Vector n= cross(b - a, c - a);
+        float area= length(n) / 2;
+        if(area == 0)
+            continue;
+
+        Quadric q= plane_quadric(a, n / (2 * area), area);
+        for(int k= 0; k < 3; k++)
+            quadrics[position[triangles[3*t +k]]]+= q;
+    }
+
+    std::vector<unsigned int> vertex_remap(positions.size());
+    std::vector<VertexKind> kinds(position_count);
+    std::vector<int> offsets(position_count +1);
+    std::vector<int> adjacency;
+    std::vector<char> touched(position_count);
+    std::unordered_map<uint64_t, EdgeInfo> edges;
+
+    struct Collapse
+    {
+        unsigned int u, v;
+        float cost;
+    };
+    std::vector<Collapse> collapses;
+
+    bool first_pass= true;
+    double max_error= 0;
+    while(triangle_count > target_triangle_count)
+    {
+        // etape 1 : adjacence positions / triangles
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for(int t= 0; t < triangle_count; t++)
+            for(int k= 0; k < 3; k++)
+                offsets[position[triangles[3*t +k]] +1]++;
+        for(unsigned int p= 0; p < position_count; p++)
+            offsets[p +1]+= offsets[p];
+
+        adjacency.resize(3 * triangle_count);
+        {
+            std::vector<int> fill(offsets.begin(), offsets.end() -1);
+            for(int t= 0; t < triangle_count; t++)
+                for(int k= 0; k < 3; k++)
+                    adjacency[fill[position[triangles[3*t +k]]]++]= t;
+        }
+
+        // etape 2 : classe les aretes et les sommets
+        edges.clear();
+        edges.reserve(3 * triangle_count);
+        for(int t= 0; t < triangle_count; t++)
+        for(int k= 0; k < 3; k++)
+        {
+            unsigned int a= triangles[3*t +k];
+            unsigned int b= triangles[3*t + (k +1) % 3];
+            if(position[a] > position[b])
+                std::swap(a, b);
+
+            unsigned int material= use_materials ? triangle_materials[t] : 0;
+            auto found= edges.insert( { edge_key(position[a], position[b]), { a, b, material, 1, 0 } } );
+            if(found.second)
+                continue;
+
+            EdgeInfo& edge= found.first->second;
+            edge.count++;
+            if(edge.va != a || edge.vb != b)
+                edge.flags|= edge_seam;
+            if(edge.material != material)
+                edge.flags|= edge_material;
+            if(edge.count > 2)
+                edge.flags|= edge_complex;
+        }
+
+        std::vector<int> border_edges(position_count, 0);
+        std::vector<int> seam_edges(position_count, 0);
+        std::vector<int> material_edges(position_count, 0);
+        std::vector<char> complex(position_count, 0);
+        for(auto& it : edges)
+        {
+            EdgeInfo& edge= it.second;
+            if(edge.count == 1)
+                edge.flags|= edge_border;
+
+            unsigned int ends[2]= { position[edge.va], position[edge.vb] };
+            for(int k= 0; k < 2; k++)
+            {
+                if(edge.flags & edge_border) border_edges[ends[k]]++;
+                if(edge.flags & edge_seam) seam_edges[ends[k]]++;
+                if(edge.flags & edge_material) material_edges[ends[k]]++;
+                if(edge.flags & edge_complex) complex[ends[k]]= 1;
+            }
+
+            // conserve les bords, coutures et limites : plans perpendiculaires au triangle, passant par l'arete
+            if(first_pass && (edge.flags & (edge_border | edge_seam | edge_material)))
+            {
+                Point a= Point(positions[edge.va]);
+                Point b= Point(positions[edge.vb]);
+                Vector ab= b - a;
+
+                // retrouve un triangle de l'arete pour calculer sa normale
+                Vector n;
+                for(int i= offsets[ends[0]]; i < offsets[ends[0] +1]; i++)
+                {
+                    int t= adjacency[i];
+                    Point p0= Point(positions[triangles[3*t]]);
+                    Point p1= Point(positions[triangles[3*t +1]]);
+                    Point p2= Point(positions[triangles[3*t +2]]);
+                    bool has_b= position[triangles[3*t]] == ends[1] || position[triangles[3*t +1]] == ends[1] || position[triangles[3*t +2]] == ends[1];
+                    if(has_b)
+                    {
+                        n= cross(p1 - p0, p2 - p0);
+                        break;
+                    }
+                }
+
+                Vector perpendicular= cross(ab, n);
+                float l= length(perpendicular);
+                if(l > 0)
+                {
+                    Quadric q= plane_quadric(a, perpendicular / l, 10 * dot(ab, ab));
+                    quadrics[ends[0]]+= q;
+                    quadrics[ends[1]]+= q;
+                }
+            }
+        }
+        first_pass= false;
+
+        for(unsigned int p= 0; p < position_count; p++)
+        {
+            // nombre de jeux d'attributs de la position
+            unsigned int wedges[3];
+            int wedge_count= 0;
+            for(int i= offsets[p]; i < offsets[p +1] && wedge_count < 3; i++)
+            {
+                int t= adjacency[i];
+                for(int k= 0; k < 3; k++)
+                {
+                    unsigned int v= triangles[3*t +k];
+                    if(position[v] == p && std::find(wedges, wedges + wedge_count, v) == wedges + wedge_count && wedge_count < 3)
+                        wedges[wedge_count++]= v;
+                }
+            }
+
+            int border= border_edges[p];
+            int seam= seam_edges[p];
+            int material= material_edges[p];
+            if(complex[p])
+                kinds[p]= kind_locked;
+            else if(border == 0 && seam == 0 && material == 0 && wedge_count == 1)
+                kinds[p]= kind_manifold;
+            else if(border == 2 && seam == 0 && material == 0 && wedge_count == 1)
+                kinds[p]= kind_border;
+            else if(seam == 2 && border == 0 && material == 0 && wedge_count == 2)
+                kinds[p]= kind_seam;
+            else if(material == 2 && border == 0 && seam == 0 && wedge_count == 1)
+                kinds[p]= kind_material;
+            else
+                kinds[p]= kind_locked;
+        }
+
+        // etape 3 : evalue les fusions autorisees, le sommet u est deplace sur le sommet v
+        auto allowed= [&]( const unsigned int u, const EdgeInfo& edge )
+        {
+            switch(kinds[u])
+            {
+                case kind_manifold: return true;
+                case kind_border: return (edge.flags & edge_border) != 0;
+                case kind_seam: return (edge.flags & edge_seam) != 0;
+                case kind_material: return (edge.flags & edge_material) != 0;
+                default: return false;
+            }
+        };
+
+        collapses.clear();
+        for(auto& it : edges)
+        {
+            const EdgeInfo& edge= it.second;
+            unsigned int a= position[edge.va];
+            unsigned int b= position[edge.vb];
+
+            Quadric q= quadrics[a];
+            q+= quadrics[b];
+            double w= std::max(q.w, 1e-12);
+
+            // deplace a sur b, ou b sur a ?
+            float cost_ab= allowed(a, edge) ? float(q(positions[edge.vb]) / w) : -1;
+            float cost_ba= allowed(b, edge) ? float(q(positions[edge.va]) / w) : -1;
+            if(cost_ab >= 0 && (cost_ba < 0 || cost_ab <= cost_ba))
+                collapses.push_back( { a, b, cost_ab } );
+            else if(cost_ba >= 0)
+                collapses.push_back( { b, a, cost_ba } );
+        }
+
+        if(collapses.empty())
+            break;
+
+        std::sort(collapses.begin(), collapses.end(),
+            []( const Collapse& a, const Collapse& b ) { return a.cost < b.cost; });
+
+        // etape 4 : fusionne les aretes les moins cheres, un sommet n'est modifie qu'une fois par passe
+        for(unsigned int i= 0; i < vertex_remap.size(); i++)
+            vertex_remap[i]= i;
+        std::fill(touched.begin(), touched.end(), 0);
+
+        // representant de chaque position, pour evaluer les triangles
+        std::vector<unsigned int> representative(position_count);
+        for(int t= 0; t < triangle_count; t++)
+            for(int k= 0; k < 3; k++)
+                representative[position[triangles[3*t +k]]]= triangles[3*t +k];
+
+        int removed= 0;
+        int target_removed= triangle_count - target_triangle_count;
+        int collapse_count= 0;
+
+        // les fusions bloquees par une fusion voisine attendent la passe suivante :
+        // limite le cout accepte pendant la passe, pour ne pas remplacer une fusion bloquee par une fusion plus chere.
+        unsigned int goal= std::min(unsigned(target_removed / 2), unsigned(collapses.size() / 8));
+        float cost_limit= collapses[goal].cost * 1.5f;
+        for(unsigned int c= 0; c < collapses.size() && removed < target_removed && collapses[c].cost <= cost_limit; c++)
+        {
+            unsigned int u= collapses[c].u;
+            unsigned int v= collapses[c].v;
+            if(touched[u] || touched[v])
+                continue;
+
+            // associe chaque jeu d'attributs de u a celui de v dans un triangle commun
+            unsigned int wedges_u[2], wedges_v[2];
+            int wedge_count= 0;
+            int shared= 0;
+            bool valid= true;
+            for(int i= offsets[u]; i < offsets[u +1] && valid; i++)
+            {
+                int t= adjacency[i];
+                unsigned int wu= 0, wv= 0;
+                bool has_v= false;
+                for(int k= 0; k < 3; k++)
+                {
+                    unsigned int x= triangles[3*t +k];
+                    if(position[x] == u) wu= x;
+                    if(position[x] == v) { wv= x; has_v= true; }
+                }
+
+                if(has_v)
+                {
+                    shared++;
+                    int w= 0;
+                    while(w < wedge_count && wedges_u[w] != wu) w++;
+                    if(w == wedge_count)
+                    {
+                        if(wedge_count == 2) { valid= false; break; }
+                        wedges_u[wedge_count]= wu;
+                        wedges_v[wedge_count]= wv;
+                        wedge_count++;
+                    }
+                    else if(wedges_v[w] != wv)
+                        valid= false;       // 2 jeux d'attributs de v pour le meme sommet u...
+                    continue;
+                }
+
+                // verifie que le triangle ne se retourne pas
+                Point p[3];
+                Point q[3];
+                for(int k= 0; k < 3; k++)
+                {
+                    unsigned int x= triangles[3*t +k];
+                    p[k]= Point(positions[x]);
+                    q[k]= (position[x] == u) ? Point(positions[representative[v]]) : p[k];
+                }
+
+                Vector n0= cross(p[1] - p[0], p[2] - p[0]);
+                Vector n1= cross(q[1] - q[0], q[2] - q[0]);
+                if(dot(n0, n1) <= 0)
+                    valid= false;
+            }
+            if(!valid || shared == 0)
+                continue;
+
+            // condition de lien : les voisins communs de u et v sont les sommets opposes a l'arete, sinon la fusion change la topologie
+            int common= 0;
+            for(int i= offsets[u]; i < offsets[u +1]; i++)
+            for(int k= 0; k < 3; k++)
+            {
+                unsigned int x= position[triangles[3*adjacency[i] +k]];
+                if(x == u || x == v)
+                    continue;
+
+                bool found= false;
+                for(int j= offsets[v]; j < offsets[v +1] && !found; j++)
+                    for(int l= 0; l < 3 && !found; l++)
+                        found= (position[triangles[3*adjacency[j] +l]] == x);
+
+                // compte chaque voisin une seule fois
+                for(int j= offsets[u]; j < i && found; j++)
+                    for(int l= 0; l < 3 && found; l++)
+                        found= (position[triangles[3*adjacency[j] +l]] != x);
+                for(int l= 0; l < k && found; l++)
+                    found= (position[triangles[3*adjacency[i] +l]] != x);
+
+                if(found)
+                    common++;
+            }
+            if(common != shared)
+                continue;
+
+            // tous les jeux d'attributs de u doivent etre associes
+            for(int i= offsets[u]; i < offsets[u +1] && valid; i++)
+            {
+                int t= adjacency[i];
+                for(int k= 0; k < 3; k++)
+                {
+                    unsigned int x= triangles[3*t +k];
+                    if(position[x] == u && std::find(wedges_u, wedges_u + wedge_count, x) == wedges_u + wedge_count)
+                        valid= false;
+                }
+            }
+            if(!valid)
+                continue;
+
+            // fusionne
+            for(int w= 0; w < wedge_count; w++)
+                vertex_remap[wedges_u[w]]= wedges_v[w];
+            quadrics[v]+= quadrics[u];
+
+            // verrouille le voisinage de u, son adjacence n'est plus a jour
+            for(int i= offsets[u]; i < offsets[u +1]; i++)
+            {
+                int t= adjacency[i];
+                for(int k= 0; k < 3; k++)
+                    touched[position[triangles[3*t +k]]]= 1;
+            }
+
+            max_error= std::max(max_error, double(collapses[c].cost));
+            removed+= shared;
+            collapse_count++;
+        }
+
+        if(collapse_count == 0)
+            break;
+
+        // etape 5 : re-indexe les triangles et supprime les triangles degeneres
+        int count= 0;
+        for(int t= 0; t < triangle_count; t++)
+        {
+            unsigned int a= vertex_remap[triangles[3*t]];
+            unsigned int b= vertex_remap[triangles[3*t +1]];
+            unsigned int c= vertex_remap[triangles[3*t +2]];
+            if(position[a] == position[b] || position[a] == position[c] || position[b] == position[c])
+                continue;
+
+            triangles[3*count]= a;
+            triangles[3*count +1]= b;
+            triangles[3*count +2]= c;
+            if(use_materials)
+                triangle_materials[count]= triangle_materials[t];
+            count++;
+        }
+
+        triangle_count= count;
+        triangles.resize(3 * count);
+        if(use_materials)
+            triangle_materials.resize(count);
+    }
+
+    error= float(std::sqrt(max_error));
+    simplified_materials.swap(triangle_materials);
+    return triangles;
+}
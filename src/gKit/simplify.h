@@ -0,0 +1,41 @@
+
+#ifndef _SIMPLIFY_H
+#define _SIMPLIFY_H
+
+#include <vector>
+
+#include "vec.h"
+
+
+//! \addtogroup objet3D
+///@{
+
+//! \file
+/*! simplification d'un maillage indexe par fusion d'aretes et metrique d'erreur quadrique.
+
+    cf "surface simplification using quadric error metrics", M. Garland, P. Heckbert, 1997
+    http://www.cs.cmu.edu/~./garland/Papers/quadrics.pdf
+
+    les sommets sont fusionnes sur un de leurs voisins, aucun sommet n'est cree : les indices simplifies referencent les sommets d'origine, tous les niveaux de details peuvent partager le meme vertex buffer.
+
+    les sommets qui partagent la meme position avec des attributs differents (coutures de texcoords ou de normales), les bords et les limites entre matieres sont conserves :
+    un sommet d'une couture, d'un bord ou d'une limite ne peut se deplacer que le long de cette couture, de ce bord ou de cette limite.
+
+    exemple :
+\code
+float error;
+std::vector<unsigned int> simplified_materials;
+std::vector<unsigned int> simplified= simplify(mesh.indices(), mesh.positions(), mesh.materials(), mesh.triangle_count() / 4, simplified_materials, error);
+\endcode
+ */
+
+/*! simplifie un maillage indexe jusqu'a target_triangle_count triangles, ou moins si possible.
+    materials, la matiere de chaque triangle, peut etre vide. simplified_materials contient la matiere de chaque triangle conserve.
+    error est la distance, dans le repere de l'objet, entre la surface simplifiee et la surface d'origine, estimee par les quadriques.
+    renvoie les indices des triangles simplifies.
+ */
+std::vector<unsigned int> simplify( const std::vector<unsigned int>& indices, const std::vector<vec3>& positions, const std::vector<unsigned int>& materials,
+    const int target_triangle_count, std::vector<unsigned int>& simplified_materials, float& error );
+
+///@}
+#endif
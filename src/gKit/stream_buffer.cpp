@@ -0,0 +1,185 @@
+
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <chrono>
+
+#include "stream_buffer.h"
+
+
+static
+size_t align( const size_t offset, const size_t alignment )
+{
+    return (offset + alignment -1) / alignment * alignment;
+}
+
+int StreamBuffer::create( const GLenum target, const size_t size, const int regions )
+{
+    assert(regions > 0);
+    release();
+
+    // alignement impose par openGL pour glBindBufferRange( )
+    GLint alignment= 16;
+    if(target == GL_UNIFORM_BUFFER)
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    else if(target == GL_SHADER_STORAGE_BUFFER)
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if(alignment < 16)
+        alignment= 16;
+
+    m_target= target;
+    m_alignment= alignment;
+    m_region_size= align(size, m_alignment);
+    m_regions= regions;
+    m_region= 0;
+    m_offset= 0;
+    m_flushed= 0;
+    m_fences.assign(regions, nullptr);
+
+    size_t total= m_region_size * regions;
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(target, m_buffer);
+
+#ifndef NO_GLEW
+    m_persistent= GLEW_ARB_buffer_storage;
+#else
+    m_persistent= false;
+#endif
+
+    if(m_persistent)
+    {
+        // buffer persistant, reste "mappe" et coherent : les ecritures sont visibles par le gpu, sans flush
+        GLbitfield flags= GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, total, nullptr, flags);
+        m_data= (unsigned char *) glMapBufferRange(target, 0, total, flags);
+        if(m_data == nullptr)
+        {
+            printf("[error] StreamBuffer: glMapBufferRange( )...\n");
+            release();
+            return -1;
+        }
+    }
+    else
+    {
+        // pas de buffer persistant, les donnees sont copiees par flush( )
+        glBufferData(target, total, nullptr, GL_STREAM_DRAW);
+        m_staging.resize(total);
+    }
+
+    return 0;
+}
+
+void StreamBuffer::release( )
+{
+    for(unsigned int i= 0; i < m_fences.size(); i++)
+        if(m_fences[i])
+            glDeleteSync(m_fences[i]);
+    m_fences.clear();
+
+    if(m_buffer)
+    {
+        if(m_persistent)
+        {
+            glBindBuffer(m_target, m_buffer);
+            glUnmapBuffer(m_target);
+        }
+        glDeleteBuffers(1, &m_buffer);
+    }
+
+    m_staging.clear();
+    m_data= nullptr;
+    m_buffer= 0;
+    m_region_size= 0;
+    m_regions= 0;
+}
+
+
+void *StreamBuffer::allocate( const size_t size, size_t& offset, const size_t alignment )
+{
+    offset= 0;
+    if(m_buffer == 0)
+        return nullptr;
+
+    size_t begin= align(m_offset, alignment ? alignment : m_alignment);
+    if(begin + size > m_region_size)
+    {
+        printf("[error] StreamBuffer: allocate %dKB, region %dKB...\n", int(size / 1024), int(m_region_size / 1024));
+        return nullptr;
+    }
+
+    m_offset= begin + size;
+    offset= size_t(m_region) * m_region_size + begin;
+    return data() + offset;
+}
+
+size_t StreamBuffer::write( const void *data, const size_t size, const size_t alignment )
+{
+    size_t offset;
+    void *ptr= allocate(size, offset, alignment);
+    if(ptr)
+        memcpy(ptr, data, size);
+
+    return offset;
+}
+
+size_t StreamBuffer::available( const size_t alignment ) const
+{
+    if(m_buffer == 0)
+        return 0;
+    
+    size_t begin= align(m_offset, alignment ? alignment : m_alignment);
+    return (begin < m_region_size) ? m_region_size - begin : 0;
+}
+
+
+void StreamBuffer::flush( )
+{
+    if(m_persistent || m_buffer == 0 || m_flushed == m_offset)
+        return;
+
+    // transfere les donnees ecrites depuis le dernier flush
+    size_t base= size_t(m_region) * m_region_size;
+    glBindBuffer(m_target, m_buffer);
+    glBufferSubData(m_target, base + m_flushed, m_offset - m_flushed, m_staging.data() + base + m_flushed);
+    m_flushed= m_offset;
+}
+
+void StreamBuffer::next_frame( )
+{
+    if(m_buffer == 0)
+        return;
+
+    flush();
+
+    // le gpu lira les donnees de la region courante apres les commandes deja emises
+    if(m_persistent)
+        m_fences[m_region]= glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    m_region= (m_region + 1) % m_regions;
+    m_offset= 0;
+    m_flushed= 0;
+
+    GLsync fence= m_fences[m_region];
+    if(fence == nullptr)
+        return;
+
+    // attend que le gpu ait fini de lire la region suivante
+    GLenum status= glClientWaitSync(fence, 0, 0);
+    if(status == GL_TIMEOUT_EXPIRED)
+    {
+        m_stalls++;
+
+        std::chrono::high_resolution_clock::time_point start= std::chrono::high_resolution_clock::now();
+        while(status == GL_TIMEOUT_EXPIRED)
+            status= glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);   // 1ms
+
+        std::chrono::high_resolution_clock::time_point stop= std::chrono::high_resolution_clock::now();
+        m_stall_time+= std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+    }
+
+    if(status == GL_WAIT_FAILED)
+        printf("[error] StreamBuffer: glClientWaitSync( )...\n");
+
+    glDeleteSync(fence);
+    m_fences[m_region]= nullptr;
+}
@@ -0,0 +1,102 @@
+
+#ifndef _STREAM_BUFFER_H
+#define _STREAM_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "glcore.h"
+
+
+//! \addtogroup openGL utilitaires openGL
+///@{
+
+//! \file
+/*! buffer pour transferer des donnees modifiees a chaque image : les donnees sont ecrites directement dans un buffer openGL, sans copie par le driver.
+
+    le buffer est decoupe en plusieurs regions (3 par defaut) : pendant que le gpu lit les donnees des images precedentes dans les autres regions, l'application ecrit les donnees de l'image suivante dans la region courante.
+    next_frame( ) pose une barriere (un fence) sur la region courante et passe a la suivante, en attendant si necessaire que le gpu ait fini de lire ses donnees. les attentes sont comptees par stalls( ).
+
+    utilise un buffer persistant, glBufferStorage( ) + glMapBufferRange(GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT), openGL 4.4 ou l'extension ARB_buffer_storage.
+    sinon, les donnees sont ecrites dans une copie et transferees par flush( ) avec glBufferSubData( ).
+
+    exemple :
+\code
+StreamBuffer stream;
+stream.create(GL_UNIFORM_BUFFER, 64*1024);
+
+// a chaque image
+size_t offset;
+Data *data= stream.allocate<Data>(n, offset);
+for(int i= 0; i < n; i++)
+    data[i]= { ... };
+stream.flush();
+
+glBindBufferRange(GL_UNIFORM_BUFFER, 0, stream.buffer(), offset, n * sizeof(Data));
+glDraw(...);
+
+stream.next_frame();
+\endcode
+ */
+class StreamBuffer
+{
+public:
+    StreamBuffer( ) : m_fences(), m_staging(), m_data(nullptr), m_target(0), m_buffer(0), m_region_size(0), m_regions(0), m_region(0), m_offset(0), m_flushed(0),
+        m_alignment(16), m_stalls(0), m_stall_time(0), m_persistent(false) {}
+
+    //! cree le buffer, regions regions de size octets. renvoie -1 en cas d'erreur.
+    int create( const GLenum target, const size_t size, const int regions= 3 );
+    //! detruit le buffer.
+    void release( );
+
+    /*! reserve size octets dans la region courante, alignes sur alignment octets, ou sur l'alignement impose par openGL pour target, si alignment est nul.
+        renvoie un pointeur pour ecrire les donnees, et leur position dans le buffer, offset, ou nullptr si la region est pleine.
+     */
+    void *allocate( const size_t size, size_t& offset, const size_t alignment= 0 );
+    //! reserve n elements de type T, cf allocate( ).
+    template < typename T >
+    T *allocate( const size_t n, size_t& offset, const size_t alignment= 0 ) { return static_cast<T *>(allocate(n * sizeof(T), offset, alignment)); }
+    //! copie size octets dans la region courante, renvoie leur position dans le buffer, cf allocate( ).
+    size_t write( const void *data, const size_t size, const size_t alignment= 0 );
+    //! renvoie le nombre d'octets encore disponibles dans la region courante, cf allocate( ).
+    size_t available( const size_t alignment= 0 ) const;
+
+    //! rend visibles par openGL les donnees ecrites depuis le dernier appel. a utiliser avant de dessiner.
+    void flush( );
+    //! termine l'utilisation de la region courante, et passe a la suivante.
+    void next_frame( );
+
+    //! renvoie l'identifiant du buffer openGL.
+    GLuint buffer( ) const { return m_buffer; }
+    //! renvoie la taille d'une region.
+    size_t region_size( ) const { return m_region_size; }
+    //! renvoie vrai si le buffer est persistant.
+    bool persistent( ) const { return m_persistent; }
+
+    //! renvoie le nombre d'attentes de next_frame( ).
+    int stalls( ) const { return m_stalls; }
+    //! renvoie la duree totale des attentes, en microsecondes.
+    long long int stall_time( ) const { return m_stall_time; }
+
+protected:
+    //! renvoie la memoire ecrite par allocate( ), le buffer persistant ou la copie. pas de pointeur conserve sur la copie, l'objet peut etre copie, cf Text.
+    unsigned char *data( ) { return m_persistent ? m_data : m_staging.data(); }
+
+    std::vector<GLsync> m_fences;
+    std::vector<unsigned char> m_staging;
+    unsigned char *m_data;      //!< buffer persistant uniquement.
+    GLenum m_target;
+    GLuint m_buffer;
+    size_t m_region_size;
+    int m_regions;
+    int m_region;
+    size_t m_offset;
+    size_t m_flushed;
+    size_t m_alignment;
+    int m_stalls;
+    long long int m_stall_time;
+    bool m_persistent;
+};
+
+///@}
+#endif
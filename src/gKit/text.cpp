@@ -54,9 +54,7 @@ Text create_text( )
 
     clear(text);
     glGenVertexArrays(1, &text.vao);
-    glGenBuffers(1, &text.ubo);
-    glBindBuffer(GL_UNIFORM_BUFFER, text.ubo);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(text.buffer), text.buffer, GL_STATIC_DRAW);
+    text.ubo.create(GL_UNIFORM_BUFFER, sizeof(text.buffer));
 
     return text;
 }
@@ -65,7 +63,7 @@ void release_text( Text& text )
 {
     release_program(text.program);
     glDeleteVertexArrays(1, &text.vao);
-    glDeleteBuffers(1, &text.ubo);
+    text.ubo.release();
     glDeleteTextures(1, &text.font);
 }
 
@@ -165,14 +163,17 @@ void draw( const Text& text, const int width, const int height )
     program_uniform(text.program, "default_color", text.color);
 
     // transfere le texte dans l'uniform buffer associe au binding 0, cf create_text()
-    glBindBufferBase(GL_UNIFORM_BUFFER, 0, text.ubo);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(text.buffer), text.buffer);
+    size_t offset= text.ubo.write(text.buffer, sizeof(text.buffer));
+    text.ubo.flush();
+    glBindBufferRange(GL_UNIFORM_BUFFER, 0, text.ubo.buffer(), offset, sizeof(text.buffer));
 
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_BLEND);
     glDisable(GL_DEPTH_TEST);
 
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    // la prochaine image utilisera une autre region du buffer
+    text.ubo.next_frame();
 
     glDisable(GL_BLEND);
     glEnable(GL_DEPTH_TEST);
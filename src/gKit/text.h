@@ -5,6 +5,7 @@
 #include "glcore.h"
 
 #include "color.h"
+#include "stream_buffer.h"
 
 
 //! \addtogroup application 
@@ -60,14 +61,14 @@ d'ou la creation et desctruction des objets openGL dans les fonctions init() et
 //! \todo interface c++
 struct Text
 {
-    Text( ) : color( White() ), font(0), program(0), vao(0), ubo(0) {}
+    Text( ) : color( White() ), font(0), program(0), vao(0), ubo() {}
     
     int buffer[24][128];
     Color color;        //!< couleur du texte.
     GLuint font;        //!< texture contenant les caracteres.
     GLuint program;     //!< shader pour afficher le texte.
     GLuint vao;         //!< vertex array object.
-    GLuint ubo;         //!< uniform buffer object, pour transferrer le texte a afficher
+    mutable StreamBuffer ubo;   //!< uniform buffer object, pour transferrer le texte a afficher, une region par image.
 };
 
 //! cree une console. a detruire avec release_text( ).
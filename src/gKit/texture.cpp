@@ -5,6 +5,7 @@
 
 #include "texture.h"
 #include "image_io.h"
+#include "texture_bc.h"
 
 
 int miplevels( const int width, const int height )
@@ -95,8 +96,83 @@ GLuint make_texture( const int unit, const ImageData& im, const GLenum texel_typ
 }
 
 
+GLuint make_texture( const int unit, const std::vector<Image>& levels, const GLenum texel_type )
+{
+    if(levels.empty() || levels[0] == Image::error())
+        return 0;
+    
+    // cree la texture openGL
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    
+    // fixe les parametres de filtrage par defaut
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, int(levels.size()) -1);
+    
+    // transfere les mipmaps precalcules, cf mipmap_levels( ), 4 float par texel
+    for(int i= 0; i < int(levels.size()); i++)
+        glTexImage2D(GL_TEXTURE_2D, i,
+            texel_type, levels[i].width(), levels[i].height(), 0,
+            GL_RGBA, GL_FLOAT, levels[i].buffer());
+    
+    return texture;
+}
+
+GLuint make_texture( const int unit, const std::vector<ImageData>& levels, const GLenum texel_type )
+{
+    if(levels.empty() || levels[0].data.empty())
+        return 0;
+    
+    // cree la texture openGL
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    
+    // fixe les parametres de filtrage par defaut
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, int(levels.size()) -1);
+    
+    GLenum format;
+    switch(levels[0].channels)
+    {
+        case 1: format= GL_RED; break;
+        case 2: format= GL_RG; break;
+        case 3: format= GL_RGB; break;
+        case 4: format= GL_RGBA; break;
+        default: format= GL_RGBA; 
+    }
+    
+    GLenum type= (levels[0].size == 4) ? GL_FLOAT : GL_UNSIGNED_BYTE;
+    
+    // transfere les mipmaps precalcules, cf mipmap_levels( ). les lignes des petits niveaux ne sont pas alignees sur 4 octets...
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for(int i= 0; i < int(levels.size()); i++)
+        glTexImage2D(GL_TEXTURE_2D, i,
+            texel_type, levels[i].width, levels[i].height, 0,
+            format, type, levels[i].buffer());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    
+    return texture;
+}
+
+
 GLuint read_texture( const int unit, const char *filename, const GLenum texel_type )
 {
+    // formats compresses, cf texture_bc.h
+    BCFormat format;
+    bool srgb;
+    if(compressed_format(texel_type, format, srgb))
+        return read_compressed_texture(unit, filename, format, 1, srgb);
+    
     ImageData image= read_image_data(filename);
     return make_texture(unit, image, texel_type);
 }
@@ -2,6 +2,8 @@
 #ifndef _TEXTURE_H
 #define _TEXTURE_H
 
+#include <vector>
+
 #include "glcore.h"
 #include "image.h"
 #include "image_io.h"
@@ -22,8 +24,14 @@ GLuint make_texture( const int unit, const Image& im, const GLenum texel_type= G
 //! \param texel_type permet de choisir la representation interne des valeurs de la texture.
 GLuint make_texture( const int unit, const ImageData& im, const GLenum texel_type= GL_RGBA );
 
+//! cree une texture a partir de mipmaps precalcules, cf mipmap_levels( ), sans glGenerateMipmap( ). a detruire avec glDeleteTextures( ).
+GLuint make_texture( const int unit, const std::vector<Image>& levels, const GLenum texel_type= GL_RGBA32F );
+
+//! cree une texture a partir des donnees de mipmaps precalcules, cf mipmap_levels( ), sans glGenerateMipmap( ). a detruire avec glDeleteTextures( ).
+GLuint make_texture( const int unit, const std::vector<ImageData>& levels, const GLenum texel_type= GL_RGBA );
+
 //! cree une texture a partir d'un fichier filename. a detruire avec glDeleteTextures( ).
-//! \param texel_type permet de choisir la representation interne des valeurs de la texture.
+//! \param texel_type permet de choisir la representation interne des valeurs de la texture. les formats compresses BC1 / BC3 / BC4 / BC5 / BC7 utilisent read_compressed_texture( ), cf texture_bc.h.
 GLuint read_texture( const int unit, const char *filename, const GLenum texel_type= GL_RGBA );
 
 //! renvoie le nombre de mipmap d'une image width x height.
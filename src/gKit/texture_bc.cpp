@@ -0,0 +1,1037 @@
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cfloat>
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+    #include <direct.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define USE_SSE
+#endif
+
+#include "texture_bc.h"
+#include "mipmap.h"
+
+// pas forcement definis par les headers openGL, cf macos
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+
+// bloc de 4x4 pixels, un tableau par canal pour traiter 4 pixels a la fois
+struct Block
+{
+    alignas(16) float c[4][16];
+};
+
+// canal c du pixel i, les canaux absents sont completes comme pour une image rgba
+static inline
+int texel( const ImageData& image, const size_t i, const int c )
+{
+    if(c < image.channels)
+        return image.data[i * image.channels + c];
+    if(c == 3)
+        return 255;
+    if(image.channels == 1)
+        return image.data[i];        // niveaux de gris
+    return 0;
+}
+
+static
+void fetch_block( const ImageData& image, const int bx, const int by, Block& block )
+{
+    for(int i= 0; i < 16; i++)
+    {
+        // repete les derniers pixels des blocs incomplets
+        int x= std::min(bx * 4 + i % 4, image.width -1);
+        int y= std::min(by * 4 + i / 4, image.height -1);
+        size_t offset= size_t(y) * image.width + x;
+        for(int c= 0; c < 4; c++)
+            block.c[c][i]= float(texel(image, offset, c));
+    }
+}
+
+
+// choisit la couleur de la palette la plus proche de chaque pixel, sur les canaux first .. first + channels -1.
+// renvoie l'erreur quadratique du bloc.
+static
+float select_indices( const Block& block, const int first, const int channels, const float palette[][4], const int count, int indices[16] )
+{
+    float error= 0;
+#ifdef USE_SSE
+    for(int i= 0; i < 16; i+= 4)
+    {
+        __m128 best= _mm_set1_ps(FLT_MAX);
+        __m128 best_index= _mm_setzero_ps();
+        for(int k= 0; k < count; k++)
+        {
+            __m128 d= _mm_setzero_ps();
+            for(int c= first; c < first + channels; c++)
+            {
+                __m128 v= _mm_sub_ps(_mm_load_ps(block.c[c] + i), _mm_set1_ps(palette[k][c]));
+                d= _mm_add_ps(d, _mm_mul_ps(v, v));
+            }
+
+            __m128 less= _mm_cmplt_ps(d, best);
+            best= _mm_min_ps(d, best);
+            best_index= _mm_or_ps(_mm_and_ps(less, _mm_set1_ps(float(k))), _mm_andnot_ps(less, best_index));
+        }
+
+        _mm_storeu_si128((__m128i *) (indices + i), _mm_cvttps_epi32(best_index));
+
+        alignas(16) float tmp[4];
+        _mm_store_ps(tmp, best);
+        error= error + tmp[0] + tmp[1] + tmp[2] + tmp[3];
+    }
+#else
+    for(int i= 0; i < 16; i++)
+    {
+        float best= FLT_MAX;
+        for(int k= 0; k < count; k++)
+        {
+            float d= 0;
+            for(int c= first; c < first + channels; c++)
+                d= d + (block.c[c][i] - palette[k][c]) * (block.c[c][i] - palette[k][c]);
+
+            if(d < best)
+            {
+                best= d;
+                indices[i]= k;
+            }
+        }
+
+        error= error + best;
+    }
+#endif
+    return error;
+}
+
+// extremites de la boite englobante des pixels
+static
+void bounds_endpoints( const Block& block, const int first, const int channels, float e0[4], float e1[4] )
+{
+    for(int c= first; c < first + channels; c++)
+    {
+        e0[c]= *std::max_element(block.c[c], block.c[c] + 16);
+        e1[c]= *std::min_element(block.c[c], block.c[c] + 16);
+    }
+}
+
+// extremites du segment porte par l'axe principal des pixels
+static
+void principal_endpoints( const Block& block, const int first, const int channels, float e0[4], float e1[4] )
+{
+    float mean[4]= { 0, 0, 0, 0 };
+    for(int c= first; c < first + channels; c++)
+    {
+        for(int i= 0; i < 16; i++)
+            mean[c]= mean[c] + block.c[c][i];
+        mean[c]= mean[c] / 16;
+    }
+
+    float covariance[4][4]= { };
+    for(int i= 0; i < 16; i++)
+    for(int a= first; a < first + channels; a++)
+    for(int b= first; b < first + channels; b++)
+        covariance[a][b]= covariance[a][b] + (block.c[a][i] - mean[a]) * (block.c[b][i] - mean[b]);
+
+    // iterations de la puissance, en partant de la diagonale de la boite englobante
+    float axis[4]= { 0, 0, 0, 0 };
+    bounds_endpoints(block, first, channels, e0, e1);
+    for(int c= first; c < first + channels; c++)
+        axis[c]= e0[c] - e1[c];
+
+    for(int k= 0; k < 8; k++)
+    {
+        float next[4]= { 0, 0, 0, 0 };
+        float length= 0;
+        for(int a= first; a < first + channels; a++)
+        {
+            for(int b= first; b < first + channels; b++)
+                next[a]= next[a] + covariance[a][b] * axis[b];
+            length= std::max(length, std::abs(next[a]));
+        }
+
+        if(length < 1e-6f)
+            break;
+        for(int c= first; c < first + channels; c++)
+            axis[c]= next[c] / length;
+    }
+
+    float length= 0;
+    for(int c= first; c < first + channels; c++)
+        length= length + axis[c] * axis[c];
+    if(length < 1e-12f)
+        // bloc uniforme, les extremites de la boite conviennent
+        return;
+
+    for(int c= first; c < first + channels; c++)
+        axis[c]= axis[c] / std::sqrt(length);
+
+    float tmin= FLT_MAX;
+    float tmax= -FLT_MAX;
+    for(int i= 0; i < 16; i++)
+    {
+        float t= 0;
+        for(int c= first; c < first + channels; c++)
+            t= t + (block.c[c][i] - mean[c]) * axis[c];
+        tmin= std::min(tmin, t);
+        tmax= std::max(tmax, t);
+    }
+
+    for(int c= first; c < first + channels; c++)
+    {
+        e0[c]= std::min(255.f, std::max(0.f, mean[c] + tmax * axis[c]));
+        e1[c]= std::min(255.f, std::max(0.f, mean[c] + tmin * axis[c]));
+    }
+}
+
+// moindres carres : ajuste les extremites aux pixels, pixel ~ (1 - w) e0 + w e1, w est le poids de l'index de chaque pixel.
+static
+bool fit_endpoints( const Block& block, const int first, const int channels, const float *weights, const int indices[16], float e0[4], float e1[4] )
+{
+    float aa= 0, ab= 0, bb= 0;
+    float ax[4]= { 0, 0, 0, 0 };
+    float bx[4]= { 0, 0, 0, 0 };
+    for(int i= 0; i < 16; i++)
+    {
+        float b= weights[indices[i]];
+        float a= 1 - b;
+        aa= aa + a * a;
+        ab= ab + a * b;
+        bb= bb + b * b;
+        for(int c= first; c < first + channels; c++)
+        {
+            ax[c]= ax[c] + a * block.c[c][i];
+            bx[c]= bx[c] + b * block.c[c][i];
+        }
+    }
+
+    float det= aa * bb - ab * ab;
+    if(std::abs(det) < 1e-6f)
+        return false;
+
+    for(int c= first; c < first + channels; c++)
+    {
+        e0[c]= std::min(255.f, std::max(0.f, (ax[c] * bb - bx[c] * ab) / det));
+        e1[c]= std::min(255.f, std::max(0.f, (bx[c] * aa - ax[c] * ab) / det));
+    }
+    return true;
+}
+
+
+// ecriture / lecture des blocs, bit par bit, poids faibles d'abord
+struct BitWriter
+{
+    BitWriter( unsigned char *_data ) : data(_data), position(0) {}
+
+    void write( const unsigned int v, const int count )
+    {
+        for(int i= 0; i < count; i++, position++)
+            if((v >> i) & 1)
+                data[position >> 3]= data[position >> 3] | (1 << (position & 7));
+    }
+
+    unsigned char *data;
+    int position;
+};
+
+struct BitReader
+{
+    BitReader( const unsigned char *_data ) : data(_data), position(0) {}
+
+    unsigned int read( const int count )
+    {
+        unsigned int v= 0;
+        for(int i= 0; i < count; i++, position++)
+            v= v | (((data[position >> 3] >> (position & 7)) & 1) << i);
+        return v;
+    }
+
+    const unsigned char *data;
+    int position;
+};
+
+
+// BC1
+static
+unsigned int pack565( const float c[4] )
+{
+    unsigned int r= unsigned(c[0] * 31 / 255 + 0.5f);
+    unsigned int g= unsigned(c[1] * 63 / 255 + 0.5f);
+    unsigned int b= unsigned(c[2] * 31 / 255 + 0.5f);
+    return (r << 11) | (g << 5) | b;
+}
+
+static
+void unpack565( const unsigned int v, int c[4] )
+{
+    int r= (v >> 11) & 31;
+    int g= (v >> 5) & 63;
+    int b= v & 31;
+    c[0]= (r << 3) | (r >> 2);
+    c[1]= (g << 2) | (g >> 4);
+    c[2]= (b << 3) | (b >> 2);
+    c[3]= 255;
+}
+
+// palette en mode 4 couleurs, c0 > c1, ou 3 couleurs + noir transparent
+static
+void bc1_palette( const unsigned int c0, const unsigned int c1, const bool four, int palette[4][4] )
+{
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    for(int c= 0; c < 4; c++)
+    {
+        if(four || c0 > c1)
+        {
+            palette[2][c]= (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c]= (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else
+        {
+            palette[2][c]= (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c]= 0;
+        }
+    }
+}
+
+static
+void encode_bc1( const Block& block, const int quality, unsigned char *out )
+{
+    float e0[4], e1[4];
+    if(quality == 0)
+        bounds_endpoints(block, 0, 3, e0, e1);
+    else
+        principal_endpoints(block, 0, 3, e0, e1);
+
+    // poids des couleurs de la palette, dans l'ordre c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+    const float weights[4]= { 0, 1, 1.f / 3, 2.f / 3 };
+    const int iterations= (quality == 0) ? 0 : (quality == 1) ? 2 : 8;
+
+    float best_error= FLT_MAX;
+    unsigned int best_c0= 0, best_c1= 0;
+    int best_indices[16]= { };
+    for(int k= 0; ; k++)
+    {
+        unsigned int c0= pack565(e0);
+        unsigned int c1= pack565(e1);
+        // mode 4 couleurs, si c0 > c1
+        if(c0 < c1)
+            std::swap(c0, c1);
+
+        int ipalette[4][4];
+        bc1_palette(c0, c1, true, ipalette);
+        float palette[4][4];
+        for(int i= 0; i < 4; i++)
+        for(int c= 0; c < 4; c++)
+            palette[i][c]= float(ipalette[i][c]);
+
+        // c0 == c1 : mode 3 couleurs, seule la premiere convient
+        int indices[16];
+        float error= select_indices(block, 0, 3, palette, (c0 == c1) ? 1 : 4, indices);
+        if(error < best_error)
+        {
+            best_error= error;
+            best_c0= c0;
+            best_c1= c1;
+            std::copy(indices, indices + 16, best_indices);
+        }
+
+        if(k >= iterations || error == 0 || c0 == c1)
+            break;
+        if(!fit_endpoints(block, 0, 3, weights, indices, e0, e1))
+            break;
+    }
+
+    memset(out, 0, 8);
+    BitWriter bits(out);
+    bits.write(best_c0, 16);
+    bits.write(best_c1, 16);
+    for(int i= 0; i < 16; i++)
+        bits.write(best_indices[i], 2);
+}
+
+static
+void decode_bc1( const unsigned char *in, const bool four, unsigned char pixels[16][4] )
+{
+    BitReader bits(in);
+    unsigned int c0= bits.read(16);
+    unsigned int c1= bits.read(16);
+
+    int palette[4][4];
+    bc1_palette(c0, c1, four, palette);
+
+    for(int i= 0; i < 16; i++)
+    {
+        int index= bits.read(2);
+        for(int c= 0; c < 4; c++)
+            pixels[i][c]= (unsigned char) palette[index][c];
+    }
+}
+
+
+// BC4, valeurs interpolees tronquees, comme les decodeurs de reference
+static
+void bc4_palette( const int r0, const int r1, float palette[8] )
+{
+    palette[0]= float(r0);
+    palette[1]= float(r1);
+    if(r0 > r1)
+    {
+        for(int k= 1; k < 7; k++)
+            palette[k +1]= float(((7 - k) * r0 + k * r1) / 7);
+    }
+    else
+    {
+        for(int k= 1; k < 5; k++)
+            palette[k +1]= float(((5 - k) * r0 + k * r1) / 5);
+        palette[6]= 0;
+        palette[7]= 255;
+    }
+}
+
+// evalue les extremites r0, r1 sur le canal channel du bloc
+static
+float bc4_indices( const Block& block, const int channel, const int r0, const int r1, int indices[16] )
+{
+    float values[8];
+    bc4_palette(r0, r1, values);
+
+    float palette[8][4];
+    for(int k= 0; k < 8; k++)
+        palette[k][channel]= values[k];
+
+    return select_indices(block, channel, 1, palette, (r0 == r1) ? 1 : 8, indices);
+}
+
+static
+void encode_bc4( const Block& block, const int channel, const int quality, unsigned char *out )
+{
+    const float *values= block.c[channel];
+    float vmin= *std::min_element(values, values + 16);
+    float vmax= *std::max_element(values, values + 16);
+
+    // mode 8 valeurs, r0 > r1
+    int best_r0= int(vmax + 0.5f);
+    int best_r1= int(vmin + 0.5f);
+    int best_indices[16];
+    float best_error= bc4_indices(block, channel, best_r0, best_r1, best_indices);
+
+    if(quality > 0)
+    {
+        // poids des valeurs de la palette, dans l'ordre r0, r1, 6/7 r0 + 1/7 r1, etc.
+        const float weights[8]= { 0, 1, 1.f / 7, 2.f / 7, 3.f / 7, 4.f / 7, 5.f / 7, 6.f / 7 };
+        const int iterations= (quality == 1) ? 2 : 8;
+
+        int indices[16];
+        std::copy(best_indices, best_indices + 16, indices);
+        for(int k= 0; k < iterations && best_error > 0 && best_r0 != best_r1; k++)
+        {
+            float e0[4], e1[4];
+            if(!fit_endpoints(block, channel, 1, weights, indices, e0, e1))
+                break;
+
+            int r0= int(e0[channel] + 0.5f);
+            int r1= int(e1[channel] + 0.5f);
+            if(r0 < r1)
+                std::swap(r0, r1);
+            if(r0 == r1)
+                break;
+
+            float error= bc4_indices(block, channel, r0, r1, indices);
+            if(error >= best_error)
+                break;
+
+            best_error= error;
+            best_r0= r0;
+            best_r1= r1;
+            std::copy(indices, indices + 16, best_indices);
+        }
+
+        // mode 6 valeurs + 0 et 255 exacts, r0 <= r1, sur les autres valeurs
+        float imin= 255, imax= 0;
+        for(int i= 0; i < 16; i++)
+            if(values[i] > 0 && values[i] < 255)
+            {
+                imin= std::min(imin, values[i]);
+                imax= std::max(imax, values[i]);
+            }
+
+        if(imin <= imax)
+        {
+            int r0= int(imin + 0.5f);
+            int r1= int(imax + 0.5f);
+            float error= bc4_indices(block, channel, r0, r1, indices);
+            if(error < best_error)
+            {
+                best_error= error;
+                best_r0= r0;
+                best_r1= r1;
+                std::copy(indices, indices + 16, best_indices);
+            }
+        }
+    }
+
+    memset(out, 0, 8);
+    BitWriter bits(out);
+    bits.write(best_r0, 8);
+    bits.write(best_r1, 8);
+    for(int i= 0; i < 16; i++)
+        bits.write(best_indices[i], 3);
+}
+
+static
+void decode_bc4( const unsigned char *in, const int channel, unsigned char pixels[16][4] )
+{
+    BitReader bits(in);
+    int r0= bits.read(8);
+    int r1= bits.read(8);
+
+    float palette[8];
+    bc4_palette(r0, r1, palette);
+    for(int i= 0; i < 16; i++)
+        pixels[i][channel]= (unsigned char) palette[bits.read(3)];
+}
+
+
+// BC7, mode 6
+static const int bc7_weights[16]= { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// extremite 7 bits par canal + 1 bit commun
+static
+void bc7_quantize( const float e[4], const int p, int q[4] )
+{
+    for(int c= 0; c < 4; c++)
+        q[c]= std::min(127, std::max(0, int((e[c] - p) / 2 + 0.5f)));
+}
+
+// choisit le bit commun qui represente le mieux l'extremite
+static
+int bc7_pbit( const float e[4] )
+{
+    float error[2]= { 0, 0 };
+    for(int p= 0; p < 2; p++)
+    {
+        int q[4];
+        bc7_quantize(e, p, q);
+        for(int c= 0; c < 4; c++)
+            error[p]= error[p] + (float((q[c] << 1) | p) - e[c]) * (float((q[c] << 1) | p) - e[c]);
+    }
+
+    return (error[1] < error[0]) ? 1 : 0;
+}
+
+static
+void bc7_palette( const int q0[4], const int p0, const int q1[4], const int p1, int palette[16][4] )
+{
+    for(int k= 0; k < 16; k++)
+    for(int c= 0; c < 4; c++)
+    {
+        int v0= (q0[c] << 1) | p0;
+        int v1= (q1[c] << 1) | p1;
+        palette[k][c]= ((64 - bc7_weights[k]) * v0 + bc7_weights[k] * v1 + 32) >> 6;
+    }
+}
+
+static
+void encode_bc7( const Block& block, const int quality, unsigned char *out )
+{
+    float e0[4], e1[4];
+    if(quality == 0)
+        bounds_endpoints(block, 0, 4, e0, e1);
+    else
+        principal_endpoints(block, 0, 4, e0, e1);
+
+    float weights[16];
+    for(int k= 0; k < 16; k++)
+        weights[k]= float(bc7_weights[k]) / 64;
+
+    const int iterations= (quality == 0) ? 0 : (quality == 1) ? 2 : 8;
+
+    float best_error= FLT_MAX;
+    int best_q0[4]= { }, best_q1[4]= { };
+    int best_p0= 0, best_p1= 0;
+    int best_indices[16]= { };
+    for(int k= 0; ; k++)
+    {
+        // quality 2 : essaye les 4 combinaisons de bits communs
+        int pbits[4][2]= { { bc7_pbit(e0), bc7_pbit(e1) }, { 0, 1 }, { 1, 0 }, { 1, 1 } };
+        int tries= 1;
+        if(quality > 1)
+        {
+            pbits[0][0]= 0;
+            pbits[0][1]= 0;
+            tries= 4;
+        }
+
+        int indices[16];
+        for(int t= 0; t < tries; t++)
+        {
+            int q0[4], q1[4];
+            bc7_quantize(e0, pbits[t][0], q0);
+            bc7_quantize(e1, pbits[t][1], q1);
+
+            int ipalette[16][4];
+            bc7_palette(q0, pbits[t][0], q1, pbits[t][1], ipalette);
+            float palette[16][4];
+            for(int i= 0; i < 16; i++)
+            for(int c= 0; c < 4; c++)
+                palette[i][c]= float(ipalette[i][c]);
+
+            int tmp[16];
+            float error= select_indices(block, 0, 4, palette, 16, tmp);
+            if(error < best_error)
+            {
+                best_error= error;
+                std::copy(q0, q0 + 4, best_q0);
+                std::copy(q1, q1 + 4, best_q1);
+                best_p0= pbits[t][0];
+                best_p1= pbits[t][1];
+                std::copy(tmp, tmp + 16, best_indices);
+            }
+        }
+
+        if(k >= iterations || best_error == 0)
+            break;
+
+        std::copy(best_indices, best_indices + 16, indices);
+        if(!fit_endpoints(block, 0, 4, weights, indices, e0, e1))
+            break;
+    }
+
+    // le bit de poids fort de l'index du premier pixel est implicite, et nul
+    if(best_indices[0] & 8)
+    {
+        std::swap(best_q0, best_q1);
+        std::swap(best_p0, best_p1);
+        for(int i= 0; i < 16; i++)
+            best_indices[i]= 15 - best_indices[i];
+    }
+
+    memset(out, 0, 16);
+    BitWriter bits(out);
+    bits.write(1 << 6, 7);
+    for(int c= 0; c < 4; c++)
+    {
+        bits.write(best_q0[c], 7);
+        bits.write(best_q1[c], 7);
+    }
+    bits.write(best_p0, 1);
+    bits.write(best_p1, 1);
+    bits.write(best_indices[0], 3);
+    for(int i= 1; i < 16; i++)
+        bits.write(best_indices[i], 4);
+}
+
+static
+void decode_bc7( const unsigned char *in, unsigned char pixels[16][4] )
+{
+    BitReader bits(in);
+    if(bits.read(7) != (1 << 6))
+    {
+        // autres modes, non produits par encode_bc7( )
+        for(int i= 0; i < 16; i++)
+        {
+            pixels[i][0]= 255;
+            pixels[i][1]= 0;
+            pixels[i][2]= 255;
+            pixels[i][3]= 255;
+        }
+        return;
+    }
+
+    int q0[4], q1[4];
+    for(int c= 0; c < 4; c++)
+    {
+        q0[c]= bits.read(7);
+        q1[c]= bits.read(7);
+    }
+    int p0= bits.read(1);
+    int p1= bits.read(1);
+
+    int palette[16][4];
+    bc7_palette(q0, p0, q1, p1, palette);
+    for(int i= 0; i < 16; i++)
+    {
+        int index= bits.read(i == 0 ? 3 : 4);
+        for(int c= 0; c < 4; c++)
+            pixels[i][c]= (unsigned char) palette[index][c];
+    }
+}
+
+
+static
+int block_size( const BCFormat format )
+{
+    return (format == BC1 || format == BC4) ? 8 : 16;
+}
+
+size_t CompressedImage::size( ) const
+{
+    size_t size= 0;
+    for(unsigned i= 0; i < levels.size(); i++)
+        size= size + levels[i].data.size();
+    return size;
+}
+
+CompressedLevel compress_level( const ImageData& image, const BCFormat format, const int quality )
+{
+    CompressedLevel level;
+    level.width= image.width;
+    level.height= image.height;
+    if(image.data.empty() || image.size != 1 || image.channels < 1 || image.channels > 4)
+    {
+        printf("[error] compress_level( ): 8 bits images only...\n");
+        return level;
+    }
+
+    int bw= (image.width + 3) / 4;
+    int bh= (image.height + 3) / 4;
+    int size= block_size(format);
+    level.data.resize(size_t(bw) * bh * size);
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int by= 0; by < bh; by++)
+    {
+        Block block;
+        for(int bx= 0; bx < bw; bx++)
+        {
+            fetch_block(image, bx, by, block);
+
+            unsigned char *out= level.data.data() + (size_t(by) * bw + bx) * size;
+            switch(format)
+            {
+                case BC1: encode_bc1(block, quality, out); break;
+                case BC3: encode_bc4(block, 3, quality, out); encode_bc1(block, quality, out + 8); break;
+                case BC4: encode_bc4(block, 0, quality, out); break;
+                case BC5: encode_bc4(block, 0, quality, out); encode_bc4(block, 1, quality, out + 8); break;
+                case BC7: encode_bc7(block, quality, out); break;
+            }
+        }
+    }
+
+    return level;
+}
+
+CompressedImage compress_image( const ImageData& image, const BCFormat format, const int quality, const bool srgb )
+{
+    CompressedImage compressed;
+    compressed.format= format;
+    compressed.srgb= srgb && format != BC4 && format != BC5;
+
+    std::vector<ImageData> levels= mipmap_levels(image, MIPMAP_BOX, compressed.srgb);
+    for(unsigned i= 0; i < levels.size(); i++)
+    {
+        compressed.levels.push_back(compress_level(levels[i], format, quality));
+        if(compressed.levels.back().data.empty())
+            return CompressedImage();
+    }
+
+    return compressed;
+}
+
+ImageData decompress_level( const CompressedLevel& level, const BCFormat format )
+{
+    int bw= (level.width + 3) / 4;
+    int bh= (level.height + 3) / 4;
+    int size= block_size(format);
+    if(level.data.size() != size_t(bw) * bh * size)
+    {
+        printf("[error] decompress_level( ): %dx%d, %d bytes...\n", level.width, level.height, int(level.data.size()));
+        return ImageData();
+    }
+
+    ImageData image(level.width, level.height, 4);
+#pragma omp parallel for schedule(static)
+    for(int by= 0; by < bh; by++)
+    for(int bx= 0; bx < bw; bx++)
+    {
+        unsigned char pixels[16][4];
+        for(int i= 0; i < 16; i++)
+        {
+            pixels[i][0]= 0;
+            pixels[i][1]= 0;
+            pixels[i][2]= 0;
+            pixels[i][3]= 255;
+        }
+
+        const unsigned char *in= level.data.data() + (size_t(by) * bw + bx) * size;
+        switch(format)
+        {
+            case BC1: decode_bc1(in, false, pixels); break;
+            case BC3: decode_bc1(in + 8, true, pixels); decode_bc4(in, 3, pixels); break;
+            case BC4: decode_bc4(in, 0, pixels); break;
+            case BC5: decode_bc4(in, 0, pixels); decode_bc4(in + 8, 1, pixels); break;
+            case BC7: decode_bc7(in, pixels); break;
+        }
+
+        for(int i= 0; i < 16; i++)
+        {
+            int x= bx * 4 + i % 4;
+            int y= by * 4 + i / 4;
+            if(x < image.width && y < image.height)
+                memcpy(image.data.data() + (size_t(y) * image.width + x) * 4, pixels[i], 4);
+        }
+    }
+
+    return image;
+}
+
+float psnr( const ImageData& a, const ImageData& b, const int channels )
+{
+    if(a.width != b.width || a.height != b.height || a.size != 1 || b.size != 1)
+    {
+        printf("[error] psnr( ): %dx%d / %dx%d images...\n", a.width, a.height, b.width, b.height);
+        return 0;
+    }
+
+    double error= 0;
+    size_t n= size_t(a.width) * a.height;
+    for(size_t i= 0; i < n; i++)
+    for(int c= 0; c < channels; c++)
+    {
+        double d= texel(a, i, c) - texel(b, i, c);
+        error= error + d * d;
+    }
+
+    if(error == 0)
+        return 100;
+
+    double mse= error / (double(n) * channels);
+    return float(10 * std::log10(255.0 * 255.0 / mse));
+}
+
+
+struct CompressedHeader
+{
+    char magic[4];
+    uint32_t format;
+    uint32_t srgb;
+    uint32_t levels;
+};
+
+struct CompressedLevelHeader
+{
+    int32_t width;
+    int32_t height;
+    uint32_t size;
+};
+
+int write_compressed_image( const CompressedImage& image, const char *filename )
+{
+    FILE *out= fopen(filename, "wb");
+    if(out == NULL)
+    {
+        printf("[error] writing compressed texture '%s'...\n", filename);
+        return -1;
+    }
+
+    CompressedHeader header= { { 'g', 'k', 'b', 'c' }, uint32_t(image.format), uint32_t(image.srgb), uint32_t(image.levels.size()) };
+    fwrite(&header, sizeof(header), 1, out);
+    for(unsigned i= 0; i < image.levels.size(); i++)
+    {
+        CompressedLevelHeader level= { image.levels[i].width, image.levels[i].height, uint32_t(image.levels[i].data.size()) };
+        fwrite(&level, sizeof(level), 1, out);
+        fwrite(image.levels[i].data.data(), 1, level.size, out);
+    }
+
+    fclose(out);
+    return 0;
+}
+
+// charge une texture compressee, sans message d'erreur, cf le cache de read_compressed_texture( )
+static
+bool read_compressed( const char *filename, CompressedImage& image )
+{
+    FILE *in= fopen(filename, "rb");
+    if(in == NULL)
+        return false;
+
+    image= CompressedImage();
+    CompressedHeader header;
+    bool valid= (fread(&header, sizeof(header), 1, in) == 1 && memcmp(header.magic, "gkbc", 4) == 0 && header.format <= BC7 && header.levels < 32);
+    if(valid)
+    {
+        image.format= BCFormat(header.format);
+        image.srgb= (header.srgb != 0);
+        for(unsigned i= 0; valid && i < header.levels; i++)
+        {
+            CompressedLevelHeader level;
+            valid= (fread(&level, sizeof(level), 1, in) == 1);
+            valid= valid && level.width > 0 && level.height > 0
+                && level.size == uint32_t((level.width + 3) / 4) * uint32_t((level.height + 3) / 4) * uint32_t(block_size(image.format));
+            if(valid)
+            {
+                image.levels.push_back( { level.width, level.height, std::vector<unsigned char>(level.size) } );
+                valid= (fread(image.levels.back().data.data(), 1, level.size, in) == level.size);
+            }
+        }
+    }
+    fclose(in);
+
+    if(!valid)
+        image= CompressedImage();
+    return valid;
+}
+
+CompressedImage read_compressed_image( const char *filename )
+{
+    CompressedImage image;
+    if(!read_compressed(filename, image))
+        printf("[error] loading compressed texture '%s'...\n", filename);
+    return image;
+}
+
+
+GLenum compressed_texel_type( const BCFormat format, const bool srgb )
+{
+    switch(format)
+    {
+        case BC1: return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BC4: return GL_COMPRESSED_RED_RGTC1;
+        case BC5: return GL_COMPRESSED_RG_RGTC2;
+        case BC7: return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return 0;
+}
+
+bool compressed_format( const GLenum texel_type, BCFormat& format, bool& srgb )
+{
+    const BCFormat formats[]= { BC1, BC3, BC4, BC5, BC7 };
+    for(int i= 0; i < 5; i++)
+    for(int s= 0; s < 2; s++)
+        if(compressed_texel_type(formats[i], s == 1) == texel_type)
+        {
+            format= formats[i];
+            srgb= (s == 1) && format != BC4 && format != BC5;
+            return true;
+        }
+
+    return false;
+}
+
+static
+bool compressed_supported( const BCFormat format )
+{
+#ifndef NO_GLEW
+    if(format == BC1 || format == BC3)
+        return GLEW_EXT_texture_compression_s3tc;
+    if(format == BC7)
+        return GLEW_ARB_texture_compression_bptc;
+    return true;
+#else
+    // macos, openGL 4.1
+    return format != BC7;
+#endif
+}
+
+GLuint make_texture( const int unit, const CompressedImage& image )
+{
+    if(image.levels.empty())
+        return 0;
+
+    if(!compressed_supported(image.format))
+    {
+        printf("[error] compressed texture format BC%d not supported...\n", (image.format == BC7) ? 7 : (image.format == BC1) ? 1 : int(image.format) + 2);
+        return 0;
+    }
+
+    // cree la texture openGL
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    // fixe les parametres de filtrage par defaut
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, int(image.levels.size()) -1);
+
+    // transfere les blocs compresses de chaque niveau
+    GLenum texel_type= compressed_texel_type(image.format, image.srgb);
+    for(int i= 0; i < int(image.levels.size()); i++)
+        glCompressedTexImage2D(GL_TEXTURE_2D, i, texel_type,
+            image.levels[i].width, image.levels[i].height, 0,
+            GLsizei(image.levels[i].data.size()), image.levels[i].data.data());
+
+    return texture;
+}
+
+
+// fnv-1a 64 bits
+static
+uint64_t hash( uint64_t h, const void *data, const size_t size )
+{
+    for(size_t i= 0; i < size; i++)
+    {
+        h= h ^ ((const unsigned char *) data)[i];
+        h= h * 1099511628211u;
+    }
+
+    return h;
+}
+
+GLuint read_compressed_texture( const int unit, const char *filename, const BCFormat format, const int quality, const bool srgb )
+{
+    // identifie le fichier et les parametres de compression
+    struct stat info;
+    if(stat(filename, &info) < 0)
+    {
+        printf("[error] loading texture '%s'...\n", filename);
+        return 0;
+    }
+
+    bool use_srgb= srgb && format != BC4 && format != BC5;
+    uint64_t key= 14695981039346656037u;
+    key= hash(key, filename, strlen(filename) +1);
+
+    const int64_t params[]= { int64_t(info.st_size), int64_t(info.st_mtime), int64_t(format), int64_t(quality), int64_t(use_srgb) };
+    key= hash(key, params, sizeof(params));
+
+    char cache[64];
+    sprintf(cache, "cache/texture_%016llx.bc", (unsigned long long) key);
+
+    CompressedImage image;
+    if(!read_compressed(cache, image))
+    {
+        ImageData data= read_image_data(filename);
+        if(data.data.empty())
+            return 0;
+
+        image= compress_image(data, format, quality, use_srgb);
+        if(image.levels.empty())
+            return 0;
+
+    #ifdef _WIN32
+        _mkdir("cache");
+    #else
+        mkdir("cache", 0755);
+    #endif
+        write_compressed_image(image, cache);
+    }
+
+    return make_texture(unit, image);
+}
@@ -0,0 +1,107 @@
+
+#ifndef _TEXTURE_BC_H
+#define _TEXTURE_BC_H
+
+#include <vector>
+
+#include "glcore.h"
+#include "image_io.h"
+
+
+//! \addtogroup openGL
+///@{
+
+//! \file
+/*! compression des textures sur le cpu, formats BC1 / BC3 / BC4 / BC5 / BC7, et cache des mipmaps compresses.
+
+    les blocs de 4x4 pixels sont compresses en parallele (openmp, si disponible), les distances entre pixels et couleurs sont
+    calculees 4 pixels a la fois (sse, si disponible).
+
+    | format | canaux | octets / pixel | rgba8 / format |
+    |--------|--------|----------------|----------------|
+    | BC1    | rgb    | 0.5            | 8x             |
+    | BC3    | rgba   | 1              | 4x             |
+    | BC4    | r      | 0.5            | 2x (8x rgba)   |
+    | BC5    | rg     | 1              | 2x (4x rgba)   |
+    | BC7    | rgba   | 1              | 4x             |
+
+    exemple :
+\code
+GLuint texture= read_texture(0, "data/monde.jpg", GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM);
+// ou
+ImageData image= read_image_data("data/monde.jpg");
+CompressedImage bc= compress_image(image, BC7);
+printf("psnr %.2fdB\n", psnr(image, decompress_level(bc.levels[0], bc.format), 4));
+GLuint texture= make_texture(0, bc);
+\endcode
+ */
+
+//! formats de compression.
+enum BCFormat
+{
+    BC1= 0,     //!< rgb, 2 couleurs 565 + 4 interpolations par bloc.
+    BC3,        //!< rgba, BC1 pour les couleurs + BC4 pour l'alpha.
+    BC4,        //!< r, 2 valeurs 8 bits + 8 interpolations par bloc.
+    BC5,        //!< rg, 2 blocs BC4, pour les normal maps, par exemple.
+    BC7         //!< rgba, mode 6 uniquement : 2 couleurs rgba 7777 + 1 bit, 16 interpolations par bloc.
+};
+
+//! mipmap compresse.
+struct CompressedLevel
+{
+    int width;
+    int height;
+    std::vector<unsigned char> data;
+};
+
+//! texture compressee et ses mipmaps, cf compress_image( ).
+struct CompressedImage
+{
+    CompressedImage( ) : levels(), format(BC1), srgb(false) {}
+
+    //! renvoie la taille de tous les niveaux, en octets.
+    size_t size( ) const;
+
+    std::vector<CompressedLevel> levels;
+    BCFormat format;
+    bool srgb;
+};
+
+/*! compresse une image 8 bits de 1 a 4 canaux et ses mipmaps, cf mipmap_levels( ).
+    \param quality 0 rapide, 1 par defaut, 2 plus lent et plus precis.
+    \param srgb les couleurs sont codees en sRGB, les mipmaps sont filtres dans l'espace lineaire. sans effet pour BC4 et BC5.
+ */
+CompressedImage compress_image( const ImageData& image, const BCFormat format, const int quality= 1, const bool srgb= true );
+
+//! compresse une image 8 bits de 1 a 4 canaux, sans mipmaps.
+CompressedLevel compress_level( const ImageData& image, const BCFormat format, const int quality= 1 );
+
+//! decompresse un niveau, renvoie une image rgba 8 bits. ne decode que les blocs produits par compress_level( ).
+ImageData decompress_level( const CompressedLevel& level, const BCFormat format );
+
+//! renvoie le psnr, en dB, entre 2 images 8 bits de memes dimensions, sur les channels premiers canaux.
+float psnr( const ImageData& a, const ImageData& b, const int channels );
+
+//! enregistre une texture compressee. renvoie -1 en cas d'erreur.
+int write_compressed_image( const CompressedImage& image, const char *filename );
+
+//! charge une texture compressee. renvoie une image sans niveaux en cas d'erreur.
+CompressedImage read_compressed_image( const char *filename );
+
+//! renvoie le format openGL correspondant, GL_COMPRESSED_RGB_S3TC_DXT1_EXT pour BC1, par exemple.
+GLenum compressed_texel_type( const BCFormat format, const bool srgb );
+
+//! renvoie vrai si texel_type est un format compresse connu, et le format BC correspondant.
+bool compressed_format( const GLenum texel_type, BCFormat& format, bool& srgb );
+
+//! cree une texture a partir d'une image compressee et de ses mipmaps. a detruire avec glDeleteTextures( ).
+GLuint make_texture( const int unit, const CompressedImage& image );
+
+/*! cree une texture compressee a partir d'un fichier. a detruire avec glDeleteTextures( ).
+    l'image compressee est conservee dans le repertoire "cache", et rechargee directement tant que le fichier n'est pas modifie.
+    cf read_texture( unit, filename, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM ), par exemple.
+ */
+GLuint read_compressed_texture( const int unit, const char *filename, const BCFormat format, const int quality= 1, const bool srgb= true );
+
+///@}
+#endif
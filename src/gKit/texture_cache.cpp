@@ -0,0 +1,566 @@
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+    #include <direct.h>
+#endif
+
+#include "texture_cache.h"
+#include "image_io.h"
+#include "image_hdr.h"
+#include "mipmap.h"
+
+
+// fichier : entete, description des mipmaps, puis les tuiles de chaque mipmap, ligne par ligne
+struct TiledHeader
+{
+    char magic[4];
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    uint32_t tile_size;
+    uint32_t hdr;
+};
+
+struct TiledLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;        // position de la premiere tuile dans le fichier
+};
+
+struct TiledTexture
+{
+    TiledTexture( ) : file(nullptr), lock(), id(-1), width(0), height(0), tile_size(0), texel_size(0), hdr(false), levels() {}
+    ~TiledTexture( ) { if(file) fclose(file); }
+
+    int tiles_x( const int level ) const { return (levels[level].width + tile_size -1) / tile_size; }
+    int tiles_y( const int level ) const { return (levels[level].height + tile_size -1) / tile_size; }
+    size_t tile_bytes( ) const { return size_t(tile_size) * tile_size * texel_size; }
+
+    FILE *file;
+    std::mutex lock;        // un seul thread lit le fichier
+
+    int id;
+    int width;
+    int height;
+    int tile_size;
+    int texel_size;
+    bool hdr;
+    std::vector<TiledLevel> levels;
+};
+
+struct TextureTile
+{
+    std::vector<unsigned char> data;
+};
+
+// partie du cache partage, tuiles les plus recentes en tete de la liste
+struct TextureCacheShard
+{
+    typedef std::list< std::pair<uint64_t, std::shared_ptr<const TextureTile>> > List;
+
+    TextureCacheShard( ) : lock(), lru(), tiles(), bytes(0), hits(0), misses(0), evictions(0) {}
+
+    std::mutex lock;
+    List lru;
+    std::unordered_map<uint64_t, List::iterator> tiles;
+    size_t bytes;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+};
+
+
+// identifiant d'une tuile : texture, mipmap, position
+static inline
+uint64_t tile_key( const int id, const int level, const int tx, const int ty )
+{
+    return (uint64_t(id) << 40) | (uint64_t(level) << 32) | (uint64_t(ty) << 16) | uint64_t(tx);
+}
+
+// melange les bits de la cle, cf splitmix64
+static inline
+uint64_t mix( uint64_t key )
+{
+    key= (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9u;
+    key= (key ^ (key >> 27)) * 0x94d049bb133111ebu;
+    return key ^ (key >> 31);
+}
+
+// fnv-1a 64 bits
+static
+uint64_t hash( uint64_t h, const void *data, const size_t size )
+{
+    for(size_t i= 0; i < size; i++)
+    {
+        h= h ^ ((const unsigned char *) data)[i];
+        h= h * 1099511628211u;
+    }
+
+    return h;
+}
+
+static
+int seek( FILE *file, const uint64_t offset )
+{
+#ifdef _WIN32
+    return _fseeki64(file, offset, SEEK_SET);
+#else
+    return fseeko(file, off_t(offset), SEEK_SET);
+#endif
+}
+
+
+int write_tiled_texture( const char *filename, const char *tiled_filename, const int tile_size )
+{
+    // construit les mipmaps, cf mipmap_levels( )
+    bool hdr= is_hdr_image(filename);
+    std::vector<ImageData> ldr_levels;
+    std::vector<Image> hdr_levels;
+    int width, height, levels;
+    if(hdr)
+    {
+        Image image= read_image_hdr(filename);
+        if(image == Image::error())
+            return -1;
+
+        hdr_levels= mipmap_levels(image, MIPMAP_BOX);
+        width= image.width();
+        height= image.height();
+        levels= int(hdr_levels.size());
+    }
+    else
+    {
+        ImageData image= read_image_data(filename);
+        if(image.data.empty() || image.size != 1)
+        {
+            printf("[error] tiled texture '%s': 8 bits images only...\n", filename);
+            return -1;
+        }
+
+        ldr_levels= mipmap_levels(image, MIPMAP_BOX, true);
+        width= image.width;
+        height= image.height;
+        levels= int(ldr_levels.size());
+    }
+
+    FILE *out= fopen(tiled_filename, "wb");
+    if(out == NULL)
+    {
+        printf("[error] writing tiled texture '%s'...\n", tiled_filename);
+        return -1;
+    }
+
+    TiledHeader header= { { 'g', 'k', 't', 't' }, uint32_t(width), uint32_t(height), uint32_t(levels), uint32_t(tile_size), uint32_t(hdr) };
+    fwrite(&header, sizeof(header), 1, out);
+
+    int texel_size= hdr ? int(sizeof(Color)) : 4;
+    size_t tile_bytes= size_t(tile_size) * tile_size * texel_size;
+    uint64_t offset= sizeof(TiledHeader) + levels * sizeof(TiledLevel);
+    for(int l= 0; l < levels; l++)
+    {
+        TiledLevel level= { 0, 0, offset };
+        level.width= uint32_t(hdr ? hdr_levels[l].width() : ldr_levels[l].width);
+        level.height= uint32_t(hdr ? hdr_levels[l].height() : ldr_levels[l].height);
+        fwrite(&level, sizeof(level), 1, out);
+
+        offset= offset + uint64_t((level.width + tile_size -1) / tile_size) * ((level.height + tile_size -1) / tile_size) * tile_bytes;
+    }
+
+    std::vector<unsigned char> tile(tile_bytes);
+    for(int l= 0; l < levels; l++)
+    {
+        int w= hdr ? hdr_levels[l].width() : ldr_levels[l].width;
+        int h= hdr ? hdr_levels[l].height() : ldr_levels[l].height;
+        for(int ty= 0; ty < (h + tile_size -1) / tile_size; ty++)
+        for(int tx= 0; tx < (w + tile_size -1) / tile_size; tx++)
+        {
+            for(int y= 0; y < tile_size; y++)
+            for(int x= 0; x < tile_size; x++)
+            {
+                // les tuiles du bord sont completees, mais ne sont jamais lues
+                int px= std::min(tx * tile_size + x, w -1);
+                int py= std::min(ty * tile_size + y, h -1);
+                unsigned char *texel= tile.data() + (size_t(y) * tile_size + x) * texel_size;
+                if(hdr)
+                {
+                    Color color= hdr_levels[l](px, py);
+                    memcpy(texel, &color, sizeof(Color));
+                }
+                else
+                {
+                    // rgba, comme pour une texture openGL
+                    const ImageData& level= ldr_levels[l];
+                    const unsigned char *p= level.data.data() + (size_t(py) * w + px) * level.channels;
+                    texel[0]= p[0];
+                    texel[1]= (level.channels == 1) ? p[0] : p[1];
+                    texel[2]= (level.channels > 2) ? p[2] : (level.channels == 1) ? p[0] : 0;
+                    texel[3]= (level.channels == 4) ? p[3] : 255;
+                }
+            }
+
+            fwrite(tile.data(), 1, tile_bytes, out);
+        }
+    }
+
+    bool error= ferror(out);
+    fclose(out);
+    if(error)
+    {
+        printf("[error] writing tiled texture '%s'...\n", tiled_filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+// charge la description des mipmaps, les tuiles seront lues a la demande
+static
+bool read_tiled_texture( const char *filename, TiledTexture& texture )
+{
+    FILE *in= fopen(filename, "rb");
+    if(in == NULL)
+        return false;
+
+    TiledHeader header;
+    bool valid= (fread(&header, sizeof(header), 1, in) == 1 && memcmp(header.magic, "gktt", 4) == 0
+        && header.levels > 0 && header.levels < 32 && header.tile_size > 0);
+    if(valid)
+    {
+        texture.levels.resize(header.levels);
+        valid= (fread(texture.levels.data(), sizeof(TiledLevel), header.levels, in) == header.levels);
+    }
+
+    if(!valid)
+    {
+        fclose(in);
+        return false;
+    }
+
+    texture.file= in;
+    texture.width= int(header.width);
+    texture.height= int(header.height);
+    texture.tile_size= int(header.tile_size);
+    texture.hdr= (header.hdr != 0);
+    texture.texel_size= texture.hdr ? int(sizeof(Color)) : 4;
+    return true;
+}
+
+
+TextureCache::TextureCache( const size_t max_size, const int shards )
+    : m_textures(), m_shards(), m_max_size(max_size), m_shard_size(0), m_bytes(0), m_peak_bytes(0), m_lookups(0), m_local_hits(0)
+{
+    int count= std::max(1, shards);
+    for(int i= 0; i < count; i++)
+        m_shards.push_back( std::unique_ptr<TextureCacheShard>(new TextureCacheShard) );
+
+    m_shard_size= max_size / count;
+}
+
+TextureCache::~TextureCache( ) {}
+
+void TextureCache::fit_shards( const size_t tile_bytes )
+{
+    // chaque partie doit pouvoir contenir au moins une tuile, sinon tile( ) depasse la taille du cache
+    if(tile_bytes <= m_shard_size)
+        return;
+
+    size_t count= std::max(size_t(1), std::min(m_shards.size(), m_max_size / tile_bytes));
+    m_shard_size= std::max(m_max_size / count, tile_bytes);
+    if(m_max_size < tile_bytes)
+        printf("[warning] TextureCache: %dKB, tiles %dKB...\n", int(m_max_size / 1024), int(tile_bytes / 1024));
+
+    // vide le cache, les tuiles ne sont plus dans les memes parties. conserve les statistiques
+    for(size_t i= 0; i < m_shards.size(); i++)
+    {
+        TextureCacheShard& shard= *m_shards[i];
+        std::lock_guard<std::mutex> guard(shard.lock);
+        if(i >= count)
+        {
+            m_shards[0]->hits+= shard.hits;
+            m_shards[0]->misses+= shard.misses;
+            m_shards[0]->evictions+= shard.evictions;
+        }
+        shard.lru.clear();
+        shard.tiles.clear();
+        shard.bytes= 0;
+    }
+    m_shards.resize(count);
+    m_bytes= 0;
+}
+
+int TextureCache::texture( const char *filename, const int tile_size )
+{
+    // identifie le fichier et la taille des tuiles
+    struct stat info;
+    if(stat(filename, &info) < 0)
+    {
+        printf("[error] loading texture '%s'...\n", filename);
+        return -1;
+    }
+
+    uint64_t key= 14695981039346656037u;
+    key= hash(key, filename, strlen(filename) +1);
+
+    const int64_t params[]= { int64_t(info.st_size), int64_t(info.st_mtime), int64_t(tile_size) };
+    key= hash(key, params, sizeof(params));
+
+    char tiled[64];
+    sprintf(tiled, "cache/texture_%016llx.tiles", (unsigned long long) key);
+
+    std::unique_ptr<TiledTexture> texture(new TiledTexture);
+    if(!read_tiled_texture(tiled, *texture))
+    {
+        // premiere utilisation, convertit l'image
+    #ifdef _WIN32
+        _mkdir("cache");
+    #else
+        mkdir("cache", 0755);
+    #endif
+        if(write_tiled_texture(filename, tiled, tile_size) < 0)
+            return -1;
+
+        if(!read_tiled_texture(tiled, *texture))
+        {
+            printf("[error] loading tiled texture '%s'...\n", tiled);
+            return -1;
+        }
+    }
+
+    fit_shards(texture->tile_bytes());
+
+    texture->id= int(m_textures.size());
+    m_textures.push_back(std::move(texture));
+    return int(m_textures.size()) -1;
+}
+
+int TextureCache::width( const int id ) const
+{
+    return m_textures[id]->width;
+}
+
+int TextureCache::height( const int id ) const
+{
+    return m_textures[id]->height;
+}
+
+size_t TextureCache::size( const int id ) const
+{
+    const TiledTexture& texture= *m_textures[id];
+
+    size_t size= 0;
+    for(int l= 0; l < int(texture.levels.size()); l++)
+        size= size + size_t(texture.levels[l].width) * texture.levels[l].height * texture.texel_size;
+    return size;
+}
+
+TextureCacheStats TextureCache::stats( ) const
+{
+    TextureCacheStats stats= { };
+    stats.lookups= m_lookups;
+    stats.local_hits= m_local_hits;
+    stats.bytes= m_bytes;
+    stats.peak_bytes= m_peak_bytes;
+    for(unsigned i= 0; i < m_shards.size(); i++)
+    {
+        std::lock_guard<std::mutex> guard(m_shards[i]->lock);
+        stats.hits+= m_shards[i]->hits;
+        stats.misses+= m_shards[i]->misses;
+        stats.evictions+= m_shards[i]->evictions;
+    }
+
+    return stats;
+}
+
+std::shared_ptr<const TextureTile> TextureCache::read_tile( const uint64_t key )
+{
+    TiledTexture& texture= *m_textures[key >> 40];
+    int level= int((key >> 32) & 0xff);
+    int ty= int((key >> 16) & 0xffff);
+    int tx= int(key & 0xffff);
+
+    std::shared_ptr<TextureTile> tile= std::make_shared<TextureTile>();
+    tile->data.resize(texture.tile_bytes());
+
+    uint64_t offset= texture.levels[level].offset + (uint64_t(ty) * texture.tiles_x(level) + tx) * texture.tile_bytes();
+    {
+        std::lock_guard<std::mutex> guard(texture.lock);
+        if(seek(texture.file, offset) != 0 || fread(tile->data.data(), 1, tile->data.size(), texture.file) != tile->data.size())
+            printf("[error] reading tile %d %d, level %d...\n", tx, ty, level);
+    }
+
+    return tile;
+}
+
+std::shared_ptr<const TextureTile> TextureCache::tile( const uint64_t key )
+{
+    TextureCacheShard& shard= *m_shards[mix(key) % m_shards.size()];
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        auto found= shard.tiles.find(key);
+        if(found != shard.tiles.end())
+        {
+            // tuile la plus recente, en tete de la liste
+            shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+            shard.hits++;
+            return found->second->second;
+        }
+    }
+
+    // lit la tuile sans bloquer les autres threads
+    std::shared_ptr<const TextureTile> tile= read_tile(key);
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.misses++;
+
+    // un autre thread a pu charger la meme tuile...
+    auto found= shard.tiles.find(key);
+    if(found != shard.tiles.end())
+        return found->second->second;
+
+    // libere les tuiles les plus anciennes, les caches des threads peuvent encore les utiliser
+    size_t size= tile->data.size();
+    while(!shard.lru.empty() && shard.bytes + size > m_shard_size)
+    {
+        size_t evicted= shard.lru.back().second->data.size();
+        shard.tiles.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+        shard.bytes-= evicted;
+        shard.evictions++;
+        m_bytes-= evicted;
+    }
+
+    shard.lru.emplace_front(key, tile);
+    shard.tiles[key]= shard.lru.begin();
+    shard.bytes+= size;
+
+    size_t bytes= m_bytes.fetch_add(size) + size;
+    size_t peak= m_peak_bytes;
+    while(bytes > peak && !m_peak_bytes.compare_exchange_weak(peak, bytes))
+        {}
+
+    return tile;
+}
+
+
+// conversion sRGB vers lineaire des texels 8 bits
+struct SRGBTable
+{
+    SRGBTable( )
+    {
+        for(int i= 0; i < 256; i++)
+        {
+            float v= float(i) / 255;
+            values[i]= (v <= 0.04045f) ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+        }
+    }
+
+    float values[256];
+};
+
+static const SRGBTable srgb_table;
+
+
+TextureCacheThread::TextureCacheThread( TextureCache& cache ) : m_cache(cache), m_keys(), m_tiles(), m_lookups(0), m_local_hits(0)
+{
+    // aucune cle valide n'utilise le mipmap 255
+    for(int i= 0; i < LOCAL_TILES; i++)
+        m_keys[i]= ~uint64_t(0);
+}
+
+TextureCacheThread::~TextureCacheThread( )
+{
+    m_cache.m_lookups+= m_lookups;
+    m_cache.m_local_hits+= m_local_hits;
+}
+
+const TextureTile *TextureCacheThread::tile( const uint64_t key )
+{
+    int slot= int(mix(key) & (LOCAL_TILES -1));
+    if(m_keys[slot] == key)
+    {
+        m_local_hits++;
+        return m_tiles[slot].get();
+    }
+
+    m_tiles[slot]= m_cache.tile(key);
+    m_keys[slot]= key;
+    return m_tiles[slot].get();
+}
+
+Color TextureCacheThread::fetch( const TiledTexture& texture, const int level, const int x, const int y )
+{
+    // repete la texture
+    int w= int(texture.levels[level].width);
+    int h= int(texture.levels[level].height);
+    int px= x % w; if(px < 0) px+= w;
+    int py= y % h; if(py < 0) py+= h;
+
+    const TextureTile *t= tile(tile_key(texture.id, level, px / texture.tile_size, py / texture.tile_size));
+    const unsigned char *texel= t->data.data() + (size_t(py % texture.tile_size) * texture.tile_size + px % texture.tile_size) * texture.texel_size;
+    if(texture.hdr)
+    {
+        Color color;
+        memcpy(&color, texel, sizeof(Color));
+        return color;
+    }
+
+    return Color(srgb_table.values[texel[0]], srgb_table.values[texel[1]], srgb_table.values[texel[2]], float(texel[3]) / 255);
+}
+
+Color TextureCacheThread::bilinear( const TiledTexture& texture, const int level, const vec2& uv )
+{
+    float x= uv.x * texture.levels[level].width - 0.5f;
+    float y= uv.y * texture.levels[level].height - 0.5f;
+    float fx= std::floor(x);
+    float fy= std::floor(y);
+    int x0= int(fx);
+    int y0= int(fy);
+    float u= x - fx;
+    float v= y - fy;
+
+    return (1 - u) * (1 - v) * fetch(texture, level, x0, y0) + u * (1 - v) * fetch(texture, level, x0 +1, y0)
+        + (1 - u) * v * fetch(texture, level, x0, y0 +1) + u * v * fetch(texture, level, x0 +1, y0 +1);
+}
+
+Color TextureCacheThread::lookup( const int id, const vec2& uv, const vec2& duvdx, const vec2& duvdy )
+{
+    m_lookups++;
+    const TiledTexture& texture= *m_cache.m_textures[id];
+
+    // empreinte du pixel dans la texture, en texels du mipmap 0
+    float dx= std::sqrt(duvdx.x * texture.width * duvdx.x * texture.width + duvdx.y * texture.height * duvdx.y * texture.height);
+    float dy= std::sqrt(duvdy.x * texture.width * duvdy.x * texture.width + duvdy.y * texture.height * duvdy.y * texture.height);
+    float footprint= std::max(dx, dy);
+
+    // filtre trilineaire, entre les 2 mipmaps les plus proches de l'empreinte
+    int levels= int(texture.levels.size());
+    float lod= (footprint > 1) ? std::min(std::log2(footprint), float(levels -1)) : 0;
+    int level= int(lod);
+    float t= lod - level;
+
+    Color color= bilinear(texture, level, uv);
+    if(t > 0 && level +1 < levels)
+        color= (1 - t) * color + t * bilinear(texture, level +1, uv);
+    return color;
+}
+
+Color TextureCacheThread::texel( const int id, const vec2& uv, const int level )
+{
+    m_lookups++;
+    const TiledTexture& texture= *m_cache.m_textures[id];
+
+    int l= std::min(level, int(texture.levels.size()) -1);
+    return fetch(texture, l, int(std::floor(uv.x * texture.levels[l].width)), int(std::floor(uv.y * texture.levels[l].height)));
+}
@@ -0,0 +1,145 @@
+
+#ifndef _TEXTURE_CACHE_H
+#define _TEXTURE_CACHE_H
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "vec.h"
+#include "color.h"
+
+
+//! \addtogroup image utilitaires pour manipuler des images
+///@{
+
+//! \file
+/*! cache de textures pour le lancer de rayons, dans l'esprit de TextureSystem d'OpenImageIO.
+
+    chaque image est convertie une seule fois en pyramide de mipmaps, decoupee en tuiles de 64x64 texels, dans le repertoire "cache".
+    les tuiles sont chargees a la demande dans un cache partage de taille fixe, quelle que soit la taille des textures. le cache est
+    decoupe en plusieurs parties independantes (LRU) pour limiter les attentes entre threads. chaque thread conserve aussi quelques tuiles
+    recentes, sans synchronisation, cf TextureCacheThread.
+
+    les images 8 bits sont conservees en sRGB, 4 octets par texel, les images .hdr en float, 16 octets par texel.
+    lookup( ) renvoie toujours une couleur lineaire, filtree sur les 2 mipmaps les plus proches de l'empreinte du pixel.
+
+    exemple :
+\code
+TextureCache cache(256 * 1024 * 1024);          // 256Mo
+int id= cache.texture("data/monde.jpg");        // a ouvrir avant le rendu
+
+#pragma omp parallel
+{
+    TextureCacheThread textures(cache);         // un par thread
+    #pragma omp for
+    for(...)
+    {
+        Color color= textures.lookup(id, uv, duvdx, duvdy);
+    }
+}
+\endcode
+ */
+
+/*! convertit une image .png / .jpg / .hdr en pyramide de mipmaps decoupee en tuiles de tile_size x tile_size texels.
+    renvoie -1 en cas d'erreur.
+ */
+int write_tiled_texture( const char *filename, const char *tiled_filename, const int tile_size= 64 );
+
+//! statistiques du cache.
+struct TextureCacheStats
+{
+    size_t lookups;     //!< nombre de lookup( ).
+    size_t local_hits;  //!< tuiles trouvees dans le cache d'un thread.
+    size_t hits;        //!< tuiles trouvees dans le cache partage.
+    size_t misses;      //!< tuiles lues dans les fichiers.
+    size_t evictions;   //!< tuiles supprimees du cache partage.
+    size_t bytes;       //!< taille actuelle du cache partage.
+    size_t peak_bytes;  //!< taille max du cache partage.
+};
+
+struct TiledTexture;
+struct TextureCacheShard;
+struct TextureTile;
+
+//! cache partage par les threads de rendu.
+class TextureCache
+{
+public:
+    /*! cree un cache de max_size octets, decoupe en shards parties.
+        le nombre de parties est reduit si une partie ne peut pas contenir une tuile, cf texture( ). le cache ne depasse pas max_size,
+        sauf si max_size est plus petit qu'une tuile. les caches des threads conservent en plus 64 tuiles chacun, au maximum.
+     */
+    TextureCache( const size_t max_size= 256 * 1024 * 1024, const int shards= 32 );
+    ~TextureCache( );
+
+    /*! ouvre une texture, la convertit si necessaire, et renvoie son identifiant, ou -1 en cas d'erreur.
+        a utiliser avant le rendu, pas pendant.
+     */
+    int texture( const char *filename, const int tile_size= 64 );
+
+    //! renvoie les dimensions d'une texture.
+    int width( const int id ) const;
+    int height( const int id ) const;
+    //! renvoie la taille de toute la pyramide d'une texture, en octets.
+    size_t size( const int id ) const;
+
+    //! renvoie les statistiques, les caches des threads les mettent a jour lorsqu'ils sont detruits.
+    TextureCacheStats stats( ) const;
+
+protected:
+    friend class TextureCacheThread;
+
+    //! renvoie une tuile, la charge si necessaire.
+    std::shared_ptr<const TextureTile> tile( const uint64_t key );
+    std::shared_ptr<const TextureTile> read_tile( const uint64_t key );
+    //! reduit le nombre de parties du cache, pour que chaque partie contienne au moins une tuile de tile_bytes octets.
+    void fit_shards( const size_t tile_bytes );
+
+    std::vector<std::unique_ptr<TiledTexture>> m_textures;
+    std::vector<std::unique_ptr<TextureCacheShard>> m_shards;
+    size_t m_max_size;
+    size_t m_shard_size;
+
+    std::atomic<size_t> m_bytes;
+    std::atomic<size_t> m_peak_bytes;
+    std::atomic<size_t> m_lookups;
+    std::atomic<size_t> m_local_hits;
+
+    TextureCache( const TextureCache& ) = delete;
+    TextureCache& operator= ( const TextureCache& ) = delete;
+};
+
+//! cache d'un thread de rendu, sans synchronisation. un par thread.
+class TextureCacheThread
+{
+public:
+    TextureCacheThread( TextureCache& cache );
+    ~TextureCacheThread( );
+
+    /*! renvoie la couleur lineaire de la texture id en uv, filtree sur l'empreinte du pixel.
+        duvdx et duvdy sont les variations des texcoords entre 2 pixels voisins, cf differentielles de rayons.
+        les texcoords sont repetees en dehors de [0 1].
+     */
+    Color lookup( const int id, const vec2& uv, const vec2& duvdx, const vec2& duvdy );
+
+    //! renvoie la couleur lineaire du texel le plus proche, sur le mipmap level.
+    Color texel( const int id, const vec2& uv, const int level= 0 );
+
+protected:
+    Color bilinear( const TiledTexture& texture, const int level, const vec2& uv );
+    Color fetch( const TiledTexture& texture, const int level, const int x, const int y );
+    const TextureTile *tile( const uint64_t key );
+
+    enum { LOCAL_TILES= 64 };
+
+    TextureCache& m_cache;
+    uint64_t m_keys[LOCAL_TILES];
+    std::shared_ptr<const TextureTile> m_tiles[LOCAL_TILES];
+    size_t m_lookups;
+    size_t m_local_hits;
+};
+
+///@}
+#endif
@@ -0,0 +1,124 @@
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "time_stats.h"
+
+
+void TimeStats::push( const float v )
+{
+    // fenetre circulaire
+    if(int(m_window.size()) < m_size)
+        m_window.push_back(v);
+    else
+        m_window[m_next]= v;
+    m_next= (m_next + 1) % m_size;
+
+    m_samples.push_back(v);
+    m_sorted_valid= false;
+}
+
+void TimeStats::clear( )
+{
+    m_window.clear();
+    m_samples.clear();
+    m_sorted.clear();
+    m_next= 0;
+    m_sorted_valid= false;
+}
+
+float TimeStats::min( ) const
+{
+    if(m_window.empty())
+        return 0;
+    return *std::min_element(m_window.begin(), m_window.end());
+}
+
+float TimeStats::max( ) const
+{
+    if(m_window.empty())
+        return 0;
+    return *std::max_element(m_window.begin(), m_window.end());
+}
+
+float TimeStats::avg( ) const
+{
+    if(m_window.empty())
+        return 0;
+
+    double sum= 0;
+    for(unsigned int i= 0; i < m_window.size(); i++)
+        sum+= m_window[i];
+    return float(sum / m_window.size());
+}
+
+float TimeStats::percentile( const float p ) const
+{
+    if(m_window.empty())
+        return 0;
+
+    // trie les mesures une seule fois par mesure ajoutee
+    if(!m_sorted_valid)
+    {
+        m_sorted= m_window;
+        std::sort(m_sorted.begin(), m_sorted.end());
+        m_sorted_valid= true;
+    }
+
+    // rang le plus proche
+    int n= int(m_sorted.size());
+    int rank= int(std::ceil(p / 100 * n)) -1;
+    rank= std::max(0, std::min(n -1, rank));
+    return m_sorted[rank];
+}
+
+
+static
+void print_stats( FILE *out, const char *name, const std::vector<float>& samples )
+{
+    // statistiques sur toutes les mesures
+    TimeStats stats(int(samples.size()));
+    for(unsigned int i= 0; i < samples.size(); i++)
+        stats.push(samples[i]);
+
+    fprintf(out, "\"%s\": { \"min\": %.4f, \"avg\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+        name, stats.min(), stats.avg(), stats.percentile(95), stats.percentile(99), stats.max());
+}
+
+int write_time_stats( const char *filename, const TimeStats& cpu_stats, const TimeStats& gpu_stats )
+{
+    FILE *out= fopen(filename, "wt");
+    if(out == nullptr)
+    {
+        printf("[error] writing stats '%s'...\n", filename);
+        return -1;
+    }
+
+    const std::vector<float>& cpu= cpu_stats.samples();
+    const std::vector<float>& gpu= gpu_stats.samples();
+
+    const char *ext= strrchr(filename, '.');
+    if(ext && strcmp(ext, ".json") == 0)
+    {
+        fprintf(out, "{\n\"frames\": %d,\n", int(cpu.size()));
+        print_stats(out, "cpu", cpu);
+        fprintf(out, ",\n");
+        print_stats(out, "gpu", gpu);
+        fprintf(out, ",\n\"samples\": [\n");
+        for(unsigned int i= 0; i < cpu.size(); i++)
+            fprintf(out, "  [ %.4f, %.4f ]%s\n", cpu[i], (i < gpu.size()) ? gpu[i] : 0.f, (i +1 < cpu.size()) ? "," : "");
+        fprintf(out, "]\n}\n");
+    }
+    else
+    {
+        fprintf(out, "frame,cpu_ms,gpu_ms\n");
+        for(unsigned int i= 0; i < cpu.size(); i++)
+            fprintf(out, "%u,%.4f,%.4f\n", i, cpu[i], (i < gpu.size()) ? gpu[i] : 0.f);
+    }
+
+    fclose(out);
+    printf("writing stats '%s'...\n", filename);
+    return 0;
+}
@@ -0,0 +1,63 @@
+
+#ifndef _TIME_STATS_H
+#define _TIME_STATS_H
+
+#include <vector>
+
+
+//! \addtogroup application utilitaires pour creer une application
+///@{
+
+//! \file
+/*! statistiques glissantes sur les dernieres mesures de temps : min, moyenne, max et percentiles.
+    toutes les mesures sont aussi conservees, cf samples( ), pour les exporter a la fin de l'execution.
+
+    exemple :
+\code
+TimeStats stats(256);
+// a chaque image
+stats.push(cpu_time);
+printf("avg %.2fms p95 %.2fms\n", stats.avg(), stats.percentile(95));
+\endcode
+ */
+class TimeStats
+{
+public:
+    //! constructeur, statistiques sur les window dernieres mesures.
+    TimeStats( const int window= 256 ) : m_window(), m_samples(), m_sorted(), m_next(0), m_size(window > 0 ? window : 1), m_sorted_valid(false) {}
+
+    //! ajoute une mesure.
+    void push( const float v );
+    //! supprime toutes les mesures.
+    void clear( );
+
+    //! renvoie le nombre de mesures dans la fenetre.
+    int count( ) const { return int(m_window.size()); }
+    //! renvoie la derniere mesure.
+    float last( ) const { return m_samples.empty() ? 0 : m_samples.back(); }
+    //! renvoie la plus petite mesure de la fenetre.
+    float min( ) const;
+    //! renvoie la plus grande mesure de la fenetre.
+    float max( ) const;
+    //! renvoie la moyenne des mesures de la fenetre.
+    float avg( ) const;
+    //! renvoie le percentile p, entre 0 et 100, des mesures de la fenetre.
+    float percentile( const float p ) const;
+
+    //! renvoie toutes les mesures, dans l'ordre.
+    const std::vector<float>& samples( ) const { return m_samples; }
+
+protected:
+    std::vector<float> m_window;
+    std::vector<float> m_samples;
+    mutable std::vector<float> m_sorted;
+    int m_next;
+    int m_size;
+    mutable bool m_sorted_valid;
+};
+
+//! exporte les temps cpu et gpu de chaque image, format json si le nom se termine par .json, csv sinon. renvoie -1 en cas d'erreur.
+int write_time_stats( const char *filename, const TimeStats& cpu, const TimeStats& gpu );
+
+///@}
+#endif
@@ -1,18 +1,59 @@
 
 #include <cstdio>
 
+#include <cstring>
 #include <set>
+#include <string>
+#include <unordered_map>
 
 #include "program.h"
 #include "uniforms.h"
 
 
-static 
-int location( const GLuint program, const char *uniform )
+// cache des identifiants des uniforms, par program.
+// les noms sont conserves une seule fois, les tables utilisent directement les chaines de caracteres, sans copie.
+struct NameHash
 {
-    if(program == 0) 
+    size_t operator() ( const char *name ) const
+    {
+        // fnv1a
+        size_t h= 2166136261u;
+        for(; *name; name++)
+            h= (h ^ (unsigned char) *name) * 16777619u;
+        return h;
+    }
+};
+
+struct NameEqual
+{
+    bool operator() ( const char *a, const char *b ) const { return strcmp(a, b) == 0; }
+};
+
+typedef std::unordered_map<const char *, GLint, NameHash, NameEqual> UniformLocations;
+
+static std::unordered_map<GLuint, UniformLocations> locations;
+static std::set<std::string> names;
+static unsigned int locations_version= 1;
+
+
+GLint uniform_location( const GLuint program, const char *uniform, const char **name, unsigned int *version )
+{
+    if(version)
+        *version= locations_version;
+    if(name)
+        *name= nullptr;
+    if(program == 0 || uniform == nullptr)
         return -1;
     
+    UniformLocations& cache= locations[program];
+    auto found= cache.find(uniform);
+    if(found != cache.end())
+    {
+        if(name)
+            *name= found->first;
+        return found->second;
+    }
+    
     // recuperer l'identifiant de l'uniform dans le program
     GLint location= glGetUniformLocation(program, uniform);
     if(location < 0)
@@ -33,10 +74,27 @@ int location( const GLuint program, const char *uniform )
         if(log.insert(error).second == true) 
             // pas la peine d'afficher le message 60 fois par seconde...
             printf("%s\n", error); 
-        
-        return -1; 
     }
     
+    // conserve le nom et l'identifiant, meme si l'uniform n'existe pas
+    const char *key= names.insert(uniform).first->c_str();
+    cache.insert( { key, location } );
+    if(name)
+        *name= key;
+    return location;
+}
+
+void clear_uniform_locations( const GLuint program )
+{
+    locations.erase(program);
+    // les UniformHandle re-evaluent leur identifiant
+    locations_version++;
+}
+
+
+static
+void check_program( const GLuint program, const char *uniform )
+{
 #ifndef GK_RELEASE
     // verifier que le program est bien en cours d'utilisation, ou utiliser glProgramUniform, mais c'est gl 4
     GLuint current;
@@ -61,10 +119,39 @@ int location( const GLuint program, const char *uniform )
         glUseProgram(program);
     }
 #endif
+}
+
+static 
+int location( const GLuint program, const char *uniform )
+{
+    if(program == 0) 
+        return -1;
     
+    GLint location= uniform_location(program, uniform);
+    if(location < 0)
+        return -1;
+    
+    check_program(program, uniform);
     return location;
 }
 
+template < typename T >
+static
+int location( const UniformHandle<T>& uniform )
+{
+    if(uniform.program == 0) 
+        return -1;
+    
+    // re-evalue l'identifiant si le program a ete modifie
+    if(uniform.version != locations_version)
+        uniform.location= uniform_location(uniform.program, uniform.name, nullptr, &uniform.version);
+    if(uniform.location < 0)
+        return -1;
+    
+    check_program(uniform.program, uniform.name);
+    return uniform.location;
+}
+
 void program_uniform( const GLuint program, const char *uniform, const unsigned int v )
 {
     glUniform1ui( location(program, uniform), v );
@@ -115,6 +202,56 @@ void program_uniform( const GLuint program, const char *uniform, const Transform
     glUniformMatrix4fv( location(program, uniform), 1, GL_TRUE, v.buffer() );
 }
 
+void program_uniform( const UniformHandle<unsigned int>& uniform, const unsigned int v )
+{
+    glUniform1ui( location(uniform), v );
+}
+
+void program_uniform( const UniformHandle<int>& uniform, const int v )
+{
+    glUniform1i( location(uniform), v );
+}
+
+void program_uniform( const UniformHandle<float>& uniform, const float v )
+{
+    glUniform1f( location(uniform), v );
+}
+
+void program_uniform( const UniformHandle<vec2>& uniform, const vec2& v )
+{
+    glUniform2fv( location(uniform), 1, &v.x );
+}
+
+void program_uniform( const UniformHandle<vec3>& uniform, const vec3& v )
+{
+    glUniform3fv( location(uniform), 1, &v.x );
+}
+
+void program_uniform( const UniformHandle<Point>& uniform, const Point& a )
+{
+    glUniform3fv( location(uniform), 1, &a.x );
+}
+
+void program_uniform( const UniformHandle<Vector>& uniform, const Vector& v )
+{
+    glUniform3fv( location(uniform), 1, &v.x );
+}
+
+void program_uniform( const UniformHandle<vec4>& uniform, const vec4& v )
+{
+    glUniform4fv( location(uniform), 1, &v.x );
+}
+
+void program_uniform( const UniformHandle<Color>& uniform, const Color& c )
+{
+    glUniform4fv( location(uniform), 1, &c.r );
+}
+
+void program_uniform( const UniformHandle<Transform>& uniform, const Transform& v )
+{
+    glUniformMatrix4fv( location(uniform), 1, GL_TRUE, v.buffer() );
+}
+
 void program_use_texture( const GLuint program, const char *uniform, const int unit, const GLuint texture, const GLuint sampler )
 {
     // verifie que l'uniform existe
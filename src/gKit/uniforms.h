@@ -45,5 +45,74 @@ void program_uniform( const GLuint program, const char *uniform, const Transform
 //! configure le pipeline et le shader program pour utiliser une texture, et des parametres de filtrages, eventuellement.
 void program_use_texture( const GLuint program, const char *uniform, const int unit, const GLuint texture, const GLuint sampler= 0 );
 
+
+/*! renvoie l'identifiant d'un uniform du shader program, ou -1 si l'uniform n'existe pas.
+    les identifiants sont conserves dans un cache, par program, glGetUniformLocation( ) n'est utilise qu'une seule fois par uniform.
+    le cache d'un program est vide par reload_program( ) et release_program( ), cf clear_uniform_locations( ).
+
+    \param name renvoie, eventuellement, une copie du nom conservee par le cache.
+    \param version renvoie, eventuellement, la version du cache, cf UniformHandle.
+ */
+GLint uniform_location( const GLuint program, const char *uniform, const char **name= nullptr, unsigned int *version= nullptr );
+
+//! vide le cache des identifiants des uniforms du program. a utiliser si le program est modifie sans utiliser reload_program( ), glLinkProgram( ) par exemple.
+void clear_uniform_locations( const GLuint program );
+
+
+/*! uniform d'un shader program, l'identifiant est recupere une seule fois, cf uniform_handle( ).
+    l'identifiant est re-evalue automatiquement apres reload_program( ).
+
+    exemple :
+\code
+// init( )
+UniformHandle<Transform> mvp= uniform_handle<Transform>(program, "mvpMatrix");
+
+// render( )
+glUseProgram(program);
+program_uniform(mvp, projection * view * model);
+\endcode
+ */
+template < typename T >
+struct UniformHandle
+{
+    UniformHandle( ) : program(0), name(nullptr), location(-1), version(0) {}
+    
+    GLuint program;             //!< shader program.
+    const char *name;           //!< nom de l'uniform, conserve par le cache.
+    mutable GLint location;     //!< identifiant de l'uniform dans le program.
+    mutable unsigned int version;       //!< version du cache utilisee pour evaluer l'identifiant.
+};
+
+//! renvoie l'uniform d'un shader program, a utiliser avec program_uniform( ).
+template < typename T >
+UniformHandle<T> uniform_handle( const GLuint program, const char *uniform )
+{
+    UniformHandle<T> handle;
+    handle.program= program;
+    handle.location= uniform_location(program, uniform, &handle.name, &handle.version);
+    return handle;
+}
+
+//! affecte une valeur a un uniform du shader program. uint.
+void program_uniform( const UniformHandle<unsigned int>& uniform, const unsigned int v );
+//! affecte une valeur a un uniform du shader program. int.
+void program_uniform( const UniformHandle<int>& uniform, const int v );
+//! affecte une valeur a un uniform du shader program. float.
+void program_uniform( const UniformHandle<float>& uniform, const float v );
+//! affecte une valeur a un uniform du shader program. vec2.
+void program_uniform( const UniformHandle<vec2>& uniform, const vec2& v );
+//! affecte une valeur a un uniform du shader program. vec3.
+void program_uniform( const UniformHandle<vec3>& uniform, const vec3& v );
+//! affecte une valeur a un uniform du shader program. Point.
+void program_uniform( const UniformHandle<Point>& uniform, const Point& v );
+//! affecte une valeur a un uniform du shader program. Vector.
+void program_uniform( const UniformHandle<Vector>& uniform, const Vector& v );
+//! affecte une valeur a un uniform du shader program. vec4.
+void program_uniform( const UniformHandle<vec4>& uniform, const vec4& v );
+//! affecte une valeur a un uniform du shader program. Color.
+void program_uniform( const UniformHandle<Color>& uniform, const Color& c );
+//! affecte une valeur a un uniform du shader program. Transform.
+void program_uniform( const UniformHandle<Transform>& uniform, const Transform& v );
+
 ///@}
 #endif
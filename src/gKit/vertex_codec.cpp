@@ -0,0 +1,240 @@
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "vertex_codec.h"
+
+
+static
+float clamp( const float v, const float vmin, const float vmax )
+{
+    return std::min(vmax, std::max(vmin, v));
+}
+
+unsigned short float_to_unorm16( const float v )
+{
+    return (unsigned short) std::lround(clamp(v, 0, 1) * 65535.f);
+}
+
+float unorm16_to_float( const unsigned short v )
+{
+    return float(v) / 65535.f;
+}
+
+short float_to_snorm16( const float v )
+{
+    return (short) std::lround(clamp(v, -1, 1) * 32767.f);
+}
+
+float snorm16_to_float( const short v )
+{
+    return std::max(float(v) / 32767.f, -1.f);
+}
+
+signed char float_to_snorm8( const float v )
+{
+    return (signed char) std::lround(clamp(v, -1, 1) * 127.f);
+}
+
+float snorm8_to_float( const signed char v )
+{
+    return std::max(float(v) / 127.f, -1.f);
+}
+
+unsigned char float_to_unorm8( const float v )
+{
+    return (unsigned char) std::lround(clamp(v, 0, 1) * 255.f);
+}
+
+float unorm8_to_float( const unsigned char v )
+{
+    return float(v) / 255.f;
+}
+
+
+unsigned short float_to_half( const float v )
+{
+    unsigned int x;
+    memcpy(&x, &v, sizeof(x));
+
+    unsigned int sign= (x >> 16) & 0x8000;
+    unsigned int e= (x >> 23) & 0xff;
+    unsigned int m= x & 0x7fffff;
+
+    // inf et nan
+    if(e == 255)
+        return (unsigned short) (sign | 0x7c00 | (m ? 0x200 : 0));
+
+    int exponent= int(e) - 127 + 15;
+    // trop grand, inf
+    if(exponent >= 31)
+        return (unsigned short) (sign | 0x7c00);
+
+    // denormalise ou trop petit
+    if(exponent <= 0)
+    {
+        if(exponent < -10)
+            return (unsigned short) sign;
+
+        m= m | 0x800000;
+        int shift= 14 - exponent;
+        unsigned int h= m >> shift;
+        unsigned int r= m & ((1u << shift) -1);
+        unsigned int half= 1u << (shift -1);
+        if(r > half || (r == half && (h & 1)))
+            h++;
+        return (unsigned short) (sign | h);
+    }
+
+    // arrondi au plus proche, la retenue peut passer dans l'exposant
+    unsigned int h= (unsigned int) (exponent << 10) | (m >> 13);
+    unsigned int r= m & 0x1fff;
+    if(r > 0x1000 || (r == 0x1000 && (h & 1)))
+        h++;
+    return (unsigned short) (sign | h);
+}
+
+float half_to_float( const unsigned short h )
+{
+    unsigned int sign= (unsigned int) (h & 0x8000) << 16;
+    unsigned int e= (h >> 10) & 0x1f;
+    unsigned int m= h & 0x3ff;
+
+    if(e == 0)
+    {
+        // zero ou denormalise
+        float v= std::ldexp(float(m), -24);
+        return sign ? -v : v;
+    }
+
+    unsigned int x;
+    if(e == 31)
+        x= sign | 0x7f800000 | (m << 13);
+    else
+        x= sign | ((e + 112) << 23) | (m << 13);
+
+    float v;
+    memcpy(&v, &x, sizeof(v));
+    return v;
+}
+
+
+static
+float sign( const float v )
+{
+    return (v >= 0) ? 1.f : -1.f;
+}
+
+vec2 oct_encode( const vec3& n )
+{
+    float l= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if(l == 0)
+        return vec2(0, 0);
+
+    vec2 p= vec2(n.x / l, n.y / l);
+    if(n.z < 0)
+        p= vec2((1 - std::abs(p.y)) * sign(p.x), (1 - std::abs(p.x)) * sign(p.y));
+    return p;
+}
+
+vec3 oct_decode( const vec2& e )
+{
+    vec3 n= vec3(e.x, e.y, 1 - std::abs(e.x) - std::abs(e.y));
+    if(n.z < 0)
+        n= vec3((1 - std::abs(e.y)) * sign(e.x), (1 - std::abs(e.x)) * sign(e.y), n.z);
+
+    float l= std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+    return vec3(n.x / l, n.y / l, n.z / l);
+}
+
+
+Unorm16x4 encode_position( const vec3& p, const Point& pmin, const Point& pmax )
+{
+    Vector d= pmax - pmin;
+    float x= (d.x > 0) ? (p.x - pmin.x) / d.x : 0;
+    float y= (d.y > 0) ? (p.y - pmin.y) / d.y : 0;
+    float z= (d.z > 0) ? (p.z - pmin.z) / d.z : 0;
+    return { float_to_unorm16(x), float_to_unorm16(y), float_to_unorm16(z), 0 };
+}
+
+vec3 decode_position( const Unorm16x4& q, const Point& pmin, const Point& pmax )
+{
+    Vector d= pmax - pmin;
+    return vec3(
+        pmin.x + unorm16_to_float(q.x) * d.x,
+        pmin.y + unorm16_to_float(q.y) * d.y,
+        pmin.z + unorm16_to_float(q.z) * d.z);
+}
+
+
+// quantifie la projection octaedrique en choisissant, parmi les 4 voisins, le code le plus proche de la normale.
+template < typename T, T (*encode)( const float ), float (*decode)( const T ) >
+static
+void encode_oct( const vec3& n, const float scale, T& rx, T& ry )
+{
+    vec2 p= oct_encode(n);
+    float fx= std::floor(clamp(p.x, -1, 1) * scale);
+    float fy= std::floor(clamp(p.y, -1, 1) * scale);
+
+    float best= -2;
+    for(int i= 0; i < 4; i++)
+    {
+        T x= encode((fx + (i & 1)) / scale);
+        T y= encode((fy + (i >> 1)) / scale);
+        vec3 d= oct_decode(vec2(decode(x), decode(y)));
+        float c= d.x * n.x + d.y * n.y + d.z * n.z;
+        if(c > best)
+        {
+            best= c;
+            rx= x;
+            ry= y;
+        }
+    }
+}
+
+Snorm16x2 encode_normal16( const vec3& n )
+{
+    Snorm16x2 e;
+    encode_oct<short, float_to_snorm16, snorm16_to_float>(n, 32767.f, e.x, e.y);
+    return e;
+}
+
+vec3 decode_normal( const Snorm16x2& e )
+{
+    return oct_decode(vec2(snorm16_to_float(e.x), snorm16_to_float(e.y)));
+}
+
+Snorm8x2 encode_normal8( const vec3& n )
+{
+    Snorm8x2 e;
+    encode_oct<signed char, float_to_snorm8, snorm8_to_float>(n, 127.f, e.x, e.y);
+    return e;
+}
+
+vec3 decode_normal( const Snorm8x2& e )
+{
+    return oct_decode(vec2(snorm8_to_float(e.x), snorm8_to_float(e.y)));
+}
+
+
+Half2 encode_texcoord( const vec2& t )
+{
+    return { float_to_half(t.x), float_to_half(t.y) };
+}
+
+vec2 decode_texcoord( const Half2& h )
+{
+    return vec2(half_to_float(h.x), half_to_float(h.y));
+}
+
+
+Rgba8 encode_color( const vec4& c )
+{
+    return { float_to_unorm8(c.x), float_to_unorm8(c.y), float_to_unorm8(c.z), float_to_unorm8(c.w) };
+}
+
+vec4 decode_color( const Rgba8& c )
+{
+    return vec4(unorm8_to_float(c.r), unorm8_to_float(c.g), unorm8_to_float(c.b), unorm8_to_float(c.a));
+}
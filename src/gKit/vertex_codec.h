@@ -0,0 +1,114 @@
+
+#ifndef _VERTEX_CODEC_H
+#define _VERTEX_CODEC_H
+
+#include "vec.h"
+
+
+//! \addtogroup objet3D
+///@{
+
+//! \file
+/*! formats de sommets compacts : positions quantifiees sur 16 bits dans l'englobant de l'objet, normales en projection octaedrique sur 2x16 ou 2x8 bits, texcoords en half float, couleurs rgba8.
+
+    chaque format correspond a un format de sommet openGL normalise, cf glVertexAttribPointer( ) :
+    - Unorm16x4 : 3 ou 4 GL_UNSIGNED_SHORT, normalized= GL_TRUE, vec3 dans [0 1] dans le shader,
+    - Snorm16x2 : 2 GL_SHORT, normalized= GL_TRUE, vec2 dans [-1 1] dans le shader, cf oct_decode( ),
+    - Snorm8x2 : 2 GL_BYTE, normalized= GL_TRUE, vec2 dans [-1 1] dans le shader, cf oct_decode( ),
+    - Half2 : 2 GL_HALF_FLOAT, normalized= GL_FALSE, vec2,
+    - Rgba8 : 4 GL_UNSIGNED_BYTE, normalized= GL_TRUE, vec4.
+
+    decodage des normales dans un shader :
+\code
+vec3 oct_decode( const vec2 e )
+{
+    vec3 n= vec3(e.x, e.y, 1 - abs(e.x) - abs(e.y));
+    if(n.z < 0)
+        n.xy= (1 - abs(n.yx)) * vec2(n.x >= 0 ? 1 : -1, n.y >= 0 ? 1 : -1);
+    return normalize(n);
+}
+\endcode
+
+    cf "a survey of efficient representations for independent unit vectors", Z. Cigolle, S. Donow, D. Evangelakos, M. Mara, M. McGuire, Q. Meyer, 2014
+    http://jcgt.org/published/0003/02/01/
+ */
+
+//! position quantifiee, 4 composantes 16 bits, w n'est pas utilise et aligne les sommets sur 8 octets.
+struct Unorm16x4 { unsigned short x, y, z, w; };
+//! normale encodee sur 2 composantes 16 bits.
+struct Snorm16x2 { short x, y; };
+//! normale encodee sur 2 composantes 8 bits.
+struct Snorm8x2 { signed char x, y; };
+//! texcoord, 2 half float.
+struct Half2 { unsigned short x, y; };
+//! couleur, 4 composantes 8 bits.
+struct Rgba8 { unsigned char r, g, b, a; };
+
+static_assert(sizeof(Unorm16x4) == 8, "Unorm16x4");
+static_assert(sizeof(Snorm16x2) == 4, "Snorm16x2");
+static_assert(sizeof(Snorm8x2) == 2, "Snorm8x2");
+static_assert(sizeof(Half2) == 4, "Half2");
+static_assert(sizeof(Rgba8) == 4, "Rgba8");
+
+//! \name conversions scalaires, meme convention que openGL pour les formats normalises.
+//@{
+//! [0 1] vers unsigned 16 bits.
+unsigned short float_to_unorm16( const float v );
+//! unsigned 16 bits vers [0 1].
+float unorm16_to_float( const unsigned short v );
+//! [-1 1] vers signed 16 bits.
+short float_to_snorm16( const float v );
+//! signed 16 bits vers [-1 1].
+float snorm16_to_float( const short v );
+//! [-1 1] vers signed 8 bits.
+signed char float_to_snorm8( const float v );
+//! signed 8 bits vers [-1 1].
+float snorm8_to_float( const signed char v );
+//! [0 1] vers unsigned 8 bits.
+unsigned char float_to_unorm8( const float v );
+//! unsigned 8 bits vers [0 1].
+float unorm8_to_float( const unsigned char v );
+
+//! float 32 bits vers half float 16 bits, arrondi au plus proche.
+unsigned short float_to_half( const float v );
+//! half float 16 bits vers float 32 bits.
+float half_to_float( const unsigned short h );
+//@}
+
+//! \name projection octaedrique des directions.
+//@{
+//! projette une direction normalisee dans le carre [-1 1]x[-1 1].
+vec2 oct_encode( const vec3& n );
+//! direction normalisee associee a un point du carre [-1 1]x[-1 1].
+vec3 oct_decode( const vec2& e );
+//@}
+
+//! \name encodage / decodage des attributs.
+//@{
+//! quantifie une position dans l'englobant [pmin pmax].
+Unorm16x4 encode_position( const vec3& p, const Point& pmin, const Point& pmax );
+//! position associee a une position quantifiee dans l'englobant [pmin pmax].
+vec3 decode_position( const Unorm16x4& q, const Point& pmin, const Point& pmax );
+
+//! encode une normale sur 2x16 bits.
+Snorm16x2 encode_normal16( const vec3& n );
+//! decode une normale encodee sur 2x16 bits.
+vec3 decode_normal( const Snorm16x2& e );
+//! encode une normale sur 2x8 bits.
+Snorm8x2 encode_normal8( const vec3& n );
+//! decode une normale encodee sur 2x8 bits.
+vec3 decode_normal( const Snorm8x2& e );
+
+//! encode des coordonnees de texture en half float.
+Half2 encode_texcoord( const vec2& t );
+//! decode des coordonnees de texture.
+vec2 decode_texcoord( const Half2& h );
+
+//! encode une couleur, composantes dans [0 1].
+Rgba8 encode_color( const vec4& c );
+//! decode une couleur.
+vec4 decode_color( const Rgba8& c );
+//@}
+
+///@}
+#endif
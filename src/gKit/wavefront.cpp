@@ -4,6 +4,7 @@
 #include <climits>
 
 #include <algorithm>
+#include <unordered_map>
 
 #include "wavefront.h"
 
@@ -35,7 +36,29 @@ std::string pathname( const std::string& filename )
 }
 
 
-Mesh read_mesh( const char *filename )
+// sommet d'un fichier obj : indices position, texcoord, normale.
+struct ObjVertex
+{
+    int p, t, n;
+    
+    bool operator== ( const ObjVertex& v ) const { return p == v.p && t == v.t && n == v.n; }
+};
+
+struct ObjVertexHash
+{
+    size_t operator() ( const ObjVertex& v ) const
+    {
+        // cf boost::hash_combine
+        size_t h= std::hash<int>()(v.p);
+        h^= std::hash<int>()(v.t) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        h^= std::hash<int>()(v.n) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+
+static
+Mesh read_obj( const char *filename, const bool indexed )
 {
     FILE *in= fopen(filename, "rt");
     if(in == NULL)
@@ -59,6 +82,9 @@ Mesh read_mesh( const char *filename )
     std::vector<int> idt;
     std::vector<int> idn;
     
+    // sommets deja inseres dans le mesh, si indexed
+    std::unordered_map<ObjVertex, unsigned int, ObjVertexHash> vertices;
+    
     char tmp[1024];
     char line_buffer[1024];
     bool error= true;
@@ -144,7 +170,9 @@ Mesh read_mesh( const char *filename )
             for(int v= 2; v +1 < (int) idp.size(); v++)
             {
                 int idv[3]= { 0, v -1, v };
-                for(int i= 0; i < 3; i++)
+                unsigned int triangle[3];
+                int i= 0;
+                for(; i < 3; i++)
                 {
                     int k= idv[i];
                     int p= (idp[k] < 0) ? (int) positions.size() + idp[k] : idp[k] -1;
@@ -152,10 +180,32 @@ Mesh read_mesh( const char *filename )
                     int n= (idn[k] < 0) ? (int) normals.size()   + idn[k] : idn[k] -1;
                     
                     if(p < 0) break; // error
-                    if(t >= 0) data.texcoord(texcoords[t]);
-                    if(n >= 0) data.normal(normals[n]);
-                    data.vertex(positions[p]);
+                    
+                    if(indexed)
+                    {
+                        // re-utilise le sommet s'il est deja dans le mesh
+                        auto found= vertices.insert( { ObjVertex{ p, t, n }, 0 } );
+                        if(found.second == false)
+                        {
+                            triangle[i]= found.first->second;
+                            continue;
+                        }
+                        
+                        if(t >= 0) data.texcoord(texcoords[t]);
+                        if(n >= 0) data.normal(normals[n]);
+                        triangle[i]= data.vertex(positions[p]);
+                        found.first->second= triangle[i];
+                    }
+                    else
+                    {
+                        if(t >= 0) data.texcoord(texcoords[t]);
+                        if(n >= 0) data.normal(normals[n]);
+                        data.vertex(positions[p]);
+                    }
                 }
+                
+                if(indexed && i == 3)
+                    data.triangle(triangle[0], triangle[1], triangle[2]);
             }
         }
         
@@ -198,9 +248,26 @@ Mesh read_mesh( const char *filename )
     if(error)
         printf("loading mesh '%s'...\n[error]\n%s\n\n", filename, line_buffer);
     
+    if(indexed)
+    {
+        printf("  %d vertices, %d triangles\n", data.vertex_count(), data.triangle_count());
+        // re-ordonne les triangles et les sommets pour le cache de sommets
+        data.optimize();
+    }
+    
     return data;
 }
 
+Mesh read_mesh( const char *filename )
+{
+    return read_obj(filename, false);
+}
+
+Mesh read_indexed_mesh( const char *filename )
+{
+    return read_obj(filename, true);
+}
+
 int write_mesh( const Mesh& mesh, const char *filename )
 {
     if(mesh == Mesh::error())
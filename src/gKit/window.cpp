@@ -11,11 +11,13 @@
 #include <cassert>
 #include <cstdio>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <cmath>
 
 #include <vector>
 #include <set>
+#include <algorithm>
 #include <string>
 #include <iostream>
 
@@ -24,7 +26,42 @@
 #include "glcore.h"
 #include "window.h"
 
+#ifdef __linux__
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
+#endif
+
+
 
+// mode headless, cf GKIT_HEADLESS
+static bool headless_mode= false;
+static int headless_frames= 0;          // nombre d'images a dessiner...
+static float headless_duration= 0;      // ... ou duree de l'execution, en secondes
+static float headless_frame_time= 16;   // temps virtuel entre 2 images, en millisecondes
+static unsigned int headless_start= 0;
+static std::string headless_stats;
+static std::string headless_capture;
+
+// numero de l'image, incremente par events()
+static int frame= -1;
+
+// evenements clavier / souris enregistres, cf GKIT_RECORD et GKIT_REPLAY
+struct InputEvent
+{
+    int frame;
+    int type;               // 0 touche enfoncee, 1 touche relachee, 2 souris
+    SDL_Keycode key;
+    unsigned int buttons;
+    int x, y;
+};
+
+static std::vector<InputEvent> replay_events;
+static unsigned int replay_next= 0;
+static bool replay= false;
+static unsigned int replay_buttons= 0;
+static int replay_x= 0;
+static int replay_y= 0;
+static FILE *record= NULL;
 
 static float aspect= 1;
 
@@ -112,6 +149,10 @@ static unsigned int last_delta= 1;
 
 float global_time( )
 {
+    // temps virtuel en mode headless, identique pour chaque execution
+    if(headless_mode)
+        return float(frame < 0 ? 0 : frame) * headless_frame_time;
+    
     unsigned int now= SDL_GetTicks();
     
     // ecoulement du temps strictement croissant...
@@ -125,6 +166,9 @@ float global_time( )
 
 float delta_time( )
 {
+    if(headless_mode)
+        return headless_frame_time;
+    
     return (float) last_delta;
 }
 
@@ -145,12 +189,21 @@ int run( Window window, int (*draw)() )
             stop= 1;    // fermer l'application si draw() renvoie 0 ou -1...
 
         // presenter le resultat
-        SDL_GL_SwapWindow(window);
+        swap_window(window);
     }
 
     return 0;
 }
 
+void swap_window( Window window )
+{
+    if(headless_mode)
+        // rien a presenter, le pbuffer conserve l'image
+        glFlush();
+    else
+        SDL_GL_SwapWindow(window);
+}
+
 static int event_count= 0;
 int last_event_count( ) { return event_count; }
 
@@ -158,6 +211,7 @@ int last_event_count( ) { return event_count; }
 int events( Window window )
 {
     event_count= 0;
+    frame++;
     
     // proportions de la fenetre
     SDL_GetWindowSize(window, &width, &height);
@@ -203,6 +257,9 @@ int events( Window window )
                 {
                     key_states[event.key.keysym.scancode]= 1;
                     last_key= event.key;    // conserver le dernier evenement
+                    
+                    if(record)
+                        fprintf(record, "%d keydown %d\n", frame, int(event.key.keysym.sym));
                 }
 
                 // fermer l'application
@@ -216,6 +273,9 @@ int events( Window window )
                 {
                     key_states[event.key.keysym.scancode]= 0;
                     last_key= event.key;    // conserver le dernier evenement
+                    
+                    if(record)
+                        fprintf(record, "%d keyup %d\n", frame, int(event.key.keysym.sym));
                 }
                 break;
 
@@ -233,14 +293,173 @@ int events( Window window )
                 break;
         }
     }
+    
+    if(replay)
+    {
+        // le deplacement de la souris n'est rejoue que pour l'image enregistree
+        replay_x= 0;
+        replay_y= 0;
+        
+        for(; replay_next < replay_events.size() && replay_events[replay_next].frame <= frame; replay_next++)
+        {
+            const InputEvent& input= replay_events[replay_next];
+            if(input.type == 2)
+            {
+                replay_buttons= input.buttons;
+                replay_x= input.x;
+                replay_y= input.y;
+                continue;
+            }
+            
+            SDL_Scancode code= SDL_GetScancodeFromKey(input.key);
+            if((size_t) code < key_states.size())
+                key_states[code]= (input.type == 0) ? 1 : 0;
+            
+            last_key.type= (input.type == 0) ? SDL_KEYDOWN : SDL_KEYUP;
+            last_key.keysym.scancode= code;
+            last_key.keysym.sym= input.key;
+        }
+    }
+    
+    if(headless_mode)
+    {
+        if(headless_frames > 0 && frame >= headless_frames)
+            stop= 1;
+        if(headless_duration > 0 && SDL_GetTicks() - headless_start >= (unsigned int) (headless_duration * 1000))
+            stop= 1;
+    }
 
     return 1 - stop;
 }
 
+unsigned int relative_mouse_state( int *x, int *y )
+{
+    if(replay)
+    {
+        if(x) *x= replay_x;
+        if(y) *y= replay_y;
+        
+        // le deplacement n'est renvoye qu'une fois par image, comme SDL_GetRelativeMouseState()
+        replay_x= 0;
+        replay_y= 0;
+        return replay_buttons;
+    }
+    
+    int mx= 0, my= 0;
+    unsigned int buttons= SDL_GetRelativeMouseState(&mx, &my);
+    if(record && (buttons || mx || my))
+        fprintf(record, "%d mouse %u %d %d\n", frame, buttons, mx, my);
+    
+    if(x) *x= mx;
+    if(y) *y= my;
+    return buttons;
+}
+
+
+//! lit la configuration du mode headless et du rejeu des evenements.
+static
+void read_config( )
+{
+    const char *mode= getenv("GKIT_HEADLESS");
+    if(mode && mode[0])
+    {
+        // GKIT_HEADLESS=300 : 300 images, GKIT_HEADLESS=10s : 10 secondes
+        headless_mode= true;
+        if(strchr(mode, 's'))
+            headless_duration= float(atof(mode));
+        else
+            headless_frames= atoi(mode);
+        
+        if(headless_frames <= 0 && headless_duration <= 0)
+            headless_frames= 100;
+        
+        const char *frame_time= getenv("GKIT_FRAME_TIME");
+        if(frame_time && atof(frame_time) > 0)
+            headless_frame_time= float(atof(frame_time));
+        
+        const char *capture= getenv("GKIT_CAPTURE");
+        if(capture)
+            headless_capture= capture;
+    }
+    
+    const char *stats= getenv("GKIT_STATS");
+    if(stats)
+        headless_stats= stats;
+    
+    const char *replay_filename= getenv("GKIT_REPLAY");
+    if(replay_filename && replay_filename[0])
+    {
+        FILE *in= fopen(replay_filename, "rt");
+        if(in == NULL)
+            printf("[error] loading replay '%s'...\n", replay_filename);
+        else
+        {
+            char line[1024];
+            while(fgets(line, sizeof(line), in) != NULL)
+            {
+                InputEvent input= { };
+                char type[64];
+                int key= 0;
+                if(sscanf(line, "%d %63s", &input.frame, type) != 2)
+                    continue;
+                
+                if(strcmp(type, "keydown") == 0 && sscanf(line, "%*d %*s %d", &key) == 1)
+                    input.type= 0;
+                else if(strcmp(type, "keyup") == 0 && sscanf(line, "%*d %*s %d", &key) == 1)
+                    input.type= 1;
+                else if(strcmp(type, "mouse") == 0 && sscanf(line, "%*d %*s %u %d %d", &input.buttons, &input.x, &input.y) == 3)
+                    input.type= 2;
+                else
+                    continue;
+                
+                input.key= SDL_Keycode(key);
+                replay_events.push_back(input);
+            }
+            fclose(in);
+            
+            // dans l'ordre des images
+            std::stable_sort(replay_events.begin(), replay_events.end(), 
+                []( const InputEvent& a, const InputEvent& b ) { return a.frame < b.frame; });
+            
+            replay= true;
+            printf("replay '%s': %d events...\n", replay_filename, int(replay_events.size()));
+        }
+    }
+    
+    const char *record_filename= getenv("GKIT_RECORD");
+    if(!replay && record_filename && record_filename[0])
+    {
+        record= fopen(record_filename, "wt");
+        if(record == NULL)
+            printf("[error] writing record '%s'...\n", record_filename);
+    }
+}
+
+bool headless( )
+{
+    return headless_mode;
+}
+
+const char *stats_filename( )
+{
+    return headless_stats.empty() ? NULL : headless_stats.c_str();
+}
+
+const char *capture_filename( )
+{
+    return headless_capture.empty() ? NULL : headless_capture.c_str();
+}
+
 
 //! creation d'une fenetre pour l'application.
 Window create_window( const int w, const int h )
 {
+    read_config();
+    
+    // pas d'affichage en mode headless : sdl ne gere que les evenements, le clavier et le temps
+    if(headless_mode)
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+    
     // init sdl
     if(SDL_Init(SDL_INIT_EVERYTHING) < 0)
     {
@@ -254,7 +473,7 @@ Window create_window( const int w, const int h )
     // creer la fenetre
     Window window= SDL_CreateWindow("gKit",
         SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, w, h,
-        SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+        headless_mode ? SDL_WINDOW_HIDDEN : SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
     if(window == NULL)
     {
         printf("[error] SDL_CreateWindow() failed.\n");
@@ -271,12 +490,25 @@ Window create_window( const int w, const int h )
 
     // conserve les dimensions de la fenetre
     SDL_GetWindowSize(window, &width, &height);
+    
+    if(headless_mode)
+    {
+        headless_start= SDL_GetTicks();
+        if(headless_frames > 0)
+            printf("[headless] %dx%d, %d frames, %.2fms per frame...\n", width, height, headless_frames, headless_frame_time);
+        else
+            printf("[headless] %dx%d, %.2fs, %.2fms per frame...\n", width, height, headless_duration, headless_frame_time);
+    }
 
     return window;
 }
 
 void release_window( Window window )
 {
+    if(record)
+        fclose(record);
+    record= NULL;
+    
     SDL_StopTextInput();
     SDL_DestroyWindow(window);
 }
@@ -304,11 +536,164 @@ void GLAPIENTRY debug( GLenum source, GLenum type, unsigned int id, GLenum sever
 #endif
 #endif
 
+//! charge les extensions et configure l'affichage des messages d'erreurs openGL. renvoie -1 en cas d'erreur.
+static
+int init_extensions( )
+{
+#ifndef NO_GLEW
+    // initialise les extensions opengl
+    glewExperimental= 1;
+    GLenum err= glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // contexte EGL, pas de display GLX, mais les fonctions openGL sont chargees
+    if(err == GLEW_ERROR_NO_GLX_DISPLAY)
+        err= GLEW_OK;
+#endif
+    if(err != GLEW_OK)
+    {
+        printf("[error] loading extensions\n%s\n", glewGetErrorString(err));
+        return -1;
+    }
+
+    // purge les erreurs opengl generees par glew !
+    while(glGetError() != GL_NO_ERROR) {;}
+
+#ifndef GK_RELEASE
+    // configure l'affichage des messages d'erreurs opengl, si l'extension est disponible
+    if(GLEW_ARB_debug_output)
+    {
+        printf("debug output enabled...\n");
+        // selectionne tous les messages
+        glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+        // desactive les messages du compilateur de shaders
+        glDebugMessageControlARB(GL_DEBUG_SOURCE_SHADER_COMPILER, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_FALSE);
+        
+        glDebugMessageCallbackARB(debug, NULL);
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+    }
+#endif
+#endif
+
+    return 0;
+}
+
+
+#ifdef __linux__
+static EGLDisplay egl_display= EGL_NO_DISPLAY;
+static EGLSurface egl_surface= EGL_NO_SURFACE;
+
+//! cree un contexte openGL EGL, sans fenetre, et un pbuffer de la taille de la fenetre : le framebuffer par defaut du contexte.
+static
+Context create_headless_context( const int major, const int minor )
+{
+    // plateforme surfaceless de mesa, si elle est disponible, ou display par defaut
+    const char *extensions= eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay= (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(extensions && strstr(extensions, "EGL_MESA_platform_surfaceless") && getPlatformDisplay)
+        egl_display= getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if(egl_display == EGL_NO_DISPLAY)
+        egl_display= eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    
+    EGLint egl_major= 0, egl_minor= 0;
+    if(egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &egl_major, &egl_minor))
+    {
+        printf("[error] EGL initialization failed.\n");
+        return NULL;
+    }
+    
+    eglBindAPI(EGL_OPENGL_API);
+    
+    const EGLint config_attributes[]= {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 16,
+        EGL_NONE };
+    EGLConfig config;
+    EGLint count= 0;
+    if(!eglChooseConfig(egl_display, config_attributes, &config, 1, &count) || count == 0)
+    {
+        printf("[error] no EGL pbuffer config.\n");
+        return NULL;
+    }
+    
+    const EGLint surface_attributes[]= { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    egl_surface= eglCreatePbufferSurface(egl_display, config, surface_attributes);
+    if(egl_surface == EGL_NO_SURFACE)
+    {
+        printf("[error] creating EGL pbuffer %dx%d.\n", width, height);
+        return NULL;
+    }
+    
+    const EGLint context_attributes[]= {
+        EGL_CONTEXT_MAJOR_VERSION, major,
+        EGL_CONTEXT_MINOR_VERSION, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#ifndef GK_RELEASE
+        EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+#endif
+        EGL_NONE };
+    EGLContext context= eglCreateContext(egl_display, config, EGL_NO_CONTEXT, context_attributes);
+    if(context == EGL_NO_CONTEXT || !eglMakeCurrent(egl_display, egl_surface, egl_surface, context))
+    {
+        printf("[error] creating openGL %d.%d context.\n", major, minor);
+        return NULL;
+    }
+    
+    printf("[headless] EGL %d.%d, %s\n", egl_major, egl_minor, (const char *) glGetString(GL_RENDERER));
+    
+    // initialise le pbuffer, sinon la premiere mesure de temps gpu est fausse avec llvmpipe
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glFinish();
+    
+    return (Context) context;
+}
+
+static
+void release_headless_context( Context context )
+{
+    eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(egl_display, (EGLContext) context);
+    eglDestroySurface(egl_display, egl_surface);
+    eglTerminate(egl_display);
+    
+    egl_surface= EGL_NO_SURFACE;
+    egl_display= EGL_NO_DISPLAY;
+}
+
+#else
+static
+Context create_headless_context( const int major, const int minor )
+{
+    printf("[error] headless mode: EGL not available.\n");
+    return NULL;
+}
+
+static
+void release_headless_context( Context context ) {}
+#endif
+
+
 //! cree et configure un contexte opengl
 Context create_context( Window window, const int major, const int minor )
 {
     if(window == NULL)
         return NULL;
+    
+    if(headless_mode)
+    {
+        Context context= create_headless_context(major, minor);
+        if(context == NULL)
+            return NULL;
+        
+        if(init_extensions() < 0)
+        {
+            release_headless_context(context);
+            return NULL;
+        }
+        
+        return context;
+    }
 
     // configure la creation du contexte opengl core profile, debug profile
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, major);
@@ -338,42 +723,21 @@ Context create_context( Window window, const int major, const int minor )
     else
         printf("adaptive vsync ON\n");
     
-#ifndef NO_GLEW
-    // initialise les extensions opengl
-    glewExperimental= 1;
-    GLenum err= glewInit();
-    if(err != GLEW_OK)
+    if(init_extensions() < 0)
     {
-        printf("[error] loading extensions\n%s\n", glewGetErrorString(err));
         SDL_GL_DeleteContext(context);
         return NULL;
     }
 
-    // purge les erreurs opengl generees par glew !
-    while(glGetError() != GL_NO_ERROR) {;}
-
-#ifndef GK_RELEASE
-    // configure l'affichage des messages d'erreurs opengl, si l'extension est disponible
-    if(GLEW_ARB_debug_output)
-    {
-        printf("debug output enabled...\n");
-        // selectionne tous les messages
-        glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
-        // desactive les messages du compilateur de shaders
-        glDebugMessageControlARB(GL_DEBUG_SOURCE_SHADER_COMPILER, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_FALSE);
-        
-        glDebugMessageCallbackARB(debug, NULL);
-        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
-    }
-#endif
-#endif
-
     return context;
 }
 
 void release_context( Context context )
 {
-    SDL_GL_DeleteContext(context);
+    if(headless_mode)
+        release_headless_context(context);
+    else
+        SDL_GL_DeleteContext(context);
 }
 
 
@@ -56,6 +56,9 @@ SDL_TextInputEvent text_event( );
 //! desactive l'evenement.
 void clear_text_event( );
 
+//! renvoie l'etat des boutons de la souris et son deplacement depuis le dernier appel, comme SDL_GetRelativeMouseState( ). enregistre ou rejoue les deplacements, cf GKIT_RECORD et GKIT_REPLAY.
+unsigned int relative_mouse_state( int *x, int *y );
+
 
 //! renvoie le temps ecoule depuis le lancement de l'application, en millisecondes.
 float global_time( );
@@ -64,6 +67,8 @@ float delta_time( );
 
 //! fonction principale. gestion des evenements et appel de la fonction draw de l'application.
 int run( Window window, int (*draw)( void ) );
+//! presente l'image, ou termine simplement l'image en mode headless.
+void swap_window( Window window );
 
 int last_event_count( );
 bool laptop_mode( );
@@ -72,6 +77,26 @@ bool laptop_mode( );
 //! fonction interne de gestion d'evenements.
 int events( Window window );
 
+
+/*! mode headless, sans affichage, pour les mesures automatiques. configure par des variables d'environnement :
+    - GKIT_HEADLESS=300 dessine 300 images, GKIT_HEADLESS=10s dessine pendant 10 secondes,
+    - GKIT_FRAME_TIME=16 temps virtuel entre 2 images, en millisecondes, cf global_time( ) et delta_time( ),
+    - GKIT_CAPTURE=image.png enregistre la derniere image,
+    - GKIT_STATS=stats.csv exporte les temps cpu et gpu de chaque image, format json si le nom se termine par .json, aussi sans le mode headless,
+    - GKIT_REPLAY=input.txt rejoue les evenements clavier / souris enregistres par GKIT_RECORD=input.txt, lors d'une execution normale.
+
+    le contexte openGL est cree par EGL, son framebuffer par defaut est un pbuffer de la taille de la fenetre.
+    fonctionne aussi avec le rasterizer logiciel de mesa, exemple :
+\code
+LIBGL_ALWAYS_SOFTWARE=1 GKIT_HEADLESS=300 GKIT_STATS=stats.csv bin/tp1_keyframes
+\endcode
+ */
+bool headless( );
+//! renvoie le fichier des temps de chaque image, GKIT_STATS, ou NULL.
+const char *stats_filename( );
+//! renvoie le fichier de la derniere image, GKIT_CAPTURE, ou NULL.
+const char *capture_filename( );
+
 //! renvoie le chemin(path) vers le fichier filename aprs l'avoir chercher par rapport  l'executable ou au rpertoire pre de l'executable
 const char* smart_path(const char* filename);
 
@@ -40,6 +40,7 @@ GLuint program;
 std::string program_log;
 int program_area;
 bool program_failed;
+bool program_pending= false;
 
 Filename mesh_filename;
 Mesh mesh;
@@ -56,13 +57,8 @@ Orbiter camera;
 Widgets widgets;
 
 // application
-void reload_program( )
+void program_errors( )
 {
-    if(program == 0)
-        program= read_program(program_filename);
-    else
-        reload_program(program, program_filename);
-    
     // recupere les erreurs, si necessaire
     program_area= program_format_errors(program, program_log);
     
@@ -72,6 +68,21 @@ void reload_program( )
     program_failed= (program_log.size() > 0);
 }
 
+void reload_program( )
+{
+    if(program == 0)
+    {
+        program= read_program(program_filename);
+        program_errors();
+    }
+    else
+    {
+        // recompile sans attendre, le program actuel reste affiche, cf draw()
+        reload_program_async(program, program_filename);
+        program_pending= true;
+    }
+}
+
 
 // cherche un fichier avec l'extension ext dans les options
 const char *option_find( std::vector<const char *>& options, const char *ext )
@@ -202,6 +213,13 @@ int draw( void )
         reload_program();
     }
     
+    // utilise la nouvelle version du program, des qu'elle est prete
+    if(program_pending && program_ready(program) != 0)
+    {
+        program_pending= false;
+        program_errors();
+    }
+    
     // recupere les mouvements de la souris
     int mx, my;
     unsigned int mb= SDL_GetRelativeMouseState(&mx, &my);
@@ -292,7 +310,7 @@ int draw( void )
     }
     else
     {
-        label(widgets, "program '%s' running...", program_filename.path);
+        label(widgets, "program '%s' %s", program_filename.path, program_pending ? "compiling..." : "running...");
         if(mesh_filename[0] != 0)
         {
             begin_line(widgets);
@@ -11,6 +11,8 @@ struct Object
     uint vertex_count;
     vec3 pmax;
     uint vertex_base;
+    vec3 cone_axis;
+    float cone_cutoff;
 };
 
 struct Draw
@@ -41,33 +43,83 @@ layout(binding= 3) buffer counterData
     uint count;
 };
 
+// row_major : organisation des matrices par lignes...
+layout(binding= 4, row_major, std430) readonly buffer modelData
+{
+    mat4 objectMatrix[];
+};
+
+
+uniform mat4 modelMatrix;
+uniform mat4 vpMatrix;
+uniform vec3 camera;        // position de la camera dans le repere du monde
+
+
+// renvoie vrai si la boite englobante est au moins partiellement visible, cf meshlet_visible( )
+bool visible( const mat4 mvp, const vec3 pmin, const vec3 pmax )
+{
+    int planes[6]= int[6](0, 0, 0, 0, 0, 0);
+    
+    // enumere les 8 sommets de la boite englobante
+    for(int i= 0; i < 8; i++)
+    {
+        vec3 p= vec3((i & 1) != 0 ? pmax.x : pmin.x, (i & 2) != 0 ? pmax.y : pmin.y, (i & 4) != 0 ? pmax.z : pmin.z);
+        vec4 h= mvp * vec4(p, 1);
+        
+        if(h.x < -h.w) planes[0]++;     // trop a gauche
+        if(h.x > h.w) planes[1]++;      // trop a droite
+        if(h.y < -h.w) planes[2]++;     // trop bas
+        if(h.y > h.w) planes[3]++;      // trop haut
+        if(h.z < -h.w) planes[4]++;     // trop pres
+        if(h.z > h.w) planes[5]++;      // trop loin
+    }
+    
+    for(int i= 0; i < 6; i++)
+        if(planes[i] == 8)
+            return false;
+    
+    return true;
+}
 
-uniform vec3 bmin;
-uniform vec3 bmax;
+// renvoie vrai si tous les triangles du groupe sont orientes dans la direction opposee a la camera, cf meshlet_backfacing( )
+bool backfacing( const mat4 model, const Object object )
+{
+    if(object.cone_cutoff >= 1)
+        return false;
+    
+    // sphere englobante et cone des normales dans le repere du monde
+    float scale= length(model[0].xyz);
+    vec3 center= vec3(model * vec4((object.pmin + object.pmax) / 2, 1));
+    float radius= length(object.pmax - object.pmin) / 2 * scale;
+    vec3 axis= normalize(mat3(model) * object.cone_axis);
+    
+    vec3 d= center - camera;
+    return dot(d, axis) >= object.cone_cutoff * length(d) + radius;
+}
 
 
 layout(local_size_x= 256) in;
 void main( )
 {
+    // 1 thread par groupe de triangles de chaque copie de l'objet
     uint id= gl_GlobalInvocationID.x;
-    if(id >= objects.length())
+    if(id >= objects.length() * objectMatrix.length())
         return;
     
-    // recupere la bbox du ieme objet...
-    vec3 pmin= objects[id].pmin;
-    vec3 pmax= objects[id].pmax;
+    uint instance= id / objects.length();
+    uint cluster= id % objects.length();
     
-    // test d'inclusion avec la bbox...
-    if(any(lessThan(pmax, bmin))        // trop a gauche pour x, etc
-    || any(greaterThan(pmin, bmax)))    // trop a droite pour x, etc
-        // pas d'intersection...
+    // tests de visibilite du groupe, dans le repere de la copie
+    mat4 model= objectMatrix[instance] * modelMatrix;
+    if(!visible(vpMatrix * model, objects[cluster].pmin, objects[cluster].pmax))
+        // en dehors de la region visible par la camera...
         return;
     
-    // bvec3 lessThan( vec3 a, vec3 b ) : compare les vecteurs composante par composante et renvoie un vecteur de bool.
-    // bvec3 greaterThan( vec3 a, vec3 b ) : idem.
-    // bool any( bvec3 ) : renvoie vrai si une des composantes du vecteur est vraie.   
+    if(backfacing(model, objects[cluster]))
+        // tous les triangles sont a l'arriere de l'objet...
+        return;
     
-    // l'objet est dans la bbox, il faut le dessiner : emettre les parametres du draw
+    // le groupe est visible, il faut le dessiner : emettre les parametres du draw
     // etape 1 : position dans le buffer de sortie
     uint index= atomicAdd(count, 1);
     // remarque : peut mieux faire, utiliser une hierarchie de compteurs atomiques, 1 par sous groupe, 1 par groupe, 1 global
@@ -75,13 +127,13 @@ void main( )
     // cf equivalent nvidia https://developer.nvidia.com/reading-between-threads-shader-intrinsics
     
     // etape 2 : initialiser les parametres
-    params[index].vertex_count= objects[id].vertex_count;
+    params[index].vertex_count= objects[cluster].vertex_count;
     params[index].instance_count= 1;
-    params[index].vertex_base= objects[id].vertex_base;
+    params[index].vertex_base= objects[cluster].vertex_base;
     params[index].instance_base= 0;
     
-    // etape 3 : conserve aussi l'indice de l'objet...
-    remap[index]= id;
+    // etape 3 : conserve aussi l'indice de la copie de l'objet...
+    remap[index]= instance;
 }
 
 #endif
@@ -0,0 +1,282 @@
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "progressive.h"
+
+
+// generateur aleatoire sans etat, permet de jitter chaque pixel sans partager de generateur entre les threads.
+// cf "hash functions for gpu rendering" http://jcgt.org/published/0009/03/02/
+static
+unsigned hash( unsigned x )
+{
+    x^= x >> 16;
+    x*= 0x7feb352du;
+    x^= x >> 15;
+    x*= 0x846ca68bu;
+    x^= x >> 16;
+    return x;
+}
+
+static
+float uniform( const unsigned x )
+{
+    return float(hash(x) >> 8) / float(1u << 24);
+}
+
+
+void Progressive::create( const Mesh& mesh, const int width, const int height )
+{
+    stop();
+
+    // triangles et informations de shading dans l'ordre des feuilles du bvh
+    m_bvh.build(mesh);
+    m_shading.build(mesh, m_bvh.primitives());
+
+    m_triangles.resize(m_shading.size());
+    for(int i= 0; i < m_shading.size(); i++)
+        m_triangles[i]= Triangle(mesh.triangle(m_shading.triangle_id(i)));
+    printf("%d triangles.\n", (int) m_triangles.size());
+
+    m_width= width;
+    m_height= height;
+
+    m_sump.assign(width * height, Black());
+    m_sumn.assign(width * height, Black());
+    m_sumv.assign(width * height, Black());
+    m_accumulated= 0;
+
+    m_hitp= Image(width, height);
+    m_hitn= Image(width, height);
+    m_hitv= Image(width, height);
+    m_frame= 0;
+
+    m_generation++;
+    m_restart= std::chrono::high_resolution_clock::now();
+}
+
+void Progressive::camera( const Orbiter& camera )
+{
+    Transform view= camera.view();
+    Transform projection= camera.projection(m_width, m_height, 45);
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    if(memcmp(&view, &m_view, sizeof(Transform)) == 0 && memcmp(&projection, &m_projection, sizeof(Transform)) == 0)
+        return;
+
+    m_camera= camera;
+    m_view= view;
+    m_projection= projection;
+
+    // abandonne la passe en cours
+    m_generation++;
+    m_restart= std::chrono::high_resolution_clock::now();
+}
+
+void Progressive::anchor( const int x, const int y )
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_anchor_x= x;
+    m_anchor_y= y;
+
+    m_generation++;
+    m_restart= std::chrono::high_resolution_clock::now();
+}
+
+void Progressive::start( )
+{
+    if(m_thread.joinable())
+        return;
+
+    m_stop= false;
+    m_thread= std::thread(&Progressive::run, this);
+}
+
+void Progressive::stop( )
+{
+    if(!m_thread.joinable())
+        return;
+
+    m_stop= true;
+    m_generation++;     // abandonne la passe en cours
+    m_thread.join();
+}
+
+void Progressive::run( )
+{
+    while(!m_stop)
+        pass();
+}
+
+bool Progressive::pass( )
+{
+    // recupere les parametres de la passe
+    Orbiter camera;
+    int ax, ay;
+    unsigned generation;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        camera= m_camera;
+        ax= m_anchor_x;
+        ay= m_anchor_y;
+        generation= m_generation;
+    }
+
+    // recommence l'accumulation si les parametres ont change
+    if(generation != m_pass_generation)
+    {
+        std::fill(m_sump.begin(), m_sump.end(), Black());
+        std::fill(m_sumn.begin(), m_sumn.end(), Black());
+        std::fill(m_sumv.begin(), m_sumv.end(), Black());
+        m_accumulated= 0;
+        m_pass_generation= generation;
+    }
+
+    auto start= std::chrono::high_resolution_clock::now();
+
+    Point d0;
+    Vector dx0, dy0;
+    camera.frame(m_width, m_height, 0, 45, d0, dx0, dy0);
+
+    Point d1;
+    Vector dx1, dy1;
+    camera.frame(m_width, m_height, 1, 45, d1, dx1, dy1);
+
+    // point de reference pour la visibilite
+    bool anchor= false;
+    Point point;
+    Vector normal;
+    if(ax >= 0 && ay >= 0)
+    {
+        Point o= d0 + (ax + 0.5f)*dx0 + (ay + 0.5f)*dy0;
+        Point e= d1 + (ax + 0.5f)*dx1 + (ay + 0.5f)*dy1;
+
+        Ray ray(o, e);
+        Hit hit;
+        if(intersect(ray, hit))
+        {
+            anchor= true;
+            point= hit.p;
+            normal= hit.n;
+        }
+    }
+
+    const unsigned sample= m_accumulated;
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int y= 0; y < m_height; y++)
+    {
+        // la camera a change, termine la passe au plus vite
+        if(m_generation != generation)
+            continue;
+
+        for(int x= 0; x < m_width; x++)
+        {
+            unsigned seed= hash((y * m_width + x) ^ hash(sample));
+            float u= uniform(seed);
+            float v= uniform(seed + 1);
+
+            Point o= d0 + (x + u)*dx0 + (y + v)*dy0;
+            Point e= d1 + (x + u)*dx1 + (y + v)*dy1;
+
+            Ray ray(o, e);
+            Hit hit;
+            if(intersect(ray, hit))
+            {
+                int i= y * m_width + x;
+                m_sump[i]= m_sump[i] + Color(hit.p.x, hit.p.y, hit.p.z);
+                m_sumn[i]= m_sumn[i] + Color(hit.n.x, hit.n.y, hit.n.z);
+
+                if(anchor)
+                {
+                    Ray shadow(hit.p + hit.n * 0.001f, point + normal * 0.001f);
+                    if(!occluded(shadow))
+                        m_sumv[i]= m_sumv[i] + Color(1, 1, 1);
+                }
+            }
+        }
+    }
+
+    if(m_generation != generation)
+        return false;
+
+    m_accumulated++;
+
+    auto stop= std::chrono::high_resolution_clock::now();
+    float ms= std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() / 1000.f;
+
+    // publie la moyenne des echantillons
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if(m_generation != generation)
+            return false;
+
+        float k= 1.f / float(m_accumulated);
+        for(int i= 0; i < m_width * m_height; i++)
+        {
+            int x= i % m_width;
+            int y= i / m_width;
+            m_hitp(x, y)= Color(m_sump[i] * k, 1);
+            m_hitn(x, y)= Color(m_sumn[i] * k, 1);
+            m_hitv(x, y)= Color(m_sumv[i] * k, 1);
+        }
+        m_frame++;
+
+        if(m_accumulated == 1)
+            m_first_image= std::chrono::duration_cast<std::chrono::microseconds>(stop - m_restart).count() / 1000.f;
+    }
+
+    m_samples= m_accumulated;
+    if(ms > 0)
+        m_samples_per_second= float(m_width * m_height) / ms * 1000.f;
+    return true;
+}
+
+bool Progressive::read( Color *hitp, Color *hitn, Color *hitv, unsigned& frame )
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if(m_frame == frame)
+        return false;
+
+    size_t size= sizeof(Color) * m_width * m_height;
+    memcpy(hitp, m_hitp.buffer(), size);
+    memcpy(hitn, m_hitn.buffer(), size);
+    memcpy(hitv, m_hitv.buffer(), size);
+    frame= m_frame;
+    return true;
+}
+
+bool Progressive::intersect( const Ray& ray, Hit& hit ) const
+{
+    hit.t= ray.tmax;
+    m_bvh.intersect(ray.o, ray.d, hit.t,
+        [&]( const int index, float& tmax )
+        {
+            float t, u, v;
+            if(!m_triangles[index].intersect(ray, tmax, t, u, v))
+                return false;
+
+            tmax= t;
+            hit.u= u;
+            hit.v= v;
+            hit.object_id= index;     // permet de retrouver toutes les infos associees au triangle, cf shading()
+            return true;
+        });
+
+    if(hit.object_id == -1)
+        return false;
+
+    hit.p= ray(hit.t);      // evalue la positon du point d'intersection sur le rayon
+    hit.n= m_shading.normal(hit.object_id, hit.u, hit.v);
+    return true;
+}
+
+bool Progressive::occluded( const Ray& ray ) const
+{
+    return m_bvh.occluded(ray.o, ray.d, ray.tmax,
+        [&]( const int index, const float tmax )
+        {
+            float t, u, v;
+            return m_triangles[index].intersect(ray, tmax, t, u, v);
+        });
+}
@@ -0,0 +1,252 @@
+
+//! \file progressive.h lancer de rayons progressif sur cpu, independant d'openGL.
+
+#ifndef _PROGRESSIVE_H
+#define _PROGRESSIVE_H
+
+#include <cfloat>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include "vec.h"
+#include "color.h"
+#include "mesh.h"
+#include "image.h"
+#include "orbiter.h"
+#include "bvh.h"
+#include "shading_table.h"
+
+#define EPSILON 0.00001f
+
+
+struct Ray
+{
+    Point o;
+    Vector d;
+    float tmax;
+    
+    Ray( const Point origine, const Point extremite ) : o(origine), d(Vector(origine, extremite)), tmax(1) {}
+    Ray( const Point origine, const Vector direction ) : o(origine), d(direction), tmax(FLT_MAX) {}
+    
+    Point operator( ) ( const float t ) const { return o + t * d; }
+};
+
+struct Hit
+{
+    Point p;
+    Vector n;
+    float t, u, v;
+    int object_id;
+    
+    Hit( ) : p(), n(), t(FLT_MAX), u(0), v(0), object_id(-1) {}
+};
+
+struct Triangle : public TriangleData
+{
+    Triangle( ) : TriangleData() {}
+    Triangle( const TriangleData& data ) : TriangleData(data) {}
+    
+    /* calcule l'intersection ray/triangle
+        cf "fast, minimum storage ray-triangle intersection" 
+        http://www.graphics.cornell.edu/pubs/1997/MT97.pdf
+
+        renvoie faux s'il n'y a pas d'intersection valide, une intersection peut exister mais peut ne pas se trouver dans l'intervalle [0 htmax] du rayon. \n
+        renvoie vrai + les coordonnees barycentriques (ru, rv) du point d'intersection + sa position le long du rayon (rt). \n
+        convention barycentrique : t(u, v)= (1 - u - v) * a + u * b + v * c \n
+    */
+    bool intersect( const Ray &ray, const float htmax, float &rt, float &ru, float&rv ) const
+    {
+        /* begin calculating determinant - also used to calculate U parameter */
+        Vector ac= Vector(Point(a), Point(c));
+        Vector pvec= cross(ray.d, ac);
+
+        /* if determinant is near zero, ray lies in plane of triangle */
+        Vector ab= Vector(Point(a), Point(b));
+        float det= dot(ab, pvec);
+        if(det > -EPSILON && det < EPSILON)
+            return false;
+
+        float inv_det= 1.0f / det;
+
+        /* calculate distance from vert0 to ray origin */
+        Vector tvec(Point(a), ray.o);
+
+        /* calculate U parameter and test bounds */
+        float u= dot(tvec, pvec) * inv_det;
+        if(u < 0.0f || u > 1.0f)
+            return false;
+
+        /* prepare to test V parameter */
+        Vector qvec= cross(tvec, ab);
+
+        /* calculate V parameter and test bounds */
+        float v= dot(ray.d, qvec) * inv_det;
+        if(v < 0.0f || u + v > 1.0f)
+            return false;
+
+        /* calculate t, ray intersects triangle */
+        rt= dot(ac, qvec) * inv_det;
+        ru= u;
+        rv= v;
+
+        // ne renvoie vrai que si l'intersection est valide (comprise entre tmin et tmax du rayon)
+        return (rt < htmax && rt > EPSILON);
+    }
+
+    //! renvoie un point a l'interieur du triangle connaissant ses coordonnees barycentriques.
+    //! convention p(u, v)= (1 - u - v) * a + u * b + v * c
+    Point point( const float u, const float v ) const
+    {
+        float w= 1.f - u - v;
+        return Point(Vector(a) * w + Vector(b) * u + Vector(c) * v);
+    }
+
+    //! renvoie une normale a l'interieur du triangle connaissant ses coordonnees barycentriques.
+    //! convention p(u, v)= (1 - u - v) * a + u * b + v * c
+    Vector normal( const float u, const float v ) const
+    {
+        float w= 1.f - u - v;
+        return Vector(na) * w + Vector(nb) * u + Vector(nc) * v;
+    }
+};
+
+
+//
+struct Source : public Triangle
+{
+    Color emission;
+    
+    Source( ) : Triangle(), emission() {}
+    Source( const TriangleData& data, const Color& color ) : Triangle(data), emission(color) {}
+};
+
+
+// construit un repere ortho tbn, a partir d'un seul vecteur...
+// cf "generating a consistently oriented tangent space" 
+// http://people.compute.dtu.dk/jerf/papers/abstracts/onb.html
+struct World
+{
+    World( const Vector& _n ) : n(_n) 
+    {
+        if(n.z < -0.9999999f)
+        {
+            t= Vector(0, -1, 0);
+            b= Vector(-1, 0, 0);
+        }
+        else
+        {
+            float a= 1.f / (1.f + n.z);
+            float d= -n.x * n.y * a;
+            t= Vector(1.f - n.x * n.x * a, d, -n.x);
+            b= Vector(d, 1.f - n.y * n.y * a, -n.y);
+        }
+    }
+    
+    Vector operator( ) ( const Vector& local )  const
+    {
+        return local.x * t + local.y * b + local.z * n;
+    }
+    
+    Vector t;
+    Vector b;
+    Vector n;
+};
+
+
+/*! lancer de rayons progressif : chaque passe trace un rayon jitter par pixel et l'accumule.
+    les passes s'executent sur un thread en arriere plan, parallelisees avec openMP.
+    un changement de camera ou de pixel de reference abandonne la passe en cours et recommence l'accumulation.
+
+    n'utilise pas openGL, une passe peut etre executee directement, cf pass(), pour tester sans fenetre.
+ */
+class Progressive
+{
+public:
+    Progressive( ) : m_triangles(), m_bvh(), m_shading(), m_width(0), m_height(0), m_accumulated(0), m_frame(0), m_anchor_x(-1), m_anchor_y(-1),
+        m_generation(1), m_stop(false), m_pass_generation(0), m_samples(0), m_samples_per_second(0), m_first_image(0) {}
+    ~Progressive( ) { stop(); }
+
+    //! prepare les images accumulees, construit le bvh des triangles du mesh et la table de shading dans l'ordre des feuilles.
+    void create( const Mesh& mesh, const int width, const int height );
+
+    //! change la camera, recommence l'accumulation si la camera a bouge.
+    void camera( const Orbiter& camera );
+    //! change le pixel de reference pour le calcul de visibilite, recommence l'accumulation.
+    void anchor( const int x, const int y );
+
+    //! demarre le thread de calcul.
+    void start( );
+    //! arrete le thread de calcul, attend la fin de la passe en cours.
+    void stop( );
+    //! renvoie vrai si le thread de calcul est demarre.
+    bool running( ) const { return m_thread.joinable(); }
+
+    //! execute une passe complete, renvoie false si la passe a ete abandonnee.
+    bool pass( );
+
+    //! copie les images accumulees si une nouvelle passe est disponible depuis frame. renvoie false sinon.
+    bool read( Color *hitp, Color *hitn, Color *hitv, unsigned& frame );
+
+    //! indice de la derniere image publiee.
+    unsigned frame( ) const { return m_frame; }
+    //! nombre d'echantillons par pixel accumules.
+    int samples( ) const { return m_samples; }
+    //! nombre de rayons primaires par seconde, mesure sur la derniere passe.
+    float samples_per_second( ) const { return m_samples_per_second; }
+    //! temps en ms entre le dernier changement de camera et la premiere image.
+    float first_image( ) const { return m_first_image; }
+
+    //! intersection avec les triangles, parcours du bvh. hit.object_id est l'indice du triangle dans l'ordre des feuilles, cf shading( ).
+    bool intersect( const Ray& ray, Hit& hit ) const;
+    //! renvoie vrai si un triangle est touche par le rayon avant ray.tmax, s'arrete sur le premier triangle touche.
+    bool occluded( const Ray& ray ) const;
+    //! informations de shading des triangles, dans l'ordre des feuilles du bvh.
+    const ShadingTable& shading( ) const { return m_shading; }
+
+    int width( ) const { return m_width; }
+    int height( ) const { return m_height; }
+
+protected:
+    void run( );
+
+    std::vector<Triangle> m_triangles;     // dans l'ordre des feuilles du bvh
+    BVH m_bvh;
+    ShadingTable m_shading;
+    int m_width;
+    int m_height;
+
+    // accumulation, uniquement modifiee par pass()
+    std::vector<Color> m_sump;
+    std::vector<Color> m_sumn;
+    std::vector<Color> m_sumv;
+    unsigned m_accumulated;
+
+    // derniere image publiee, protegee par m_lock
+    Image m_hitp;
+    Image m_hitn;
+    Image m_hitv;
+    std::atomic<unsigned> m_frame;
+
+    // parametres, proteges par m_lock
+    Orbiter m_camera;
+    Transform m_view;
+    Transform m_projection;
+    int m_anchor_x;
+    int m_anchor_y;
+
+    std::mutex m_lock;
+    std::thread m_thread;
+    std::atomic<unsigned> m_generation;
+    std::atomic<bool> m_stop;
+    unsigned m_pass_generation;
+
+    std::chrono::high_resolution_clock::time_point m_restart;
+    std::atomic<int> m_samples;
+    std::atomic<float> m_samples_per_second;
+    std::atomic<float> m_first_image;
+};
+
+#endif
@@ -1,5 +1,5 @@
 
-#version 330
+#version 430
 
 #ifdef VERTEX_SHADER
 out vec2 position;
@@ -23,10 +23,24 @@ struct Triangle
 	vec3 ac;	// arete 2
 };
 
-// uniform buffer 0
-uniform triangleData
+// storage buffer 0, triangles dans l'ordre des feuilles du bvh
+layout(std430, binding= 0) readonly buffer triangleData
 {
-	Triangle triangles[1024];
+	Triangle triangles[];
+};
+
+// storage buffer 1, cf BVHNode dans src/gKit/bvh.h
+struct Node
+{
+	vec3 pmin;
+	int left;
+	vec3 pmax;
+	int right;
+};
+
+layout(std430, binding= 1) readonly buffer nodeData
+{
+	Node nodes[];
 };
 
 
@@ -54,12 +68,29 @@ bool intersect( const Triangle triangle, const vec3 o, const vec3 d, const float
         return (rt < tmax && rt > 0);
 }
 
+// intersection rayon / boite, renvoie tnear ou -1 si le rayon ne touche pas la boite entre 0 et tmax.
+float intersect( const vec3 pmin, const vec3 pmax, const vec3 o, const vec3 invd, const float tmax )
+{
+	vec3 t0= (pmin - o) * invd;
+	vec3 t1= (pmax - o) * invd;
+	vec3 tn= min(t0, t1);
+	vec3 tf= max(t0, t1);
+
+	float tnear= max(max(tn.x, tn.y), max(tn.z, 0));
+	float tfar= min(min(tf.x, tf.y), min(tf.z, tmax));
+	return (tnear <= tfar) ? tnear : -1;
+}
+
 uniform mat4 mvpInvMatrix;
+#ifndef USE_BVH
 uniform int triangle_count;
+#endif
 
 in vec2 position;
 out vec4 fragment_color;
 
+#define MAX_DEPTH 64
+
 void main( )
 {
 	// construction du rayon pour le pixel, passage depuis le repere projectif
@@ -74,6 +105,8 @@ void main( )
 	float hitu= 0;
 	float hitv= 0;
 	int hitid= 0;
+
+#ifndef USE_BVH
 	for(int i= 0; i < triangle_count; i++)
 	{
 		float t, u, v;
@@ -85,7 +118,62 @@ void main( )
 			hitid= i;
 		}
 	}
-	
+
+#else
+	// parcours du bvh avec une pile, visite le fils le plus proche en premier
+	vec3 invd= 1 / d;
+
+	int stack[MAX_DEPTH +1];
+	int top= 0;
+	stack[top++]= 0;
+	while(top > 0)
+	{
+		Node node= nodes[stack[--top]];
+		if(intersect(node.pmin, node.pmax, o, invd, hit) < 0)
+			continue;
+
+		if(node.right < 0)
+		{
+			// feuille
+			for(int i= node.left; i < node.left - node.right; i++)
+			{
+				float t, u, v;
+				if(intersect(triangles[i], o, d, hit, t, u, v))
+				{
+					hit= t;
+					hitu= u;
+					hitv= v;
+					hitid= i;
+				}
+			}
+		}
+		else
+		{
+			Node left= nodes[node.left];
+			Node right= nodes[node.right];
+			float tleft= intersect(left.pmin, left.pmax, o, invd, hit);
+			float tright= intersect(right.pmin, right.pmax, o, invd, hit);
+			if(tleft >= 0 && tright >= 0)
+			{
+				if(tleft < tright)
+				{
+					stack[top++]= node.right;
+					stack[top++]= node.left;
+				}
+				else
+				{
+					stack[top++]= node.left;
+					stack[top++]= node.right;
+				}
+			}
+			else if(tleft >= 0)
+				stack[top++]= node.left;
+			else if(tright >= 0)
+				stack[top++]= node.right;
+		}
+	}
+#endif
+
 	fragment_color= vec4(hitu, hitv, 0, 1);
 }
 #endif
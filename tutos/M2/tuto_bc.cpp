@@ -0,0 +1,115 @@
+
+//! \file tuto_bc.cpp compression des textures : temps de compression, psnr et memoire utilisee, cf texture_bc.h.
+
+#include <cstdio>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "image_io.h"
+#include "texture_bc.h"
+#include "app.h"
+
+
+struct Test
+{
+    BCFormat format;
+    int quality;
+    const char *name;
+    int channels;       // canaux compares par le psnr
+};
+
+static const Test tests[]= {
+    { BC1, 1, "BC1", 3 },
+    { BC3, 1, "BC3", 4 },
+    { BC4, 1, "BC4", 1 },
+    { BC5, 1, "BC5", 2 },
+    { BC7, 0, "BC7 q0", 4 },
+    { BC7, 1, "BC7 q1", 4 },
+    { BC7, 2, "BC7 q2", 4 },
+};
+
+
+class TP : public App
+{
+public:
+    TP( const std::vector<const char *>& filenames ) : App(256, 256, 4, 3), m_filenames(filenames) {}
+
+    int init( )
+    {
+        for(unsigned f= 0; f < m_filenames.size(); f++)
+        {
+            ImageData image= read_image_data(m_filenames[f]);
+            if(image.data.empty())
+                continue;
+
+            // taille de la texture rgba8 et de ses mipmaps
+            size_t rgba_size= 0;
+            for(int w= image.width, h= image.height; ; w= std::max(1, w / 2), h= std::max(1, h / 2))
+            {
+                rgba_size+= size_t(w) * h * 4;
+                if(w == 1 && h == 1)
+                    break;
+            }
+
+            printf("%s: %dx%d, %d channels, rgba8 %.2fMB\n", m_filenames[f], image.width, image.height, image.channels, double(rgba_size) / 1024 / 1024);
+            printf("  format     time   psnr cpu   psnr gpu      vram\n");
+
+            for(const Test& test : tests)
+            {
+                // pas de mipmaps filtres en sRGB, pour comparer le niveau 0 avec l'image
+                std::chrono::high_resolution_clock::time_point start= std::chrono::high_resolution_clock::now();
+                CompressedImage bc= compress_image(image, test.format, test.quality, false);
+                std::chrono::high_resolution_clock::time_point stop= std::chrono::high_resolution_clock::now();
+                float time= float(std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()) / 1000;
+                if(bc.levels.empty())
+                    return -1;
+
+                float cpu= psnr(image, decompress_level(bc.levels[0], bc.format), test.channels);
+
+                // decompression par le driver
+                float gpu= 0;
+                GLuint texture= make_texture(0, bc);
+                if(texture)
+                {
+                    ImageData level(image.width, image.height, 4);
+                    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, level.buffer());
+                    gpu= psnr(image, level, test.channels);
+                    glDeleteTextures(1, &texture);
+                }
+
+                printf("  %-6s %8.2fms %8.2fdB %8.2fdB %7.2fMB %.0fx\n", test.name, time, cpu, gpu,
+                    double(bc.size()) / 1024 / 1024, double(rgba_size) / double(bc.size()));
+            }
+        }
+
+        return 0;
+    }
+
+    int quit( ) { return 0; }
+
+    // pas d'affichage, uniquement les mesures
+    int render( ) { return 0; }
+
+protected:
+    std::vector<const char *> m_filenames;
+};
+
+
+int main( int argc, char **argv )
+{
+    std::vector<const char *> filenames;
+    for(int i= 1; i < argc; i++)
+        filenames.push_back(argv[i]);
+    if(filenames.empty())
+    {
+        filenames.push_back("data/monde.jpg");
+        filenames.push_back("data/papillon.png");
+    }
+
+    TP tp(filenames);
+    tp.run();
+
+    return 0;
+}
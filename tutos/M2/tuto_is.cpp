@@ -1,6 +1,8 @@
 
 #include <cfloat>
 #include <cmath>
+#include <cstring>
+#include <cstdlib>
 
 #include "app.h"
 
@@ -21,142 +23,9 @@
 #include "texture.h"
 
 #include "orbiter.h"
+#include "text.h"
 
-#define EPSILON 0.00001f
-
-
-struct Ray
-{
-    Point o;
-    Vector d;
-    float tmax;
-    
-    Ray( const Point origine, const Point extremite ) : o(origine), d(Vector(origine, extremite)), tmax(1) {}
-    Ray( const Point origine, const Vector direction ) : o(origine), d(direction), tmax(FLT_MAX) {}
-    
-    Point operator( ) ( const float t ) const { return o + t * d; }
-};
-
-struct Hit
-{
-    Point p;
-    Vector n;
-    float t, u, v;
-    int object_id;
-    
-    Hit( ) : p(), n(), t(FLT_MAX), u(0), v(0), object_id(-1) {}
-};
-
-struct Triangle : public TriangleData
-{
-    Triangle( ) : TriangleData() {}
-    Triangle( const TriangleData& data ) : TriangleData(data) {}
-    
-    /* calcule l'intersection ray/triangle
-        cf "fast, minimum storage ray-triangle intersection" 
-        http://www.graphics.cornell.edu/pubs/1997/MT97.pdf
-
-        renvoie faux s'il n'y a pas d'intersection valide, une intersection peut exister mais peut ne pas se trouver dans l'intervalle [0 htmax] du rayon. \n
-        renvoie vrai + les coordonnees barycentriques (ru, rv) du point d'intersection + sa position le long du rayon (rt). \n
-        convention barycentrique : t(u, v)= (1 - u - v) * a + u * b + v * c \n
-    */
-    bool intersect( const Ray &ray, const float htmax, float &rt, float &ru, float&rv ) const
-    {
-        /* begin calculating determinant - also used to calculate U parameter */
-        Vector ac= Vector(Point(a), Point(c));
-        Vector pvec= cross(ray.d, ac);
-
-        /* if determinant is near zero, ray lies in plane of triangle */
-        Vector ab= Vector(Point(a), Point(b));
-        float det= dot(ab, pvec);
-        if(det > -EPSILON && det < EPSILON)
-            return false;
-
-        float inv_det= 1.0f / det;
-
-        /* calculate distance from vert0 to ray origin */
-        Vector tvec(Point(a), ray.o);
-
-        /* calculate U parameter and test bounds */
-        float u= dot(tvec, pvec) * inv_det;
-        if(u < 0.0f || u > 1.0f)
-            return false;
-
-        /* prepare to test V parameter */
-        Vector qvec= cross(tvec, ab);
-
-        /* calculate V parameter and test bounds */
-        float v= dot(ray.d, qvec) * inv_det;
-        if(v < 0.0f || u + v > 1.0f)
-            return false;
-
-        /* calculate t, ray intersects triangle */
-        rt= dot(ac, qvec) * inv_det;
-        ru= u;
-        rv= v;
-
-        // ne renvoie vrai que si l'intersection est valide (comprise entre tmin et tmax du rayon)
-        return (rt < htmax && rt > EPSILON);
-    }
-
-    //! renvoie un point a l'interieur du triangle connaissant ses coordonnees barycentriques.
-    //! convention p(u, v)= (1 - u - v) * a + u * b + v * c
-    Point point( const float u, const float v ) const
-    {
-        float w= 1.f - u - v;
-        return Point(Vector(a) * w + Vector(b) * u + Vector(c) * v);
-    }
-
-    //! renvoie une normale a l'interieur du triangle connaissant ses coordonnees barycentriques.
-    //! convention p(u, v)= (1 - u - v) * a + u * b + v * c
-    Vector normal( const float u, const float v ) const
-    {
-        float w= 1.f - u - v;
-        return Vector(na) * w + Vector(nb) * u + Vector(nc) * v;
-    }
-};
-
-
-//
-struct Source : public Triangle
-{
-    Color emission;
-    
-    Source( ) : Triangle(), emission() {}
-    Source( const TriangleData& data, const Color& color ) : Triangle(data), emission(color) {}
-};
-
-
-// construit un repere ortho tbn, a partir d'un seul vecteur...
-// cf "generating a consistently oriented tangent space" 
-// http://people.compute.dtu.dk/jerf/papers/abstracts/onb.html
-struct World
-{
-    World( const Vector& _n ) : n(_n) 
-    {
-        if(n.z < -0.9999999f)
-        {
-            t= Vector(0, -1, 0);
-            b= Vector(-1, 0, 0);
-        }
-        else
-        {
-            float a= 1.f / (1.f + n.z);
-            float d= -n.x * n.y * a;
-            t= Vector(1.f - n.x * n.x * a, d, -n.x);
-            b= Vector(d, 1.f - n.y * n.y * a, -n.y);
-        }
-    }
-    
-    Vector operator( ) ( const Vector& local )  const
-    {
-        return local.x * t + local.y * b + local.z * n;
-    }
-    
-    Vector t;
-    Vector b;
-    Vector n;
-};
+#include "progressive.h"
 
 
 GLuint make_texture( const int unit, const int width, const int height )
@@ -182,12 +51,11 @@ struct IS : public App
     // constructeur : donner les dimensions de l'image, et eventuellement la version d'openGL.
     IS( const char *filename ) : App(1024, 640) 
     {
-        m_mesh= read_mesh(filename);
+        m_mesh= read_indexed_mesh(filename);
         if(m_mesh == Mesh::error())
             return;
         
         build_sources();
-        build_triangles();
         
         if(m_camera.read_orbiter("orbiter.txt") < 0)
         {
@@ -206,15 +74,31 @@ struct IS : public App
         m_ntexture= make_texture(1, window_width(), window_height());
         m_vtexture= make_texture(2, window_width(), window_height());
         
-        m_hitp= Image(window_width(), window_height());
-        m_hitn= Image(window_width(), window_height());
-        m_hitv= Image(window_width(), window_height());
+        // lancer de rayons progressif, sur un thread en arriere plan
+        m_tracer.create(m_mesh, window_width(), window_height());
+        m_tracer.camera(m_camera);
+        m_frame= 0;
+        
+        // anneau de pixel buffers pour transferer les images sans attendre le gpu, cf upload()
+        // chaque buffer contient les 3 images : positions, normales, visibilite.
+        glGenBuffers(3, m_pbo);
+        for(int i= 0; i < 3; i++)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo[i]);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, 3 * sizeof(Color) * window_width() * window_height(), nullptr, GL_STREAM_DRAW);
+            m_fences[i]= 0;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        m_pbo_index= 0;
+        
+        m_console= create_text();
         
         glGenVertexArrays(1, &m_vao);
         glBindVertexArray(m_vao);
         
         m_program= read_program("tutos/M2/is.glsl");
         program_print_errors(m_program);
+        m_reload= false;
         
         // etat openGL par defaut
         glClearColor(0.2f, 0.2f, 0.2f, 1.f);        // couleur par defaut de la fenetre
@@ -226,6 +110,55 @@ struct IS : public App
         return 0;
     }
     
+    // transfere la derniere image calculee par le tracer, si elle est disponible. n'attend jamais le gpu. 
+    bool upload( )
+    {
+        if(m_tracer.frame() == m_frame)
+            return false;   // rien de nouveau
+        
+        // le gpu utilise encore le buffer ? essayer de nouveau a la prochaine image
+        GLsync& fence= m_fences[m_pbo_index];
+        if(fence)
+        {
+            if(glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                return false;
+            
+            glDeleteSync(fence);
+            fence= 0;
+        }
+        
+        int size= window_width() * window_height();
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo[m_pbo_index]);
+        Color *data= (Color *) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, 3 * sizeof(Color) * size, 
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        bool copy= false;
+        if(data)
+        {
+            copy= m_tracer.read(data, data + size, data + 2*size, m_frame);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        
+        if(copy)
+        {
+            // transfert asynchrone, depuis le pixel buffer
+            GLuint textures[3]= { m_ptexture, m_ntexture, m_vtexture };
+            for(int i= 0; i < 3; i++)
+            {
+                glActiveTexture(GL_TEXTURE0 +i);
+                glBindTexture(GL_TEXTURE_2D, textures[i]);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 
+                    0, 0, window_width(), window_height(),
+                    GL_RGBA, GL_FLOAT, (const GLvoid *) (sizeof(Color) * size * i));
+            }
+            
+            fence= glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            m_pbo_index= (m_pbo_index +1) % 3;
+        }
+        
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return copy;
+    }
+    
     int render( )
     {
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -233,7 +166,15 @@ struct IS : public App
         if(key_state('r'))
         {
             clear_key_state('r');
-            reload_program(m_program, "tutos/M2/is.glsl");
+            // recompile sans attendre, le program actuel reste utilise
+            reload_program_async(m_program, "tutos/M2/is.glsl");
+            m_reload= true;
+        }
+        
+        if(m_reload && program_ready(m_program) != 0)
+        {
+            // nouvelle version prete, ou erreurs
+            m_reload= false;
             program_print_errors(m_program);
         }
         
@@ -261,92 +202,29 @@ struct IS : public App
         {
             clear_key_state(' ');
             mode= (mode +1) % 2;
-        
+            
             if(mode == 1)
             {
                 int mx, my;
                 SDL_GetMouseState(&mx, &my);
                 vec2 pixel= vec2(mx, window_height() - my -1);
-                texcoord= vec2(pixel.x / m_hitp.width(), pixel.y / m_hitp.height());
+                texcoord= vec2((pixel.x + 0.5f) / window_width(), (pixel.y + 0.5f) / window_height());
                 printf("pixel %f %f\n", pixel.x, pixel.y);
                 
                 // go
-                Point d0;
-                Vector dx0, dy0;
-                m_camera.frame(m_hitp.width(), m_hitp.height(), 0, 45, d0, dx0, dy0);
-                
-                Point d1;
-                Vector dx1, dy1;
-                m_camera.frame(m_hitp.width(), m_hitp.height(), 1, 45, d1, dx1, dy1);
-                
-                // pixel
-                Point o= d0 + pixel.x*dx0 + pixel.y*dy0;
-                Point e= d1 + pixel.x*dx1 + pixel.y*dy1;
-
-                Point point;
-                Vector normal;
-                
-                Ray ray(o, e);
-                Hit hit;
-                if(intersect(ray, hit))
-                {
-                    point= hit.p;
-                    normal= hit.n;
-                    
-                    // frame
-                #pragma omp parallel for schedule(dynamic, 16)
-                    for(int y= 0; y < m_hitp.height(); y++)
-                    for(int x= 0; x < m_hitp.width(); x++)
-                    {
-                        // clear
-                        m_hitp(x, y)= Black();
-                        m_hitn(x, y)= Black();
-                        m_hitv(x, y)= Black();
-                        
-                        Point o= d0 + x*dx0 + y*dy0;
-                        Point e= d1 + x*dx1 + y*dy1;
-                        
-                        Ray ray(o, e);
-                        Hit hit;
-                        if(intersect(ray, hit))
-                        {
-                            m_hitp(x, y)= Color(hit.p.x, hit.p.y, hit.p.z);
-                            m_hitn(x, y)= Color(hit.n.x, hit.n.y, hit.n.z);
-                            
-                            Ray shadow(hit.p + hit.n * 0.001f, point + normal * 0.001f);
-                            Hit shadow_hit;
-                            int v= 1;
-                            if(intersect(shadow, shadow_hit))
-                                v= 0;
-                            
-                            m_hitv(x, y)= Color(v, v, v);
-                        }
-                    }
-                    
-                    // transferre les donnees
-                    glActiveTexture(GL_TEXTURE0);
-                    glBindTexture(GL_TEXTURE_2D, m_ptexture);
-                    glTexSubImage2D(GL_TEXTURE_2D, 0, 
-                        0, 0, m_hitp.width(), m_hitp.height(),
-                        GL_RGBA, GL_FLOAT, m_hitp.buffer());
-                    
-                    glActiveTexture(GL_TEXTURE0 +1);
-                    glBindTexture(GL_TEXTURE_2D, m_ntexture);
-                    glTexSubImage2D(GL_TEXTURE_2D, 0, 
-                        0, 0, m_hitn.width(), m_hitn.height(),
-                        GL_RGBA, GL_FLOAT, m_hitn.buffer());
-                    
-                    glActiveTexture(GL_TEXTURE0 +2);
-                    glBindTexture(GL_TEXTURE_2D, m_vtexture);
-                    glTexSubImage2D(GL_TEXTURE_2D, 0, 
-                        0, 0, m_hitv.width(), m_hitv.height(),
-                        GL_RGBA, GL_FLOAT, m_hitv.buffer());
-                }
+                m_tracer.anchor(pixel.x, pixel.y);
+                m_tracer.start();
             }
+            else
+                m_tracer.stop();
         }
         
         if(mode == 1)
         {
+            // recommence l'accumulation si la camera a bouge
+            m_tracer.camera(m_camera);
+            upload();
+            
             glBindVertexArray(m_vao);
             glUseProgram(m_program);
             
@@ -364,6 +242,12 @@ struct IS : public App
             glBindTexture(GL_TEXTURE_2D, m_vtexture);
             
             glDrawArrays(GL_TRIANGLES, 0, 3);
+            
+            clear(m_console);
+            printf(m_console, 0, 0, "%d samples/pixel", m_tracer.samples());
+            printf(m_console, 0, 1, "%.2f Msamples/s", m_tracer.samples_per_second() / 1000000.f);
+            printf(m_console, 0, 2, "first image %.1fms", m_tracer.first_image());
+            draw(m_console, window_width(), window_height());
         }
         
         else if(mode == 0)
@@ -386,6 +270,20 @@ struct IS : public App
     
     int quit( )
     {
+        m_tracer.stop();
+        
+        for(int i= 0; i < 3; i++)
+            if(m_fences[i])
+                glDeleteSync(m_fences[i]);
+        glDeleteBuffers(3, m_pbo);
+        
+        glDeleteTextures(1, &m_ptexture);
+        glDeleteTextures(1, &m_ntexture);
+        glDeleteTextures(1, &m_vtexture);
+        glDeleteVertexArrays(1, &m_vao);
+        release_program(m_program);
+        release_text(m_console);
+        
         m_mesh.release();
         return 0;
     }
@@ -420,54 +318,23 @@ struct IS : public App
         return false;
     }
 
-
-    // recuperer les triangles du mesh
-    int build_triangles( )
-    {
-        for(int i= 0; i < m_mesh.triangle_count(); i++)
-            m_triangles.push_back( Triangle(m_mesh.triangle(i)) );
-        
-        printf("%d triangles.\n", (int) m_triangles.size());
-        return (int) m_triangles.size();
-    }
-
-
-    // calcule l'intersection d'un rayon et de tous les triangles
-    bool intersect( const Ray& ray, Hit& hit )
-    {
-        hit.t= ray.tmax;
-        for(size_t i= 0; i < m_triangles.size(); i++)
-        {
-            float t, u, v;
-            if(m_triangles[i].intersect(ray, hit.t, t, u, v))
-            {
-                hit.t= t;
-                hit.u= u;
-                hit.v= v;
-                
-                hit.p= ray(t);      // evalue la positon du point d'intersection sur le rayon
-                hit.n= m_triangles[i].normal(u, v);
-                
-                hit.object_id= i;	// permet de retrouver toutes les infos associees au triangle
-            }
-        }
-        
-        return (hit.object_id != -1);
-    }
-
 protected:
     Mesh m_mesh;
     Orbiter m_camera;
+    Text m_console;
 
-    std::vector<Triangle> m_triangles;
     std::vector<Source> m_sources;
 
-    Image m_hitp;
-    Image m_hitn;
-    Image m_hitv;
+    Progressive m_tracer;
+    unsigned m_frame;
+    
+    GLuint m_pbo[3];
+    GLsync m_fences[3];
+    int m_pbo_index;
 
     GLuint m_vao;
     GLuint m_program;
+    bool m_reload;
     
     GLuint m_ptexture;
     GLuint m_ntexture;
@@ -475,8 +342,64 @@ protected:
 };
 
 
+// calcule quelques passes sans fenetre ni contexte openGL et enregistre l'image de visibilite.
+int headless( const char *filename, const int passes )
+{
+    Mesh mesh= read_indexed_mesh(filename);
+    if(mesh == Mesh::error())
+        return 1;
+    
+    Orbiter camera;
+    if(camera.read_orbiter("orbiter.txt") < 0)
+    {
+        Point pmin, pmax;
+        mesh.bounds(pmin, pmax);
+        camera.lookat(pmin, pmax);
+    }
+    
+    const int width= 1024;
+    const int height= 640;
+    
+    Progressive tracer;
+    tracer.create(mesh, width, height);
+    tracer.camera(camera);
+    tracer.anchor(width / 2, height / 2);
+    
+    for(int i= 0; i < passes; i++)
+    {
+        tracer.pass();
+        if(i == 0)
+            printf("first image %.1fms\n", tracer.first_image());
+    }
+    printf("%d samples/pixel, %.2f Msamples/s\n", tracer.samples(), tracer.samples_per_second() / 1000000.f);
+    
+    Image hitp(width, height);
+    Image hitn(width, height);
+    Image hitv(width, height);
+    unsigned frame= 0;
+    tracer.read(&hitp(0, 0), &hitn(0, 0), &hitv(0, 0), frame);
+    
+    if(write_image(hitv, "is_visibility.png") < 0)
+        return 1;
+    return 0;
+}
+
+
 int main( int argc, char **argv )
 {
+    // tuto_is --headless [file.obj] [passes]
+    if(argc > 1 && strcmp(argv[1], "--headless") == 0)
+    {
+        const char *filename= "cornell.obj";
+        if(argc > 2)
+            filename= argv[2];
+        int passes= 16;
+        if(argc > 3)
+            passes= atoi(argv[3]);
+        
+        return headless(filename, passes);
+    }
+    
     const char *filename= "cornell.obj";
     if(argc > 1)
         filename= argv[1];
@@ -1,5 +1,5 @@
 
-//! \file tuto_mdi.cpp affichage de plusieurs objets avec glMultiDrawIndirect() + mesure du temps d'execution par le cpu et le gpu (utilise une requete / query openGL)
+//! \file tuto_mdi.cpp affichage de plusieurs objets avec glMultiDrawIndirect() + niveaux de details + mesure du temps d'execution par le cpu et le gpu (utilise une requete / query openGL)
 
 #include <chrono>
 
@@ -9,6 +9,7 @@
 
 #include "wavefront.h"
 #include "texture.h"
+#include "lod.h"
 
 #include "orbiter.h"
 #include "draw.h"
@@ -20,9 +21,10 @@
 // representation des parametres 
 struct IndirectParam
 {
-    unsigned int vertex_count;
+    unsigned int index_count;
     unsigned int instance_count;
-    unsigned int first_vertex;
+    unsigned int first_index;
+    int base_vertex;
     unsigned int first_instance;
 };
 
@@ -40,17 +42,20 @@ public:
             return -1;
         printf("GL_ARB_shader_draw_parameters ON\n");
             
-        m_objet= read_mesh("data/bigguy.obj");
+        m_objet= read_indexed_mesh("data/bigguy.obj");
         Point pmin, pmax;
         m_objet.bounds(pmin, pmax);
         m_camera.lookat(pmin - Vector(200, 200,  0), pmax + Vector(200, 200, 0));
         
+        // niveaux de details, chaque niveau divise par 2 le nombre de triangles
+        m_lod.build(m_objet, 5, 0.5f, "data/bigguy.lod");
+        
         // genere les parametres des draws et les transformations
         for(int y= -15; y <= 15; y++)
         for(int x= -15; x <= 15; x++)
         {
             m_multi_model.push_back( Translation(x *20, y *20, 0) );
-            m_multi_indirect.push_back( { unsigned(m_objet.vertex_count()), 1, 0, 0} );
+            m_multi_indirect.push_back( { unsigned(m_objet.index_count()), 1, 0, 0, 0} );
         }
         // oui c'est la meme chose qu'un draw instancie, mais c'est juste pour comparer les 2 solutions...
         
@@ -67,6 +72,13 @@ public:
         // creation des vertex buffer, uniquement les positions
         m_vao= m_objet.create_buffers(/* texcoords */ false, /* normals */ false, /* colors */ false);
         
+        // remplace l'index buffer par les indices de tous les niveaux de details
+        glBindVertexArray(m_vao);
+        glGenBuffers(1, &m_index_buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * m_lod.indices().size(), m_lod.indices().data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        
         // shader programs
         m_program_direct= read_program("tutos/M2/indirect_direct.glsl");        // affichage classique N draws
         program_print_errors(m_program_direct);
@@ -97,7 +109,9 @@ public:
         
         release_program(m_program);
         m_objet.release();
+        glDeleteBuffers(1, &m_index_buffer);
         glDeleteBuffers(1, &m_indirect_buffer);
+        glDeleteBuffers(1, &m_model_buffer);
         
         return 0;
     }
@@ -122,6 +136,23 @@ public:
         else if(mb & SDL_BUTTON(2))         // le bouton du milieu est enfonce
             m_camera.translation((float) mx / (float) window_width(), (float) my / (float) window_height());
         
+        Transform view= m_camera.view();
+        Transform projection= m_camera.projection(window_width(), window_height(), 45);
+        
+        // choisit le niveau de details de chaque objet, erreur < 1 pixel
+        long int triangles= 0;
+        for(int i= 0; i < int(m_multi_model.size()); i++)
+        {
+            int id= m_lod.select(m_multi_model[i] * m_model, view, projection, window_height());
+            m_multi_indirect[i].index_count= m_lod.level(id).count;
+            m_multi_indirect[i].first_index= m_lod.level(id).first;
+            triangles+= m_lod.triangle_count(id);
+        }
+        long int full= long(m_objet.triangle_count()) * long(m_multi_model.size());
+        
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(IndirectParam) * m_multi_indirect.size(), m_multi_indirect.data());
+        
         // mesure le temps d'execution du draw
         glBeginQuery(GL_TIME_ELAPSED, m_time_query);    // pour le gpu
         std::chrono::high_resolution_clock::time_point cpu_start= std::chrono::high_resolution_clock::now();    // pour le cpu
@@ -132,32 +163,32 @@ public:
         glUseProgram(m_program_direct);
         
         program_uniform(m_program_direct, "modelMatrix", m_model);
-        program_uniform(m_program_direct, "vpMatrix", m_camera.projection(window_width(), window_height(), 45) * m_camera.view());
-        program_uniform(m_program_direct, "viewMatrix", m_camera.view());
+        program_uniform(m_program_direct, "vpMatrix", projection * view);
+        program_uniform(m_program_direct, "viewMatrix", view);
         
         // dessine l'objet avec 1 draw par copie
         for(int i= 0; i < int(m_multi_model.size()); i++)
         {
             program_uniform(m_program_direct, "objectMatrix", m_multi_model[i]);
-            glDrawArrays(GL_TRIANGLES, 0, m_objet.vertex_count());
+            glDrawElements(GL_TRIANGLES, m_multi_indirect[i].index_count, GL_UNSIGNED_INT, (const void *) (m_multi_indirect[i].first_index * sizeof(unsigned int)));
         }
         // dans ce cas particulier, on pourrait utiliser un draw instancie, mais ce n'est pas le but du tuto...
         
     #else
-        // dessine n copies de l'objet avec 1 seul appel a glMultiDrawArraysIndirect
+        // dessine n copies de l'objet avec 1 seul appel a glMultiDrawElementsIndirect
         glBindVertexArray(m_vao);
         glUseProgram(m_program);
         
         // uniforms...
         program_uniform(m_program, "modelMatrix", m_model);
-        program_uniform(m_program, "vpMatrix", m_camera.projection(window_width(), window_height(), 45) * m_camera.view());
-        program_uniform(m_program, "viewMatrix", m_camera.view());
+        program_uniform(m_program, "vpMatrix", projection * view);
+        program_uniform(m_program, "viewMatrix", view);
         
         // buffers...
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0,  m_model_buffer);
         glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
         
-        glMultiDrawArraysIndirect(m_objet.primitives(), 0, m_multi_indirect.size(), 0);
+        glMultiDrawElementsIndirect(m_objet.primitives(), GL_UNSIGNED_INT, 0, m_multi_indirect.size(), 0);
     #endif
         
         
@@ -174,17 +205,20 @@ public:
         clear(m_console);
         printf(m_console, 0, 0, "cpu  %02dms %03dus", (int) (cpu_time / 1000000), (int) ((cpu_time / 1000) % 1000));
         printf(m_console, 0, 1, "gpu  %02dms %03dus", (int) (gpu_time / 1000000), (int) ((gpu_time / 1000) % 1000));
+        printf(m_console, 0, 2, "triangles %ldK / %ldK (-%d%%)", triangles / 1000, full / 1000, int(100 - 100 * triangles / full));
         
         draw(m_console, window_width(), window_height());
         
         printf("cpu    %02dms %03dus    ", (int) (cpu_time / 1000000), (int) ((cpu_time / 1000) % 1000));
-        printf("gpu    %02dms %03dus\n", (int) (gpu_time / 1000000), (int) ((gpu_time / 1000) % 1000));
+        printf("gpu    %02dms %03dus    ", (int) (gpu_time / 1000000), (int) ((gpu_time / 1000) % 1000));
+        printf("triangles %ldK / %ldK\n", triangles / 1000, full / 1000);
         
         return 1;
     }
     
 protected:
     GLuint m_indirect_buffer;
+    GLuint m_index_buffer;
     GLuint m_model_buffer;
     GLuint m_time_query;
     
@@ -196,6 +230,7 @@ protected:
 
     Transform m_model;
     Mesh m_objet;
+    MeshLOD m_lod;
     Orbiter m_camera;
     
     std::vector<IndirectParam> m_multi_indirect;
@@ -1,5 +1,5 @@
 
-//! \file tuto_mdi_count.cpp 
+//! \file tuto_mdi_count.cpp affichage des groupes de triangles visibles de plusieurs objets, selectionnes par un compute shader, avec glMultiDrawArraysIndirectCount()
 
 #include <chrono>
 
@@ -9,6 +9,7 @@
 
 #include "wavefront.h"
 #include "texture.h"
+#include "meshlet.h"
 
 #include "orbiter.h"
 #include "draw.h"
@@ -33,6 +34,8 @@ struct alignas(16) Object
     unsigned int vertex_count;
     Point pmax;
     unsigned int vertex_base;
+    Vector cone_axis;
+    float cone_cutoff;
 };
 // alignement GLSL correct...
 
@@ -52,22 +55,34 @@ public:
             return -1;
         printf("GL_ARB_shader_draw_parameters ON\n");
         
-        m_object= read_mesh("data/bigguy.obj");
+        Mesh mesh= read_mesh("data/bigguy.obj");
         Point pmin, pmax;
-        m_object.bounds(pmin, pmax);
+        mesh.bounds(pmin, pmax);
         m_camera.lookat(pmin - Vector(200, 200,  0), pmax + Vector(200, 200, 0));
         
-        // genere les parametres des draws et les transformations
+        // decoupe l'objet en groupes de triangles
+        std::vector<unsigned int> cluster_indices;
+        std::vector<Meshlet> meshlets= build_meshlets(mesh.indices(), mesh.positions(), cluster_indices);
+        printf("%d clusters\n", int(meshlets.size()));
+        
+        // re-ordonne les sommets, les triangles de chaque groupe sont consecutifs
+        m_object= Mesh(GL_TRIANGLES);
+        for(unsigned int i= 0; i < cluster_indices.size(); i++)
+            m_object.vertex(mesh.positions()[cluster_indices[i]]);
+        
+        // boite englobante et cone des normales de chaque groupe, dans le repere de l'objet
+        for(unsigned int i= 0; i < meshlets.size(); i++)
+            m_objects.push_back( {meshlets[i].pmin, meshlets[i].count, meshlets[i].pmax, meshlets[i].first, meshlets[i].cone_axis, meshlets[i].cone_cutoff} );
+        
+        // genere les transformations
         for(int y= -15; y <= 15; y++)
         for(int x= -15; x <= 15; x++)
-        {
             m_multi_model.push_back( Translation(x *20, y *20, 0) );
-            
-            // calcule la bbox de chaque objet dans le repere du monde
-            m_objects.push_back( {pmin + Vector(x *20, y *20, 0), unsigned(m_object.vertex_count()), pmax + Vector(x *20, y *20, 0), 0} );
-        }
         // oui c'est la meme chose qu'un draw instancie, mais c'est juste pour comparer les 2 solutions...
         
+        // nombre max de draws, tous les groupes de toutes les copies
+        m_draw_count= m_objects.size() * m_multi_model.size();
+        
         // transformations des objets
         glGenBuffers(1, &m_model_buffer);
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_model_buffer);
@@ -81,12 +96,12 @@ public:
         // re-indexation des objets visibles
         glGenBuffers(1, &m_remap_buffer);
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_remap_buffer);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(int) * m_objects.size(), nullptr, GL_DYNAMIC_DRAW);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(int) * m_draw_count, nullptr, GL_DYNAMIC_DRAW);
         
         // parametres du multi draw indirect
         glGenBuffers(1, &m_indirect_buffer);
         glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
-        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(IndirectParam) * m_objects.size(), nullptr, GL_DYNAMIC_DRAW);   
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(IndirectParam) * m_draw_count, nullptr, GL_DYNAMIC_DRAW);   
         
         // nombre de draws de multi draw indirect count 
         glGenBuffers(1, &m_parameter_buffer);
@@ -129,6 +144,7 @@ public:
         
         m_object.release();
         
+        glDeleteBuffers(1, &m_model_buffer);
         glDeleteBuffers(1, &m_indirect_buffer);
         glDeleteBuffers(1, &m_parameter_buffer);
         glDeleteBuffers(1, &m_remap_buffer);
@@ -149,7 +165,7 @@ public:
         
         // deplace la camera
         int mx, my;
-        unsigned int mb= SDL_GetRelativeMouseState(&mx, &my);
+        unsigned int mb= relative_mouse_state(&mx, &my);
         if(mb & SDL_BUTTON(1))              // le bouton gauche est enfonce
             m_camera.rotation(mx, my);
         else if(mb & SDL_BUTTON(3))         // le bouton droit est enfonce
@@ -161,19 +177,22 @@ public:
         glBeginQuery(GL_TIME_ELAPSED, m_time_query);    // pour le gpu
         std::chrono::high_resolution_clock::time_point cpu_start= std::chrono::high_resolution_clock::now();    // pour le cpu
         
-        // etape 1: compute shader, tester l'inclusion des objets dans une boite
+        Transform view= m_camera.view();
+        Transform projection= m_camera.projection(window_width(), window_height(), 45);
+        
+        // etape 1: compute shader, tester la visibilite des groupes de triangles de chaque objet
         glUseProgram(m_program_cull);
         
         // uniforms...
-        program_uniform(m_program_cull, "bmin", Point(-60, -60, -10));
-        program_uniform(m_program_cull, "bmax", Point(60, 60, 10));
-        //~ program_uniform(m_program_cull, "bmin", Point(-120, -120, -10));
-        //~ program_uniform(m_program_cull, "bmax", Point(120, 120, 10));
+        program_uniform(m_program_cull, "modelMatrix", m_model);
+        program_uniform(m_program_cull, "vpMatrix", projection * view);
+        program_uniform(m_program_cull, "camera", m_camera.position());
         
         // storage buffers...
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_object_buffer);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_remap_buffer);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_indirect_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_model_buffer);
         
         // compteur
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_parameter_buffer);
@@ -184,8 +203,8 @@ public:
         // glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(int), &zero);
         
         // nombre de groupes de shaders
-        int n= m_objects.size() / 256;
-        if(m_objects.size() % 256)
+        int n= m_draw_count / 256;
+        if(m_draw_count % 256)
             n= n +1;
         
         glDispatchCompute(n, 1, 1);
@@ -199,8 +218,8 @@ public:
         
         // uniforms...
         program_uniform(m_program, "modelMatrix", m_model);
-        program_uniform(m_program, "vpMatrix", m_camera.projection(window_width(), window_height(), 45) * m_camera.view());
-        program_uniform(m_program, "viewMatrix", m_camera.view());
+        program_uniform(m_program, "vpMatrix", projection * view);
+        program_uniform(m_program, "viewMatrix", view);
         
         // storage buffers...
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_model_buffer);
@@ -210,7 +229,7 @@ public:
         glBindBuffer(GL_PARAMETER_BUFFER_ARB, m_parameter_buffer);
         glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
         
-        glMultiDrawArraysIndirectCountARB(m_object.primitives(), 0, 0, m_objects.size(), 0);
+        glMultiDrawArraysIndirectCountARB(m_object.primitives(), 0, 0, m_draw_count, 0);
         
         // affiche le temps 
         glEndQuery(GL_TIME_ELAPSED);
@@ -221,14 +240,20 @@ public:
         GLint64 gpu_time= 0;
         glGetQueryObjecti64v(m_time_query, GL_QUERY_RESULT, &gpu_time);
         
+        // recupere le nombre de groupes dessines
+        unsigned int draws= 0;
+        glGetBufferSubData(GL_PARAMETER_BUFFER_ARB, 0, sizeof(unsigned int), &draws);
+        
         clear(m_console);
         printf(m_console, 0, 0, "cpu  %02dms %03dus", (int) (cpu_time / 1000000), (int) ((cpu_time / 1000) % 1000));
         printf(m_console, 0, 1, "gpu  %02dms %03dus", (int) (gpu_time / 1000000), (int) ((gpu_time / 1000) % 1000));
+        printf(m_console, 0, 2, "clusters %d / %d", draws, m_draw_count);
         
         draw(m_console, window_width(), window_height());
         
         printf("cpu    %02dms %03dus    ", (int) (cpu_time / 1000000), (int) ((cpu_time / 1000) % 1000));
-        printf("gpu    %02dms %03dus\n", (int) (gpu_time / 1000000), (int) ((gpu_time / 1000) % 1000));
+        printf("gpu    %02dms %03dus    ", (int) (gpu_time / 1000000), (int) ((gpu_time / 1000) % 1000));
+        printf("clusters %d / %d\n", draws, m_draw_count);
         
         return 1;
     }
@@ -253,6 +278,7 @@ protected:
     
     std::vector<Transform> m_multi_model;
     std::vector<Object> m_objects;
+    int m_draw_count;
 
 };
 
@@ -0,0 +1,169 @@
+
+//! \file tuto_mipmap.cpp mesure le temps de construction des mipmaps : mipmap_resize( ) de material_data.cpp, glGenerateMipmap( ) et mipmap_levels( ).
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+
+#include "image_io.h"
+#include "mipmap.h"
+#include "texture.h"
+#include "app.h"
+
+
+// version de reference, cf material_data.cpp : reconstruit chaque niveau a partir de l'image complete, sans correction gamma
+static
+void mipmap_resize( ImageData& image, const int lod )
+{
+    int w= image.width;
+    int h= image.height;
+    int stride= image.channels;
+    int row_stride= image.width;
+    for(int l= 0; l < lod; l++)
+    {
+        w= std::max(1, w / 2);
+        h= std::max(1, h / 2);
+
+        for(int y= 0; y < h; y++)
+        for(int x= 0; x < w; x++)
+        for(int i= 0; i < image.channels; i++)
+        {
+            int m= 0;
+            m= m + image.data[((2*y) * row_stride + 2*x) * stride + i];
+            m= m + image.data[((2*y) * row_stride + 2*x +1) * stride + i];
+            m= m + image.data[((2*y +1) * row_stride + 2*x) * stride + i];
+            m= m + image.data[((2*y +1) * row_stride + 2*x +1) * stride + i];
+
+            image.data[(y * w + x) * stride + i]= m / 4;
+        }
+
+        row_stride= w;
+    }
+
+    image.width= w;
+    image.height= h;
+    image.data.resize(size_t(w) * h * stride);
+}
+
+static
+std::vector<ImageData> reference_levels( const ImageData& image )
+{
+    std::vector<ImageData> levels;
+    levels.push_back(image);
+    for(int lod= 1; levels.back().width > 1 || levels.back().height > 1; lod++)
+    {
+        ImageData level= image;
+        mipmap_resize(level, lod);
+        levels.push_back(level);
+    }
+
+    return levels;
+}
+
+
+// renvoie le temps min en ms de plusieurs executions de f
+template < typename F >
+float measure( F f, const int runs= 5 )
+{
+    float best= 0;
+    for(int i= 0; i < runs; i++)
+    {
+        std::chrono::high_resolution_clock::time_point start= std::chrono::high_resolution_clock::now();
+        f();
+        std::chrono::high_resolution_clock::time_point stop= std::chrono::high_resolution_clock::now();
+
+        float time= float(std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()) / 1000;
+        if(i == 0 || time < best)
+            best= time;
+    }
+
+    return best;
+}
+
+// ecart max entre les texels de 2 niveaux de meme dimension
+static
+int max_difference( const ImageData& a, const ImageData& b )
+{
+    if(a.width != b.width || a.height != b.height || a.channels != b.channels)
+        return -1;
+
+    int m= 0;
+    for(size_t i= 0; i < a.data.size(); i++)
+        m= std::max(m, std::abs(int(a.data[i]) - int(b.data[i])));
+    return m;
+}
+
+
+class TP : public App
+{
+public:
+    TP( const char *filename ) : App(256, 256, 4, 3), m_filename(filename) {}
+
+    int init( )
+    {
+        ImageData image= read_image_data(m_filename);
+        if(image.data.empty())
+            return -1;
+
+        printf("%s: %dx%d, %d channels\n", m_filename, image.width, image.height, image.channels);
+
+        std::vector<ImageData> reference;
+        float reference_time= measure( [&]() { reference= reference_levels(image); } );
+        printf("  mipmap_resize( )           %8.2fms, %d levels\n", reference_time, int(reference.size()));
+
+        std::vector<ImageData> box;
+        float box_time= measure( [&]() { box= mipmap_levels(image, MIPMAP_BOX, false); } );
+        printf("  mipmap_levels( box )       %8.2fms, level 1 max difference %d\n", box_time, max_difference(box[1], reference[1]));
+
+        std::vector<ImageData> box_srgb;
+        float box_srgb_time= measure( [&]() { box_srgb= mipmap_levels(image, MIPMAP_BOX, true); } );
+        printf("  mipmap_levels( box, srgb ) %8.2fms\n", box_srgb_time);
+
+        std::vector<ImageData> kaiser;
+        float kaiser_time= measure( [&]() { kaiser= mipmap_levels(image, MIPMAP_KAISER, true); } );
+        printf("  mipmap_levels( kaiser )    %8.2fms\n", kaiser_time);
+
+        Image float_image= read_image(m_filename);
+        std::vector<Image> float_levels;
+        float float_time= measure( [&]() { float_levels= mipmap_levels(float_image, MIPMAP_BOX); } );
+        printf("  mipmap_levels( float box ) %8.2fms\n", float_time);
+
+        float float_kaiser_time= measure( [&]() { float_levels= mipmap_levels(float_image, MIPMAP_KAISER); } );
+        printf("  mipmap_levels( float kaiser ) %5.2fms\n", float_kaiser_time);
+
+        // glGenerateMipmap( ) sur le gpu, glFinish( ) pour attendre la fin
+        GLuint texture= make_texture(0, image);
+        glFinish();
+        float gl_time= measure( [&]() { glGenerateMipmap(GL_TEXTURE_2D); glFinish(); } );
+        printf("  glGenerateMipmap( )        %8.2fms\n", gl_time);
+        glDeleteTextures(1, &texture);
+
+        // transfert des niveaux precalcules
+        float upload_time= measure( [&]() { GLuint t= make_texture(0, kaiser); glFinish(); glDeleteTextures(1, &t); } );
+        printf("  make_texture( levels )     %8.2fms\n", upload_time);
+
+        return 0;
+    }
+
+    int quit( ) { return 0; }
+
+    // pas d'affichage, uniquement les mesures
+    int render( ) { return 0; }
+
+protected:
+    const char *m_filename;
+};
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/monde.jpg";
+    if(argc > 1)
+        filename= argv[1];
+
+    TP tp(filename);
+    tp.run();
+
+    return 0;
+}
@@ -11,6 +11,7 @@
 
 #include "mesh.h"
 #include "wavefront.h"
+#include "bvh.h"
 
 #include "program.h"
 #include "uniforms.h"
@@ -70,9 +71,10 @@ namespace glsl
 struct RT : public AppTime
 {
     // constructeur : donner les dimensions de l'image, et eventuellement la version d'openGL.
-    RT( const char *filename ) : AppTime(1024, 640) 
+    // openGL 4.3 pour les storage buffers
+    RT( const char *filename ) : AppTime(1024, 640, 4, 3) 
     {
-        m_mesh= read_mesh(filename);
+        m_mesh= read_indexed_mesh(filename);
     }
     
     int init( )
@@ -87,8 +89,9 @@ struct RT : public AppTime
         glGenVertexArrays(1, &m_vao);
         glBindVertexArray(m_vao);
         
-        glGenBuffers(1, &m_buffer);
-        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+        // construit le bvh
+        BVH bvh;
+        bvh.build(m_mesh);
         
         // 
         struct triangle 
@@ -98,33 +101,49 @@ struct RT : public AppTime
             glsl::vec3 ac;
         };
         
+        // triangles dans l'ordre des feuilles du bvh
         std::vector<triangle> data;
         data.reserve(m_mesh.triangle_count());
-        for(int i= 0; i < m_mesh.triangle_count(); i++)
+        for(int id : bvh.primitives())
         {
-            TriangleData t= m_mesh.triangle(i);
+            TriangleData t= m_mesh.triangle(id);
             data.push_back( { Point(t.a), Point(t.b) - Point(t.a), Point(t.c) - Point(t.a) } );
         }
         
-        // alloue le buffer
-        // alloue au moins 1024 triangles, cf le shader
-        if(data.size() < 1024)
-            data.resize(1024);
-        glBufferData(GL_UNIFORM_BUFFER, data.size() * sizeof(triangle), data.data(), GL_STATIC_READ);
-
+        glGenBuffers(1, &m_buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, data.size() * sizeof(triangle), data.data(), GL_STATIC_READ);
+        
+        // noeuds, BVHNode respecte deja l'alignement std430, cf bvh.h
+        glGenBuffers(1, &m_node_buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_node_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, bvh.nodes().size() * sizeof(BVHNode), bvh.nodes().data(), GL_STATIC_READ);
+        
         //
-        m_program= read_program("tutos/M2/raytrace.glsl");
-        program_print_errors(m_program);
-
-        // associe l'uniform buffer a l'entree 0
-        GLint index= glGetUniformBlockIndex(m_program, "triangleData");
-        glUniformBlockBinding(m_program, index, 0);
+        m_program_linear= read_program("tutos/M2/raytrace.glsl");
+        program_print_errors(m_program_linear);
+        m_program_bvh= read_program("tutos/M2/raytrace.glsl", "#define USE_BVH\n");
+        program_print_errors(m_program_bvh);
+        m_use_bvh= true;
+        
+        // mesure le temps du draw, sans interferer avec la requete de AppTime
+        glGenQueries(2*QUERIES, &m_queries[0][0]);
+        m_query_first= 0;
+        m_query_count= 0;
+        m_frames= 0;
+        m_time= 0;
         
         return 0;
     }
     
     int quit( )
     {
+        glDeleteQueries(2*QUERIES, &m_queries[0][0]);
+        release_program(m_program_linear);
+        release_program(m_program_bvh);
+        glDeleteBuffers(1, &m_buffer);
+        glDeleteBuffers(1, &m_node_buffer);
+        glDeleteVertexArrays(1, &m_vao);
         return 0;
     }
     
@@ -140,6 +159,14 @@ struct RT : public AppTime
             m_camera.lookat(pmin, pmax);        
         }
         
+        if(key_state('b'))
+        {
+            clear_key_state('b');
+            m_use_bvh= !m_use_bvh;
+            m_frames= 0;
+            m_time= 0;
+        }
+        
         // deplace la camera
         int mx, my;
         unsigned int mb= SDL_GetRelativeMouseState(&mx, &my);
@@ -156,26 +183,93 @@ struct RT : public AppTime
         Transform mvp= p * v * m;
         
         // config pipeline
+        GLuint program= m_use_bvh ? m_program_bvh : m_program_linear;
         glBindVertexArray(m_vao);
-        glUseProgram(m_program);
+        glUseProgram(program);
         
-        // uniform buffer 0
-        glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_buffer);
-        program_uniform(m_program, "triangle_count", std::min((int) m_mesh.triangle_count(), 1024) );
+        // storage buffers 0 et 1
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_node_buffer);
+        if(!m_use_bvh)
+            program_uniform(program, "triangle_count", (int) m_mesh.triangle_count());
         
-        program_uniform(m_program, "mvpInvMatrix", mvp.inverse());
+        program_uniform(program, "mvpInvMatrix", mvp.inverse());
+        
+        // attend le resultat le plus ancien uniquement si toutes les requetes sont utilisees
+        if(m_query_count == QUERIES)
+            read_time_query(true);
+        
+        int q= (m_query_first + m_query_count) % QUERIES;
+        glQueryCounter(m_queries[q][0], GL_TIMESTAMP);
         glDrawArrays(GL_TRIANGLES, 0, 3);
+        glQueryCounter(m_queries[q][1], GL_TIMESTAMP);
+        m_query_bvh[q]= m_use_bvh;
+        m_query_count++;
+        
+        // recupere les resultats disponibles, sans attendre
+        while(read_time_query(false))
+            {}
         
         return 1;
     }
     
+    // temps moyen du shader, linear ou bvh, cf AppTime::read_time_query( )
+    bool read_time_query( const bool wait )
+    {
+        if(m_query_count == 0)
+            return false;
+        
+        const GLuint *queries= m_queries[m_query_first];
+        if(!wait)
+        {
+            // le resultat est-il disponible ?
+            GLint available= 0;
+            glGetQueryObjectiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if(!available)
+                return false;
+        }
+        
+        GLint64 start= 0;
+        GLint64 stop= 0;
+        glGetQueryObjecti64v(queries[0], GL_QUERY_RESULT, &start);
+        glGetQueryObjecti64v(queries[1], GL_QUERY_RESULT, &stop);
+        
+        // ignore les mesures de l'autre mode, apres un changement
+        if(m_query_bvh[m_query_first] == m_use_bvh)
+        {
+            m_time+= stop - start;
+            m_frames++;
+            if(m_frames == 100)
+            {
+                printf("%s: %.2fms\n", m_use_bvh ? "bvh" : "linear", double(m_time) / m_frames / 1000000.0);
+                m_frames= 0;
+                m_time= 0;
+            }
+        }
+        
+        m_query_first= (m_query_first + 1) % QUERIES;
+        m_query_count--;
+        return true;
+    }
+    
 protected:
     Mesh m_mesh;
     Orbiter m_camera;
 
-    GLuint m_program;
+    GLuint m_program_linear;
+    GLuint m_program_bvh;
     GLuint m_vao;
     GLuint m_buffer;
+    GLuint m_node_buffer;
+    bool m_use_bvh;
+    
+    enum { QUERIES= 4 };
+    GLuint m_queries[QUERIES][2];
+    bool m_query_bvh[QUERIES];
+    int m_query_first;
+    int m_query_count;
+    GLint64 m_time;
+    int m_frames;
 };
 
     
@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <ctime>
 #include <chrono>
+#include <algorithm>
 
 #include "vec.h"
 #include "mat.h"
@@ -15,9 +16,27 @@
 #include "uniforms.h"
 
 #include "orbiter.h"
+#include "cull.h"
+#include "stream_buffer.h"
 #include "app_time.h"
 
 
+// code de morton 3d, 8 bits par axe
+static unsigned int morton( const unsigned int x, const unsigned int y, const unsigned int z )
+{
+    auto spread= []( unsigned int v )
+    {
+        v= (v | (v << 16)) & 0x030000FF;
+        v= (v | (v << 8)) & 0x0300F00F;
+        v= (v | (v << 4)) & 0x030C30C3;
+        v= (v | (v << 2)) & 0x09249249;
+        return v;
+    };
+    
+    return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+
 class DrawInstanceBuffer : public AppTime
 {
 public:
@@ -76,8 +95,35 @@ public:
             m_positions.push_back(vec3(x *4, y *4, z *4));
         }
         
+        // trie les instances, les cubes voisins sont consecutifs dans le buffer et peuvent etre dessines par le meme draw, cf build_indirect( )
+        auto key= []( const vec3& p ) { return morton(unsigned(p.x / 4 + 128), unsigned(p.y / 4 + 128), unsigned(p.z / 4 + 128)); };
+        std::sort(m_positions.begin(), m_positions.end(), 
+            [&]( const vec3& a, const vec3& b ) { return key(a) < key(b); });
+        
         m_instance_count= int(m_positions.size());
         
+        // boites englobantes des instances, pour les tests de visibilite
+        for(int i= 0; i < m_instance_count; i++)
+            m_boxes.push(pmin + Vector(m_positions[i]), pmax + Vector(m_positions[i]));
+        
+        // verifie et mesure les tests de visibilite
+        {
+            Frustum frustum(m_camera.projection(window_width(), window_height(), 45) * m_camera.view());
+            
+            std::vector<unsigned int> reference;
+            std::chrono::high_resolution_clock::time_point scalar_start= std::chrono::high_resolution_clock::now();
+            cull_scalar(frustum, m_boxes, reference);
+            std::chrono::high_resolution_clock::time_point scalar_stop= std::chrono::high_resolution_clock::now();
+            cull(frustum, m_boxes, m_visible);
+            std::chrono::high_resolution_clock::time_point simd_stop= std::chrono::high_resolution_clock::now();
+            
+            double scalar_time= std::chrono::duration<double, std::nano>(scalar_stop - scalar_start).count();
+            double simd_time= std::chrono::duration<double, std::nano>(simd_stop - scalar_stop).count();
+            printf("cull %d instances: scalar %.2fns, simd %.2fns /instance\n", m_instance_count, scalar_time / m_instance_count, simd_time / m_instance_count);
+            if(reference != m_visible)
+                printf("[error] cull: %d / %d visible instances...\n", int(m_visible.size()), int(reference.size()));
+        }
+        
         printf("buffer %dKB\n", int(sizeof(vec3) * m_positions.size() / 1024));
         
         // cree et initialise le buffer d'instance
@@ -92,16 +138,16 @@ public:
         glVertexAttribDivisor(1, 1);    // !! c'est la seule difference entre un attribut de sommet et un attribut d'instance !!
         glEnableVertexAttribArray(1);
         
-        // openGL 4.3
-        glGenBuffers(1, &m_instance_storage);
-        glBindBuffer(GL_ARRAY_BUFFER, m_instance_storage);
-        //~ glBufferStorage(GL_ARRAY_BUFFER,  sizeof(vec3) * m_positions.size(), m_positions.data(), GL_DYNAMIC_STORAGE_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
-        glBufferStorage(GL_ARRAY_BUFFER,  sizeof(vec3) * m_positions.size(), nullptr, GL_DYNAMIC_STORAGE_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
+        // parametres des draws des instances visibles
+        glGenBuffers(1, &m_indirect_buffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(IndirectParam) * 1024, nullptr, GL_STREAM_DRAW);
+        m_indirect_size= 1024;
         
-        m_storage= glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(vec3) * m_positions.size(), 
-            GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_WRITE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT | GL_MAP_PERSISTENT_BIT);
-        if(m_storage == nullptr) 
+        // openGL 4.4, buffer persistant, 3 regions utilisees a tour de role
+        if(m_stream.create(GL_ARRAY_BUFFER, sizeof(vec3) * m_positions.size()) < 0)
             return -1;
+        printf("stream buffer: persistent %d, 3x%dKB\n", int(m_stream.persistent()), int(m_stream.region_size() / 1024));
         
         // cree et initialise un autre vao 
         glGenVertexArrays(1, &m_vao_storage);
@@ -113,7 +159,8 @@ public:
         glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, /* stride */ 0, (const GLvoid *) offset_normals);
         glEnableVertexAttribArray(2);
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_instance_storage);
+        // l'offset de l'attribut d'instance change a chaque image, cf render( )
+        glBindBuffer(GL_ARRAY_BUFFER, m_stream.buffer());
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, /* stride */ 0, /* offset */ 0);
         glVertexAttribDivisor(1, 1);    // !! c'est la seule difference entre un attribut de sommet et un attribut d'instance !!
         glEnableVertexAttribArray(1);
@@ -146,6 +193,12 @@ public:
         glDeleteVertexArrays(1, &m_vao);
         glDeleteBuffers(1, &m_buffer);
         glDeleteBuffers(1, &m_instance_buffer);
+        glDeleteBuffers(1, &m_indirect_buffer);
+        glDeleteVertexArrays(1, &m_vao_storage);
+        m_stream.release();
+        
+        if(m_stream.stalls())
+            printf("stream buffer: %d stalls, %dus\n", m_stream.stalls(), int(m_stream.stall_time()));
         return 0;
     }
     
@@ -162,7 +215,7 @@ public:
 
         // deplace la camera
         int mx, my;
-        unsigned int mb= SDL_GetRelativeMouseState(&mx, &my);
+        unsigned int mb= relative_mouse_state(&mx, &my);
         if(mb & SDL_BUTTON(1))              // le bouton gauche est enfonce
             m_camera.rotation(mx, my);
         else if(mb & SDL_BUTTON(3))         // le bouton droit est enfonce
@@ -174,7 +227,7 @@ public:
         if(key_state(SDLK_SPACE))
         {
             clear_key_state(SDLK_SPACE);
-            mode= (mode + 1) % 5;
+            mode= (mode + 1) % 6;
             printf("mode %d\n", mode);
         }
         
@@ -210,39 +263,73 @@ public:
         else if(mode == 3)
         {
             // strategie 4 :
-            // persistant map + flush
+            // persistant map, ecrit les positions dans la region de l'image, pendant que le gpu lit les regions des images precedentes
             
             std::chrono::high_resolution_clock::time_point copy_start= std::chrono::high_resolution_clock::now();
-            memcpy(m_storage, m_positions.data(), sizeof(vec3) * m_positions.size());
+            size_t offset= m_stream.write(m_positions.data(), sizeof(vec3) * m_positions.size());
+            m_stream.flush();
             
             std::chrono::high_resolution_clock::time_point copy_stop= std::chrono::high_resolution_clock::now();
             auto copy_time= std::chrono::duration_cast<std::chrono::microseconds>(copy_stop - copy_start).count();
             //~ printf("copy  %02dus\n", int(copy_time));
             
-            glBindBuffer(GL_ARRAY_BUFFER, m_instance_storage);            
-            glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0,  sizeof(vec3) * m_positions.size());
-            
             glBindVertexArray(m_vao_storage);
+            glBindBuffer(GL_ARRAY_BUFFER, m_stream.buffer());
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, /* stride */ 0, (const GLvoid *) offset);
         }
-        else
+        else if(mode == 4)
         {
             // pas de modifications
             glBindVertexArray(m_vao);
         }
         
-        // draw
-        glUseProgram(m_program);
-        
         Transform m= m_model;
         Transform v= m_camera.view();
         Transform p= m_camera.projection(window_width(), window_height(), 45);
         Transform mvp= p * v * m;
         Transform mv= v * m;
         
+        if(mode == 5)
+        {
+            // strategie 5 :
+            // pas de modifications, elimine les instances en dehors de la region visible par la camera
+            // et transfere uniquement les parametres des draws des instances visibles
+            std::chrono::high_resolution_clock::time_point cull_start= std::chrono::high_resolution_clock::now();
+            
+            cull(Frustum(mvp), m_boxes, m_visible);
+            build_indirect(m_visible, m_vertex_count, m_params);
+            
+            std::chrono::high_resolution_clock::time_point cull_stop= std::chrono::high_resolution_clock::now();
+            auto cull_time= std::chrono::duration_cast<std::chrono::microseconds>(cull_stop - cull_start).count();
+            // pas d'affichage a chaque image, le terminal ralentit la mesure. AppTime efface m_console apres render( )
+            //~ printf("cull %02dus: %d visible instances, %d draws\n", int(cull_time), int(m_visible.size()), int(m_params.size()));
+            
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
+            if(int(m_params.size()) > m_indirect_size)
+            {
+                m_indirect_size= int(m_params.size());
+                glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(IndirectParam) * m_indirect_size, nullptr, GL_STREAM_DRAW);
+            }
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(IndirectParam) * m_params.size(), m_params.data());
+            
+            // les draws utilisent les positions des instances a partir de first_instance
+            glBindVertexArray(m_vao);
+        }
+        
+        // draw
+        glUseProgram(m_program);
+        
         program_uniform(m_program, "mvpMatrix", mvp);
         program_uniform(m_program, "normalMatrix", mv.normal());
         
-        glDrawArraysInstanced(GL_TRIANGLES, 0, m_vertex_count, std::min(m_instance_count, 4096));
+        if(mode == 5)
+            glMultiDrawArraysIndirect(GL_TRIANGLES, 0, m_params.size(), 0);
+        else
+            glDrawArraysInstanced(GL_TRIANGLES, 0, m_vertex_count, std::min(m_instance_count, 4096));
+        
+        if(mode == 3)
+            // passe a la region suivante, attend le gpu si necessaire
+            m_stream.next_frame();
         
         return 1;
     }
@@ -250,13 +337,19 @@ public:
 protected:
     std::vector<vec3> m_positions;
     
+    // tests de visibilite
+    CullBoxes m_boxes;
+    std::vector<unsigned int> m_visible;
+    std::vector<IndirectParam> m_params;
+    GLuint m_indirect_buffer;
+    int m_indirect_size;
+    
     // solution openGL3
     GLuint m_vao;
     GLuint m_instance_buffer;
     // solution openGL4
     GLuint m_vao_storage;
-    GLuint m_instance_storage;
-    void *m_storage;
+    StreamBuffer m_stream;
 
     Transform m_model;
     Orbiter m_camera;
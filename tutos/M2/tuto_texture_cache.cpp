@@ -0,0 +1,270 @@
+
+//! \file tuto_texture_cache.cpp lancer de rayons sur une scene texturee, les textures sont lues par un cache de tuiles, cf texture_cache.h.
+
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "vec.h"
+#include "mat.h"
+#include "bvh.h"
+#include "orbiter.h"
+#include "image.h"
+#include "image_io.h"
+#include "texture_cache.h"
+
+#include "../mesh_data.h"
+
+
+struct Ray
+{
+    Point o;
+    Vector d;
+    float tmax;
+
+    Ray( const Point& _o, const Point& _e ) : o(_o), d(Vector(_o, _e)), tmax(FLT_MAX) {}
+};
+
+struct Hit
+{
+    int triangle_id;
+    float t;
+    float u, v;
+
+    Hit( ) : triangle_id(-1), t(0), u(0), v(0) {}
+    Hit( const int _id, const float _t, const float _u, const float _v ) : triangle_id(_id), t(_t), u(_u), v(_v) {}
+
+    operator bool( ) const { return (triangle_id != -1); }
+};
+
+struct Triangle
+{
+    Point p;
+    Vector e1, e2;
+    vec2 ta, tb, tc;    // texcoords des sommets
+    int material;
+
+    // cf tuto_ray.cpp, convention p(u, v)= (1 - u - v) * a + u * b + v * c
+    Hit intersect( const Ray& ray, const float htmax, const int id ) const
+    {
+        float u, v, t;
+        if(!plane(ray, u, v, t))
+            return Hit();
+        if(u < 0 || u > 1 || v < 0 || u + v > 1 || t < 0 || t > htmax)
+            return Hit();
+
+        return Hit(id, t, u, v);
+    }
+
+    // coordonnees barycentriques du point du plan du triangle touche par le rayon, sans verifier qu'il est dans le triangle
+    bool plane( const Ray& ray, float& u, float& v, float& t ) const
+    {
+        Vector pvec= cross(ray.d, e2);
+        float det= dot(e1, pvec);
+        if(std::abs(det) < 1e-12f)
+            return false;
+
+        float inv_det= 1 / det;
+        Vector tvec(p, ray.o);
+        u= dot(tvec, pvec) * inv_det;
+
+        Vector qvec= cross(tvec, e1);
+        v= dot(ray.d, qvec) * inv_det;
+        t= dot(e2, qvec) * inv_det;
+        return true;
+    }
+
+    vec2 texcoord( const float u, const float v ) const
+    {
+        float w= 1 - u - v;
+        return vec2(w * ta.x + u * tb.x + v * tc.x, w * ta.y + u * tb.y + v * tc.y);
+    }
+};
+
+
+// scene par defaut : un sol et un mur textures
+static
+MeshData default_scene( )
+{
+    MeshData data;
+    data.positions= { vec3(-100, 0, -100), vec3(100, 0, -100), vec3(100, 0, 100), vec3(-100, 0, 100),
+        vec3(-10, 0, -20), vec3(10, 0, -20), vec3(10, 10, -20), vec3(-10, 10, -20) };
+    data.texcoords= { vec2(0, 0), vec2(50, 0), vec2(50, 50), vec2(0, 50),
+        vec2(0, 0), vec2(1, 0), vec2(1, 1), vec2(0, 1) };
+
+    const int quads[2][4]= { { 0, 3, 2, 1 }, { 4, 5, 6, 7 } };
+    for(int q= 0; q < 2; q++)
+    {
+        const int corners[6]= { 0, 1, 2, 0, 2, 3 };
+        for(int i= 0; i < 6; i++)
+        {
+            data.position_indices.push_back(quads[q][corners[i]]);
+            data.texcoord_indices.push_back(quads[q][corners[i]]);
+            data.normal_indices.push_back(-1);
+        }
+        data.material_indices.push_back(q);
+        data.material_indices.push_back(q);
+    }
+
+    data.materials.resize(2);
+    data.materials[0].diffuse= White();
+    data.materials[0].diffuse_filename= "data/grid.png";
+    data.materials[1].diffuse= White();
+    data.materials[1].diffuse_filename= "data/monde.jpg";
+    return data;
+}
+
+
+int main( int argc, char **argv )
+{
+    // tuto_texture_cache [mesh.obj] [taille du cache en Mo]
+    MeshData data= (argc > 1 && argv[1][0] != 0) ? read_mesh_data(argv[1]) : default_scene();
+    if(data.position_indices.empty())
+        return 1;
+
+    size_t cache_size= size_t((argc > 2) ? atoi(argv[2]) : 16) * 1024 * 1024;
+    TextureCache cache(cache_size);
+
+    // ouvre les textures avant le rendu
+    std::vector<int> textures(data.materials.size(), -1);
+    size_t textures_size= 0;
+    for(unsigned i= 0; i < data.materials.size(); i++)
+        if(!data.materials[i].diffuse_filename.empty())
+        {
+            textures[i]= cache.texture(data.materials[i].diffuse_filename.c_str());
+            if(textures[i] >= 0)
+                textures_size+= cache.size(textures[i]);
+        }
+
+    // triangles et englobants
+    std::vector<Triangle> triangles;
+    std::vector<Point> pmin, pmax;
+    for(unsigned i= 0; i +2 < data.position_indices.size(); i+= 3)
+    {
+        Point a= Point(data.positions[data.position_indices[i]]);
+        Point b= Point(data.positions[data.position_indices[i +1]]);
+        Point c= Point(data.positions[data.position_indices[i +2]]);
+
+        Triangle triangle;
+        triangle.p= a;
+        triangle.e1= Vector(a, b);
+        triangle.e2= Vector(a, c);
+        triangle.ta= (data.texcoord_indices[i] < 0) ? vec2(0, 0) : data.texcoords[data.texcoord_indices[i]];
+        triangle.tb= (data.texcoord_indices[i +1] < 0) ? vec2(0, 0) : data.texcoords[data.texcoord_indices[i +1]];
+        triangle.tc= (data.texcoord_indices[i +2] < 0) ? vec2(0, 0) : data.texcoords[data.texcoord_indices[i +2]];
+        triangle.material= data.material_indices.empty() ? -1 : data.material_indices[i / 3];
+        triangles.push_back(triangle);
+
+        pmin.push_back(min(a, min(b, c)));
+        pmax.push_back(max(a, max(b, c)));
+    }
+
+    BVH bvh;
+    bvh.build(pmin, pmax);
+
+    // range les triangles dans l'ordre des feuilles
+    std::vector<Triangle> leaves;
+    for(unsigned i= 0; i < bvh.primitives().size(); i++)
+        leaves.push_back(triangles[bvh.primitives()[i]]);
+
+    // camera
+    Image image(1024, 640);
+    Transform view, projection;
+    if(argc > 1 && argv[1][0] != 0)
+    {
+        Point bmin, bmax;
+        bounds(data, bmin, bmax);
+
+        Orbiter camera;
+        camera.lookat(bmin, bmax);
+        view= camera.view();
+        projection= camera.projection(image.width(), image.height(), 45);
+    }
+    else
+    {
+        view= Lookat(Point(0, 2, 15), Point(0, 3, -20), Vector(0, 1, 0));
+        projection= Perspective(45, float(image.width()) / float(image.height()), 0.1f, 1000);
+    }
+    Transform inv= Inverse(Viewport(image.width(), image.height()) * projection * view);
+
+    auto primary= [&]( const float x, const float y ) { return Ray(inv(Point(x, y, 0)), inv(Point(x, y, 1))); };
+
+    auto cpu_start= std::chrono::high_resolution_clock::now();
+
+#pragma omp parallel
+    {
+        // un cache par thread
+        TextureCacheThread local(cache);
+
+    #pragma omp for schedule(dynamic, 1)
+        for(int py= 0; py < image.height(); py++)
+        for(int px= 0; px < image.width(); px++)
+        {
+            Ray ray= primary(px + 0.5f, py + 0.5f);
+
+            Hit hit;
+            float tmax= ray.tmax;
+            bvh.intersect(ray.o, ray.d, tmax,
+                [&]( const int id, float& htmax )
+                {
+                    if(Hit h= leaves[id].intersect(ray, htmax, id))
+                    {
+                        hit= h;
+                        htmax= h.t;
+                        return true;
+                    }
+                    return false;
+                });
+
+            if(!hit)
+            {
+                image(px, py)= Color(0.2f, 0.3f, 0.5f);
+                continue;
+            }
+
+            const Triangle& triangle= leaves[hit.triangle_id];
+            Color diffuse= (triangle.material < 0) ? Color(0.8f) : data.materials[triangle.material].diffuse;
+
+            int texture= (triangle.material < 0) ? -1 : textures[triangle.material];
+            if(texture >= 0)
+            {
+                vec2 uv= triangle.texcoord(hit.u, hit.v);
+
+                // differentielles : les rayons des pixels voisins touchent le plan du triangle
+                vec2 duvdx(0, 0), duvdy(0, 0);
+                float u, v, t;
+                if(triangle.plane(primary(px + 1.5f, py + 0.5f), u, v, t))
+                {
+                    vec2 uvx= triangle.texcoord(u, v);
+                    duvdx= vec2(uvx.x - uv.x, uvx.y - uv.y);
+                }
+                if(triangle.plane(primary(px + 0.5f, py + 1.5f), u, v, t))
+                {
+                    vec2 uvy= triangle.texcoord(u, v);
+                    duvdy= vec2(uvy.x - uv.x, uvy.y - uv.y);
+                }
+
+                diffuse= diffuse * local.lookup(texture, uv, duvdx, duvdy);
+            }
+
+            float cos_theta= std::abs(dot(normalize(cross(triangle.e1, triangle.e2)), normalize(ray.d)));
+            image(px, py)= Color(diffuse * cos_theta, 1);
+        }
+    }
+
+    auto cpu_stop= std::chrono::high_resolution_clock::now();
+    int cpu_time= std::chrono::duration_cast<std::chrono::milliseconds>(cpu_stop - cpu_start).count();
+    printf("cpu  %ds %03dms\n", int(cpu_time / 1000), int(cpu_time % 1000));
+
+    TextureCacheStats stats= cache.stats();
+    size_t tiles= stats.local_hits + stats.hits + stats.misses;
+    printf("texture cache: %zu lookups, %zu tiles : %.1f%% thread, %.1f%% shared, %zu misses, %zu evictions\n",
+        stats.lookups, tiles, 100.0 * stats.local_hits / std::max(size_t(1), tiles), 100.0 * stats.hits / std::max(size_t(1), tiles), stats.misses, stats.evictions);
+    printf("  peak %.2fMB / %.2fMB, textures %.2fMB\n", double(stats.peak_bytes) / 1024 / 1024, double(cache_size) / 1024 / 1024, double(textures_size) / 1024 / 1024);
+
+    write_image(image, "texture_cache.png");
+    return 0;
+}
@@ -1,29 +1,62 @@
 //! \file material_data.cpp 
 
 #include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <cstdlib>
 #include <algorithm>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
 
 #include "image_io.h"
 #include "texture.h"
+#include "stream_buffer.h"
 #include "material_data.h"
 #include "mesh_data.h"
 
 
-struct TextureData
+// image a charger, diffuse ou exposant d'une matiere
+struct TextureJob
 {
-    ImageData diffuse_image;
-    bool use_diffuse= false;
+    std::string filename;
+    int material;
+    bool ns;
     
-    ImageData ns_image;
-    bool use_ns= false;
+    int width;          //!< dimensions lues dans l'entete du fichier, 0 si le format n'est pas reconnu
+    int height;
+    int channels;
 };
 
+// image decodee et redimensionnee, en attente de transfert
+struct TextureLevel
+{
+    int job;
+    ImageData image;
+    Color color;
+};
+
+// file des images decodees par les threads, transferees par le thread openGL
+struct TextureQueue
+{
+    std::mutex mutex;
+    std::condition_variable ready;      // une image est disponible
+    std::condition_variable space;      // de la memoire est disponible
+    std::deque<TextureLevel> levels;
+    size_t bytes;                       // memoire utilisee par les images en cours de decodage et par les images de la file
+    size_t max_bytes;
+};
+
+
 static
-int miplevel_size( const ImageData& image, const int lod )
+size_t miplevel_size( const int width, const int height, const int channels, const int lod )
 {
-    int w= std::max(1, image.width / (1<<lod));
-    int h= std::max(1, image.height / (1<<lod));
-    return image.channels * image.size * w * h;
+    size_t w= std::max(1, width / (1<<lod));
+    size_t h= std::max(1, height / (1<<lod));
+    return channels * w * h;
 }
 
 static inline
@@ -32,17 +65,17 @@ int offset( const int width, const int stride, const int x, const int y, const i
     return (y * width + x) * stride + c;
 }
 
+// reduit les dimensions de l'image, sans copie
 static
-ImageData mipmap_resize( const ImageData& image, const int lod )
+void mipmap_resize( ImageData& image, const int lod )
 {
     assert(image.size == 1);
+    if(lod == 0)
+        return;
     
-    ImageData level= ImageData(image.width, image.height, image.channels, image.size);
-    level.data= image.data;
-    
-    int w= level.width;
-    int h= level.height;
-    int stride= level.channels * level.size;
+    int w= image.width;
+    int h= image.height;
+    int stride= image.channels * image.size;
     int row_stride= image.width;        // "preserve" les images de largeur impaire...
     for(int l= 0; l < lod; l++)
     {
@@ -54,12 +87,12 @@ ImageData mipmap_resize( const ImageData& image, const int lod )
         for(int i= 0; i < image.channels; i++)
         {
             int m= 0;
-            m= m + level.data[offset(row_stride, stride, 2*x, 2*y, i)];
-            m= m + level.data[offset(row_stride, stride, 2*x +1, 2*y, i)];
-            m= m + level.data[offset(row_stride, stride, 2*x, 2*y +1, i)];
-            m= m + level.data[offset(row_stride, stride, 2*x +1, 2*y +1, i)];
+            m= m + image.data[offset(row_stride, stride, 2*x, 2*y, i)];
+            m= m + image.data[offset(row_stride, stride, 2*x +1, 2*y, i)];
+            m= m + image.data[offset(row_stride, stride, 2*x, 2*y +1, i)];
+            m= m + image.data[offset(row_stride, stride, 2*x +1, 2*y +1, i)];
             
-            level.data[offset(w, stride, x, y, i)]= m / 4;
+            image.data[offset(w, stride, x, y, i)]= m / 4;
         }
         
         row_stride= w;
@@ -67,9 +100,10 @@ ImageData mipmap_resize( const ImageData& image, const int lod )
     
     //~ printf("  resize %d : %dx%d, %dx%d\n", lod, image.width, image.height, w, h);
     
-    level.width= w;
-    level.height= h;
-    return level;
+    image.width= w;
+    image.height= h;
+    image.data.resize(size_t(w) * h * stride);
+    image.data.shrink_to_fit();
 }
 
 static
@@ -89,105 +123,272 @@ Color average_color( const ImageData& image )
 }
 
 
-int read_textures( std::vector<MaterialData>& materials, const size_t max_size )
+static
+unsigned int read_be16( const unsigned char *p ) { return (p[0] << 8) | p[1]; }
+static
+unsigned int read_be32( const unsigned char *p ) { return (unsigned(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static
+unsigned int read_le16( const unsigned char *p ) { return p[0] | (p[1] << 8); }
+static
+unsigned int read_le32( const unsigned char *p ) { return p[0] | (p[1] << 8) | (p[2] << 16) | (unsigned(p[3]) << 24); }
+
+// lit les dimensions d'une image png, jpeg ou bmp, sans la decoder. channels est le nombre de canaux de read_image_data( ).
+static
+bool read_image_size( const char *filename, int& width, int& height, int& channels )
 {
-    std::vector<TextureData> textures;
+    width= 0;
+    height= 0;
+    channels= 0;
     
-    // evalue la taille totale occuppee par toutes les images / textures
-    size_t total_size= 0;
-    for(int i= 0; i < (int) materials.size(); i++)
+    FILE *in= fopen(filename, "rb");
+    if(in == nullptr)
+        return false;
+    
+    unsigned char header[32]= { };
+    size_t n= fread(header, 1, sizeof(header), in);
+    if(n >= 26 && memcmp(header, "\x89PNG", 4) == 0)
     {
-        const MaterialData &material= materials[i];
-        TextureData data;
+        // entete IHDR
+        width= read_be32(header + 16);
+        height= read_be32(header + 20);
+        channels= (header[25] == 6) ? 4 : 3;
+    }
+    else if(n >= 30 && header[0] == 'B' && header[1] == 'M')
+    {
+        width= (int) read_le32(header + 18);
+        height= std::abs((int) read_le32(header + 22));
+        channels= (read_le16(header + 28) == 32) ? 4 : 3;
+    }
+    else if(n >= 2 && header[0] == 0xFF && header[1] == 0xD8)
+    {
+        // parcours les segments jusqu'a l'entete de la frame, SOFn
+        fseek(in, 2, SEEK_SET);
+        unsigned char segment[9];
+        while(fread(segment, 1, 4, in) == 4 && segment[0] == 0xFF)
+        {
+            unsigned int marker= segment[1];
+            unsigned int length= read_be16(segment + 2);
+            if(marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+            {
+                if(fread(segment, 1, 5, in) == 5)
+                {
+                    height= read_be16(segment + 1);
+                    width= read_be16(segment + 3);
+                    channels= 3;
+                }
+                break;
+            }
+            
+            if(length < 2 || fseek(in, length - 2, SEEK_CUR) != 0)
+                break;
+        }
+    }
+    
+    fclose(in);
+    return (width > 0 && height > 0);
+}
+
+
+// decode, redimensionne les images et les transmet au thread openGL, sans depasser la memoire de la file
+static
+void decode_textures( const std::vector<TextureJob>& jobs, const int lod, std::atomic<int>& next, TextureQueue& queue )
+{
+    for(;;)
+    {
+        int id= next++;
+        if(id >= (int) jobs.size())
+            break;
         
-        if(!material.diffuse_filename.empty())
+        // reserve la memoire de l'image complete avant de la decoder, au moins une image est toujours decodee
+        size_t reserve= miplevel_size(jobs[id].width, jobs[id].height, jobs[id].channels, 0);
         {
-            data.use_diffuse= true;
-            data.diffuse_image= read_image_data(material.diffuse_filename.c_str());
-            total_size= total_size + data.diffuse_image.width * data.diffuse_image.height * data.diffuse_image.channels * data.diffuse_image.size;
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            queue.space.wait(lock, [&]( ) { return queue.bytes == 0 || queue.bytes + reserve <= queue.max_bytes; });
+            queue.bytes+= reserve;
         }
-        if(!material.ns_filename.empty())
+        
+        TextureLevel level;
+        level.job= id;
+        level.image= read_image_data(jobs[id].filename.c_str());
+        if(level.image.width > 0)
         {
-            data.use_ns= true;
-            data.ns_image= read_image_data(material.ns_filename.c_str());
-            total_size= total_size + data.ns_image.width * data.ns_image.height * data.ns_image.channels * data.ns_image.size;
+            mipmap_resize(level.image, lod);
+            level.color= average_color(level.image);
         }
         
-        if(total_size > max_size)
+        // ne conserve que la memoire de l'image redimensionnee
+        size_t size= level.image.data.size();
+        {
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            queue.bytes= queue.bytes - reserve + size;
+            queue.levels.push_back(std::move(level));
+        }
+        queue.ready.notify_one();
+        queue.space.notify_all();
+    }
+}
+
+// cree une texture, les donnees sont transferees par un buffer de transfert, cf StreamBuffer
+static
+GLuint upload_texture( const ImageData& image, StreamBuffer& staging )
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    
+    // memes parametres que make_texture( )
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    
+    GLenum format= GL_RGBA;
+    if(image.channels == 3)
+        format= GL_RGB;
+    
+    size_t size= image.data.size();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if(size <= staging.region_size())
+    {
+        // passe a la region suivante du buffer, si necessaire. attend que le gpu ait fini de la lire
+        if(staging.available() < size)
+            staging.next_frame();
+        
+        size_t offset= staging.write(image.data.data(), size);
+        staging.flush();
+        
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, (const GLvoid *) offset);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else
+        // trop gros pour le buffer de transfert
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    
+    // prefiltre la texture
+    glGenerateMipmap(GL_TEXTURE_2D);
+    return texture;
+}
+
+
+int read_textures( std::vector<MaterialData>& materials, const size_t max_size )
+{
+    std::chrono::high_resolution_clock::time_point start= std::chrono::high_resolution_clock::now();
+    
+    // images a charger
+    std::vector<TextureJob> jobs;
+    for(int i= 0; i < (int) materials.size(); i++)
+    {
+        const MaterialData &material= materials[i];
+        if(!material.diffuse_filename.empty())
+            jobs.push_back( { material.diffuse_filename, i, false, 0, 0, 0 } );
+        if(!material.ns_filename.empty())
+            jobs.push_back( { material.ns_filename, i, true, 0, 0, 0 } );
+    }
+    
+    // evalue la taille totale occuppee par toutes les images / textures, sans les decoder
+    size_t total_size= 0;
+    for(int i= 0; i < (int) jobs.size(); i++)
+    {
+        TextureJob& job= jobs[i];
+        if(!read_image_size(job.filename.c_str(), job.width, job.height, job.channels))
         {
-            // ne stocke plus les images apres avoir depasse la limite de taille
-            std::vector<unsigned char>().swap(data.diffuse_image.data);
-            std::vector<unsigned char>().swap(data.ns_image.data);
+            // format inconnu, decode l'image...
+            ImageData image= read_image_data(job.filename.c_str());
+            job.width= image.width;
+            job.height= image.height;
+            job.channels= image.channels;
         }
         
-        textures.emplace_back(data);
+        total_size= total_size + miplevel_size(job.width, job.height, job.channels, 0);
     }
     
     printf("using %dMB / %dMB\n", int(total_size / 1024 / 1024), int(max_size / 1024 / 1024));
     
     // reduit les dimensions des images / textures jusqu'a respecter la limite de taille
     int lod= 0;
-    for(; total_size > max_size ; lod++)
+    while(total_size > max_size)
     {
+        lod++;
         total_size= 0;
-        for(int i= 0; i < (int) textures.size(); i++)
-        {
-            if(textures[i].use_diffuse)
-                total_size= total_size + miplevel_size(textures[i].diffuse_image, lod);
-            if(textures[i].use_ns)
-                total_size= total_size + miplevel_size(textures[i].ns_image, lod);
-        }
+        for(int i= 0; i < (int) jobs.size(); i++)
+            total_size= total_size + miplevel_size(jobs[i].width, jobs[i].height, jobs[i].channels, lod);
     }
     
     printf("  lod %d, %dMB\n", lod, int(total_size / 1024 / 1024));
     
     // charge une texture par defaut, en cas d'erreur de chargement
     GLuint default_texture= read_texture(0, "data/grid.png");
+    for(int i= 0; i < (int) materials.size(); i++)
+    {
+        materials[i].diffuse_texture= default_texture;
+        materials[i].ns_texture= default_texture;
+    }
     
-    printf("resizing textures...\n");
-    // construit les textures a la bonne resolution
-    for(int i= 0;  i < (int) textures.size(); i++)
+    if(jobs.empty())
+        return 0;
+    
+    // buffer de transfert, assez gros pour les images courantes
+    size_t region_size= 0;
+    for(int i= 0; i < (int) jobs.size(); i++)
+        region_size= std::max(region_size, miplevel_size(jobs[i].width, jobs[i].height, jobs[i].channels, lod));
+    region_size= std::min(region_size, size_t(32*1024*1024));
+    
+    StreamBuffer staging;
+    staging.create(GL_PIXEL_UNPACK_BUFFER, region_size, 3);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    
+    // decode les images en parallele, les images en cours de decodage et en attente de transfert utilisent au plus 1/4 de la limite de taille
+    TextureQueue queue;
+    queue.bytes= 0;
+    queue.max_bytes= max_size / 4;
+    
+    std::atomic<int> next(0);
+    int count= std::max(1, std::min((int) jobs.size(), (int) std::thread::hardware_concurrency() -1));
+    std::vector<std::thread> threads;
+    for(int i= 0; i < count; i++)
+        threads.push_back( std::thread(decode_textures, std::cref(jobs), lod, std::ref(next), std::ref(queue)) );
+    
+    printf("resizing textures, %d threads...\n", count);
+    // construit les textures a la bonne resolution, dans l'ordre de decodage
+    for(int n= 0; n < (int) jobs.size(); n++)
     {
-        TextureData& data= textures[i]; 
-        MaterialData& material= materials[i]; 
-        
-        if(data.use_diffuse && data.diffuse_image.width > 0)
+        TextureLevel level;
         {
-            if(data.diffuse_image.data.empty())
-            {
-                // recharge l'image, si necessaire
-                data.diffuse_image= read_image_data(material.diffuse_filename.c_str());
-                assert(data.diffuse_image.width > 0);
-            }
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            queue.ready.wait(lock, [&]( ) { return !queue.levels.empty(); });
             
-            ImageData level= mipmap_resize(data.diffuse_image, lod);
-            material.diffuse_texture= make_texture(0, level);
-            
-            material.diffuse_texture_color= average_color(level);
+            level= std::move(queue.levels.front());
+            queue.levels.pop_front();
+            queue.bytes-= level.image.data.size();
         }
-        else
-            material.diffuse_texture= default_texture;
+        queue.space.notify_all();
         
-        if(data.use_ns && data.ns_image.width > 0)
+        if(level.image.width == 0)
+            // erreur de chargement, utilise la texture par defaut
+            continue;
+        
+        const TextureJob& job= jobs[level.job];
+        MaterialData& material= materials[job.material];
+        if(!job.ns)
         {
-            if(data.ns_image.data.empty())
-            {
-                // recharge l'image, si necessaire
-                data.ns_image= read_image_data(material.ns_filename.c_str());
-                assert(data.ns_image.width > 0);
-            }
-            
-            ImageData level= mipmap_resize(data.ns_image, lod);
-            material.ns_texture= make_texture(0, level);
+            material.diffuse_texture= upload_texture(level.image, staging);
+            material.diffuse_texture_color= level.color;
         }
         else
-            material.ns_texture= default_texture;
-        
-        // nettoyage, les images ne sont plus necessaires
-        std::vector<unsigned char>().swap(data.diffuse_image.data);
-        std::vector<unsigned char>().swap(data.ns_image.data);
+            material.ns_texture= upload_texture(level.image, staging);
     }
     
+    for(int i= 0; i < count; i++)
+        threads[i].join();
+    
+    staging.release();
+    
+    std::chrono::high_resolution_clock::time_point stop= std::chrono::high_resolution_clock::now();
+    int ms= int(std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count());
+    printf("  %d textures, %dms\n", (int) jobs.size(), ms);
     return total_size;
 }
 
@@ -204,3 +405,100 @@ void release_textures( std::vector<MaterialData>& materials )
     }
 }
 
+
+GLuint make_texture_array( const std::vector<MaterialData>& materials, std::vector<int>& layers, const int max_size )
+{
+    layers.assign(materials.size(), -1);
+    
+    // une couche par texture, plusieurs matieres peuvent utiliser la meme texture
+    std::vector<GLuint> textures;
+    for(int i= 0; i < (int) materials.size(); i++)
+    {
+        GLuint texture= materials[i].diffuse_texture;
+        if(texture == 0)
+            continue;
+        
+        int layer= int(std::find(textures.begin(), textures.end(), texture) - textures.begin());
+        if(layer == (int) textures.size())
+            textures.push_back(texture);
+        layers[i]= layer;
+    }
+    
+    if(textures.empty())
+        return 0;
+    
+    GLint max_layers= 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    if((int) textures.size() > max_layers)
+    {
+        printf("[error] texture array: %d textures, %d layers max...\n", (int) textures.size(), max_layers);
+        return 0;
+    }
+    
+    // dimension des couches
+    int size= 1;
+    for(int i= 0; i < (int) textures.size(); i++)
+    {
+        GLint width= 0;
+        GLint height= 0;
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        size= std::max(size, std::max(width, height));
+    }
+    size= std::min(size, max_size);
+    
+    int levels= 1;
+    while((size >> levels) > 0)
+        levels++;
+    
+    GLuint array= 0;
+    glGenTextures(1, &array);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, size, size, (GLsizei) textures.size());
+    
+    // copie et redimensionne chaque texture dans sa couche, cf glBlitFramebuffer( )
+    GLuint framebuffers[2];
+    glGenFramebuffers(2, framebuffers);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+    
+    for(int i= 0; i < (int) textures.size(); i++)
+    {
+        // utilise le plus petit niveau de mipmap plus grand que la couche, le filtrage du blit ne lit que 4 texels...
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        int lod= 0;
+        GLint width= 0;
+        GLint height= 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        for(;;)
+        {
+            GLint w= 0;
+            GLint h= 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, lod +1, GL_TEXTURE_WIDTH, &w);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, lod +1, GL_TEXTURE_HEIGHT, &h);
+            if(w < size || h < size)
+                break;
+            
+            lod++;
+            width= w;
+            height= h;
+        }
+        
+        glFramebufferTexture(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textures[i], lod);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, array, 0, i);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, size, size, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+    
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(2, framebuffers);
+    
+    // prefiltre les couches
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    
+    printf("texture array: %d textures, %dx%d, %dMB\n", (int) textures.size(), size, size, int(size_t(size) * size * 4 * textures.size() * 4 / 3 / 1024 / 1024));
+    return array;
+}
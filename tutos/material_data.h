@@ -12,4 +12,10 @@ int read_textures( std::vector<MaterialData>& materials, const size_t max_size=
 //! detruit les textures.
 void release_textures( std::vector<MaterialData>& materials );
 
+/*! regroupe les textures diffuses des matieres dans une texture 2d array, une couche par texture. a utiliser apres read_textures( ).
+    les couches sont carrees, de la dimension de la plus grande texture, sans depasser max_size. les textures sont redimensionnees.
+    renvoie la texture, ou 0 en cas d'erreur, et la couche utilisee par chaque matiere, -1 si la matiere n'a pas de texture.
+ */
+GLuint make_texture_array( const std::vector<MaterialData>& materials, std::vector<int>& layers, const int max_size= 1024 );
+
 #endif
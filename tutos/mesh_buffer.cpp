@@ -4,6 +4,8 @@
 #include <map>
 #include <algorithm>
 
+#include "mesh_optimize.h"
+
 #include "mesh_data.h"
 #include "mesh_buffer.h"
 
@@ -45,6 +47,42 @@ struct MeshVertex
 };
 
 
+void optimize( MeshBuffer& mesh, const int cache_size )
+{
+    std::vector<unsigned int> indices(mesh.indices.begin(), mesh.indices.end());
+    int vertex_count= int(mesh.positions.size());
+    
+    float acmr_before= acmr(indices, cache_size);
+    float atvr_before= atvr(indices, vertex_count, cache_size);
+    
+    // re-ordonne les triangles de chaque groupe, les groupes de matieres ne sont pas modifies
+    for(const MeshGroup& group : mesh.material_groups)
+    {
+        std::vector<unsigned int> group_indices(indices.begin() + group.first, indices.begin() + group.first + group.count);
+        
+        std::vector<int> clusters;
+        std::vector<int> order= vertex_cache_order(group_indices, vertex_count, cache_size, clusters);
+        order= overdraw_order(group_indices, mesh.positions, order, clusters);
+        group_indices= reorder_triangles(group_indices, order);
+        
+        std::copy(group_indices.begin(), group_indices.end(), indices.begin() + group.first);
+    }
+    
+    // re-ordonne les sommets
+    std::vector<int> remap= vertex_fetch_order(indices, vertex_count);
+    mesh.positions= remap_vertices(mesh.positions, remap);
+    if(!mesh.texcoords.empty())
+        mesh.texcoords= remap_vertices(mesh.texcoords, remap);
+    if(!mesh.normals.empty())
+        mesh.normals= remap_vertices(mesh.normals, remap);
+    
+    mesh.indices.assign(indices.begin(), indices.end());
+    
+    printf("optimize : acmr %.3f -> %.3f, atvr %.3f -> %.3f\n", 
+        acmr_before, acmr(indices, cache_size), atvr_before, atvr(indices, vertex_count, cache_size));
+}
+
+
 MeshBuffer buffers( const MeshData& data )
 {
     MeshBuffer mesh;
@@ -124,6 +162,8 @@ MeshBuffer buffers( const MeshData& data )
     // termine la description du dernier groupe de triangles
     mesh.material_groups.back().count= 3*triangles.size() - mesh.material_groups.back().first;
     
+    optimize(mesh);
+    
     printf("buffers : %d positions, %d texcoords, %d normals, %d indices, %d groups\n", 
         (int) mesh.positions.size(), (int) mesh.texcoords.size(), (int) mesh.normals.size(), (int) mesh.indices.size(), (int) mesh.material_groups.size());
     
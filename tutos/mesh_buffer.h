@@ -48,8 +48,11 @@ struct MeshBuffer
 };
 
 
-//! construction a partir des donnees d'un maillage.
+//! construction a partir des donnees d'un maillage. les triangles de chaque groupe sont re-ordonnes par optimize( ).
 MeshBuffer buffers( const MeshData& data );
 
+//! re-ordonne les triangles de chaque groupe et les sommets pour le cache de sommets et l'overdraw, cf mesh_optimize.h.
+void optimize( MeshBuffer& mesh, const int cache_size= 16 );
+
 
 #endif
@@ -14,11 +14,30 @@
 #include "app_time.h"        // classe Application a deriver
 
 
+// parametres d'un draw indirect, cf glMultiDrawElementsIndirect( )
+struct IndirectParam
+{
+    unsigned int index_count;
+    unsigned int instance_count;
+    unsigned int first_index;
+    int base_vertex;
+    unsigned int first_instance;
+};
+
+// matiere d'un groupe de triangles, alignement std430, cf mesh_viewer_mdi.glsl
+struct alignas(16) MaterialParam
+{
+    Color diffuse;
+    int layer;
+    int pad[3];
+};
+
+
 class MeshViewer: public AppTime
 {
 public:
     // constructeur : donner les dimensions de l'image, et eventuellement la version d'openGL.
-    MeshViewer( const char *file ) : AppTime(1024, 640), m_filename(file) {}
+    MeshViewer( const char *file ) : AppTime(1024, 640, 4, 3), m_filename(file) {}     // openGL version 4.3, ne marchera pas sur mac.
     
     int init( )
     {
@@ -108,6 +127,53 @@ public:
         m_program= read_program("tutos/mesh_viewer.glsl");
         program_print_errors(m_program);
         
+        // ou : dessine tous les groupes avec un seul glMultiDrawElementsIndirect( ), 
+        // les matieres sont dans un storage buffer et les textures dans une texture 2d array, indexes par gl_DrawIDARB
+        m_use_mdi= false;
+        m_mdi_program= 0;
+        m_texture_array= 0;
+        m_material_buffer= 0;
+        m_indirect_buffer= 0;
+        if(GLEW_ARB_shader_draw_parameters)
+        {
+            std::vector<int> layers;
+            m_texture_array= make_texture_array(m_mesh.materials, layers);
+            
+            std::vector<MaterialParam> materials;
+            std::vector<IndirectParam> indirect;
+            for(int i= 0; i < (int) m_mesh.material_groups.size(); i++)
+            {
+                const MeshGroup& group= m_mesh.material_groups[i];
+                
+                MaterialParam material= { Color(0.8f, 0.8f, 0.8f), -1, { } };
+                if(group.material >= 0)
+                {
+                    material.diffuse= m_mesh.materials[group.material].diffuse;
+                    if(m_texture_array > 0)
+                        material.layer= layers[group.material];
+                }
+                materials.push_back(material);
+                
+                indirect.push_back( { unsigned(group.count), 1, unsigned(group.first), 0, 0 } );
+            }
+            
+            glGenBuffers(1, &m_material_buffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_material_buffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(MaterialParam) * materials.size(), materials.data(), GL_STATIC_DRAW);
+            
+            glGenBuffers(1, &m_indirect_buffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(IndirectParam) * indirect.size(), indirect.data(), GL_STATIC_DRAW);
+            
+            m_mdi_program= read_program("tutos/mesh_viewer_mdi.glsl");
+            program_print_errors(m_mdi_program);
+            
+            GLint status= GL_FALSE;
+            glGetProgramiv(m_mdi_program, GL_LINK_STATUS, &status);
+            m_use_mdi= (status == GL_TRUE);
+            printf("%d groups: %d draws, %s\n", (int) m_mesh.material_groups.size(), m_use_mdi ? 1 : (int) m_mesh.material_groups.size(), m_use_mdi ? "multi draw indirect" : "direct");
+        }
+        
         // etat openGL par defaut
         glClearColor(0.2f, 0.2f, 0.2f, 1.f);        // couleur par defaut de la fenetre
         
@@ -126,6 +192,11 @@ public:
         glDeleteBuffers(1, &m_index_buffer);
         glDeleteVertexArrays(1, &m_vao);
         release_program(m_program);
+        
+        glDeleteTextures(1, &m_texture_array);
+        glDeleteBuffers(1, &m_material_buffer);
+        glDeleteBuffers(1, &m_indirect_buffer);
+        release_program(m_mdi_program);
         return 0;
     }
     
@@ -195,8 +266,36 @@ public:
             flat= !flat;
         }
         
+        // alterne entre 1 draw par groupe et 1 multi draw indirect
+        if(key_state('m') && m_mdi_program > 0)
+        {
+            clear_key_state('m');
+            m_use_mdi= !m_use_mdi;
+            printf("%s\n", m_use_mdi ? "multi draw indirect" : "direct");
+        }
+        
         // go !
         glBindVertexArray(m_vao);
+        if(m_use_mdi)
+        {
+            glUseProgram(m_mdi_program);
+            program_uniform(m_mdi_program, "mvpMatrix", mvp);
+            program_uniform(m_mdi_program, "mvMatrix", mv);
+            
+            // toutes les textures sur l'unite 0
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture_array);
+            glBindSampler(0, m_sampler);
+            program_uniform(m_mdi_program, "diffuse_textures", 0);
+            
+            // les matieres et les parametres des draws
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_material_buffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
+            
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, (GLsizei) m_mesh.material_groups.size(), 0);
+            return 1;
+        }
+        
         for(int i= 0; i < (int) m_mesh.material_groups.size(); i++)
         {
             //~ program_uniform(m_program, "color", Color((i % 100) / 99.f, 1 - (i % 10) / 9.f, (i % 4) / 3.f));
@@ -250,6 +349,12 @@ protected:
     GLuint m_texture;
     GLuint m_sampler;
     GLuint m_program;
+    
+    GLuint m_mdi_program;
+    GLuint m_texture_array;
+    GLuint m_material_buffer;
+    GLuint m_indirect_buffer;
+    bool m_use_mdi;
 
     const char *m_filename;
 };
@@ -0,0 +1,77 @@
+//! \file mesh_viewer_mdi.glsl meme shader que mesh_viewer.glsl, les matieres sont dans un storage buffer, indexe par gl_DrawIDARB.
+
+#version 430
+
+#ifdef VERTEX_SHADER
+
+#extension GL_ARB_shader_draw_parameters : require
+
+layout(location= 0) in vec3 position;
+layout(location= 1) in vec2 texcoord;
+layout(location= 2) in vec3 normal;
+
+uniform mat4 mvpMatrix;
+uniform mat4 mvMatrix;
+
+out vec3 vertex_position;
+out vec2 vertex_texcoord;
+out vec3 vertex_normal;
+flat out int vertex_draw;
+
+void main( )
+{
+    gl_Position= mvpMatrix * vec4(position, 1);
+
+    vertex_position= vec3(mvMatrix * vec4(position, 1));
+    vertex_texcoord= texcoord;
+    vertex_normal= mat3(mvMatrix) * normal;
+
+    // 1 draw par groupe de triangles, donc par matiere
+    vertex_draw= gl_DrawIDARB;
+}
+
+#endif
+
+
+#ifdef FRAGMENT_SHADER
+
+struct Material
+{
+    vec4 diffuse;
+    int layer;          // couche de la texture diffuse, -1 sans texture
+    int pad[3];
+};
+
+layout(binding= 0, std430) readonly buffer materialData
+{
+    Material materials[];
+};
+
+uniform sampler2DArray diffuse_textures;
+
+in vec3 vertex_position;
+in vec2 vertex_texcoord;
+in vec3 vertex_normal;
+flat in int vertex_draw;
+
+out vec4 fragment_color;
+
+void main( )
+{
+    float cos_theta= abs(dot(normalize(- vertex_position), normalize(vertex_normal)));
+
+    Material material= materials[vertex_draw];
+    vec4 color_texture= vec4(1);
+    if(material.layer >= 0)
+        color_texture= texture(diffuse_textures, vec3(vertex_texcoord, material.layer));
+    if(color_texture.a < 0.3)
+        discard;
+
+    // module la couleur de la matiere par la couleur de la texture
+    vec3 color= material.diffuse.rgb * color_texture.rgb * cos_theta;
+
+    // applique une correction gamma au resultat
+    fragment_color= vec4(pow(color, vec3(1.0 / 2, 1.0 / 2, 1.0 / 2)), 1);
+}
+
+#endif
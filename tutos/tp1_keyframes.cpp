@@ -1,6 +1,8 @@
 
 //! \file tuto7.cpp reprise de tuto6.cpp mais en derivant App::init(), App::quit() et bien sur App::render().
 
+#include <cstddef>
+
 #include "wavefront.h"
 #include "texture.h"
 
@@ -9,6 +11,10 @@
 #include "program.h"
 #include "uniforms.h"
 #include "app_time.h"        // classe Application a deriver
+#include "vertex_codec.h"
+#include "stream_buffer.h"
+#include "shadow_map.h"
+#include "profiler.h"
 
 namespace glsl {
     struct alignas(16) vec4
@@ -33,6 +39,14 @@ namespace glsl {
 
 }
 
+// transformations d'une instance, cf struct Instance dans tp1_keyframes.glsl et tp1_keyframes_shadow.glsl
+struct instanceData {
+    Transform model;
+    Transform mvp;          // projection * view * model
+    int frame;              // frame de l'animation
+    int pad[3];             // alignement std430 de la structure, sur 16 octets
+};
+
 struct materialData {
     glsl::vec4 ambient;
     glsl::vec4 diffuse;
@@ -51,6 +65,10 @@ struct Buffers
     GLuint materials_buffer;
     int count;
     GLuint framebuffer;
+    // decodage des positions compactes des keyframes
+    Point pmin, pmax;
+    Point position_offset;
+    Vector position_scale;
 
     Buffers( ) : vao(0),buffer(0), materials_buffer(0), count(0) {}
 
@@ -245,67 +263,58 @@ struct Buffers
 
     }
 
+    // sommet compact d'une frame, cf vertex_codec.h : position quantifiee sur 3x16 bits et normale octaedrique sur 2x8 bits, 8 octets au lieu de 24.
+    struct KeyframeVertex
+    {
+        unsigned short x, y, z;
+        Snorm8x2 n;
+    };
+
     void createkeyframes(std::vector<Mesh> m){
         if(!m[0].vertex_buffer_size()) return;
 
         if(m[0].vertex_buffer_size() != m[1].vertex_buffer_size()) return;
 
-        buffers = new GLuint[m.size()];
+        // englobant de toutes les frames, les positions sont quantifiees dans cet englobant
+        m[0].bounds(pmin, pmax);
+        for (size_t i = 1; i < m.size(); i++) {
+            Point bmin, bmax;
+            m[i].bounds(bmin, bmax);
+            pmin = min(pmin, bmin);
+            pmax = max(pmax, bmax);
+        }
 
-        // cree et configure le vertex array object: conserve la description des attributs de sommets
+        // vertex array object vide, les sommets sont lus par le vertex shader, cf keyframe_vertex( ) dans tp1_keyframes.glsl
         glGenVertexArrays(1, &vao);
         glBindVertexArray(vao);
 
-        // cree et initialise le buffer: conserve la positions des sommets
+        // cree et initialise le buffer: une frame par mesh, les sommets d'une frame sont entrelaces
+        // chaque instance utilise une frame differente, le buffer est un storage buffer indexe par frame * count + gl_VertexID
         glGenBuffers(1, &buffer);
         glBindBuffer(GL_ARRAY_BUFFER, buffer);
 
-        size_t size = m[0].vertex_buffer_size() * m.size() + m[0].normal_buffer_size() * m.size();
-        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
-
-        //transfere les positions des sommets
-        size_t offset = 0;
-        size = m[0].vertex_buffer_size();
-
-        // attribut 0, position des sommets, declare dans le vertex shader : in vec3 position;
-        glVertexAttribPointer(0,3, GL_FLOAT,GL_FALSE,0,(const GLvoid *)offset);
-        glEnableVertexAttribArray(0);
-
-        offset = offset + size;
-        size= m[0].normal_buffer_size();
-
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, /* stride */ 0, (const GLvoid *) offset);
-        glEnableVertexAttribArray(1);
-
-        offset = offset + size;
-        size= m[1].vertex_buffer_size();
-
-        // et configure l'attribut 1, vec2 texcoord
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, /* stride */ 0, (const GLvoid *) offset);
-        glEnableVertexAttribArray(2);
-
-        offset = offset + size;
-        size= m[1].normal_buffer_size();
-
-        // et configure l'attribut 1, vec2 texcoord
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, /* stride */ 0, (const GLvoid *) offset);
-        glEnableVertexAttribArray(3);
+        size_t frame_size = m[0].vertex_count() * sizeof(KeyframeVertex);
+        glBufferData(GL_ARRAY_BUFFER, frame_size * m.size(), nullptr, GL_STATIC_DRAW);
 
+        std::vector<KeyframeVertex> vertices(m[0].vertex_count());
+        for (size_t f = 0; f < m.size(); f++) {
+            const std::vector<vec3>& positions = m[f].positions();
+            const std::vector<vec3>& normals = m[f].normals();
+            for (size_t i = 0; i < vertices.size(); i++) {
+                Unorm16x4 q = encode_position(positions[i], pmin, pmax);
+                vertices[i] = { q.x, q.y, q.z, encode_normal8(normals[i]) };
+            }
 
-        size_t offsetIt = 0;
-        size_t sizeIt = 0;
-
-        for (auto it = m.begin(); it!=m.end(); it++) {
-            offsetIt += sizeIt;
-            sizeIt = (*it).vertex_buffer_size();
-            glBufferSubData(GL_ARRAY_BUFFER, offsetIt,  sizeIt, (*it).vertex_buffer());
-            offsetIt += sizeIt;
-            sizeIt = (*it).normal_buffer_size();
-            glBufferSubData(GL_ARRAY_BUFFER, offsetIt,  sizeIt, (*it).normal_buffer());
-
+            glBufferSubData(GL_ARRAY_BUFFER, f * frame_size, frame_size, vertices.data());
         }
 
+        printf("keyframes: %d frames, %.1fMo (vs %.1fMo)\n", int(m.size()),
+            float(frame_size * m.size()) / 1024 / 1024,
+            float((m[0].vertex_buffer_size() + m[0].normal_buffer_size()) * m.size()) / 1024 / 1024);
 
+        // decodage des positions dans le vertex shader
+        position_offset = pmin;
+        position_scale = pmax - pmin;
 
         std::vector<materialData> data(m[0].triangle_count());
         std::vector<unsigned int> mats = m[0].materials();
@@ -349,6 +358,8 @@ public:
     // creation des objets de l'application
     int init( )
     {
+        PROFILE_SCOPE("init");
+
         m_meshes.push_back(read_mesh("data/run/Robot_000001.obj"));
         m_meshes.push_back(read_mesh("data/run/Robot_000002.obj"));
         m_meshes.push_back(read_mesh("data/run/Robot_000003.obj"));
@@ -373,7 +384,10 @@ public:
         m_meshes.push_back(read_mesh("data/run/Robot_000022.obj"));
         m_meshes.push_back(read_mesh("data/run/Robot_000023.obj"));
 
-        m_objet.createkeyframes(m_meshes);
+        {
+            PROFILE_SCOPE("create keyframes");
+            m_objet.createkeyframes(m_meshes);
+        }
 
         m_floor = read_mesh("data/floor30x30.obj");
         m_objet2.create2(m_floor);
@@ -401,26 +415,40 @@ public:
         m_program_shadow2 = read_program("tutos/tp1_static_shadow.glsl");
         program_print_errors(m_program_shadow2);
 
-        glGenTextures(1, &shadow_map);
-        glBindTexture(GL_TEXTURE_2D, shadow_map);
-
-        // configuration framebuffer / texture
-        glTexImage2D(GL_TEXTURE_2D,
-            /* level */ 0,
-            /* texel format */ GL_DEPTH_COMPONENT,
-            /* width, height, border */5 * window_width(), 5 * window_height(), 0,
-            /* data format */ GL_DEPTH_COMPONENT, /* data type */ GL_UNSIGNED_INT,
-            /* data */ nullptr);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glGenFramebuffers(1, &framebuffer);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
-        //glFramebufferTexture(GL_DRAW_FRAMEBUFFER, /* attachment */ GL_COLOR_ATTACHMENT0, /* texture */ color_texture, /* mipmap level */ 0);
-        glFramebufferTexture(GL_DRAW_FRAMEBUFFER, /* attachment */ GL_DEPTH_ATTACHMENT, /* texture */ shadow_map, /* mipmap level */ 0);
+        // recupere une seule fois les identifiants des uniforms
+        m_uniforms.dt= uniform_handle<float>(m_program, "dt");
+        m_uniforms.position_offset= uniform_handle<Point>(m_program, "position_offset");
+        m_uniforms.position_scale= uniform_handle<Vector>(m_program, "position_scale");
+        m_uniforms.vertex_count= uniform_handle<int>(m_program, "vertex_count");
+        m_uniforms.inv_view= uniform_handle<Transform>(m_program, "invViewMatrix");
+        m_uniforms.light_pos= uniform_handle<vec4>(m_program, "lightPos");
+        m_uniforms.light_color= uniform_handle<vec4>(m_program, "lightColor");
+        m_uniforms.view= uniform_handle<Transform>(m_program, "viewMatrix");
+
+        m_static_uniforms.model= uniform_handle<Transform>(m_program2, "modelMatrix");
+        m_static_uniforms.mvp= uniform_handle<Transform>(m_program2, "mvpMatrix");
+        m_static_uniforms.view= uniform_handle<Transform>(m_program2, "viewMatrix");
+        m_static_uniforms.inv_view= uniform_handle<Transform>(m_program2, "invViewMatrix");
+        m_static_uniforms.light_pos= uniform_handle<vec4>(m_program2, "lightPos");
+        m_static_uniforms.light_color= uniform_handle<vec4>(m_program2, "lightColor");
+
+        m_shadow_uniforms.dt= uniform_handle<float>(m_program_shadow, "dt");
+        m_shadow_uniforms.position_offset= uniform_handle<Point>(m_program_shadow, "position_offset");
+        m_shadow_uniforms.position_scale= uniform_handle<Vector>(m_program_shadow, "position_scale");
+        m_shadow_uniforms.vertex_count= uniform_handle<int>(m_program_shadow, "vertex_count");
+        m_shadow_uniforms.light= uniform_handle<Transform>(m_program_shadow, "lightMatrix");
+
+        m_shadow2_mvp= uniform_handle<Transform>(m_program_shadow2, "mvpMatrix");
+
+        // transformations des instances, re-ecrites a chaque image
+        m_instances.create(GL_SHADER_STORAGE_BUFFER, sizeof(instanceData) * 64);
+
+        // shadow maps : 3 cascades 1024x1024, ajustees a chaque image sur la region visible par la camera
+        if(m_shadows.create(1024, 3) < 0)
+            return -1;
+        printf("shadow maps: %d cascades, %.1fMo (vs %.1fMo)\n", m_shadows.cascades(),
+            float(m_shadows.memory()) / 1024 / 1024, float(25 * window_width() * window_height() * 4) / 1024 / 1024);
+
         // etat openGL par defaut
         glClearColor(0.2f, 0.2f, 0.2f, 1.f);        // couleur par defaut de la fenetre
 
@@ -441,10 +469,11 @@ public:
         release_program(m_program2);
         release_program(m_program_shadow);
         release_program(m_program_shadow2);
+        m_instances.release();
+        if(m_instances.stalls())
+            printf("instances: %d stalls, %dus\n", m_instances.stalls(), int(m_instances.stall_time()));
         // nettoyage
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-        glDeleteTextures(1, &shadow_map);
-        glDeleteTextures(1, &color_texture);
+        m_shadows.release();
 
         return 0;
     }
@@ -458,7 +487,7 @@ public:
         // deplace la camera
 
         int mx, my;
-        unsigned int mb= SDL_GetRelativeMouseState(&mx, &my);
+        unsigned int mb= relative_mouse_state(&mx, &my);
         if(mb & SDL_BUTTON(1))              // le bouton gauche est enfonce
             m_camera.rotation(mx, my);
         else if(mb & SDL_BUTTON(3))         // le bouton droit est enfonce
@@ -479,10 +508,6 @@ public:
             t1 = t0 + 1000/24.f;
         }
 
-        Transform ortho = Ortho(-30.0f,30.0f,-30.0f,30.0f,0.0001f,1000.0f);
-        Transform orthoView = Lookat(Point(50,250,0), Origin(), Vector(0,0,1));
-        Transform invOrthoView = Inverse(orthoView);
-
         Transform view = m_camera.view();
         Transform projection = m_camera.projection(window_width(), window_height(), 45);
 
@@ -490,133 +515,121 @@ public:
 
         Transform invView = Inverse(view);
 
+        // transformations des instances, utilisees par les 2 passes
+        if(frames.size() * sizeof(instanceData) > m_instances.region_size())
+            m_instances.create(GL_SHADER_STORAGE_BUFFER, 2 * frames.size() * sizeof(instanceData));
 
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
-
-        glViewport(0,0, window_width() * 5, window_height() * 5);
-
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glUseProgram(m_program_shadow);
-        glBindVertexArray(m_objet.vao);
-        int location;
-
-        location= glGetUniformLocation(m_program_shadow, "dt");
-        glUniform1f(location, dt);
-        location= glGetUniformLocation(m_program_shadow, "viewMatrix");
-        glUniformMatrix4fv(location, 1, GL_TRUE, orthoView.buffer());
-        location= glGetUniformLocation(m_program_shadow, "invViewMatrix");
-        glUniformMatrix4fv(location, 1, GL_TRUE, invOrthoView.buffer());
-        location= glGetUniformLocation(m_program_shadow, "lightPos");
-        glUniform4f(location,50.f,250.f,0.f,1.f);
-
+        // et englobant des objets qui projettent des ombres
+        Point casters_min, casters_max;
+        m_floor.bounds(casters_min, casters_max);
 
+        size_t instances_offset;
+        instanceData *instances= m_instances.allocate<instanceData>(frames.size(), instances_offset);
         for (size_t i = 0 ; i < frames.size() ; i++) {
             Transform model = Identity() * Translation(i*5, 0,0)  * RotationY(i * (360/frames.size()));
-            Transform mvo = ortho * orthoView * model;
-            location= glGetUniformLocation(m_program_shadow, "modelMatrix");
-            glUniformMatrix4fv(location, 1, GL_TRUE, model.buffer());
-            location= glGetUniformLocation(m_program_shadow, "mvpMatrix");
-            glUniformMatrix4fv(location, 1, GL_TRUE, mvo.buffer());
-            glDrawArrays(GL_TRIANGLES, frames[i] * 2 * m_objet.count , m_objet.count);
+            instances[i].model= model;
+            instances[i].mvp= projection * view * model;
+            instances[i].frame= frames[i];
+
+            for (int k = 0; k < 8; k++) {
+                Point p= model(Point((k & 1) ? m_objet.pmax.x : m_objet.pmin.x, (k & 2) ? m_objet.pmax.y : m_objet.pmin.y, (k & 4) ? m_objet.pmax.z : m_objet.pmin.z));
+                casters_min = min(casters_min, p);
+                casters_max = max(casters_max, p);
+            }
+        }
+        m_instances.flush();
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, m_instances.buffer(), instances_offset, frames.size() * sizeof(instanceData));
+        // sommets des frames
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_objet.buffer);
+
+        {
+            PROFILE_SCOPE("shadow pass");
+            PROFILE_GPU_SCOPE("shadow pass");
+
+            // ajuste les cascades sur la region visible par la camera, lumiere directionnelle
+            Vector light_direction = Vector(Point(50,250,0), Origin());
+            m_shadows.fit(view, projection, light_direction, casters_min, casters_max);
+
+            // le sol est statique : il n'est dessine que si les cascades changent
+            if (!m_shadows.static_valid()) {
+                glUseProgram(m_program_shadow2);
+                glBindVertexArray(m_objet2.vao);
+
+                for (int c = 0; c < m_shadows.cascades(); c++) {
+                    m_shadows.bind_static(c);
+                    program_uniform(m_shadow2_mvp, m_shadows.transform(c));
+                    glDrawArrays(GL_TRIANGLES, 0 , m_objet2.count);
+                }
+                m_shadows.validate_static();
+            }
+
+            // les robots sont dessines dans chaque cascade, un seul draw pour tous les robots,
+            // gl_InstanceID selectionne les transformations et la frame
+            glUseProgram(m_program_shadow);
+            glBindVertexArray(m_objet.vao);
+
+            program_uniform(m_shadow_uniforms.dt, dt);
+            program_uniform(m_shadow_uniforms.position_offset, m_objet.position_offset);
+            program_uniform(m_shadow_uniforms.position_scale, m_objet.position_scale);
+            program_uniform(m_shadow_uniforms.vertex_count, m_objet.count);
+
+            for (int c = 0; c < m_shadows.cascades(); c++) {
+                m_shadows.bind(c);
+                program_uniform(m_shadow_uniforms.light, m_shadows.transform(c));
+                glDrawArraysInstanced(GL_TRIANGLES, 0, m_objet.count, frames.size());
+            }
         }
-
-        glUseProgram(m_program_shadow2);
-        glBindVertexArray(m_objet2.vao);
-
-        location= glGetUniformLocation(m_program_shadow2, "viewMatrix");
-        glUniformMatrix4fv(location, 1, GL_TRUE, orthoView.buffer());
-        location= glGetUniformLocation(m_program_shadow2, "invViewMatrix");
-        glUniformMatrix4fv(location, 1, GL_TRUE, invOrthoView.buffer());
-        location= glGetUniformLocation(m_program_shadow2, "lightPos");
-        glUniform4f(location,250.f,50.f,0.f,1.f);
-
-        Transform model = Identity();
-        Transform mvo = ortho * orthoView * model;
-        location= glGetUniformLocation(m_program_shadow2, "modelMatrix");
-        glUniformMatrix4fv(location, 1, GL_TRUE, model.buffer());
-        location= glGetUniformLocation(m_program_shadow2, "mvpMatrix");
-        glUniformMatrix4fv(location, 1, GL_TRUE, mvo.buffer());
-        glDrawArrays(GL_TRIANGLES, 0 , m_objet2.count);
-
-        /*
-
-
-        */
 
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 
-        glViewport(0,0, window_width(), window_height());
+        {
+            PROFILE_SCOPE("main pass");
+            PROFILE_GPU_SCOPE("main pass");
 
-        glUseProgram(m_program);
-        glBindVertexArray(m_objet.vao);
+            glViewport(0,0, window_width(), window_height());
 
-        location= glGetUniformLocation(m_program, "dt");
-        glUniform1f(location, dt);
-        location= glGetUniformLocation(m_program, "viewMatrix");
-        glUniformMatrix4fv(location, 1, GL_TRUE, view.buffer());
-        location= glGetUniformLocation(m_program, "invViewMatrix");
-        glUniformMatrix4fv(location, 1, GL_TRUE, invView.buffer());
-        location= glGetUniformLocation(m_program, "lightPos");
-        glUniform4f(location,50.f,250.f,0.f,1.f);
-        location= glGetUniformLocation(m_program, "lightColor");
-        glUniform4f(location,1.f,1.f,1.f,1.f);
-        // dessiner les triangles de l'objet
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objet.materials_buffer);
+            glUseProgram(m_program);
+            glBindVertexArray(m_objet.vao);
 
-        glBindTexture(GL_TEXTURE_2D, shadow_map);
-
-        location= glGetUniformLocation(m_program, "shadowMap");
-        glUniform1i(location, 0);   // utilise la texture selectionnee sur l'unite 0
-
-
-        for (size_t i = 0 ; i < frames.size() ; i++) {
-            Transform model = Identity() * Translation(i*5, 0,0)  * RotationY(i * (360/frames.size()));
-            Transform mvp = projection * view * model;
-            Transform mvo = ortho * orthoView * model;
-            location= glGetUniformLocation(m_program, "modelMatrix");
-            glUniformMatrix4fv(location, 1, GL_TRUE, model.buffer());
-            location= glGetUniformLocation(m_program, "mvpMatrix");
-            glUniformMatrix4fv(location, 1, GL_TRUE, mvp.buffer());
-            location= glGetUniformLocation(m_program, "sourceMatrix");
-            glUniformMatrix4fv(location, 1, GL_TRUE, (Viewport(1,1) * mvo).buffer());
-            glDrawArrays(GL_TRIANGLES, frames[i] * 2 * m_objet.count , m_objet.count);
-        }
+            program_uniform(m_uniforms.dt, dt);
+            program_uniform(m_uniforms.position_offset, m_objet.position_offset);
+            program_uniform(m_uniforms.position_scale, m_objet.position_scale);
+            program_uniform(m_uniforms.vertex_count, m_objet.count);
+            program_uniform(m_uniforms.view, view);
+            program_uniform(m_uniforms.inv_view, invView);
+            program_uniform(m_uniforms.light_pos, vec4(50.f,250.f,0.f,1.f));
+            program_uniform(m_uniforms.light_color, vec4(1.f,1.f,1.f,1.f));
+            // dessiner les triangles de l'objet
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objet.materials_buffer);
 
-        glBindTexture(GL_TEXTURE_2D, 0);
+            // utilise les shadow maps sur l'unite 0
+            m_shadows.use(m_program, 0);
 
-        glUseProgram(m_program2);
-        glBindVertexArray(m_objet2.vao);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, m_objet.count, frames.size());
 
-        location= glGetUniformLocation(m_program2, "viewMatrix");
-        glUniformMatrix4fv(location, 1, GL_TRUE, view.buffer());
-        location= glGetUniformLocation(m_program2, "invViewMatrix");
-        glUniformMatrix4fv(location, 1, GL_TRUE, invView.buffer());
-        location= glGetUniformLocation(m_program2, "lightPos");
-        glUniform4f(location,250.f,50.f,0.f,1.f);
-        location= glGetUniformLocation(m_program2, "lightColor");
-        glUniform4f(location,1.f,1.f,1.f,1.f);
-        // dessiner les triangles de l'objet
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objet2.materials_buffer);
+            glUseProgram(m_program2);
+            glBindVertexArray(m_objet2.vao);
 
-        model = Identity();
-        Transform mvp = projection * view * model;
-        Transform mvo2 = ortho * orthoView * model;
-        location= glGetUniformLocation(m_program2, "modelMatrix");
-        glUniformMatrix4fv(location, 1, GL_TRUE, model.buffer());
-        location= glGetUniformLocation(m_program2, "mvpMatrix");
-        glUniformMatrix4fv(location, 1, GL_TRUE, mvp.buffer());
+            program_uniform(m_static_uniforms.view, view);
+            program_uniform(m_static_uniforms.inv_view, invView);
+            program_uniform(m_static_uniforms.light_pos, vec4(250.f,50.f,0.f,1.f));
+            program_uniform(m_static_uniforms.light_color, vec4(1.f,1.f,1.f,1.f));
+            // dessiner les triangles de l'objet
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objet2.materials_buffer);
 
-        glBindTexture(GL_TEXTURE_2D, shadow_map);
+            Transform model = Identity();
+            Transform mvp = projection * view * model;
+            program_uniform(m_static_uniforms.model, model);
+            program_uniform(m_static_uniforms.mvp, mvp);
 
-        location= glGetUniformLocation(m_program2, "shadowMap");
-        glUniform1i(location, 0);   // utilise la texture selectionnee sur l'unite 0
+            m_shadows.use(m_program2, 0);
 
-        location= glGetUniformLocation(m_program2, "sourceMatrix");
-        glUniformMatrix4fv(location, 1, GL_TRUE, (Viewport(1,1) * mvo2).buffer());
+            glDrawArrays(GL_TRIANGLES, 0 , m_objet2.count);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        }
 
-        glDrawArrays(GL_TRIANGLES, 0 , m_objet2.count);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        // la prochaine image ecrit les transformations dans une autre region
+        m_instances.next_frame();
         return 1;
     }
 
@@ -626,9 +639,27 @@ protected:
     Buffers m_objet, m_objet2;
     GLuint m_program, m_program2;
     GLuint m_program_shadow, m_program_shadow2;
-    GLuint framebuffer;
-    GLuint color_texture;
-    GLuint shadow_map;
+    StreamBuffer m_instances;
+
+    // uniforms des shaders
+    struct {
+        UniformHandle<float> dt;
+        UniformHandle<Point> position_offset;
+        UniformHandle<Vector> position_scale;
+        UniformHandle<int> vertex_count;
+        UniformHandle<Transform> view, inv_view;
+        UniformHandle<vec4> light_pos, light_color;
+        UniformHandle<Transform> light;
+    } m_uniforms, m_shadow_uniforms;
+
+    struct {
+        UniformHandle<Transform> model, mvp;
+        UniformHandle<Transform> view, inv_view;
+        UniformHandle<vec4> light_pos, light_color;
+    } m_static_uniforms;
+
+    UniformHandle<Transform> m_shadow2_mvp;
+    CascadedShadowMap m_shadows;
     Orbiter m_camera;
     std::vector<int> frames ;
     float t0,t1,dt;
@@ -637,9 +668,16 @@ protected:
 
 int main( int argc, char **argv )
 {
+    // tp1_keyframes trace.json : mesure les etapes de chaque image, a visualiser avec chrome://tracing
+    if(argc > 1)
+        profiler_enable(true);
+
     // il ne reste plus qu'a creer un objet application et la lancer
     TP tp;
     tp.run();
 
+    if(argc > 1)
+        profiler_write(argv[1]);
+
     return 0;
 }
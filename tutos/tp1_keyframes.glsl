@@ -11,34 +11,74 @@ layout(std430, binding = 0) readonly buffer materialsData
     material data[];
 };
 #ifdef VERTEX_SHADER
-layout(location= 0) in vec3 position;
-layout(location= 1) in vec3 normal;
-layout(location= 2) in vec3 position2;
-layout(location= 3) in vec3 normal2;
-uniform mat4 mvpMatrix;
-uniform mat4 modelMatrix;
-uniform mat4 viewMaxtrix;
+// sommets compacts des frames, cf KeyframeVertex dans tp1_keyframes.cpp : position 3x16 bits dans l'englobant des frames, normale octaedrique 2x8 bits
+layout(std430, binding = 2) readonly buffer keyframesData
+{
+    uvec2 keyframes[];
+};
+uniform int vertex_count;
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+
+vec3 oct_decode( const vec2 e )
+{
+    vec3 n= vec3(e.x, e.y, 1 - abs(e.x) - abs(e.y));
+    if(n.z < 0)
+        n.xy= (1 - abs(n.yx)) * vec2(n.x >= 0 ? 1 : -1, n.y >= 0 ? 1 : -1);
+    return normalize(n);
+}
+// position dans [0 1] et normale d'un sommet d'une frame
+void keyframe_vertex( const int frame, out vec3 position, out vec2 normal )
+{
+    uvec2 data= keyframes[frame * vertex_count + gl_VertexID];
+    position= vec3(data.x & 0xffffu, data.x >> 16, data.y & 0xffffu) / 65535.0;
+    normal= unpackSnorm4x8(data.y).zw;
+}
+
+struct Instance
+{
+    mat4 model;
+    mat4 mvp;
+    int frame;      // frame de l'animation
+};
+
+// transformations des instances, cf instanceData dans tp1_keyframes.cpp
+layout(std430, row_major, binding = 1) readonly buffer instancesData
+{
+    Instance instances[];
+};
+
+uniform mat4 viewMatrix;
 uniform mat4 invViewMatrix;
 uniform vec4 lightPos;
 uniform float dt;
-uniform mat4 sourceMatrix;
 
 out vec3 n;
 out vec3 l;
 out vec3 v;
-out vec3 p;
+out vec3 p;         // position dans le repere monde
+out float depth;    // distance a la camera
 
 void main( )
 {
-    vec3 pos= position * (1-dt) + position2*dt;
-    gl_Position= mvpMatrix * vec4(pos, 1);
+    // interpole la frame de l'instance et la suivante
+    int instance= gl_InstanceID;
+    vec3 position, position2;
+    vec2 normal, normal2;
+    keyframe_vertex(instances[instance].frame, position, normal);
+    keyframe_vertex(instances[instance].frame +1, position2, normal2);
+
+    mat4 modelMatrix= instances[instance].model;
+    vec3 pos= position_offset + (position * (1-dt) + position2*dt) * position_scale;
+    gl_Position= instances[instance].mvp * vec4(pos, 1);
 
-    vec3 norm = normal * (1-dt) + normal2*dt;
+    vec3 norm = oct_decode(normal) * (1-dt) + oct_decode(normal2)*dt;
 
     n = mat3(modelMatrix) * norm;
     l = vec3(lightPos) - vec3(modelMatrix * vec4(pos, 1));
     v = vec3(invViewMatrix * vec4(0,0,0,1)) - vec3(modelMatrix * vec4(pos, 1));
-    p = vec3(sourceMatrix * vec4(pos + (0.1 * norm),1));
+    p = vec3(modelMatrix * vec4(pos, 1));
+    depth = -(viewMatrix * vec4(p, 1)).z;
 }
 
 #endif
@@ -47,17 +87,35 @@ void main( )
 #ifdef FRAGMENT_SHADER
 out vec4 fragment_color;
 uniform vec4 lightColor;
-uniform sampler2D shadowMap;
+
+// shadow maps en cascades, cf CascadedShadowMap
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[4];
+uniform vec4 shadowSplits;
+uniform vec4 shadowBias;
+
+// renvoie la fraction de lumiere qui eclaire le point p, de normale n, a une distance depth de la camera
+float shadow( const vec3 p, const vec3 n, const float depth )
+{
+    // selectionne la cascade en fonction de la distance a la camera
+    int cascade= 0;
+    while(cascade < 3 && depth > shadowSplits[cascade])
+        cascade++;
+
+    vec4 s= shadowMatrices[cascade] * vec4(p + n * shadowBias[cascade], 1);
+    return texture(shadowMap, vec4(s.xy, cascade, s.z));
+}
+
 in vec3 n;
 in vec3 l;
 in vec3 v;
 in vec3 p;
+in float depth;
 
 void main( )
 {
-    float depth = texture(shadowMap, p.xy).x;
-
-    float shadow = 1.f;
+    vec3 N = normalize(n);
+    float visibility = 0.2f + 0.8f * shadow(p, N, depth);
 
 //    vec2 poissonDisk[4] = vec2[](
 //      vec2( -0.94201624, -0.39906216 ),
@@ -73,11 +131,6 @@ void main( )
 //    }
 
 
-    if (depth < p.z) {
-        shadow = 0.2f;
-    }
-
-    vec3 N = normalize(n);
     vec3 L = normalize(l);
     vec3 V = normalize(v);
     vec3 ambient = vec3(lightColor * data[gl_PrimitiveID].ambient);
@@ -99,7 +152,7 @@ void main( )
 
     vec3 result = ambient + diffuse + specular * diff;
 
-    fragment_color= vec4(shadow * result,1);
+    fragment_color= vec4(visibility * result,1);
 }
 
 #endif
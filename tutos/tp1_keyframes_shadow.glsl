@@ -1,11 +1,43 @@
 #version 430
 #ifdef VERTEX_SHADER
-layout(location= 0) in vec3 position;
-layout(location= 1) in vec3 normal;
-layout(location= 2) in vec3 position2;
-layout(location= 3) in vec3 normal2;
-uniform mat4 mvpMatrix;
-uniform mat4 modelMatrix;
+// sommets compacts des frames, cf KeyframeVertex dans tp1_keyframes.cpp : position 3x16 bits dans l'englobant des frames, normale octaedrique 2x8 bits
+layout(std430, binding = 2) readonly buffer keyframesData
+{
+    uvec2 keyframes[];
+};
+uniform int vertex_count;
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+
+vec3 oct_decode( const vec2 e )
+{
+    vec3 n= vec3(e.x, e.y, 1 - abs(e.x) - abs(e.y));
+    if(n.z < 0)
+        n.xy= (1 - abs(n.yx)) * vec2(n.x >= 0 ? 1 : -1, n.y >= 0 ? 1 : -1);
+    return normalize(n);
+}
+// position dans [0 1] et normale d'un sommet d'une frame
+void keyframe_vertex( const int frame, out vec3 position, out vec2 normal )
+{
+    uvec2 data= keyframes[frame * vertex_count + gl_VertexID];
+    position= vec3(data.x & 0xffffu, data.x >> 16, data.y & 0xffffu) / 65535.0;
+    normal= unpackSnorm4x8(data.y).zw;
+}
+
+struct Instance
+{
+    mat4 model;
+    mat4 mvp;
+    int frame;      // frame de l'animation
+};
+
+// transformations des instances, cf instanceData dans tp1_keyframes.cpp
+layout(std430, row_major, binding = 1) readonly buffer instancesData
+{
+    Instance instances[];
+};
+
+uniform mat4 lightMatrix;     // cascade, cf CascadedShadowMap::transform( )
 uniform mat4 viewMaxtrix;
 uniform mat4 invViewMatrix;
 uniform vec4 lightPos;
@@ -17,10 +49,18 @@ out vec3 v;
 
 void main( )
 {
-    vec3 p= position * (1-dt) + position2*dt;
-    gl_Position= mvpMatrix * vec4(p, 1);
+    // interpole la frame de l'instance et la suivante
+    int instance= gl_InstanceID;
+    vec3 position, position2;
+    vec2 normal, normal2;
+    keyframe_vertex(instances[instance].frame, position, normal);
+    keyframe_vertex(instances[instance].frame +1, position2, normal2);
+
+    mat4 modelMatrix= instances[instance].model;
+    vec3 p= position_offset + (position * (1-dt) + position2*dt) * position_scale;
+    gl_Position= lightMatrix * modelMatrix * vec4(p, 1);
 
-    vec3 norm = normal * (1-dt) + normal2*dt;
+    vec3 norm = oct_decode(normal) * (1-dt) + oct_decode(normal2)*dt;
 
     n = mat3(modelMatrix) * norm;
     l = vec3(lightPos) - vec3(modelMatrix * vec4(p, 1));
@@ -15,15 +15,15 @@ layout(location= 0) in vec3 position;
 layout(location= 1) in vec3 normal;
 uniform mat4 mvpMatrix;
 uniform mat4 modelMatrix;
-uniform mat4 viewMaxtrix;
+uniform mat4 viewMatrix;
 uniform mat4 invViewMatrix;
 uniform vec4 lightPos;
-uniform mat4 sourceMatrix;
 
 out vec3 n;
 out vec3 l;
 out vec3 v;
-out vec3 p;
+out vec3 p;         // position dans le repere monde
+out float depth;    // distance a la camera
 
 void main( )
 {
@@ -34,7 +34,8 @@ void main( )
     n = mat3(modelMatrix) * normal;
     l = vec3(lightPos) - vec3(modelMatrix * vec4(pos, 1));
     v = vec3(invViewMatrix * vec4(0,0,0,1)) - vec3(modelMatrix * vec4(pos, 1));
-    p = vec3(sourceMatrix * vec4(pos + (0.1 * normal),1));
+    p = vec3(modelMatrix * vec4(pos, 1));
+    depth = -(viewMatrix * vec4(p, 1)).z;
 }
 
 #endif
@@ -43,28 +44,38 @@ void main( )
 #ifdef FRAGMENT_SHADER
 out vec4 fragment_color;
 uniform vec4 lightColor;
-uniform sampler2D shadowMap;
+
+// shadow maps en cascades, cf CascadedShadowMap
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[4];
+uniform vec4 shadowSplits;
+uniform vec4 shadowBias;
+
+// renvoie la fraction de lumiere qui eclaire le point p, de normale n, a une distance depth de la camera
+float shadow( const vec3 p, const vec3 n, const float depth )
+{
+    // selectionne la cascade en fonction de la distance a la camera
+    int cascade= 0;
+    while(cascade < 3 && depth > shadowSplits[cascade])
+        cascade++;
+
+    vec4 s= shadowMatrices[cascade] * vec4(p + n * shadowBias[cascade], 1);
+    return texture(shadowMap, vec4(s.xy, cascade, s.z));
+}
+
 in vec3 n;
 in vec3 l;
 in vec3 v;
 in vec3 p;
+in float depth;
 
 void main( )
 {
 //    fragment_color= vec4(p.xy, 0, 1);
 //            return;
 
-    float depth = texture(shadowMap, p.xy).x;
-
-    float shadow;
-
-    if (depth < p.z) {
-        shadow = 0.2f;
-    } else {
-        shadow = 1.f;
-    }
-
     vec3 N = normalize(n);
+    float visibility = 0.2f + 0.8f * shadow(p, N, depth);
     vec3 L = normalize(l);
     vec3 V = normalize(v);
     vec3 ambient = vec3(lightColor * data[gl_PrimitiveID].ambient);
@@ -86,7 +97,7 @@ void main( )
 
     vec3 result = diffuse + specular * diff;
 
-    fragment_color= vec4(shadow * result,1);
+    fragment_color= vec4(visibility * result,1);
 }
 
 #endif